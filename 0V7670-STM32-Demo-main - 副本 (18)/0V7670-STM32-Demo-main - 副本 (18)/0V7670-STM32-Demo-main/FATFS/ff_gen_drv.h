@@ -53,6 +53,7 @@
 #endif
 
 /* Includes ------------------------------------------------------------------*/
+#include "stm32f10x.h"
 #include "diskio.h"
 #include "ff.h"
 
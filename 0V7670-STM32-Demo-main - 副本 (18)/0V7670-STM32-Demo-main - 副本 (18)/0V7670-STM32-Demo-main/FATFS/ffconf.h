@@ -22,7 +22,9 @@
 /*-----------------------------------------------------------------------------/
 / Additional user header to be used
 /-----------------------------------------------------------------------------*/
-#include "stm32f10x.h"
+#if defined(__CC_ARM)
+#include "stm32f10x.h"	/* Device header on the target only; host tests build FatFs without it */
+#endif
 
 /*-----------------------------------------------------------------------------/
 / Functions and Buffer Configurations
@@ -68,6 +70,9 @@
 #define _USE_FASTSEEK        1
 /* This option switches fast seek feature. (0:Disable or 1:Enable) */
 
+#define _USE_EXPAND          1
+/* This option switches f_expand() function, backported from R0.12. (0:Disable or 1:Enable) */
+
 #define _USE_LABEL           0
 /* This option switches volume label functions, f_getlabel() and f_setlabel().
 /  (0:Disable or 1:Enable) */
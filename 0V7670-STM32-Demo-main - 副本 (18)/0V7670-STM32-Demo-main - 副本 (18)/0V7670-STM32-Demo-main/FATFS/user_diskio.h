@@ -30,7 +30,27 @@
 
 /* Includes ------------------------------------------------------------------*/
 /* Exported types ------------------------------------------------------------*/
+/* Write-behind cache counters, returned by disk_ioctl(CTRL_CACHE_STATS) */
+typedef struct
+{
+  DWORD write_hits;       /* Single-sector writes to a sector already cached */
+  DWORD write_misses;     /* Single-sector writes that took a new cache slot */
+  DWORD read_hits;        /* Sectors read from the cache instead of the card */
+  DWORD read_misses;      /* disk_read calls that went to the card */
+  DWORD flushes;          /* Runs of adjacent sectors written from the cache */
+  DWORD flushed_sectors;  /* Sectors written by those runs */
+} USER_CacheStatsTypeDef;
+
 /* Exported constants --------------------------------------------------------*/
+/* Write-behind cache size in 512-byte sectors (RAM budget); 0 writes through */
+#ifndef USER_CACHE_SECTORS
+#define USER_CACHE_SECTORS   4
+#endif
+
+/* Driver-specific disk_ioctl codes */
+#define CTRL_CACHE_STATS     64  /* Copy the counters to (USER_CacheStatsTypeDef *)buff */
+#define CTRL_CACHE_RESET     65  /* Clear the counters */
+
 /* Exported functions ------------------------------------------------------- */
 extern Diskio_drvTypeDef  USER_Driver;
 
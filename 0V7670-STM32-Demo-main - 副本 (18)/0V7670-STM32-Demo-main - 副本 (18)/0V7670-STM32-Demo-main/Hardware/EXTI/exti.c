@@ -1,8 +1,27 @@
 #include "exti.h"
-#include "ov7670.h"
+#include "OV7670.h"
+#include "frame.h"
+#include <stddef.h>
 
+static void FIFO_WriteStart(void)
+{
+	FIFO_WRST = 0;														//复位写指针		  		 
+	FIFO_WRST = 1;	
+	FIFO_WEN = 1;														//允许写入FIFO 	  
+}
+
+static void FIFO_WriteStop(void)
+{
+	FIFO_WEN = 0;
+	FIFO_WRST = 0;
+	FIFO_WRST = 1;
+}
+
+//配置已生效（且舍弃帧已过）的第一帧才开始写入
+static Frame_ConfigTypeDef FIFO_Frame = {FIFO_WriteStart, FIFO_WriteStop, OV7670_VsyncUpdate, NULL};
 
-void mEXTI_Init(void)
+
+void mEXTI_Init(void (*frame_event)(Frame_EventTypeDef ev, const Frame_InfoTypeDef *info))
 {
     GPIO_InitTypeDef GPIO_InitStructure;
     EXTI_InitTypeDef EXTI_InitStructure;
@@ -24,6 +43,8 @@ void mEXTI_Init(void)
     EXTI_InitStructure.EXTI_Trigger = EXTI_Trigger_Rising;				//上升沿中断
     EXTI_InitStructure.EXTI_LineCmd = ENABLE;							//使能中断
     EXTI_Init(&EXTI_InitStructure);
+    FIFO_Frame.event = frame_event;
+    Frame_Init(&FIFO_Frame);											//帧状态机回到IDLE，之后才打开中断
     
     NVIC_InitStructure.NVIC_IRQChannel = EXTI2_IRQn;					//使能外部中断所在的通道
     NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;			//抢占优先级0 
@@ -34,23 +55,15 @@ void mEXTI_Init(void)
 
 void EXTI2_IRQHandler(void)
 {
+	uint32_t now = DWT_CYCCNT;
+
 	if(EXTI_GetITStatus(EXTI_Line2) == SET)								//是8线的中断
 	{      
-		if(OV7670_STA < 2)
-		{
-			if(OV7670_STA == 0)
-			{
-				FIFO_WRST = 0;											//复位写指针		  		 
-				FIFO_WRST = 1;	
-				FIFO_WEN = 1;											//允许写入FIFO 	  
-			}else
-			{
-				FIFO_WEN = 0;
-				FIFO_WRST = 0;
-				FIFO_WRST = 1;
-			}
-			OV7670_STA++;												//帧中断加1 
-		}
+		if(OV7670_FrameCount)											//两次VSYNC的间隔即实际帧周期
+			OV7670_VsyncPeriod = now - OV7670_VsyncAt;
+		OV7670_VsyncAt = now;
+		OV7670_FrameCount++;
+		Frame_Vsync(now);												//停止/开始写入FIFO，之间切换传感器配置
 	}
 	EXTI_ClearITPendingBit(EXTI_Line2);									//清除EXTI8线路挂起位						
 }
@@ -1,7 +1,9 @@
 #ifndef _EXTI_H
 #define _EXTI_H
 #include "sys.h"
+#include "frame.h"
 
-void mEXTI_Init(void);
+//frame_event：帧状态变化时在VSYNC中断中调用（例如向任务投递事件），可为NULL
+void mEXTI_Init(void (*frame_event)(Frame_EventTypeDef ev, const Frame_InfoTypeDef *info));
 
 #endif
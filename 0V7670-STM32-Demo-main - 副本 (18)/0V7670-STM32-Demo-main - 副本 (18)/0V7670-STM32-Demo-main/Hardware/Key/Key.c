@@ -1,5 +1,6 @@
 #include "stm32f10x.h"                  // Device header
 #include "delay.h"
+#include "Key.h"
 /**
   * 函    数：按键初始化
   * 参    数：无
@@ -86,3 +87,41 @@ uint8_t Key_GetNum(void)
 
     return KeyNum;  // 返回键码值，如果没有按键按下，所有if都不成立，则键码为默认值0
 }
+
+/**
+  * 函    数：读取当前按下的按键（不消抖）
+  * 返 回 值：键码1~5，同时按下多个时取键码最大的，0代表没有按键按下
+  */
+static uint8_t Key_Read(void)
+{
+    if (GPIO_ReadInputDataBit(GPIOB, GPIO_Pin_7) == 0) {return 5;}
+    if (GPIO_ReadInputDataBit(GPIOB, GPIO_Pin_6) == 0) {return 4;}
+    if (GPIO_ReadInputDataBit(GPIOC, GPIO_Pin_15) == 0) {return 3;}
+    if (GPIO_ReadInputDataBit(GPIOC, GPIO_Pin_14) == 0) {return 2;}
+    if (GPIO_ReadInputDataBit(GPIOA, GPIO_Pin_8) == 0) {return 1;}
+    return 0;
+}
+
+/**
+  * 函    数：按键扫描（非阻塞），每KEY_SCAN_MS毫秒调用一次
+  * 返 回 值：按下的瞬间返回键码1~5，其余时间返回0
+  * 注意事项：连续KEY_DEBOUNCE_SCANS次读到同一个状态才认为稳定（代替delay_ms消抖），
+  *           按下时即返回，不等待松手；松手稳定之后才能再次返回
+  */
+uint8_t Key_Scan(void)
+{
+    static uint8_t Stable, Last, Count;
+    uint8_t Now = Key_Read();
+    
+    if (Now != Last)
+    {
+        Last = Now;
+        Count = 0;
+        return 0;
+    }
+    if (Count < KEY_DEBOUNCE_SCANS) {Count ++;}
+    if (Count < KEY_DEBOUNCE_SCANS || Now == Stable) {return 0;}
+    
+    Stable = Now;
+    return Now;  // 松手（Now为0）时同样返回0
+}
@@ -1,7 +1,13 @@
 #ifndef __KEY_H
 #define __KEY_H
 
+#include <stdint.h>
+
+#define KEY_SCAN_MS         10      // Key_Scan的调用间隔
+#define KEY_DEBOUNCE_SCANS  2       // 消抖：连续2次（20ms）状态相同
+
 void Key_Init(void);
-uint8_t Key_GetNum(void);
+uint8_t Key_GetNum(void);           // 阻塞式，等待松手
+uint8_t Key_Scan(void);             // 非阻塞，由定时任务周期调用
 
 #endif
@@ -30,4 +30,30 @@ void LED_Init(void)
     GPIO_SetBits(GPIOB, GPIO_Pin_3 | GPIO_Pin_4);  //设置PB3和PB4引脚为高电平
 }
 
-
+/**
+  * 函    数：设置补光模式
+  * 参    数：light_mode 1=不补光, 2=可见光补光(PB3), 3=红外光补光(PB4)
+  * 返 回 值：无
+  * 注意事项：补光灯低电平点亮，PA15保持高电平
+  */
+void LED_SetFillLight(uint8_t light_mode)
+{
+    GPIO_SetBits(GPIOA, GPIO_Pin_15);  //PA15=高，关闭补光
+    
+    switch (light_mode)
+    {
+        case 2:  //可见光补光
+            GPIO_SetBits(GPIOB, GPIO_Pin_4);    //PB4=高，关闭红外
+            GPIO_ResetBits(GPIOB, GPIO_Pin_3);  //PB3=低，开启可见光
+            break;
+        
+        case 3:  //红外光补光
+            GPIO_SetBits(GPIOB, GPIO_Pin_3);    //PB3=高，关闭可见光
+            GPIO_ResetBits(GPIOB, GPIO_Pin_4);  //PB4=低，开启红外
+            break;
+        
+        default: //不补光
+            GPIO_SetBits(GPIOB, GPIO_Pin_3 | GPIO_Pin_4);
+            break;
+    }
+}
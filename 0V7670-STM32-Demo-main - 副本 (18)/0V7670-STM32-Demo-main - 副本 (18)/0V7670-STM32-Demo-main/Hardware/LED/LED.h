@@ -2,6 +2,7 @@
 #define __LED_H
 
 void LED_Init(void);
+void LED_SetFillLight(uint8_t light_mode);
 
 
 #endif
@@ -0,0 +1,275 @@
+#include "FIFO.h"
+#include "OV7670.h"
+#include "delay.h"
+
+uint32_t FIFO_LineCycles;
+uint32_t FIFO_LineCyclesMax;
+static uint32_t FIFO_StartCycles;			//本行FIFO_LineStart耗用的周期数
+
+#if FIFO_READ_MODE == FIFO_READ_DMA
+
+//PB5在复位读指针时作为普通输出，读数据时切换为TIM3_CH2复用输出（TIM3部分重映射）
+#define FIFO_RCLK_OUT()			{GPIOB->CRL &= 0XFF0FFFFF;GPIOB->CRL |= 0X00300000;}
+#define FIFO_RCLK_AF()			{FIFO_RCLK = 0;GPIOB->CRL &= 0XFF0FFFFF;GPIOB->CRL |= 0X00B00000;}
+
+//DMA采样缓冲区。F1的GPIO寄存器只能按字访问，DMA按字读IDR、按半字写入，数据在高字节
+static uint16_t FIFO_Samples[FIFO_LINE_SIZE];
+
+/*
+ * TIM3：CH2(PB5)输出PWM2作为RCLK，CC1比较事件触发DMA1通道6采样GPIOB->IDR
+ * TIM4：单脉冲模式，计满一行(640个RCLK周期)后自动停止，TRGO(计数使能)作为TIM3门控
+ * 由硬件保证每行恰好640个RCLK上升沿和640次采样，不依赖中断响应时间
+ */
+void FIFO_Init(void)
+{
+	TIM_TimeBaseInitTypeDef TIM_InitStructure;
+	TIM_OCInitTypeDef TIM_OCInitStructure;
+	DMA_InitTypeDef DMA_InitStructure;
+
+	DWT_Init();
+
+	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM3 | RCC_APB1Periph_TIM4, ENABLE);
+	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOB | RCC_APB2Periph_AFIO, ENABLE);
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+	//TIM3部分重映射，CH2 -> PB5（CH1不输出，PB4仍为普通IO）
+	//不用GPIO_PinRemapConfig：库函数会把SWJ_CFG写成111，连SWD一起关掉
+	AFIO->MAPR = (AFIO->MAPR & ~(AFIO_MAPR_TIM3_REMAP | AFIO_MAPR_SWJ_CFG))
+		| AFIO_MAPR_TIM3_REMAP_PARTIALREMAP | AFIO_MAPR_SWJ_CFG_JTAGDISABLE;
+
+	//TIM3：RCLK发生器，门控从模式
+	TIM_InitStructure.TIM_Period = FIFO_RCLK_PERIOD - 1;
+	TIM_InitStructure.TIM_Prescaler = 0;
+	TIM_InitStructure.TIM_ClockDivision = TIM_CKD_DIV1;
+	TIM_InitStructure.TIM_CounterMode = TIM_CounterMode_Up;
+	TIM_TimeBaseInit(TIM3, &TIM_InitStructure);
+
+	TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_PWM2;			//CNT<CCR2为低，之后为高
+	TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Enable;
+	TIM_OCInitStructure.TIM_Pulse = FIFO_RCLK_RISE;
+	TIM_OCInitStructure.TIM_OCPolarity = TIM_OCPolarity_High;
+	TIM_OC2Init(TIM3, &TIM_OCInitStructure);
+
+	TIM_OCInitStructure.TIM_OCMode = TIM_OCMode_Timing;			//CH1只产生采样事件，不输出
+	TIM_OCInitStructure.TIM_OutputState = TIM_OutputState_Disable;
+	TIM_OCInitStructure.TIM_Pulse = FIFO_RCLK_SAMPLE;
+	TIM_OC1Init(TIM3, &TIM_OCInitStructure);
+
+	TIM_SelectInputTrigger(TIM3, TIM_TS_ITR3);					//ITR3 = TIM4
+	TIM_SelectSlaveMode(TIM3, TIM_SlaveMode_Gated);
+	TIM_DMACmd(TIM3, TIM_DMA_CC1, ENABLE);
+	TIM_Cmd(TIM3, ENABLE);										//门控打开时才计数
+
+	//TIM4：一行的门控时间
+	TIM_InitStructure.TIM_Period = FIFO_LINE_SIZE * FIFO_RCLK_PERIOD - 1;
+	TIM_TimeBaseInit(TIM4, &TIM_InitStructure);
+	TIM_SelectOnePulseMode(TIM4, TIM_OPMode_Single);
+	TIM_SelectOutputTrigger(TIM4, TIM_TRGOSource_Enable);
+	TIM_ClearFlag(TIM4, TIM_FLAG_Update);						//TimeBaseInit产生的更新事件
+
+	//DMA1通道6：TIM3_CH1请求，GPIOB->IDR -> FIFO_Samples
+	DMA_DeInit(DMA1_Channel6);
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&GPIOB->IDR;
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)FIFO_Samples;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+	DMA_InitStructure.DMA_BufferSize = FIFO_LINE_SIZE;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Word;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_HalfWord;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_VeryHigh;
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(DMA1_Channel6, &DMA_InitStructure);
+}
+
+//复位FIFO读指针，之后从帧首字节开始读取
+void FIFO_ReadReset(void)
+{
+	FIFO_RCLK_OUT();
+	FIFO_RRST = 0;
+	delay_us(1);
+	FIFO_RCLK = 0;
+	delay_us(1);
+	FIFO_RCLK = 1;
+	delay_us(1);
+	FIFO_RCLK = 0;
+	delay_us(1);
+	FIFO_RRST = 1;
+	delay_us(1);
+	FIFO_RCLK = 1;
+	delay_us(1);
+	FIFO_RCLK_AF();							//交给TIM3，RCLK保持低电平直到下一行开始
+	FIFO_LineCyclesMax = 0;
+}
+
+//启动一行读取，立即返回
+static void FIFO_DoLineStart(void)
+{
+	DMA1_Channel6->CCR &= ~DMA_CCR6_EN;
+	DMA1->IFCR = DMA1_FLAG_GL6;
+	DMA1_Channel6->CNDTR = FIFO_LINE_SIZE;
+	DMA1_Channel6->CMAR = (uint32_t)FIFO_Samples;
+	DMA1_Channel6->CCR |= DMA_CCR6_EN;
+
+	TIM3->CNT = 0;
+	TIM4->CNT = 0;
+	TIM4->CR1 |= TIM_CR1_CEN;				//打开门控，单脉冲结束后自动关闭
+}
+
+uint8_t FIFO_LineBusy(void)
+{
+	return (DMA1->ISR & DMA1_FLAG_TC6) == 0;
+}
+
+//等待本行采样完成并压缩到buf
+static void FIFO_DoLineFinish(uint8_t *buf)
+{
+	while(FIFO_LineBusy());
+	FIFO_PackLine(FIFO_Samples, buf, FIFO_LINE_SIZE);
+}
+
+#else
+
+void FIFO_Init(void)
+{
+	DWT_Init();
+}
+
+//复位FIFO读指针，之后从帧首字节开始读取
+void FIFO_ReadReset(void)
+{
+	FIFO_RRST = 0;
+	delay_us(1);
+	FIFO_RCLK = 0;
+	delay_us(1);
+	FIFO_RCLK = 1;
+	delay_us(1);
+	FIFO_RCLK = 0;
+	delay_us(1);
+	FIFO_RRST = 1;
+	delay_us(1);
+	FIFO_RCLK = 1;
+	delay_us(1);
+	FIFO_LineCyclesMax = 0;
+}
+
+#if FIFO_READ_MODE == FIFO_READ_CPU
+
+//RCLK(PB5)和数据(PB8-PB15)都在GPIOB；三个访问宏可在主机上替换为假寄存器做字节序验证
+#ifndef FIFO_CPU_RCLK_L
+#define FIFO_CPU_RCLK_L()		(GPIOB->BRR = FIFO_RCLK_PIN)
+#define FIFO_CPU_RCLK_H()		(GPIOB->BSRR = FIFO_RCLK_PIN)
+#define FIFO_CPU_DATA()			(GPIOB->IDR & 0XFF00)
+#endif
+
+#if FIFO_CPU_IN_RAM
+#define FIFO_CPU_FUNC			RAMFUNC
+#else
+#define FIFO_CPU_FUNC
+#endif
+
+/*
+ * 每次循环读2个像素(4字节)，拼成一个字写入buf
+ * 小端字写入后内存中字节顺序为b0 b1 b2 b3，与逐字节读取的大端RGB565一致
+ * RCLK低电平期间读IDR，上升沿推进到下一字节；IDR输入同步约2个周期，远大于AL422B的存取时间
+ */
+FIFO_CPU_FUNC static void FIFO_ReadLineCPU(uint32_t *buf)
+{
+	uint32_t w;
+	uint32_t n;
+
+	for(n = FIFO_LINE_SIZE / 4; n != 0; n--)
+	{
+		FIFO_CPU_RCLK_L();
+		w = FIFO_CPU_DATA() >> 8;				//像素0高字节
+		FIFO_CPU_RCLK_H();
+
+		FIFO_CPU_RCLK_L();
+		w |= FIFO_CPU_DATA();					//像素0低字节
+		FIFO_CPU_RCLK_H();
+
+		FIFO_CPU_RCLK_L();
+		w |= FIFO_CPU_DATA() << 8;				//像素1高字节
+		FIFO_CPU_RCLK_H();
+
+		FIFO_CPU_RCLK_L();
+		w |= FIFO_CPU_DATA() << 16;				//像素1低字节
+		FIFO_CPU_RCLK_H();
+
+		*buf++ = w;
+	}
+}
+
+#endif
+
+static void FIFO_DoLineStart(void)
+{
+}
+
+uint8_t FIFO_LineBusy(void)
+{
+	return 0;
+}
+
+//读取一行320像素到buf（640字节）
+static void FIFO_DoLineFinish(uint8_t *buf)
+{
+#if FIFO_READ_MODE == FIFO_READ_CPU
+	FIFO_ReadLineCPU((uint32_t *)buf);
+#else
+	uint16_t j;
+
+	delay_us(2);
+
+	for(j = 0; j < FIFO_IMG_WIDTH; j++)
+	{
+		FIFO_RCLK = 0;
+		delay_us(1);
+		buf[j * 2] = OV7670_RedData() >> 8;			//高字节
+
+		FIFO_RCLK = 1;
+		delay_us(1);
+		FIFO_RCLK = 0;
+		delay_us(1);
+		buf[j * 2 + 1] = OV7670_RedData() >> 8;		//低字节
+		FIFO_RCLK = 1;
+	}
+#endif
+}
+
+#endif
+
+//以下统计的是读取本身占用CPU的周期数（不含两次调用之间的其他处理）
+void FIFO_LineStart(void)
+{
+	uint32_t start = DWT_CYCCNT;
+
+	FIFO_DoLineStart();
+	FIFO_StartCycles = DWT_CYCCNT - start;
+}
+
+void FIFO_LineFinish(uint8_t *buf)
+{
+	uint32_t start = DWT_CYCCNT;
+
+	FIFO_DoLineFinish(buf);
+
+	FIFO_LineCycles = FIFO_StartCycles + (DWT_CYCCNT - start);
+	if(FIFO_LineCycles > FIFO_LineCyclesMax)
+		FIFO_LineCyclesMax = FIFO_LineCycles;
+}
+
+//读取一行320像素到buf（640字节）
+void FIFO_ReadLine(uint8_t *buf)
+{
+	FIFO_LineStart();
+	FIFO_LineFinish(buf);
+}
+
+void FIFO_PackLine(const uint16_t *samples, uint8_t *buf, uint16_t len)
+{
+	while(len--)
+	{
+		*buf++ = *samples++ >> 8;
+	}
+}
@@ -0,0 +1,51 @@
+#ifndef __FIFO_H
+#define __FIFO_H
+#include "sys.h"
+
+//AL422B FIFO读出接口，按行读取OV7670写入的一帧图像
+//行缓冲区字节顺序与串口/SD协议一致：每像素先高字节后低字节（RGB565大端）
+
+#define FIFO_IMG_WIDTH			320						//QVGA宽度
+#define FIFO_IMG_HEIGHT			240						//QVGA高度
+#define FIFO_LINE_SIZE			(FIFO_IMG_WIDTH * 2)	//每行640字节
+
+//读出方式
+#define FIFO_READ_GPIO			0						//软件翻转RCLK，每个边沿delay_us(1)
+#define FIFO_READ_DMA			1						//TIM3产生RCLK，DMA采样GPIOB->IDR
+#define FIFO_READ_CPU			2						//SRAM中运行的展开循环，直接写BSRR/BRR，无延时
+
+#ifndef FIFO_READ_MODE
+#define FIFO_READ_MODE			FIFO_READ_DMA
+#endif
+
+//DMA方式的RCLK时序（TIM3/TIM4时钟72MHz）
+//每个RCLK周期：CNT=0起为低电平，CNT=FIFO_RCLK_SAMPLE时DMA采样，CNT=FIFO_RCLK_RISE时上升沿推进读指针
+#define FIFO_RCLK_PERIOD		36						//72MHz/36 = 2MHz RCLK
+#define FIFO_RCLK_SAMPLE		(FIFO_RCLK_PERIOD / 4)
+#define FIFO_RCLK_RISE			(FIFO_RCLK_PERIOD / 2)
+#define FIFO_LINE_TIME_US		(FIFO_LINE_SIZE * FIFO_RCLK_PERIOD / 72)	//每行读出时间，320us
+
+//CPU方式的读出循环是否放到SRAM执行。SRAM取指与GPIO访问共用System总线，
+//收益以FIFO_LineCycles实测为准，定义为0可与FLASH执行对比
+#ifndef FIFO_CPU_IN_RAM
+#define FIFO_CPU_IN_RAM			1
+#endif
+
+//最近一行读取耗用的CPU周期数（DWT，LineStart+LineFinish），FIFO_ReadReset时清零最大值
+extern uint32_t FIFO_LineCycles;
+extern uint32_t FIFO_LineCyclesMax;
+
+void FIFO_Init(void);
+void FIFO_ReadReset(void);
+void FIFO_ReadLine(uint8_t *buf);						//buf需4字节对齐（CPU方式按字写入）
+
+//分步读取：启动后CPU可处理上一行数据，FIFO_LineFinish等待完成并写入buf
+//GPIO/CPU方式没有后台读取，LineStart不做事，读取在LineFinish中完成
+void FIFO_LineStart(void);
+uint8_t FIFO_LineBusy(void);
+void FIFO_LineFinish(uint8_t *buf);
+
+//把DMA采到的IDR半字（数据在PB8-PB15）压缩成字节
+void FIFO_PackLine(const uint16_t *samples, uint8_t *buf, uint16_t len);
+
+#endif
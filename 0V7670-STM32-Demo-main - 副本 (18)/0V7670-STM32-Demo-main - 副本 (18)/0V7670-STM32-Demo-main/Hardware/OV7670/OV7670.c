@@ -1,8 +1,39 @@
-#include "OV7670.H"
-#include "DELAY.H"
-#include "SCCB.H"
+#include "OV7670.h"
+#include "delay.h"
+#include "SCCB.h"
+#include "FIFO.h"
+#include <string.h>
+
+volatile uint32_t OV7670_FrameCount = 0;		//上电以来的VSYNC次数
+SCCB_StatsTypeDef OV7670_SccbStats;	//开机以来寄存器写入的统计（次数、重试、耗时）
+uint32_t OV7670_RegsSkipped;			//与影子寄存器相同而未写入的次数
+volatile uint32_t OV7670_ConfigFrame;
+volatile uint32_t OV7670_ConfigCycles;
+volatile uint32_t OV7670_VsyncAt;
+volatile uint32_t OV7670_VsyncPeriod;
+OV7670_ClockTypeDef OV7670_Clock = {OV7670_XCLK_HSE, 1, 1};	//与寄存器表一致：8MHz x4 / (2*2) = 8MHz
+
+static const OV7670_ConfigTypeDef * volatile OV7670_Pending;	//等待在VSYNC之后应用的配置
+static volatile u8 OV7670_ApplyDue;								//1=VSYNC已过，拍照任务可以写入OV7670_Pending
+static volatile u8 OV7670_Settle;								//切换后还需舍弃的帧数
+static volatile u16 OV7670_FpsX10;								//最近一次应用的配置的fps_x10
+
+static const u8 OV7670_PllMul[4] = {1, 4, 6, 8};
+static const u8 OV7670_McoSource[3] = {RCC_MCO_HSE, RCC_MCO_PLLCLK_Div2, RCC_MCO_SYSCLK};
+
+//与寄存器表一致：增益上限8x，曝光目标0x75/0x63
+const OV7670_ConfigTypeDef OV7670_DefaultConfig =
+{
+	lightmode, saturation, brightness, contrast, effect,
+	OV7670_QVGA_WINDOW,
+	2, 0x75, 0x63,
+	0
+};
 
-uint8_t  OV7670_STA = 0;
+//影子寄存器：最近一次写入（或读到）的值，有效位为0时表示未知
+#define OV7670_REG_COUNT		0xCA
+static u8 OV7670_Shadow[OV7670_REG_COUNT];
+static u8 OV7670_ShadowValid[(OV7670_REG_COUNT + 7) / 8];
 
 const u8 ov7670_init_reg[][2] = 
 {   
@@ -217,6 +248,131 @@ const u8 ov7670_init_reg[][2] =
 };
 
 
+//读回值与写入值不同的寄存器不做读回比较：
+//0x12 COM7 bit7复位后自动清零；0xc8 间接访问的数据寄存器（地址在0x79中）；
+//0x00/0x01/0x02/0x03/0x10/0x6a 增益、白平衡和曝光，自动控制打开后随时被改写
+static u8 OV7670_NoVerify(u8 reg, u8 val)
+{
+	switch(reg)
+	{
+		case 0x12: return (val & 0x80) != 0;
+		case 0xc8:
+		case 0x00: case 0x01: case 0x02: case 0x03:
+		case 0x10: case 0x6a:
+			return 1;
+	}
+	return 0;
+}
+
+static const SCCB_LoadTypeDef OV7670_Load = {OV7670_VERIFY, SCCB_RETRIES, OV7670_NoVerify};
+
+//批量写入寄存器，失败时重试，统计累加到OV7670_SccbStats
+static u8 OV7670_WriteRegs(const u8 *table, u16 count)
+{
+	return SCCB_WR_Table(table, count, &OV7670_Load, &OV7670_SccbStats);
+}
+
+static u8 OV7670_IsValid(u8 reg)
+{
+	return reg < OV7670_REG_COUNT && ((OV7670_ShadowValid[reg >> 3] >> (reg & 7)) & 1);
+}
+
+static void OV7670_SetValid(u8 reg, u8 valid)
+{
+	if(reg >= OV7670_REG_COUNT)
+		return;
+	if(valid)
+		OV7670_ShadowValid[reg >> 3] |= 1 << (reg & 7);
+	else
+		OV7670_ShadowValid[reg >> 3] &= ~(1 << (reg & 7));
+}
+
+//COM8（0x13）打开自动增益/白平衡/曝光后，对应的寄存器由传感器改写，写入的值不起作用
+static u8 OV7670_AutoOwned(u8 reg, u8 com8)
+{
+	switch(reg)
+	{
+		case 0x00: return (com8 & 0x04) != 0;					//AGC: GAIN
+		case 0x01: case 0x02: case 0x6a: return (com8 & 0x02) != 0;	//AWB: BLUE/RED/GGAIN
+		case 0x10: return (com8 & 0x01) != 0;					//AEC: AECH
+	}
+	return 0;
+}
+
+//写入一个寄存器并更新影子
+static u8 OV7670_WriteReg(u8 reg, u8 val)
+{
+	u8 pair[2];
+	u8 res;
+	u8 com8;
+	u8 r;
+
+	pair[0] = reg;
+	pair[1] = val;
+	res = OV7670_WriteRegs(pair, 1);
+
+	if(reg == 0x12 && (val & 0x80))
+	{
+		memset(OV7670_ShadowValid, 0, sizeof(OV7670_ShadowValid));		//软复位，全部恢复默认值
+		return res;
+	}
+	if(reg < OV7670_REG_COUNT)
+		OV7670_Shadow[reg] = val;
+	OV7670_SetValid(reg, !res && reg != 0xc8);				//0xc8的含义取决于0x79，不缓存
+	if(reg == 0x13)
+	{
+		//打开的自动控制接管对应的寄存器，影子值不再代表寄存器内容（写入失败时按全部打开处理）
+		com8 = res ? 0xFF : val;
+		for(r = 0; r < OV7670_REG_COUNT; r++)
+		{
+			if(OV7670_AutoOwned(r, com8))
+				OV7670_SetValid(r, 0);
+		}
+	}
+	return res;
+}
+
+/*
+ * 按顺序写入寄存器列表，跳过与影子寄存器相同的值，以及由已打开的自动控制改写的寄存器
+ * 返回：0 全部成功；1 有寄存器写入失败（该寄存器的影子值变为未知）
+ */
+static u8 OV7670_SetRegs(const u8 *table, u16 count)
+{
+	u8 result = 0;
+	u16 i;
+
+	for(i = 0; i < count; i++)
+	{
+		u8 reg = table[i * 2];
+		u8 val = table[i * 2 + 1];
+
+		if((OV7670_IsValid(0x13) && OV7670_AutoOwned(reg, OV7670_Shadow[0x13]))
+			|| (OV7670_IsValid(reg) && OV7670_Shadow[reg] == val))
+		{
+			OV7670_RegsSkipped++;
+			continue;
+		}
+		result |= OV7670_WriteReg(reg, val);
+	}
+	return result;
+}
+
+//读-改-写时的原值：影子有效时不访问SCCB
+static u8 OV7670_ShadowReg(u8 reg)
+{
+	u8 val;
+
+	if(OV7670_IsValid(reg))
+		return OV7670_Shadow[reg];
+	val = SCCB_RD_Reg(reg);
+	if(reg < OV7670_REG_COUNT && reg != 0xc8 && !OV7670_AutoOwned(reg, 0xFF))
+	{
+		OV7670_Shadow[reg] = val;
+		OV7670_SetValid(reg, 1);
+	}
+	return val;
+}
+
 void OV7670_XCLK_ON(void)
 {
     GPIO_InitTypeDef GPIO_InitStructure;
@@ -226,7 +382,7 @@ void OV7670_XCLK_ON(void)
     GPIO_InitStructure.GPIO_Speed = GPIO_Speed_50MHz;
     GPIO_InitStructure.GPIO_Mode = GPIO_Mode_AF_PP;
     GPIO_Init(GPIOA, &GPIO_InitStructure);
-    RCC_MCOConfig(RCC_MCO_HSE);
+    RCC_MCOConfig(OV7670_McoSource[OV7670_Clock.xclk]);
 }
 
 
@@ -242,13 +398,14 @@ void OV7670_XCLK_OFF(void)
 }
 
 //OV7670功能设置
+//各设置先生成寄存器列表，由OV7670_SetRegs只写入与影子寄存器不同的部分
 //白平衡设置
 //0:自动
 //1:太阳sunny
 //2,阴天cloudy
 //3,办公室office
 //4,家里home
-void OV7670_Light_Mode(u8 mode)
+static u8 OV7670_LightModeRegs(u8 mode, u8 (*regs)[2])
 {
 	u8 reg13val=0XE7;			//默认就是设置为自动白平衡
 	u8 reg01val=0;
@@ -276,9 +433,16 @@ void OV7670_Light_Mode(u8 mode)
 			reg02val=0X40;
 			break;
 	}
-	SCCB_WR_Reg(0X13,reg13val);	//COM8设置
-	SCCB_WR_Reg(0X01,reg01val);	//AWB蓝色通道增益
-	SCCB_WR_Reg(0X02,reg02val);	//AWB红色通道增益
+	regs[0][0]=0X13; regs[0][1]=reg13val;	//COM8设置，在增益之前写入（决定增益由谁控制）
+	regs[1][0]=0X01; regs[1][1]=reg01val;	//AWB蓝色通道增益
+	regs[2][0]=0X02; regs[2][1]=reg02val;	//AWB红色通道增益
+	return 3;
+}
+
+void OV7670_Light_Mode(u8 mode)
+{
+	u8 regs[3][2];
+	OV7670_SetRegs(regs[0], OV7670_LightModeRegs(mode, regs));
 }
 
 //色度设置
@@ -287,7 +451,7 @@ void OV7670_Light_Mode(u8 mode)
 //2,0
 //3,1
 //4,2
-void OV7670_Color_Saturation(u8 sat)
+static u8 OV7670_SaturationRegs(u8 sat, u8 (*regs)[2])
 {
 	u8 reg4f5054val=0X80;		//默认就是sat=2,即不调节色度的设置
  	u8 reg52val=0X22;
@@ -315,13 +479,20 @@ void OV7670_Color_Saturation(u8 sat)
 			reg53val=0X8D;
 			break;
 	}
-	SCCB_WR_Reg(0X4F,reg4f5054val);	//色彩矩阵系数1
-	SCCB_WR_Reg(0X50,reg4f5054val);	//色彩矩阵系数2 
-	SCCB_WR_Reg(0X51,0X00);			//色彩矩阵系数3  
-	SCCB_WR_Reg(0X52,reg52val);		//色彩矩阵系数4 
-	SCCB_WR_Reg(0X53,reg53val);		//色彩矩阵系数5 
-	SCCB_WR_Reg(0X54,reg4f5054val);	//色彩矩阵系数6  
-	SCCB_WR_Reg(0X58,0X9E);			//MTXS 
+	regs[0][0]=0X4F; regs[0][1]=reg4f5054val;	//色彩矩阵系数1
+	regs[1][0]=0X50; regs[1][1]=reg4f5054val;	//色彩矩阵系数2 
+	regs[2][0]=0X51; regs[2][1]=0X00;			//色彩矩阵系数3  
+	regs[3][0]=0X52; regs[3][1]=reg52val;		//色彩矩阵系数4 
+	regs[4][0]=0X53; regs[4][1]=reg53val;		//色彩矩阵系数5 
+	regs[5][0]=0X54; regs[5][1]=reg4f5054val;	//色彩矩阵系数6  
+	regs[6][0]=0X58; regs[6][1]=0X9E;			//MTXS 
+	return 7;
+}
+
+void OV7670_Color_Saturation(u8 sat)
+{
+	u8 regs[7][2];
+	OV7670_SetRegs(regs[0], OV7670_SaturationRegs(sat, regs));
 }
 
 //亮度设置
@@ -330,7 +501,7 @@ void OV7670_Color_Saturation(u8 sat)
 //2,0
 //3,1
 //4,2
-void OV7670_Brightness(u8 bright)
+static u8 OV7670_BrightnessRegs(u8 bright, u8 (*regs)[2])
 {
 	u8 reg55val=0X00;//默认就是bright=2
   	switch(bright)
@@ -348,7 +519,14 @@ void OV7670_Brightness(u8 bright)
 			reg55val=0X30;
 			break;
 	}
-	SCCB_WR_Reg(0X55,reg55val);	//亮度调节 
+	regs[0][0]=0X55; regs[0][1]=reg55val;	//亮度调节 
+	return 1;
+}
+
+void OV7670_Brightness(u8 bright)
+{
+	u8 regs[1][2];
+	OV7670_SetRegs(regs[0], OV7670_BrightnessRegs(bright, regs));
 }
 
 //对比度设置
@@ -357,7 +535,7 @@ void OV7670_Brightness(u8 bright)
 //2,0
 //3,1
 //4,2
-void OV7670_Contrast(u8 contras)
+static u8 OV7670_ContrastRegs(u8 contras, u8 (*regs)[2])
 {
 	u8 reg56val=0X40;			//默认就是contrast=2
 	switch(contras)
@@ -375,7 +553,14 @@ void OV7670_Contrast(u8 contras)
 			reg56val=0X60;
 			break;
 	}
-	SCCB_WR_Reg(0X56,reg56val);	//对比度调节
+	regs[0][0]=0X56; regs[0][1]=reg56val;	//对比度调节
+	return 1;
+}
+
+void OV7670_Contrast(u8 contras)
+{
+	u8 regs[1][2];
+	OV7670_SetRegs(regs[0], OV7670_ContrastRegs(contras, regs));
 }
 
 //特效设置
@@ -386,7 +571,7 @@ void OV7670_Contrast(u8 contras)
 //4,偏绿色
 //5,偏蓝色
 //6,复古	    
-void OV7670_Special_Effects(u8 eft)
+static u8 OV7670_EffectRegs(u8 eft, u8 (*regs)[2])
 {
 	u8 reg3aval=0X04;			//默认为普通模式
 	u8 reg67val=0XC0;
@@ -424,14 +609,55 @@ void OV7670_Special_Effects(u8 eft)
 			reg68val=0X40;
 			break;
 	}
-	SCCB_WR_Reg(0X3A,reg3aval);	//TSLB设置
-	SCCB_WR_Reg(0X68,reg67val);	//MANU,手动U值
-	SCCB_WR_Reg(0X67,reg68val);	//MANV,手动V值
+	regs[0][0]=0X3A; regs[0][1]=reg3aval;	//TSLB设置，在手动UV值之前写入
+	regs[1][0]=0X68; regs[1][1]=reg67val;	//MANU,手动U值
+	regs[2][0]=0X67; regs[2][1]=reg68val;	//MANV,手动V值
+	return 3;
+}
+
+void OV7670_Special_Effects(u8 eft)
+{
+	u8 regs[3][2];
+	OV7670_SetRegs(regs[0], OV7670_EffectRegs(eft, regs));
+}
+
+//自动曝光/增益的范围
+//ceiling: 增益上限0~6（2x,4x,8x,16x,32x,64x,128x）; high/low: 曝光目标的上下限（AEW/AEB，稳定区间）
+static u8 OV7670_ExposureRegs(u8 ceiling, u8 high, u8 low, u8 (*regs)[2])
+{
+	regs[0][0]=0X14; regs[0][1]=((ceiling&0X07)<<4)|0X08;	//COM9,bit3保持寄存器表中的值
+	regs[1][0]=0X24; regs[1][1]=high;	//AEW
+	regs[2][0]=0X25; regs[2][1]=low;	//AEB
+	return 3;
+}
+
+//帧率：在帧尾插入dummy行（DM_LNL/DM_LNH），不改变时钟，可以在VSYNC中切换
+//fps_x10: 帧率x10，0或高于当前时钟的最高帧率时不插入
+static u16 OV7670_DummyLines(u16 fps_x10)
+{
+	u32 lines;
+
+	if(fps_x10 == 0)
+		return 0;
+	lines = OV7670_IntClockHz(&OV7670_Clock) / OV7670_LINE_CLOCKS * 10 / fps_x10;
+	if(lines <= OV7670_FRAME_LINES)
+		return 0;
+	lines -= OV7670_FRAME_LINES;
+	return lines > 0XFFFF ? 0XFFFF : (u16)lines;
+}
+
+static u8 OV7670_FrameRateRegs(u16 fps_x10, u8 (*regs)[2])
+{
+	u16 lines = OV7670_DummyLines(fps_x10);
+	regs[0][0]=0X92; regs[0][1]=lines&0XFF;	//DM_LNL
+	regs[1][0]=0X93; regs[1][1]=lines>>8;	//DM_LNH
+	return 2;
 }
 
 //设置图像输出窗口
 //对QVGA设置。
-void OV7670_Window_Set(u16 sx,u16 sy,u16 width,u16 height)
+//0x03/0x32的其他位取自影子寄存器，不再从SCCB读回
+static u8 OV7670_WindowRegs(u16 sx,u16 sy,u16 width,u16 height, u8 (*regs)[2])
 {
 	u16 endx;
 	u16 endy;
@@ -439,18 +665,23 @@ void OV7670_Window_Set(u16 sx,u16 sy,u16 width,u16 height)
 	endx=sx+width*2;					//V*2
  	endy=sy+height*2;
 	if(endy>784)endy-=784;
-	temp=SCCB_RD_Reg(0X03);				//读取Vref之前的值
+	temp=OV7670_ShadowReg(0X03);		//读取Vref之前的值
 	temp&=0XF0;
 	temp|=((endx&0X03)<<2)|(sx&0X03);
-	SCCB_WR_Reg(0X03,temp);				//设置Vref的start和end的最低2位
-	SCCB_WR_Reg(0X19,sx>>2);			//设置Vref的start高8位
-	SCCB_WR_Reg(0X1A,endx>>2);			//设置Vref的end的高8位
+	regs[0][0]=0X03; regs[0][1]=temp;	//设置Vref的start和end的最低2位
+	regs[1][0]=0X19; regs[1][1]=sx>>2;	//设置Vref的start高8位
+	regs[2][0]=0X1A; regs[2][1]=endx>>2;	//设置Vref的end的高8位
+
+	//Href的最低3位（0x32）未写入，保持寄存器表中的值
+	regs[3][0]=0X17; regs[3][1]=sy>>3;	//设置Href的start高8位
+	regs[4][0]=0X18; regs[4][1]=endy>>3;	//设置Href的end的高8位
+	return 5;
+}
 
-	temp=SCCB_RD_Reg(0X32);				//读取Href之前的值
-	temp&=0XC0;
-	temp|=((endy&0X07)<<3)|(sy&0X07);
-	SCCB_WR_Reg(0X17,sy>>3);			//设置Href的start高8位
-	SCCB_WR_Reg(0X18,endy>>3);			//设置Href的end的高8位
+void OV7670_Window_Set(u16 sx,u16 sy,u16 width,u16 height)
+{
+	u8 regs[5][2];
+	OV7670_SetRegs(regs[0], OV7670_WindowRegs(sx, sy, width, height, regs));
 }
 
 
@@ -460,36 +691,194 @@ void OV7670_SetWindow(u16 startx,u16 starty,u16 width,u16 height)
 	uint16_t endy;
 	uint8_t x_reg;
 	uint8_t y_reg;
-	uint8_t temp;
+	uint8_t regs[6][2];
 	
 	endx = (startx + width*2)%784;
 	endy = (starty + height*2);
 	
-	x_reg = SCCB_RD_Reg(0x32);
+	x_reg = OV7670_ShadowReg(0x32);
 	x_reg &= 0xc0;
-	y_reg = SCCB_RD_Reg(0x03);
+	y_reg = OV7670_ShadowReg(0x03);
 	y_reg &= 0xf0;
 	
 	//设置HREF
-	temp = x_reg | ((endx & 0x7) << 3) | (startx & 0x7);
-	SCCB_WR_Reg(0x32,temp);
-	temp = (startx & 0x7f8) >> 3;
-	SCCB_WR_Reg(0x17,temp);
-	temp = (endx & 0x7f8) >> 3;
-	SCCB_WR_Reg(0x18,temp);
+	regs[0][0] = 0x32; regs[0][1] = x_reg | ((endx & 0x7) << 3) | (startx & 0x7);
+	regs[1][0] = 0x17; regs[1][1] = (startx & 0x7f8) >> 3;
+	regs[2][0] = 0x18; regs[2][1] = (endx & 0x7f8) >> 3;
 	
 	//设置VREF
-	temp = y_reg | ((endy & 0x3) << 2) | (starty & 0x3);
-	SCCB_WR_Reg(0x03,temp);
-	temp = (starty & 0x3fc) >> 2;
-	SCCB_WR_Reg(0x19,temp);
-	temp = (endy & 0x3fc) >> 2;
-	SCCB_WR_Reg(0x1a,temp);
+	regs[3][0] = 0x03; regs[3][1] = y_reg | ((endy & 0x3) << 2) | (starty & 0x3);
+	regs[4][0] = 0x19; regs[4][1] = (starty & 0x3fc) >> 2;
+	regs[5][0] = 0x1a; regs[5][1] = (endy & 0x3fc) >> 2;
+	OV7670_SetRegs(regs[0], 6);
+}
+
+//按依赖顺序生成整个配置的寄存器列表，只写入变化的寄存器：
+//COM8（自动增益/白平衡/曝光开关）在手动增益和曝光范围之前，色彩矩阵系数在MTXS之前，TSLB在手动UV之前，最后是窗口
+u8 OV7670_Apply(const OV7670_ConfigTypeDef *cfg)
+{
+	u8 regs[OV7670_CONFIG_REGS][2];
+	u8 n = 0;
+
+	n += OV7670_LightModeRegs(cfg->light_mode, regs + n);
+	n += OV7670_ExposureRegs(cfg->gain_ceiling, cfg->ae_high, cfg->ae_low, regs + n);
+	n += OV7670_FrameRateRegs(cfg->fps_x10, regs + n);
+	n += OV7670_SaturationRegs(cfg->sat_level, regs + n);
+	n += OV7670_BrightnessRegs(cfg->bright_level, regs + n);
+	n += OV7670_ContrastRegs(cfg->contrast_level, regs + n);
+	n += OV7670_EffectRegs(cfg->effect_mode, regs + n);
+	OV7670_FpsX10 = cfg->fps_x10;
+	n += OV7670_WindowRegs(cfg->win_sx, cfg->win_sy, cfg->win_width, cfg->win_height, regs + n);
+	return OV7670_SetRegs(regs[0], n);
+}
+
+static u32 OV7670_XclkHz(u8 xclk)
+{
+	switch(xclk)
+	{
+		case OV7670_XCLK_PLL_DIV2: return SystemCoreClock / 2;		//SYSCLK取自PLL
+		case OV7670_XCLK_SYSCLK: return SystemCoreClock;
+	}
+	return HSE_VALUE;
+}
+
+u32 OV7670_IntClockHz(const OV7670_ClockTypeDef *clk)
+{
+	return OV7670_XclkHz(clk->xclk) * OV7670_PllMul[clk->pll] / (2 * (clk->prescale + 1));
+}
+
+//时钟hz、dummy行lines时的帧率x10
+static u16 OV7670_FpsFor(u32 hz, u16 lines)
+{
+	return (u16)((uint64_t)hz * 10 / ((u32)OV7670_LINE_CLOCKS * (OV7670_FRAME_LINES + lines)));
+}
+
+u16 OV7670_ClockFor(u8 xclk, u16 fps_x10, OV7670_ClockTypeDef *clk)
+{
+	uint64_t need = (uint64_t)fps_x10 * OV7670_FRAME_LINES * OV7670_LINE_CLOCKS / 10;
+	OV7670_ClockTypeDef c;
+	u32 best = 0;
+	u32 hz;
+
+	c.xclk = xclk;
+	for(c.pll = 0; c.pll < 4; c.pll++)
+	{
+		for(c.prescale = 0; c.prescale < 64; c.prescale++)
+		{
+			hz = OV7670_IntClockHz(&c);
+			if(hz > OV7670_INTCLK_MAX)
+				continue;
+			//够用时取最低的时钟（相同时倍频较小），都不够时取最高的
+			if(best == 0 || (hz >= need ? (best < need || hz < best) : (best < need && hz > best)))
+			{
+				best = hz;
+				*clk = c;
+			}
+		}
+	}
+	return OV7670_FpsFor(best, 0);
+}
+
+u16 OV7670_SetClock(u8 xclk, u16 fps_x10)
+{
+	OV7670_ClockTypeDef clk;
+	u8 regs[4][2];
+	u8 clkrc;
+	u8 n;
+	u16 max;
+
+	clkrc = OV7670_ShadowReg(0X11) & 0X80;		//bit6（直接使用外部时钟）保持为0
+	max = OV7670_ClockFor(xclk, fps_x10, &clk);
+	if(memcmp(&clk, &OV7670_Clock, sizeof(clk)) != 0)
+	{
+		//先把内部时钟降到最低，切换XCLK和倍频的过程中不超过上限
+		regs[0][0]=0X11; regs[0][1]=clkrc|0X3F;
+		OV7670_SetRegs(regs[0], 1);
+		if(clk.xclk != OV7670_Clock.xclk)
+			RCC_MCOConfig(OV7670_McoSource[clk.xclk]);
+		OV7670_Clock = clk;
+	}
+	regs[0][0]=0X6B; regs[0][1]=(OV7670_ShadowReg(0X6B)&0X3F)|(clk.pll<<6);	//DBLV
+	regs[1][0]=0X11; regs[1][1]=clkrc|clk.prescale;							//CLKRC
+	n = 2 + OV7670_FrameRateRegs(OV7670_FpsX10, regs + 2);					//dummy行随时钟重新计算
+	OV7670_SetRegs(regs[0], n);
+	return max;
+}
+
+u16 OV7670_MaxFps(void)
+{
+	return OV7670_FpsFor(OV7670_IntClockHz(&OV7670_Clock), 0);
+}
+
+u32 OV7670_LineCycles(void)
+{
+	return (u32)((uint64_t)OV7670_LINE_CLOCKS * SystemCoreClock / OV7670_IntClockHz(&OV7670_Clock));
+}
+
+u32 OV7670_FrameLines(void)
+{
+	return OV7670_FRAME_LINES + OV7670_DummyLines(OV7670_FpsX10);
+}
+
+u32 OV7670_FrameCycles(void)
+{
+	return OV7670_LineCycles() * OV7670_FrameLines();
+}
+
+void OV7670_RequestConfig(const OV7670_ConfigTypeDef *cfg, u8 settle)
+{
+	__disable_irq();					//一起更新，VSYNC中断不会看到一半
+	OV7670_Settle = settle;
+	OV7670_Pending = cfg;
+	OV7670_ApplyDue = 0;				//等下一个VSYNC，在消隐开始后写入
+	__enable_irq();
+}
+
+u8 OV7670_ConfigReady(void)
+{
+	return OV7670_Pending == 0 && OV7670_Settle == 0;
+}
+
+//中断中不访问SCCB：有待切换的配置时只记下VSYNC已过，这一帧不写入FIFO，由拍照任务在帧事件中写入
+u8 OV7670_VsyncUpdate(void)
+{
+	if(OV7670_Pending)
+	{
+		OV7670_ApplyDue = 1;
+		return 0;
+	}
+	if(OV7670_Settle)
+	{
+		OV7670_Settle--;
+		return 0;
+	}
+	return 1;
+}
+
+//VSYNC上升沿之后是垂直消隐（QVGA约20行，1ms以上），每次写入约70us（读回比较时约140us），
+//切换补光模式时一般只有3~12个寄存器变化。VSYNC时没有写入FIFO的这一帧算作一个舍弃帧；
+//任务来晚、写入延续到下一个VSYNC时，中断看到配置仍未切换，那一帧也不写入
+u8 OV7670_ConfigService(void)
+{
+	const OV7670_ConfigTypeDef *cfg = OV7670_Pending;
+	u32 start;
+
+	if(!cfg || !OV7670_ApplyDue)
+		return 0;
+	start = DWT_CYCCNT;
+	OV7670_Apply(cfg);
+	OV7670_ConfigCycles = DWT_CYCCNT - start;
+	OV7670_ConfigFrame = OV7670_FrameCount;
+	if(OV7670_Settle)
+		OV7670_Settle--;
+	OV7670_ApplyDue = 0;
+	OV7670_Pending = 0;					//最后清除：之前的VSYNC中断不改变Settle
+	return 1;
 }
 
 unsigned char OV7670_Init(void)
 {
-	unsigned char i;
+	u16 i;
 	GPIO_InitTypeDef GPIO_InitStructure;
    
 	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOB
@@ -548,19 +937,21 @@ unsigned char OV7670_Init(void)
 //	LCD_ShowNum(0,50,WHITE,BLACK,SCCB_RD_Reg(0x0a),16);
 //	LCD_ShowNum(0,100,WHITE,BLACK,SCCB_RD_Reg(0x0b),16);
 
+	//寄存器表逐条写入（不跳过），同时建立影子寄存器
+	memset(OV7670_ShadowValid, 0, sizeof(OV7670_ShadowValid));
 	for(i = 0; i < sizeof(ov7670_init_reg)/sizeof(ov7670_init_reg[0]); i++)
 	{
-		SCCB_WR_Reg(ov7670_init_reg[i][0],ov7670_init_reg[i][1]);
+		OV7670_WriteReg(ov7670_init_reg[i][0], ov7670_init_reg[i][1]);
 	}
 	
-	OV7670_Light_Mode(lightmode);			//白平衡设置0~4; 0
-	OV7670_Color_Saturation(saturation);	//色度设置0~4; 2
-	OV7670_Brightness(brightness);			//亮度设置0~4; 2
-	OV7670_Contrast(contrast);				//对比度设置0~4; 2
- 	OV7670_Special_Effects(effect);			//特效设置0~6; 0
-	//OV7670_Window_Set(12,176,240,320);	//设置窗口
-	OV7670_Window_Set(12,176,240,320);		//设置窗口
+	//XCLK来源和帧率；默认值与寄存器表相同，不产生写入
+	OV7670_SetClock(OV7670_XCLK_SOURCE, OV7670_MAX_FPS_X10);
+	
+	//白平衡、色度、亮度、对比度、特效和窗口，与寄存器表相同的值不再写入
+	OV7670_Apply(&OV7670_DefaultConfig);
 	//OV7670_SetWindow(184,10,128,128);
 	
+	FIFO_Init();							//FIFO读出引擎（DMA方式下配置TIM3/TIM4/DMA）
+	
 	return 0;
 }
@@ -1,6 +1,7 @@
 #ifndef _OV7660_H
 #define _OV7660_H
 #include "stm32f10x.h"
+#include "SCCB.h"
 
 #define OV7670_VSYNC_PORT		GPIOA  
 #define FIFO_WRST_PORT			GPIOA  
@@ -31,9 +32,134 @@
 #define contrast	4
 #define effect		0
 
-extern uint8_t OV7670_STA;
+//XCLK来源（PA8，MCO输出）
+#define OV7670_XCLK_HSE			0		//8MHz，低于传感器的标称输入范围（10~48MHz）
+#define OV7670_XCLK_PLL_DIV2	1		//PLL/2=36MHz
+#define OV7670_XCLK_SYSCLK		2		//72MHz，超出传感器输入范围和GPIO的50MHz，仅用于测试
+
+#ifndef OV7670_XCLK_SOURCE
+#define OV7670_XCLK_SOURCE		OV7670_XCLK_HSE
+#endif
+#ifndef OV7670_MAX_FPS_X10
+#define OV7670_MAX_FPS_X10		100		//开机时按此帧率x10选择时钟（HSE时与寄存器表相同：PLLx4，CLKRC=1）
+#endif
+
+//帧时序（标称值）：每帧510行，每行784tp，RGB565时1tp=2个内部时钟，dummy行加在帧尾
+#define OV7670_FRAME_LINES		510
+#define OV7670_LINE_CLOCKS		(784 * 2)
+#define OV7670_INTCLK_MAX		24000000	//内部时钟上限（VGA 30fps）
+//VSYNC上升沿之后3行VSYNC脉冲和17行消隐，QVGA每个输出行占2行，
+//边读边写时按此计算各行写完的时刻，窗口起始行不同造成的偏差由读出余量覆盖
+#define OV7670_FRAME_LEAD		20
+#define OV7670_ROW_LINES		2
+
+//传感器时钟：内部时钟 = XCLK * PLL倍频 / (2 * (prescale + 1))
+typedef struct
+{
+	u8 xclk;					//OV7670_XCLK_xx
+	u8 pll;						//DBLV[7:6]：0=不倍频，1=x4，2=x6，3=x8
+	u8 prescale;				//CLKRC[5:0]
+} OV7670_ClockTypeDef;
+
+#ifndef OV7670_VERIFY
+#define OV7670_VERIFY	1		//1=寄存器写入后读回比较，不一致时重写（每个寄存器多一次读，约多一倍时间）
+#endif
+
+//传感器配置（期望状态），OV7670_Apply按依赖顺序只写入与影子寄存器不同的寄存器
+typedef struct
+{
+	u8  light_mode;				//白平衡0~4（0=自动）
+	u8  sat_level;				//色度0~4
+	u8  bright_level;			//亮度0~4
+	u8  contrast_level;			//对比度0~4
+	u8  effect_mode;			//特效0~6
+	u16 win_sx;					//窗口，参数同OV7670_Window_Set
+	u16 win_sy;
+	u16 win_width;
+	u16 win_height;
+	u8  gain_ceiling;			//自动增益上限0~6（2x~128x，COM9）
+	u8  ae_high;				//自动曝光目标上限（AEW）
+	u8  ae_low;					//自动曝光目标下限（AEB）
+	u16 fps_x10;				//帧率x10，0=当前时钟的最高帧率；较低时插入dummy行，自动曝光时间可以更长
+} OV7670_ConfigTypeDef;
+
+#define OV7670_CONFIG_REGS	25		//一个配置涉及的寄存器数
+#define OV7670_QVGA_WINDOW	12, 176, 240, 320	//win_sx, win_sy, win_width, win_height
+
+//命名的配置，例如每种补光模式一个
+typedef struct
+{
+	const char *name;
+	OV7670_ConfigTypeDef cfg;
+} OV7670_ProfileTypeDef;
+
+extern const OV7670_ConfigTypeDef OV7670_DefaultConfig;
+
+extern volatile uint32_t OV7670_FrameCount;
+extern SCCB_StatsTypeDef OV7670_SccbStats;
+extern uint32_t OV7670_RegsSkipped;
+extern volatile uint32_t OV7670_ConfigFrame;		//最近一次切换配置时的OV7670_FrameCount
+extern volatile uint32_t OV7670_ConfigCycles;		//该次切换的耗时（DWT周期）
+extern volatile uint32_t OV7670_VsyncAt;			//最近一次VSYNC的DWT_CYCCNT
+extern volatile uint32_t OV7670_VsyncPeriod;		//最近两次VSYNC的间隔（DWT周期），实测的帧周期
+extern OV7670_ClockTypeDef OV7670_Clock;			//当前的传感器时钟
 
 unsigned char OV7670_Init(void);
 void OV7670_Window_Set(u16 sx,u16 sy,u16 width,u16 height);
+void OV7670_SetWindow(u16 startx,u16 starty,u16 width,u16 height);
+void OV7670_Light_Mode(u8 mode);
+void OV7670_Color_Saturation(u8 sat);
+void OV7670_Brightness(u8 bright);
+void OV7670_Contrast(u8 contras);
+void OV7670_Special_Effects(u8 eft);
+
+/*
+ * 选择达到fps_x10（帧率x10）的最低内部时钟，不超过OV7670_INTCLK_MAX
+ * 返回：该时钟下的最高帧率x10（达不到fps_x10时为可达到的最高帧率）
+ */
+u16 OV7670_ClockFor(u8 xclk, u16 fps_x10, OV7670_ClockTypeDef *clk);
+
+/*
+ * 切换XCLK来源并设置PLL/CLKRC，再按当前配置的fps_x10重新计算dummy行
+ * 切换后的前一两帧曝光不正确，调用者应舍弃
+ * 返回：该时钟下的最高帧率x10
+ */
+u16 OV7670_SetClock(u8 xclk, u16 fps_x10);
+
+u32 OV7670_IntClockHz(const OV7670_ClockTypeDef *clk);
+u16 OV7670_MaxFps(void);			//当前时钟下的最高帧率x10
+u32 OV7670_LineCycles(void);		//当前时钟下一行的标称时间（DWT周期），与FIFO_LineCycles比较读出是否跟得上
+u32 OV7670_FrameLines(void);		//当前帧率下每帧的行数（含dummy行）
+u32 OV7670_FrameCycles(void);		//当前帧率下一帧的标称时间（DWT周期，含dummy行）
+
+/*
+ * 应用一个配置：按依赖顺序生成寄存器列表，只写入与影子寄存器不同的值，
+ * 由已打开的自动控制改写的增益寄存器不写入
+ * 返回：0 成功；1 有寄存器写入失败
+ */
+u8 OV7670_Apply(const OV7670_ConfigTypeDef *cfg);
+
+/*
+ * 请求切换配置：下一个VSYNC（垂直消隐开始）之后由OV7670_ConfigService写入，之后的第一帧使用新配置
+ * settle：切换后还需舍弃的帧数（补光改变时为1：新帧开头几行的曝光开始于补光打开之前）；
+ *         VSYNC时等待写入的这一帧算作其中一帧
+ * cfg须在切换完成前保持有效（通常为const表中的项）
+ */
+void OV7670_RequestConfig(const OV7670_ConfigTypeDef *cfg, u8 settle);
+
+/* 请求的配置已应用且舍弃帧已过 */
+u8 OV7670_ConfigReady(void);
+
+/*
+ * EXTI2中断中每个VSYNC调用一次，不访问SCCB：有待切换的配置时记下VSYNC已过
+ * 返回：1 这一帧可以写入FIFO；0 配置尚未切换或仍在舍弃帧中
+ */
+u8 OV7670_VsyncUpdate(void);
+
+/*
+ * 拍照任务在帧事件（FRAME_EV_HOLD）中调用：VSYNC之后写入待切换的配置
+ * 返回：1 已写入；0 没有待写入的配置或VSYNC尚未到来
+ */
+u8 OV7670_ConfigService(void);
 
 #endif
@@ -1,10 +1,33 @@
 #include "sys.h"
 #include "SCCB.h"
-#include "delay.h"
+
+//各段等待的DWT周期数，由SCCB_SetTiming计算
+static u32 SCCB_LowCycles;
+static u32 SCCB_HighCycles;
+static u32 SCCB_BufCycles;
+
+static void SCCB_Wait(u32 cycles)
+{
+	u32 start = DWT_CYCCNT;
+	while(DWT_CYCCNT - start < cycles);
+}
+
+static u32 SCCB_NsToCycles(u16 ns)
+{
+	return ((u32)ns * (SystemCoreClock / 1000000) + 999) / 1000;	//向上取整，不短于规定时间
+}
+
+void SCCB_SetTiming(const SCCB_TimingTypeDef *timing)
+{
+	SCCB_LowCycles = SCCB_NsToCycles(timing->low_ns);
+	SCCB_HighCycles = SCCB_NsToCycles(timing->high_ns);
+	SCCB_BufCycles = SCCB_NsToCycles(timing->buf_ns);
+}
 
 void SCCB_Init(void)
 {			
  	GPIO_InitTypeDef GPIO_InitStructure;
+	SCCB_TimingTypeDef timing = {SCCB_LOW_NS, SCCB_HIGH_NS, SCCB_BUF_NS};
  	
  	RCC_APB2PeriphClockCmd(RCC_APB2Periph_GPIOA | RCC_APB2Periph_GPIOB, ENABLE);	
 	
@@ -21,39 +44,40 @@ void SCCB_Init(void)
  	GPIO_SetBits(SCCB_SCL_PORT,SCCB_SCL_PIN);
 	GPIO_SetBits(SCCB_SDA_PORT,SCCB_SDA_PIN);		
  
-	SCCB_SDA_OUT();	   
+	SCCB_SDA_OUT();
+
+	DWT_Init();
+	SCCB_SetTiming(&timing);
 }			 
 
 void SCCB_Start(void)
 {
 	SCCB_SDA=1;				//数据线高电平	   
 	SCCB_SCL=1;				//在时钟线高的时候数据线由高至低
-	delay_us(50);  
+	SCCB_Wait(SCCB_HighCycles);
 	SCCB_SDA=0;
-	delay_us(50);	 
+	SCCB_Wait(SCCB_HighCycles);
 	SCCB_SCL=0;				//数据线恢复低电平，单操作函数必要	  
 }
 
 void SCCB_Stop(void)
 {
 	SCCB_SDA=0;
-	delay_us(50);	 
+	SCCB_Wait(SCCB_LowCycles);
 	SCCB_SCL=1;	
-	delay_us(50); 
+	SCCB_Wait(SCCB_HighCycles);
 	SCCB_SDA=1;	
-	delay_us(50);
+	SCCB_Wait(SCCB_BufCycles);	//下一次起始之前的总线空闲时间
 }  
 
 void SCCB_No_Ack(void)
 {
-	delay_us(50);
 	SCCB_SDA=1;
+	SCCB_Wait(SCCB_LowCycles);
 	SCCB_SCL=1;
-	delay_us(50);
+	SCCB_Wait(SCCB_HighCycles);
 	SCCB_SCL=0;
-	delay_us(50);
 	SCCB_SDA=0;
-	delay_us(50);
 }
 
 u8 SCCB_WR_Byte(u8 dat)
@@ -64,16 +88,16 @@ u8 SCCB_WR_Byte(u8 dat)
 		if(dat&0x80)SCCB_SDA=1;
 		else SCCB_SDA=0;
 		dat<<=1;
-		delay_us(50);
+		SCCB_Wait(SCCB_LowCycles);
 		SCCB_SCL=1;
-		delay_us(50);
+		SCCB_Wait(SCCB_HighCycles);
 		SCCB_SCL=0;
 	}
 	
 	SCCB_SDA_IN();			//设置SDA为输入
-	delay_us(50);
+	SCCB_Wait(SCCB_LowCycles);
 	SCCB_SCL=1;				//接收第九位,以判断是否发送成功
-	delay_us(50);
+	SCCB_Wait(SCCB_HighCycles);
 	if(SCCB_READ_SDA)res=1;	//SDA=1发送失败，返回1
 	else res=0;				//SDA=0发送成功，返回0
 	SCCB_SCL=0;
@@ -87,11 +111,11 @@ u8 SCCB_RD_Byte(void)
 	SCCB_SDA_IN();			//设置SDA为输入
 	for(j=8;j>0;j--)		//循环8次接收数据
 	{		     	  
-		delay_us(50);
+		SCCB_Wait(SCCB_LowCycles);
 		SCCB_SCL=1;
+		SCCB_Wait(SCCB_HighCycles);
 		temp=temp<<1;
 		if(SCCB_READ_SDA)temp++;   
-		delay_us(50);
 		SCCB_SCL=0;
 	}	
 	SCCB_SDA_OUT();			//设置SDA为输出
@@ -103,9 +127,7 @@ u8 SCCB_WR_Reg(u8 reg,u8 data)
 	u8 res=0;
 	SCCB_Start();					//启动SCCB传输
 	if(SCCB_WR_Byte(SCCB_ID))res=1;	//写器件ID
-	delay_us(100);
 	if(SCCB_WR_Byte(reg))res=1;		//写寄存器地址
-	delay_us(100);
 	if(SCCB_WR_Byte(data))res=1;	//写数据
 	SCCB_Stop();
 	return	res;
@@ -116,17 +138,50 @@ u8 SCCB_RD_Reg(u8 reg)
 	u8 val=0;
 	SCCB_Start();				//启动SCCB传输
 	SCCB_WR_Byte(SCCB_ID);		//写器件ID
-	delay_us(100);
 	SCCB_WR_Byte(reg);			//写寄存器地址
-	delay_us(100);
-	SCCB_Stop();
-	delay_us(100);
-	//设置寄存器地址后，才是读
+	SCCB_Stop();				//SCCB不支持重复起始，先停止再开始读
 	SCCB_Start();
 	SCCB_WR_Byte(SCCB_ID|0X01);	//发送读命令
-	delay_us(100);
 	val=SCCB_RD_Byte();			//读取数据
 	SCCB_No_Ack();
 	SCCB_Stop();
 	return val;
 }
+
+u8 SCCB_WR_Table(const u8 *table, u16 count, const SCCB_LoadTypeDef *opt, SCCB_StatsTypeDef *stats)
+{
+	u32 start = DWT_CYCCNT;
+	u8 result = 0;
+	u8 tries;
+	u16 i;
+
+	for(i = 0; i < count; i++)
+	{
+		u8 reg = table[i * 2];
+		u8 val = table[i * 2 + 1];
+
+		for(tries = 0; ; tries++)
+		{
+			if(tries)
+				stats->retries++;
+			if(SCCB_WR_Reg(reg, val))
+				stats->nacks++;
+			else if(!opt->verify || (opt->no_verify && opt->no_verify(reg, val)) || SCCB_RD_Reg(reg) == val)
+				break;
+			else
+				stats->mismatches++;
+
+			if(tries >= opt->retries)
+			{
+				stats->failed++;
+				stats->last_failed = reg;
+				result = 1;
+				break;
+			}
+		}
+		stats->writes++;
+	}
+
+	stats->cycles += DWT_CYCCNT - start;
+	return result;
+}
@@ -16,7 +16,42 @@
 #define SCCB_READ_SDA			PAin(1)
 #define SCCB_ID					0X42
 
+//总线时序（ns），按DWT周期计数等待，与主频无关
+//默认值为SCCB/I2C快速模式的最小值（约385kHz）；连线较长或上拉较弱时用SCCB_SetTiming放慢
+#define SCCB_LOW_NS				1300					//SCL低电平（tLOW），SDA在此期间改变
+#define SCCB_HIGH_NS			600						//SCL高电平（tHIGH），也用作起始/停止条件的建立和保持时间
+#define SCCB_BUF_NS				1300					//停止到下一次起始的总线空闲时间（tBUF）
+#define SCCB_RETRIES			3						//批量写入时每个寄存器的重试次数（NACK或读回不一致）
+
+typedef struct
+{
+	u16 low_ns;
+	u16 high_ns;
+	u16 buf_ns;
+} SCCB_TimingTypeDef;
+
+//批量写入的统计，SCCB_WR_Table累加到其中
+typedef struct
+{
+	u16 writes;					//写入的寄存器数
+	u16 retries;				//重试次数
+	u16 nacks;					//NACK次数
+	u16 mismatches;				//读回不一致次数
+	u16 failed;					//重试后仍失败的寄存器数
+	u8  last_failed;			//最后一个失败的寄存器地址
+	u32 cycles;					//总耗时（DWT周期）
+} SCCB_StatsTypeDef;
+
+//批量写入的选项
+typedef struct
+{
+	u8 verify;					//1=每次写入后读回比较
+	u8 retries;					//每个寄存器的重试次数
+	u8 (*no_verify)(u8 reg, u8 val);	//返回1的寄存器不读回比较（读回值与写入值不同的寄存器），可为NULL
+} SCCB_LoadTypeDef;
+
 void SCCB_Init(void);
+void SCCB_SetTiming(const SCCB_TimingTypeDef *timing);
 void SCCB_Start(void);
 void SCCB_Stop(void);
 void SCCB_No_Ack(void);
@@ -25,4 +60,10 @@ u8 SCCB_RD_Byte(void);
 u8 SCCB_WR_Reg(u8 reg,u8 data);
 u8 SCCB_RD_Reg(u8 reg);
 
+/*
+ * 按顺序写入count个寄存器，table为{地址, 值}对（u8 [][2]表的首行），NACK或读回不一致时重试
+ * 返回：0 全部成功；1 有寄存器重试后仍失败（其余寄存器照常写入）
+ */
+u8 SCCB_WR_Table(const u8 *table, u16 count, const SCCB_LoadTypeDef *opt, SCCB_StatsTypeDef *stats);
+
 #endif
@@ -1,14 +1,103 @@
 #include "SDdriver.h"
 #include "ff.h"
 #include "stm32f10x_spi.h"
-#include "Delay.h"
+#include "stm32f10x_dma.h"
+#include "sys.h"
 
 uint8_t DFF=0xFF;
 uint8_t test;
 uint8_t SD_TYPE=0x00;
+uint32_t SD_SpiHz;				// SPI clock selected after init
+uint32_t SD_InitTicks;			// Duration of the last SD_init, in SD_NOW() ticks (boot timing)
 
 MSD_CARDINFO SD0_CardInfo;
 
+//////////////////////////////////////////////////////////////
+// Timeouts: deadlines on the DWT cycle counter, no sleeping
+//////////////////////////////////////////////////////////////
+#ifndef SD_NOW
+#define SD_NOW()				DWT_CYCCNT
+#define SD_TICKS_PER_MS			(SystemCoreClock / 1000)
+#endif
+
+static uint32_t SD_Deadline(uint32_t ms)
+{
+	return SD_NOW() + ms * SD_TICKS_PER_MS;
+}
+
+static uint8_t SD_Expired(uint32_t deadline)
+{
+	return (int32_t)(SD_NOW() - deadline) >= 0;
+}
+
+#if SD_USE_DMA
+//////////////////////////////////////////////////////////////
+// SPI1 block transfers on DMA1: channel 2 = RX, channel 3 = TX
+//////////////////////////////////////////////////////////////
+static const uint8_t SD_DmaFF = 0xFF;	// TX source while reading
+static uint8_t SD_DmaSink;				// RX sink while writing
+
+void (*SD_IdleHook)(void);				// Called while a block is in flight
+
+static void SD_DmaInit(void)
+{
+	DMA_InitTypeDef DMA_InitStructure;
+
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+
+	// Memory address, increment and length are set per transfer by SD_DmaXfer
+	DMA_DeInit(DMA1_Channel2);
+	DMA_DeInit(DMA1_Channel3);
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&SPI1->DR;
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)&SD_DmaSink;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralSRC;
+	DMA_InitStructure.DMA_BufferSize = 0;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Disable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_High;		// Below the FIFO sampler (VeryHigh)
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(DMA1_Channel2, &DMA_InitStructure);
+
+	// TX one level lower than RX so a received byte is always drained before the next one lands
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+	DMA_Init(DMA1_Channel3, &DMA_InitStructure);
+}
+
+// Full-duplex transfer of len bytes. tx==0 clocks out 0xFF, rx==0 discards input.
+static void SD_DmaXfer(const uint8_t *tx, uint8_t *rx, uint16_t len)
+{
+	DMA1_Channel2->CCR &= ~(DMA_CCR2_EN | DMA_CCR2_MINC);
+	DMA1_Channel3->CCR &= ~(DMA_CCR3_EN | DMA_CCR3_MINC);
+	DMA1->IFCR = DMA1_FLAG_GL2 | DMA1_FLAG_GL3;
+
+	DMA1_Channel2->CMAR = rx ? (uint32_t)rx : (uint32_t)&SD_DmaSink;
+	DMA1_Channel3->CMAR = tx ? (uint32_t)tx : (uint32_t)&SD_DmaFF;
+	DMA1_Channel2->CNDTR = len;
+	DMA1_Channel3->CNDTR = len;
+	if(rx) DMA1_Channel2->CCR |= DMA_CCR2_MINC;
+	if(tx) DMA1_Channel3->CCR |= DMA_CCR3_MINC;
+	DMA1_Channel2->CCR |= DMA_CCR2_EN;
+	DMA1_Channel3->CCR |= DMA_CCR3_EN;
+
+	// TXE is already set, so the first TX request fires as soon as it is enabled
+	SPI1->CR2 |= SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx;
+
+	// RX finishes last: every byte has been clocked out and read back
+	while((DMA1->ISR & DMA1_FLAG_TC2) == 0)
+	{
+		if(SD_IdleHook) SD_IdleHook();
+	}
+
+	SPI1->CR2 &= ~(SPI_I2S_DMAReq_Rx | SPI_I2S_DMAReq_Tx);
+	DMA1_Channel2->CCR &= ~DMA_CCR2_EN;
+	DMA1_Channel3->CCR &= ~DMA_CCR3_EN;
+}
+#endif
+
 //////////////////////////////////////////////////////////////
 // Chip Select
 //////////////////////////////////////////////////////////////
@@ -19,42 +108,78 @@ void SD_CS(uint8_t p){
 		GPIO_ResetBits(SD_CS_GPIO_Port, SD_CS_Pin); // CS = LOW (Select)
 		}
 }
+
+// Wait until the card releases DO (0xFF = not busy)
+uint8_t SD_WaitReady(uint32_t ms)
+{
+	uint32_t deadline = SD_Deadline(ms);
+
+	do{
+		if(spi_readwrite(DFF) == 0xFF) return 0;
+	}while(!SD_Expired(deadline));
+
+	return 1;
+}
+
+// Release the card; one extra clock lets it release DO
+static void SD_Deselect(void)
+{
+	SD_CS(0);
+	spi_readwrite(DFF);
+}
+
+// Select the card and wait for it to be ready for a command
+static uint8_t SD_Select(void)
+{
+	SD_CS(1);
+	spi_readwrite(DFF);
+	if(SD_WaitReady(SD_TIMEOUT_WRITE_MS) == 0) return 0;
+	SD_Deselect();
+	return 1;
+}
+
+// Wait for any previous write to finish (used by CTRL_SYNC)
+uint8_t SD_Sync(void)
+{
+	uint8_t r = SD_Select();
+	SD_Deselect();
+	return r;
+}
+
 ///////////////////////////////////////////////////////////////
-// Send command, release after sending
+// Send command; the card stays selected for the data phase.
+// ACMDs (ACMD flag set) are prefixed with CMD55.
 //////////////////////////////////////////////////////////////
 int SD_sendcmd(uint8_t cmd,uint32_t arg,uint8_t crc){
 	uint8_t r1;
-  uint16_t retry;
-  uint16_t timeout;
+	uint8_t n;
 
-  SD_CS(0);
-	delay_ms(20);
-  SD_CS(1);
+	if(cmd & ACMD){
+		cmd &= ~ACMD;
+		r1 = SD_sendcmd(CMD55, 0, 0x01);
+		if(r1 > 1) return r1;
+	}
 
-  // Wait for bus idle, with timeout
-  timeout = 0;
-	do{
-		retry=spi_readwrite(DFF);
-		timeout++;
-		if(timeout > 1000) return 0xFF;  // Timeout return
-	}while(retry!=0xFF);
-
-  spi_readwrite(cmd | 0x40);
-  spi_readwrite(arg >> 24);
-  spi_readwrite(arg >> 16);
-  spi_readwrite(arg >> 8);
-  spi_readwrite(arg);
-  spi_readwrite(crc);
-  if(cmd==CMD12)spi_readwrite(DFF);
-
-  // Wait for response with timeout
-  timeout = 0;
-  do
+	// CMD12 is sent in the middle of a read stream, the card is never "ready" there
+	if(cmd != CMD12){
+		SD_Deselect();
+		if(SD_Select()) return 0xFF;
+	}
+
+	spi_readwrite(cmd | 0x40);
+	spi_readwrite(arg >> 24);
+	spi_readwrite(arg >> 16);
+	spi_readwrite(arg >> 8);
+	spi_readwrite(arg);
+	spi_readwrite(crc);
+	if(cmd==CMD12)spi_readwrite(DFF);	// Skip the stuff byte
+
+	// Response arrives within NCR (max 8) bytes
+	n = 10;
+	do
 	{
-		r1=spi_readwrite(0xFF);
-		timeout++;
-		if(timeout > 1000) return 0xFF;  // Timeout return
-	}while(r1&0X80);
+		r1=spi_readwrite(DFF);
+	}while((r1&0X80) && --n);
 
 	return r1;
 }
@@ -66,131 +191,161 @@ int SD_sendcmd(uint8_t cmd,uint32_t arg,uint8_t crc){
 uint8_t SD_init(void)
 {
 	uint8_t r1;
-	uint8_t buff[6] = {0};
-	uint16_t retry;
+	uint8_t buff[16] = {0};
+	uint32_t deadline;
+	uint32_t start;
 	uint8_t i;
 
-//	MX_SPI3_Init();
-	SPI_setspeed(0x00);
+	DWT_Init();
+	start = SD_NOW();
+#if SD_USE_DMA
+	SD_DmaInit();
+#endif
+	SD_TYPE = 0;
+	SPI_setspeed(SPI_BaudRatePrescaler_256);	// 281kHz, identification mode must stay below 400kHz
 
-	// CS high, send at least 74 clocks(10 bytes = 80 clocks)
-	SD_CS(0);  // CS = HIGH (Release)
-	delay_ms(10);
-	for(retry=0;retry<20;retry++){  // Increased to 20 bytes
-			spi_readwrite(DFF);
+	// CS high, send at least 74 clocks
+	SD_CS(0);
+	for(i=0;i<10;i++){
+		spi_readwrite(DFF);
 	}
 
 	// SD card enter IDLE state
-	retry = 0;
+	deadline = SD_Deadline(SD_TIMEOUT_INIT_MS);
 	do{
-		r1 = SD_sendcmd(CMD0 ,0, 0x95);
-		retry++;
-		if(retry > 200) {
-			SD_CS(0);
+		r1 = SD_sendcmd(CMD0, 0, 0x95);
+		if(SD_Expired(deadline)){
+			SD_Deselect();
+			SD_InitTicks = SD_NOW() - start;
 			return 1;  // Init timeout
 		}
 	}while(r1!=0x01);
 
-	// Check SD card type
-	SD_TYPE=0;
-	r1 = SD_sendcmd(CMD8, 0x1AA, 0x87);
-	if(r1==0x01){
+	// Check SD card type; ACMD41 may take up to 1s
+	deadline = SD_Deadline(SD_TIMEOUT_INIT_MS);
+	if(SD_sendcmd(CMD8, 0x1AA, 0x87)==0x01){
 		for(i=0;i<4;i++)buff[i]=spi_readwrite(DFF);	//Get trailing return value of R7 resp
 		if(buff[2]==0X01&&buff[3]==0XAA)//Card supports 2.7~3.6V
 		{
-			retry=0XFFFE;
-			do
-			{
-				SD_sendcmd(CMD55,0,0X01);	//Send CMD55
-				r1=SD_sendcmd(CMD41,0x40000000,0X01);//Send CMD41
-			}while(r1&&retry--);
-			if(retry&&SD_sendcmd(CMD58,0,0X01)==0)//Identify SD2.0 card version
-			{
-				for(i=0;i<4;i++)buff[i]=spi_readwrite(0XFF);//Get OCR value
-				if(buff[0]&0x40){
-					SD_TYPE=V2HC;
-				}else {
-					SD_TYPE=V2;
-				}
-			}
-		}else{
-			SD_sendcmd(CMD55,0,0X01);			//Send CMD55
-			r1=SD_sendcmd(CMD41,0,0X01);	//Send CMD41
-			if(r1<=1)
-			{
-				SD_TYPE=V1;
-				retry=0XFFFE;
-				do //Wait for exit IDLE mode
-				{
-					SD_sendcmd(CMD55,0,0X01);	//Send CMD55
-					r1=SD_sendcmd(CMD41,0,0X01);//Send CMD41
-				}while(r1&&retry--);
-			}else//MMC card does not support CMD55+CMD41
+			while(SD_sendcmd(ACMD41,0x40000000,0X01) && !SD_Expired(deadline));
+			if(!SD_Expired(deadline)&&SD_sendcmd(CMD58,0,0X01)==0)//Identify SD2.0 card version
 			{
-				SD_TYPE=MMC;//MMC V3
-				retry=0XFFFE;
-				do //Wait for exit IDLE mode
-				{
-					r1=SD_sendcmd(CMD1,0,0X01);//Send CMD1
-				}while(r1&&retry--);
+				for(i=0;i<4;i++)buff[i]=spi_readwrite(DFF);//Get OCR value
+				SD_TYPE = (buff[0]&0x40) ? V2HC : V2;
 			}
-			if(retry==0||SD_sendcmd(CMD16,512,0X01)!=0)SD_TYPE=ERR;//Bad card
 		}
+	}else{
+		if(SD_sendcmd(ACMD41,0,0X01)<=1)
+		{
+			SD_TYPE=V1;
+			while(SD_sendcmd(ACMD41,0,0X01) && !SD_Expired(deadline));	//Wait for exit IDLE mode
+		}else//MMC card does not support CMD55+CMD41
+		{
+			SD_TYPE=MMC;//MMC V3
+			while(SD_sendcmd(CMD1,0,0X01) && !SD_Expired(deadline));
+		}
+		if(SD_Expired(deadline)||SD_sendcmd(CMD16,512,0X01)!=0)SD_TYPE=ERR;//Bad card
 	}
-	SD_CS(0);
-	SPI_setspeed(0x08);
-	if(SD_TYPE)return 0;
-	else return 1;
+	if(SD_TYPE==V2 && SD_sendcmd(CMD16,512,0X01)!=0)SD_TYPE=ERR;	//Byte addressed V2 card: fix block length
+	SD_Deselect();
+
+	if(!SD_TYPE)
+	{
+		SD_InitTicks = SD_NOW() - start;
+		return 1;
+	}
+
+	// Switch to the fastest clock allowed by both the card (CSD TRAN_SPEED) and SPI1
+	SPI_setspeed(SPI_BaudRatePrescaler_16);
+	if(SD_GETCSD(buff)==0)
+		SD_SetMaxSpeed(buff[3]);
+	else
+		SD_SetMaxSpeed(0x32);	// 25MHz, the default for all SD cards
+	SD_InitTicks = SD_NOW() - start;
+	return 0;
+}
+
+// Pick the smallest SPI1 prescaler that respects both limits
+void SD_SetMaxSpeed(uint8_t tran_speed)
+{
+	static const uint8_t mult[16] = {0, 10, 12, 13, 15, 20, 25, 30, 35, 40, 45, 50, 55, 60, 70, 80};
+	static const uint32_t unit[4] = {10000, 100000, 1000000, 10000000};	// TRAN_SPEED unit / 10
+	uint32_t card_hz, pclk_hz, hz;
+	uint8_t br;
+
+	card_hz = unit[tran_speed & 0x03] * mult[(tran_speed >> 3) & 0x0F];
+	if(card_hz == 0 || (tran_speed & 0x04)) card_hz = 25000000;
+	if(card_hz > SD_SPI_MAX_HZ) card_hz = SD_SPI_MAX_HZ;
+
+	pclk_hz = SystemCoreClock;	// SPI1 is on APB2 = HCLK
+	for(br = 0, hz = pclk_hz / 2; br < 7 && hz > card_hz; br++) hz >>= 1;
+
+	SD_SpiHz = hz;
+	SPI_setspeed(br << 3);
 }
 
 
 //Read specified length data
 uint8_t SD_ReceiveData(uint8_t *data, uint16_t len)
 {
-   uint8_t r1;
-   uint16_t timeout = 0;
-   SD_CS(1);
-   do
-   {
-      r1 = spi_readwrite(0xFF);
-      delay_ms(10);
-      timeout++;
-      if(timeout > 200) {
-        SD_CS(0);
-        return 1;  // Timeout return error
-      }
-	 }while(r1 != 0xFE);
-  while(len--)
-  {
-   *data = spi_readwrite(0xFF);
-   data++;
-  }
-  spi_readwrite(0xFF);
-  spi_readwrite(0xFF);
-  return 0;
+	uint8_t r1;
+	uint32_t deadline = SD_Deadline(SD_TIMEOUT_READ_MS);
+
+	do
+	{
+		r1 = spi_readwrite(DFF);
+		if(r1 != 0xFF) break;
+	}while(!SD_Expired(deadline));
+	if(r1 != 0xFE) return 1;	// Timeout or data error token
+
+#if SD_USE_DMA
+	if(len >= SD_DMA_MIN_LEN)
+	{
+		SD_DmaXfer(0, data, len);
+	}
+	else
+#endif
+	while(len--)
+	{
+		*data++ = spi_readwrite(DFF);
+	}
+	spi_readwrite(DFF);		// Discard CRC
+	spi_readwrite(DFF);
+	return 0;
 }
-//Write a data packet to SD card (512 bytes)
-uint8_t SD_SendBlock(uint8_t*buf,uint8_t cmd)
+static void SD_SendData(const uint8_t *buf, uint16_t len)
 {
-	uint16_t t;
-	uint8_t r1;
-	uint16_t timeout = 0;
-	do{
-		r1=spi_readwrite(0xFF);
-		timeout++;
-		if(timeout > 1000) return 1;  // Timeout
-	}while(r1!=0xFF);
+#if SD_USE_DMA
+	SD_DmaXfer(buf, 0, len);
+#else
+	while(len--)spi_readwrite(*buf++);
+#endif
+}
+
+// Send one data packet from up to two buffers: head_len bytes of head, then the rest of the 512 from tail
+static uint8_t SD_SendBlockParts(const uint8_t *head, uint16_t head_len, const uint8_t *tail, uint8_t cmd)
+{
+	uint8_t t;
+
+	if(SD_WaitReady(SD_TIMEOUT_WRITE_MS)) return 1;	// Previous block still programming
 
 	spi_readwrite(cmd);
 	if(cmd!=0XFD)//Not end command
 	{
-		for(t=0;t<512;t++)spi_readwrite(buf[t]);//Increase speed, reduce function parameter time
-	    spi_readwrite(0xFF);//Ignore crc
-	    spi_readwrite(0xFF);
+		if(head_len) SD_SendData(head, head_len);
+		if(head_len < 512) SD_SendData(tail, 512 - head_len);
+		spi_readwrite(0xFF);//Ignore crc
+		spi_readwrite(0xFF);
 		t=spi_readwrite(0xFF);//Receive response
 		if((t&0x1F)!=0x05)return 2;//Response error
 	}
-    return 0;//Write successful
+	return 0;//Write successful
+}
+
+//Write a data packet to SD card (512 bytes)
+uint8_t SD_SendBlock(uint8_t*buf,uint8_t cmd)
+{
+	return SD_SendBlockParts(buf, 512, 0, cmd);
 }
 
 //Get CID information
@@ -201,7 +356,7 @@ uint8_t SD_GETCID (uint8_t *cid_data)
 		if(r1==0x00){
 			r1=SD_ReceiveData(cid_data,16);
 		}
-		SD_CS(0);
+		SD_Deselect();
 		if(r1)return 1;
 		else return 0;
 }
@@ -213,7 +368,7 @@ uint8_t SD_GETCSD(uint8_t *csd_data){
 	{
     r1=SD_ReceiveData(csd_data, 16);//Receive 16 bytes data
     }
-	SD_CS(0);//Deselect
+	SD_Deselect();
 	if(r1)return 1;
 	else return 0;
 }
@@ -249,11 +404,13 @@ int MSD0_GetCardInfo(PMSD_CARDINFO SD0_CardInfo)
   r1 = SD_sendcmd(CMD9, 0, 0xFF);
   if(r1 != 0x00)
   {
+    SD_Deselect();
     return r1;
   }
 
   if(SD_ReceiveData(CSD_Tab, 16))
   {
+	SD_Deselect();
 	return 1;
   }
 
@@ -261,10 +418,13 @@ int MSD0_GetCardInfo(PMSD_CARDINFO SD0_CardInfo)
   r1 = SD_sendcmd(CMD10, 0, 0xFF);
   if(r1 != 0x00)
   {
+    SD_Deselect();
     return r1;
   }
 
-  if(SD_ReceiveData(CID_Tab, 16))
+  r1 = SD_ReceiveData(CID_Tab, 16);
+  SD_Deselect();
+  if(r1)
   {
 	return 2;
   }
@@ -380,71 +540,120 @@ int MSD0_GetCardInfo(PMSD_CARDINFO SD0_CardInfo)
 }
 
 
+//////////////////////////////////////////////////////////////
+// Streaming multi-block transfers. The card stays selected between
+// blocks; nothing else may use SPI1 until the matching Stop call.
+//////////////////////////////////////////////////////////////
+
+//Start a CMD25 write stream; count>0 pre-erases that many blocks (ACMD23)
+uint8_t SD_WriteMultiStart(uint32_t sector, uint32_t count)
+{
+	if(SD_TYPE!=V2HC)sector <<= 9;//Convert to byte address
+	if(count && SD_TYPE!=MMC)
+	{
+		if(SD_sendcmd(ACMD23,count,0X01)!=0) {SD_Deselect(); return 1;}
+	}
+	if(SD_sendcmd(CMD25,sector,0X01)!=0) {SD_Deselect(); return 1;}
+	return 0;
+}
+
+uint8_t SD_WriteMultiBlock(const uint8_t *buf)
+{
+	return SD_SendBlockParts(buf,512,0,0xFC);
+}
+
+//One block assembled from the end of one buffer and the start of the next, without copying
+uint8_t SD_WriteMultiBlockParts(const uint8_t *head, uint16_t head_len, const uint8_t *tail)
+{
+	return SD_SendBlockParts(head,head_len,tail,0xFC);
+}
+
+//Send the stop token; the card programs the last block in the background
+uint8_t SD_WriteMultiStop(void)
+{
+	uint8_t r1 = SD_SendBlock(0,0xFD);
+	SD_Deselect();
+	return r1;
+}
+
+uint8_t SD_ReadMultiStart(uint32_t sector)
+{
+	if(SD_TYPE!=V2HC)sector <<= 9;//Convert to byte address
+	if(SD_sendcmd(CMD18,sector,0X01)!=0) {SD_Deselect(); return 1;}
+	return 0;
+}
+
+uint8_t SD_ReadMultiBlock(uint8_t *buf)
+{
+	return SD_ReceiveData(buf,512);
+}
+
+uint8_t SD_ReadMultiStop(void)
+{
+	uint8_t r1 = SD_sendcmd(CMD12,0,0X01);
+	if(r1==0 && SD_WaitReady(SD_TIMEOUT_READ_MS)) r1 = 1;
+	SD_Deselect();
+	return r1;
+}
+
 //Write SD card
 //buf:data buffer
 //sector:start sector
 //cnt:sector count
 //return value:0,ok;other,failed.
-uint8_t SD_WriteDisk(uint8_t*buf,uint32_t sector,uint8_t cnt)
+uint8_t SD_WriteDisk(uint8_t*buf,uint32_t sector,uint32_t cnt)
 {
 	uint8_t r1;
-	if(SD_TYPE!=V2HC)sector *= 512;//Convert to byte address
 	if(cnt==1)
 	{
+		if(SD_TYPE!=V2HC)sector <<= 9;//Convert to byte address
 		r1=SD_sendcmd(CMD24,sector,0X01);//Write command
 		if(r1==0)//Command sent successfully
 		{
 			r1=SD_SendBlock(buf,0xFE);//Write 512 bytes
 		}
-	}else
+		SD_Deselect();
+		return r1;
+	}
+
+	r1=SD_WriteMultiStart(sector,cnt);
+	while(r1==0 && cnt--)
 	{
-		if(SD_TYPE!=MMC)
-		{
-			SD_sendcmd(CMD55,0,0X01);
-			SD_sendcmd(CMD23,cnt,0X01);//Send command
-		}
- 		r1=SD_sendcmd(CMD25,sector,0X01);//Continuous write command
-		if(r1==0)
-		{
-			do
-			{
-				r1=SD_SendBlock(buf,0xFC);//Receive 512 bytes
-				buf+=512;
-			}while(--cnt && r1==0);
-			r1=SD_SendBlock(0,0xFD);//Receive 512 bytes
-		}
+		r1=SD_WriteMultiBlock(buf);
+		buf+=512;
 	}
-	SD_CS(0);//Deselect
-	return r1;//
+	if(SD_WriteMultiStop() && r1==0) r1=1;
+	return r1;
 }
 //Read SD card
 //buf:data buffer
 //sector:sector
 //cnt:sector count
 //return value:0,ok;other,failed.
-uint8_t SD_ReadDisk(uint8_t*buf,uint32_t sector,uint8_t cnt)
+uint8_t SD_ReadDisk(uint8_t*buf,uint32_t sector,uint32_t cnt)
 {
 	uint8_t r1;
-	if(SD_TYPE!=V2HC)sector <<= 9;//Convert to byte address
 	if(cnt==1)
 	{
+		if(SD_TYPE!=V2HC)sector <<= 9;//Convert to byte address
 		r1=SD_sendcmd(CMD17,sector,0X01);//Read command
 		if(r1==0)//Command sent successfully
 		{
 			r1=SD_ReceiveData(buf,512);//Receive 512 bytes
 		}
-	}else
+		SD_Deselect();
+		return r1;
+	}
+
+	r1=SD_ReadMultiStart(sector);
+	if(r1) return r1;
+	while(r1==0 && cnt--)
 	{
-		r1=SD_sendcmd(CMD18,sector,0X01);//Continuous read command
-		do
-		{
-			r1=SD_ReceiveData(buf,512);//Receive 512 bytes
-			buf+=512;
-		}while(--cnt && r1==0);
-		SD_sendcmd(CMD12,0,0X01);	//Send stop command
+		r1=SD_ReadMultiBlock(buf);
+		buf+=512;
 	}
-	SD_CS(0);//Deselect
-	return r1;//
+	if(SD_ReadMultiStop() && r1==0) r1=1;
+	return r1;
 }
 
 
@@ -2,6 +2,8 @@
 #include "integer.h"
 
 extern uint8_t SD_TYPE;
+extern uint32_t SD_SpiHz;
+extern uint32_t SD_InitTicks;
 
 #define SD_CS_GPIO_Port GPIOA
 #define SD_CS_Pin GPIO_Pin_4
@@ -16,6 +18,24 @@ extern uint8_t SD_TYPE;
 #define DUMMY_BYTE				 0xFF 
 #define MSD_BLOCKSIZE			 512
 
+//Timeouts (ms), from the SD physical layer spec for SPI mode
+#define SD_TIMEOUT_INIT_MS		1000	//ACMD41 initialization
+#define SD_TIMEOUT_READ_MS		200		//Read data token (spec: 100ms)
+#define SD_TIMEOUT_WRITE_MS		500		//Write busy / program (spec: 250ms, SDXC 500ms)
+
+//Highest SPI clock SPI1 is specified for in master mode
+#define SD_SPI_MAX_HZ			18000000
+
+//Sector data on DMA1 channel 2 (SPI1_RX) / channel 3 (SPI1_TX); 0 = byte-by-byte polling
+#ifndef SD_USE_DMA
+#define SD_USE_DMA				1
+#endif
+#define SD_DMA_MIN_LEN			64		//Shorter reads (CSD/CID) stay polled
+
+#if SD_USE_DMA
+extern void (*SD_IdleHook)(void);	//Runs while a DMA block transfer is in flight; must not touch SPI1
+#endif
+
 
 //CMD definitions
 #define CMD0    0       //Card reset
@@ -35,6 +55,11 @@ extern uint8_t SD_TYPE;
 #define CMD58   58      //CMD58, read OCR information
 #define CMD59   59      //CMD59, enable/disable CRC, should return 0x00
 
+//Application commands, SD_sendcmd sends CMD55 first
+#define ACMD    0x80
+#define ACMD23  (ACMD | 23)   //ACMD23, SET_WR_BLK_ERASE_COUNT before CMD25
+#define ACMD41  (ACMD | 41)   //ACMD41, SD_SEND_OP_COND
+
 //Data write response meanings
 #define MSD_DATA_OK                0x05
 #define MSD_DATA_CRC_ERROR         0x0B
@@ -139,8 +164,21 @@ uint8_t 		SD_GETCSD(uint8_t *csd_data);
 int 				MSD0_GetCardInfo(PMSD_CARDINFO SD0_CardInfo);
 uint8_t			SD_ReceiveData(uint8_t *data, uint16_t len);
 uint8_t 		SD_SendBlock(uint8_t*buf,uint8_t cmd);
-uint8_t 		SD_ReadDisk(uint8_t*buf,uint32_t sector,uint8_t cnt);
-uint8_t 		SD_WriteDisk(uint8_t*buf,uint32_t sector,uint8_t cnt);
+uint8_t 		SD_ReadDisk(uint8_t*buf,uint32_t sector,uint32_t cnt);
+uint8_t 		SD_WriteDisk(uint8_t*buf,uint32_t sector,uint32_t cnt);
+uint8_t			SD_WaitReady(uint32_t ms);
+uint8_t			SD_Sync(void);
+void			SD_SetMaxSpeed(uint8_t tran_speed);
+int				SD_sendcmd(uint8_t cmd,uint32_t arg,uint8_t crc);
+
+// Streaming multi-block transfers (card stays selected until Stop)
+uint8_t			SD_WriteMultiStart(uint32_t sector, uint32_t count);
+uint8_t			SD_WriteMultiBlock(const uint8_t *buf);
+uint8_t			SD_WriteMultiBlockParts(const uint8_t *head, uint16_t head_len, const uint8_t *tail);
+uint8_t			SD_WriteMultiStop(void);
+uint8_t			SD_ReadMultiStart(uint32_t sector);
+uint8_t			SD_ReadMultiBlock(uint8_t *buf);
+uint8_t			SD_ReadMultiStop(void);
 
 
 void SPI_setspeed(uint8_t speed);
@@ -2,37 +2,96 @@
 
 uint8_t TIM_1S = 0;
 uint16_t FS_Cnt = 0;
+volatile uint32_t TIM_Seconds = 0;		//上电以来的秒数（TIMER_Init之后）
+
+static volatile uint32_t TIMER_Wraps;	//TIM2溢出次数，即微秒时间的高位
+static uint64_t TIMER_NextSecond;		//下一次秒计数加1的时刻（只在中断中使用）
 
 void TIMER_Init(void)
 {
 	TIM_TimeBaseInitTypeDef TIM_InitStructure;
 	NVIC_InitTypeDef        NVIC_InitStructure;
-	
+
 	RCC_APB1PeriphClockCmd(RCC_APB1Periph_TIM2,ENABLE);
 	NVIC_PriorityGroupConfig(NVIC_PriorityGroup_2);
-	
-	TIM_InitStructure.TIM_Period = 10000-1;                    //自动重装载值，5000us进入一次中断
-	TIM_InitStructure.TIM_Prescaler = 7200-1;                  //定时器分频
+
+	TIMER_Wraps = 0;
+	TIMER_NextSecond = 1000000;
+
+	TIM_InitStructure.TIM_Period = 0XFFFF;                     //自由计数，65536us溢出一次
+	TIM_InitStructure.TIM_Prescaler = SystemCoreClock / 1000000 - 1;	//APB1分频不为1时TIM2时钟为HCLK，分频到1MHz
 	TIM_InitStructure.TIM_ClockDivision = TIM_CKD_DIV1;        //定时器时钟分频
 	TIM_InitStructure.TIM_CounterMode = TIM_CounterMode_Up;    //计数模式
-	
-	TIM_TimeBaseInit(TIM2,&TIM_InitStructure);                 //定时器初始化
-	TIM_Cmd(TIM2,ENABLE);         	                           //使能定时器
+
+	TIM_TimeBaseInit(TIM2,&TIM_InitStructure);                 //定时器初始化（产生更新事件装入分频值，计数器清零）
+	TIM_ClearFlag(TIM2,TIM_FLAG_Update);                       //初始化产生的更新事件不算溢出
 	TIM_ITConfig(TIM2,TIM_IT_Update,ENABLE);                   //溢出中断
-	
+	TIM_Cmd(TIM2,ENABLE);         	                           //使能定时器
+
 	NVIC_InitStructure.NVIC_IRQChannel = TIM2_IRQn;
 	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
 	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 1;
 	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
-	
+
 	NVIC_Init(&NVIC_InitStructure);
 }
 
 void TIM2_IRQHandler(void)
 {
+	uint32_t PriMask;
+	uint64_t now;
+
 	if(TIM_GetITStatus(TIM2,TIM_IT_Update) == SET)
 	{
-		TIM_1S = 1;
+		//加高位和清标志之间不能被更高优先级中断中的TIMER_Micros64看到
+		PriMask = __get_PRIMASK();
+		__disable_irq();
+		TIMER_Wraps++;
 		TIM_ClearITPendingBit(TIM2,TIM_IT_Update);                //清除中断标志位
+		__set_PRIMASK(PriMask);
+
+		now = (uint64_t)TIMER_Wraps << 16;
+		while(now >= TIMER_NextSecond)
+		{
+			TIMER_NextSecond += 1000000;
+			TIM_Seconds++;
+			TIM_1S = 1;
+		}
 	}
 }
+
+//上电以来的微秒数：溢出次数 + TIM2计数值（1MHz）
+uint64_t TIMER_Micros64(void)
+{
+	uint32_t PriMask;
+	uint32_t wraps;
+	uint16_t cnt;
+
+	PriMask = __get_PRIMASK();
+	__disable_irq();
+	wraps = TIMER_Wraps;
+	cnt = TIM2->CNT;
+	if(TIM2->SR & TIM_SR_UIF)			//已溢出但中断还没处理（关中断期间或在更高优先级中断中调用）
+	{
+		wraps++;
+		cnt = TIM2->CNT;				//溢出之后重读，之前读到的可能是溢出前的值
+	}
+	__set_PRIMASK(PriMask);
+
+	return ((uint64_t)wraps << 16) | cnt;
+}
+
+uint32_t TIMER_Millis(void)
+{
+	return (uint32_t)(TIMER_Micros64() / 1000);
+}
+
+uint64_t TIMER_Deadline(uint32_t us)
+{
+	return TIMER_Micros64() + us;
+}
+
+uint8_t TIMER_Expired(uint64_t deadline)
+{
+	return TIMER_Micros64() >= deadline;
+}
@@ -2,9 +2,25 @@
 #define _TIMER_H
 #include "sys.h"
 
+/*
+ * 时间基准：TIM2按1MHz自由计数（16位，65.536ms溢出一次），溢出中断扩展为64位微秒时间，单调递增不回绕
+ *
+ *   TIMER_Micros64   上电（TIMER_Init）以来的微秒数，任何中断中都可以调用
+ *   TIMER_Deadline   超时时刻，TIMER_Expired检查是否已到，不阻塞；等待外设时代替循环计数
+ *   TIM_Seconds      秒计数，在溢出中断中更新（最多晚65ms），TIM_1S每秒置1
+ *
+ * 微秒以下的时序（SCCB位时序、读出节拍）仍按DWT周期计数；短延时见delay.h。
+ * TIMER_Init之前时间不走，超时永远不会到，须在使用超时的驱动之前调用。
+ */
+
 extern uint8_t TIM_1S;
 extern uint16_t FS_Cnt;
+extern volatile uint32_t TIM_Seconds;
 
 void TIMER_Init(void);
+uint64_t TIMER_Micros64(void);
+uint32_t TIMER_Millis(void);
+uint64_t TIMER_Deadline(uint32_t us);	//从现在起us微秒后的时刻
+uint8_t TIMER_Expired(uint64_t deadline);
 
 #endif
@@ -1,10 +1,33 @@
 #include "stm32f10x.h"                  // Device header
+#include "USART.h"
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 char Serial_RxPacket[100];				//定义接收数据包数组，数据包格式"@MSG\r\n"
 uint8_t Serial_RxFlag;					//定义接收数据包标志位
 
+/*发送队列：Serial_TxTail为DMA正在发送的描述符，Serial_TxTail~Serial_TxHead-1依次等待*/
+typedef struct
+{
+	const uint8_t *Buf;
+	uint16_t Length;
+	uint8_t Pooled;						//数据在Serial_TxPool中，发送完成后释放
+	Serial_TxDone Done;
+} Serial_TxDesc;
+
+static Serial_TxDesc Serial_TxQueue[SERIAL_TX_QUEUE];
+static volatile uint8_t Serial_TxHead;	//只由主程序修改
+static volatile uint8_t Serial_TxTail;	//只由DMA中断修改
+static volatile uint8_t Serial_TxBusy;
+
+/*缓冲池按分配顺序释放：[Serial_PoolTail, Serial_PoolHead)为未发送完的数据，回绕时末尾剩余部分跳过*/
+static uint8_t Serial_TxPool[SERIAL_TX_POOL];
+static volatile uint16_t Serial_PoolHead;
+static volatile uint16_t Serial_PoolTail;
+
+void DMA1_Channel4_IRQHandler(void);
+
 /**
   * 函    数：串口初始化
   * 参    数：无
@@ -52,10 +75,228 @@ void Serial_Init(void)
 	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;		//指定NVIC线路的响应优先级为1
 	NVIC_Init(&NVIC_InitStructure);							//将结构体变量交给NVIC_Init，配置NVIC外设
 	
+	/*DMA1通道4：USART1_TX，每次传输的地址和长度由Serial_TxStart设置*/
+	RCC_AHBPeriphClockCmd(RCC_AHBPeriph_DMA1, ENABLE);
+	DMA_InitTypeDef DMA_InitStructure;
+	DMA_DeInit(DMA1_Channel4);
+	DMA_InitStructure.DMA_PeripheralBaseAddr = (uint32_t)&USART1->DR;
+	DMA_InitStructure.DMA_MemoryBaseAddr = (uint32_t)Serial_TxPool;
+	DMA_InitStructure.DMA_DIR = DMA_DIR_PeripheralDST;
+	DMA_InitStructure.DMA_BufferSize = 0;
+	DMA_InitStructure.DMA_PeripheralInc = DMA_PeripheralInc_Disable;
+	DMA_InitStructure.DMA_MemoryInc = DMA_MemoryInc_Enable;
+	DMA_InitStructure.DMA_PeripheralDataSize = DMA_PeripheralDataSize_Byte;
+	DMA_InitStructure.DMA_MemoryDataSize = DMA_MemoryDataSize_Byte;
+	DMA_InitStructure.DMA_Mode = DMA_Mode_Normal;
+	DMA_InitStructure.DMA_Priority = DMA_Priority_Medium;
+	DMA_InitStructure.DMA_M2M = DMA_M2M_Disable;
+	DMA_Init(DMA1_Channel4, &DMA_InitStructure);
+	DMA_ITConfig(DMA1_Channel4, DMA_IT_TC, ENABLE);
+	USART_DMACmd(USART1, USART_DMAReq_Tx, ENABLE);
+	
+	NVIC_InitStructure.NVIC_IRQChannel = DMA1_Channel4_IRQn;
+	NVIC_InitStructure.NVIC_IRQChannelCmd = ENABLE;
+	NVIC_InitStructure.NVIC_IRQChannelPreemptionPriority = 0;	//高于串口接收和TIM2；DMA中断不能响应时由Serial_TxPoll处理
+	NVIC_InitStructure.NVIC_IRQChannelSubPriority = 1;
+	NVIC_Init(&NVIC_InitStructure);
+	
 	/*USART使能*/
 	USART_Cmd(USART1, ENABLE);								//使能USART1，串口开始运行
 }
 
+/**
+  * 函    数：启动发送Serial_TxTail指向的描述符（关中断或在DMA中断中调用）
+  * 参    数：无
+  * 返 回 值：无
+  */
+static void Serial_TxStart(void)
+{
+	Serial_TxDesc *Desc = &Serial_TxQueue[Serial_TxTail & (SERIAL_TX_QUEUE - 1)];
+	
+	DMA1_Channel4->CCR &= ~DMA_CCR4_EN;
+	DMA1_Channel4->CMAR = (uint32_t)Desc->Buf;
+	DMA1_Channel4->CNDTR = Desc->Length;
+	DMA1_Channel4->CCR |= DMA_CCR4_EN;
+	Serial_TxBusy = 1;
+}
+
+/**
+  * 函    数：等待发送空间时查询DMA完成标志（关中断调用）
+  * 参    数：无
+  * 返 回 值：无
+  * 注意事项：关中断时或在优先级不低于DMA1通道4的中断中等待，DMA中断无法执行，
+  *           只能在这里结束已完成的描述符；DMA中断先执行时标志已清除，这里不做事
+  */
+static void Serial_TxPoll(void)
+{
+	if (DMA1->ISR & DMA1_FLAG_TC4)
+	{
+		DMA1_Channel4_IRQHandler();
+	}
+}
+
+/**
+  * 函    数：在缓冲池中找一段连续空间（关中断调用）
+  * 参    数：Length 需要的字节数
+  * 返 回 值：起始偏移，SERIAL_TX_POOL表示空间不足
+  */
+static uint16_t Serial_PoolAlloc(uint16_t Length)
+{
+	uint16_t Tail = Serial_PoolTail;
+	
+	if (Serial_PoolHead >= Tail)
+	{
+		if (Length <= SERIAL_TX_POOL - Serial_PoolHead) {return Serial_PoolHead;}
+		if (Length < Tail) {return 0;}		//回绕，保持Head不追上Tail
+	}
+	else if (Length < Tail - Serial_PoolHead)
+	{
+		return Serial_PoolHead;
+	}
+	return SERIAL_TX_POOL;
+}
+
+/**
+  * 函    数：复制数据到缓冲池并排队发送
+  * 参    数：Data 数据首地址，调用返回后即可复用
+  * 参    数：Length 数据长度
+  * 返 回 值：无
+  * 注意事项：紧接在上一段复制数据之后、且上一段还未开始发送时，直接并入上一段，
+  *           连续的字符串和printf输出合并成一次DMA传输
+  */
+static void Serial_Write(const uint8_t *Data, uint16_t Length)
+{
+	uint16_t Chunk, Offset;
+	uint32_t PriMask;
+	Serial_TxDesc *Last;
+	
+	while (Length)
+	{
+		Chunk = Length > SERIAL_TX_CHUNK ? SERIAL_TX_CHUNK : Length;
+		
+		PriMask = __get_PRIMASK();
+		__disable_irq();
+		Offset = Serial_PoolAlloc(Chunk);
+		Last = &Serial_TxQueue[(Serial_TxHead - 1) & (SERIAL_TX_QUEUE - 1)];
+		if (Offset != SERIAL_TX_POOL && (uint8_t)(Serial_TxHead - Serial_TxTail) >= 2
+			&& Last->Pooled && Last->Buf + Last->Length == &Serial_TxPool[Offset])
+		{
+			memcpy(&Serial_TxPool[Offset], Data, Chunk);
+			Last->Length += Chunk;				//上一段还在排队，直接加长
+		}
+		else if (Offset != SERIAL_TX_POOL && (uint8_t)(Serial_TxHead - Serial_TxTail) < SERIAL_TX_QUEUE)
+		{
+			memcpy(&Serial_TxPool[Offset], Data, Chunk);
+			Last = &Serial_TxQueue[Serial_TxHead & (SERIAL_TX_QUEUE - 1)];
+			Last->Buf = &Serial_TxPool[Offset];
+			Last->Length = Chunk;
+			Last->Pooled = 1;
+			Last->Done = 0;
+			Serial_TxHead ++;
+			if (!Serial_TxBusy) {Serial_TxStart();}
+		}
+		else
+		{
+			Serial_TxPoll();					//缓冲池或队列满，等待DMA释放
+			Chunk = 0;
+		}
+		if (Chunk) {Serial_PoolHead = Offset + Chunk;}
+		__set_PRIMASK(PriMask);
+		
+		Data += Chunk;
+		Length -= Chunk;
+	}
+}
+
+/**
+  * 函    数：不复制数据，直接排队发送
+  * 参    数：Array 要发送数组的首地址，Done回调之前不能修改
+  * 参    数：Length 要发送数组的长度
+  * 参    数：Done 发送完成回调，可为0
+  * 返 回 值：无
+  */
+void Serial_SendArrayAsync(const uint8_t *Array, uint16_t Length, Serial_TxDone Done)
+{
+	uint32_t PriMask;
+	Serial_TxDesc *Desc;
+	
+	if (Length == 0)
+	{
+		if (Done) {Done(Array);}
+		return;
+	}
+	
+	PriMask = __get_PRIMASK();
+	__disable_irq();
+	while ((uint8_t)(Serial_TxHead - Serial_TxTail) >= SERIAL_TX_QUEUE)	//队列满，等待
+	{
+		Serial_TxPoll();
+		__set_PRIMASK(PriMask);				//调用者开着中断时让DMA中断有机会执行
+		__disable_irq();
+	}
+	Desc = &Serial_TxQueue[Serial_TxHead & (SERIAL_TX_QUEUE - 1)];
+	Desc->Buf = Array;
+	Desc->Length = Length;
+	Desc->Pooled = 0;
+	Desc->Done = Done;
+	Serial_TxHead ++;
+	if (!Serial_TxBusy) {Serial_TxStart();}
+	__set_PRIMASK(PriMask);
+}
+
+/**
+  * 函    数：等待队列中的数据全部发出（包括最后一个字节的停止位）
+  * 参    数：无
+  * 返 回 值：无
+  */
+void Serial_Flush(void)
+{
+	uint32_t PriMask;
+	
+	while (Serial_TxBusy)
+	{
+		PriMask = __get_PRIMASK();
+		__disable_irq();
+		Serial_TxPoll();
+		__set_PRIMASK(PriMask);
+	}
+	while (USART_GetFlagStatus(USART1, USART_FLAG_TC) == RESET);
+}
+
+/**
+  * 函    数：DMA1通道4中断函数，一个描述符发送完成
+  * 参    数：无
+  * 返 回 值：无
+  */
+void DMA1_Channel4_IRQHandler(void)
+{
+	Serial_TxDesc *Desc;
+	
+	if (DMA1->ISR & DMA1_FLAG_TC4)
+	{
+		DMA1->IFCR = DMA1_FLAG_GL4;
+		
+		Desc = &Serial_TxQueue[Serial_TxTail & (SERIAL_TX_QUEUE - 1)];
+		if (Desc->Pooled)
+		{
+			Serial_PoolTail = (uint16_t)(Desc->Buf - Serial_TxPool) + Desc->Length;
+		}
+		if (Desc->Done) {Desc->Done(Desc->Buf);}
+		Serial_TxTail ++;
+		
+		if (Serial_TxTail != Serial_TxHead)
+		{
+			Serial_TxStart();
+		}
+		else
+		{
+			Serial_TxBusy = 0;
+			Serial_PoolHead = 0;				//队列空，缓冲池从头开始，减少回绕
+			Serial_PoolTail = 0;
+		}
+	}
+}
+
 /**
   * 函    数：串口发送一个字节
   * 参    数：Byte 要发送的一个字节
@@ -63,9 +304,7 @@ void Serial_Init(void)
   */
 void Serial_SendByte(uint8_t Byte)
 {
-	USART_SendData(USART1, Byte);		//将字节数据写入数据寄存器，写入后USART自动生成时序波形
-	while (USART_GetFlagStatus(USART1, USART_FLAG_TXE) == RESET);	//等待发送完成
-	/*下次写入数据寄存器会自动清除发送完成标志位，故此循环后，无需清除标志位*/
+	Serial_Write(&Byte, 1);				//与其他发送函数共用队列，保证顺序
 }
 
 /**
@@ -76,11 +315,7 @@ void Serial_SendByte(uint8_t Byte)
   */
 void Serial_SendArray(uint8_t *Array, uint16_t Length)
 {
-	uint16_t i;
-	for (i = 0; i < Length; i ++)		//遍历数组
-	{
-		Serial_SendByte(Array[i]);		//依次调用Serial_SendByte发送每个字节数据
-	}
+	Serial_Write(Array, Length);		//复制后立即返回，Array可马上复用
 }
 
 /**
@@ -90,11 +325,7 @@ void Serial_SendArray(uint8_t *Array, uint16_t Length)
   */
 void Serial_SendString(char *String)
 {
-	uint8_t i;
-	for (i = 0; String[i] != '\0'; i ++)//遍历字符数组（字符串），遇到字符串结束标志位后停止
-	{
-		Serial_SendByte(String[i]);		//依次调用Serial_SendByte发送每个字节数据
-	}
+	Serial_Write((uint8_t *)String, strlen(String));
 }
 
 /**
@@ -120,10 +351,12 @@ uint32_t Serial_Pow(uint32_t X, uint32_t Y)
 void Serial_SendNumber(uint32_t Number, uint8_t Length)
 {
 	uint8_t i;
+	uint8_t Digits[10];
 	for (i = 0; i < Length; i ++)		//根据数字长度遍历数字的每一位
 	{
-		Serial_SendByte(Number / Serial_Pow(10, Length - i - 1) % 10 + '0');	//依次调用Serial_SendByte发送每位数字
+		Digits[i] = Number / Serial_Pow(10, Length - i - 1) % 10 + '0';
 	}
+	Serial_Write(Digits, Length);		//整串排队发送
 }
 
 /**
@@ -6,9 +6,23 @@
 extern char Serial_RxPacket[];
 extern uint8_t Serial_RxFlag;
 
+/*
+ * 发送经DMA1通道4排队完成，所有发送函数都不等待数据发出：
+ * Serial_SendArrayAsync 不复制，Array在Done回调之前必须保持有效
+ * 其余发送函数把数据复制到内部缓冲池后立即返回，缓冲池或队列满时等待
+ * 可以在关中断时或在任何中断中调用：等待时直接查询DMA完成标志，不依赖DMA中断
+ */
+#define SERIAL_TX_QUEUE		8			//发送描述符个数（2的幂）
+#define SERIAL_TX_POOL		1024		//复制发送的缓冲池大小
+#define SERIAL_TX_CHUNK		256			//每次关中断复制的最大字节数
+
+typedef void (*Serial_TxDone)(const uint8_t *Buf);	//发送完成回调，在DMA中断或等待空间的发送函数中执行，回调中不能发送
+
 void Serial_Init(void);
 void Serial_SendByte(uint8_t Byte);
 void Serial_SendArray(uint8_t *Array, uint16_t Length);
+void Serial_SendArrayAsync(const uint8_t *Array, uint16_t Length, Serial_TxDone Done);
+void Serial_Flush(void);
 void Serial_SendString(char *String);
 void Serial_SendNumber(uint32_t Number, uint8_t Length);
 void Serial_Printf(char *format, ...);
@@ -67,3 +67,119 @@ print("尝试不同反转方式:")
 print(f"反转位: {hex(reverse_bits32(stm32_crc))} == {hex(python_crc)} ? {reverse_bits32(stm32_crc) == python_crc}")
 print(f"反转字节: {hex(reverse_bytes32(stm32_crc))} == {hex(python_crc)} ? {reverse_bytes32(stm32_crc) == python_crc}")
 print(f"反转位+字节: {hex(reverse_bytes32(reverse_bits32(stm32_crc)))} == {hex(python_crc)} ? {reverse_bytes32(reverse_bits32(stm32_crc)) == python_crc}")
+
+
+# ==================== 硬件CRC后端（System/crc32.c, CRC32_BACKEND_HW）====================
+
+import random
+import zlib
+
+
+class Stm32CrcUnit:
+    """CRC外设的逐位模型：写DR时把32位字与DR异或，再按MSB优先移位32次"""
+
+    def __init__(self):
+        self.dr = 0xFFFFFFFF
+
+    def reset(self):
+        self.dr = 0xFFFFFFFF
+
+    def write(self, word):
+        crc = self.dr ^ word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else (crc << 1)
+            crc &= 0xFFFFFFFF
+        self.dr = crc
+
+
+class HwCrc32:
+    """与crc32.c硬件后端逐行对应的模型：头尾字节逐位计算，中间按字送入外设"""
+
+    def __init__(self):
+        self.unit = Stm32CrcUnit()
+        self.hw_state = 0
+        self.loads = 0
+
+    @staticmethod
+    def byte_update(crc, data):
+        for byte in data:
+            crc ^= byte
+            for _ in range(8):
+                crc = (crc >> 1) ^ 0xEDB88320 if crc & 1 else crc >> 1
+        return crc
+
+    def hw_load(self, dr):
+        for _ in range(32):
+            dr = ((dr ^ 0x04C11DB7) >> 1) | 0x80000000 if dr & 1 else dr >> 1
+        self.unit.reset()
+        self.unit.write(~dr & 0xFFFFFFFF)
+        self.loads += 1
+
+    def init(self):
+        self.unit.reset()
+        self.hw_state = 0xFFFFFFFF
+        return 0xFFFFFFFF
+
+    def update(self, crc, data, address):
+        """address为data在内存中的起始地址，决定对齐前要逐位处理的字节数"""
+        n = min((4 - (address & 3)) & 3, len(data))
+        crc = self.byte_update(crc, data[:n])
+        data = data[n:]
+        if len(data) >= 4:
+            if crc != self.hw_state:
+                self.hw_load(reverse_bits32(crc))
+            words = len(data) // 4
+            for i in range(words):
+                self.unit.write(reverse_bits32(int.from_bytes(data[i * 4:i * 4 + 4], 'little')))
+            crc = reverse_bits32(self.unit.dr)
+            self.hw_state = crc
+            data = data[words * 4:]
+        return self.byte_update(crc, data)
+
+    @staticmethod
+    def final(crc):
+        return ~crc & 0xFFFFFFFF
+
+
+print()
+print("硬件CRC后端模型验证:")
+rng = random.Random(7670)
+frame = bytes(rng.getrandbits(8) for _ in range(640 * 16))
+
+# 1. 按640字节行链式计算（对应Capture_Stream）
+hw = HwCrc32()
+crc = hw.init()
+for line in range(16):
+    crc = hw.update(crc, frame[line * 640:(line + 1) * 640], 0x20000000)
+ok_lines = hw.final(crc) == zlib.crc32(frame) & 0xFFFFFFFF
+print(f"按行链式: {ok_lines}  (重新装载外设 {hw.loads} 次)")
+
+# 2. 任意长度、任意对齐的分段，覆盖头尾字节和状态重新装载
+ok_split = True
+for trial in range(300):
+    length = rng.randrange(0, 200)
+    data = frame[:length]
+    hw = HwCrc32()
+    crc = hw.init()
+    pos = 0
+    addr = rng.randrange(0, 4)
+    while pos < length:
+        step = rng.randrange(1, 24)
+        crc = hw.update(crc, data[pos:pos + step], addr + pos)
+        pos += step
+    if hw.final(crc) != zlib.crc32(data) & 0xFFFFFFFF:
+        ok_split = False
+        print(f"❌ 长度{length} 不匹配")
+        break
+print(f"任意分段: {ok_split}")
+
+# 3. 装载任意状态：装载后DR必须等于目标值
+hw = HwCrc32()
+ok_load = True
+for _ in range(200):
+    target = rng.getrandbits(32)
+    hw.hw_load(target)
+    if hw.unit.dr != target:
+        ok_load = False
+        break
+print(f"状态装载: {ok_load}")
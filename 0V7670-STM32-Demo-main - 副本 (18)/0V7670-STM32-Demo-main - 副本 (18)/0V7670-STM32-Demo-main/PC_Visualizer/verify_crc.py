@@ -44,3 +44,91 @@ if crc_python == crc_software:
     print("\n✓ CRC32算法验证通过！STM32代码可以使用此实现。")
 else:
     print("\n❌ CRC32不匹配，需要调整算法")
+
+
+# ==================== 查表CRC32（System/crc32.c）====================
+
+import os
+import re
+import time
+
+
+def make_tables(slices=8):
+    """生成crc32.c中的CRC32_Table：T[k][n]为字节n后跟k个0字节的CRC"""
+    t0 = []
+    for n in range(256):
+        c = n
+        for _ in range(8):
+            c = (c >> 1) ^ 0xEDB88320 if c & 1 else c >> 1
+        t0.append(c)
+    tables = [t0]
+    for k in range(1, slices):
+        prev = tables[k - 1]
+        tables.append([t0[c & 0xFF] ^ (c >> 8) for c in prev])
+    return tables
+
+
+TABLES = make_tables()
+
+
+def crc32_slice(data_bytes, slices):
+    """与CRC32_Update相同的算法：按字节对齐后，每次处理4/8字节（小端字）"""
+    t = TABLES
+    crc = 0xFFFFFFFF
+    i, n = 0, len(data_bytes)
+    if slices >= 4:
+        # 对齐只影响C代码的访问方式，这里从偏移0开始，结果相同
+        if slices == 8:
+            while n - i >= 8:
+                lo = crc ^ int.from_bytes(data_bytes[i:i + 4], 'little')
+                hi = int.from_bytes(data_bytes[i + 4:i + 8], 'little')
+                crc = (t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                       t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24])
+                i += 8
+        while n - i >= 4:
+            crc ^= int.from_bytes(data_bytes[i:i + 4], 'little')
+            crc = t[3][crc & 0xFF] ^ t[2][(crc >> 8) & 0xFF] ^ t[1][(crc >> 16) & 0xFF] ^ t[0][crc >> 24]
+            i += 4
+    while i < n:
+        crc = t[0][(crc ^ data_bytes[i]) & 0xFF] ^ (crc >> 8)
+        i += 1
+    return ~crc & 0xFFFFFFFF
+
+
+def read_c_tables(path):
+    """从crc32.c中取出CRC32_Table的全部常数"""
+    with open(path, encoding='utf-8') as f:
+        src = f.read()
+    body = src[src.index('CRC32_Table[CRC32_SLICE][256]'):src.index('};')]
+    return [int(v, 16) for v in re.findall(r'0x([0-9A-Fa-f]{8})', body)]
+
+
+print("\n查表CRC32验证:")
+c_file = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'System', 'crc32.c')
+if os.path.exists(c_file):
+    c_values = read_c_tables(c_file)
+    expect = [v for row in TABLES for v in row]
+    print(f"crc32.c表项: {len(c_values)}  匹配: {c_values == expect}")
+else:
+    print("未找到System/crc32.c，跳过表项检查")
+
+all_ok = True
+for slices in (1, 4, 8):
+    for length in list(range(0, 40)) + [640, 153600]:
+        chunk = image_data[7:7 + length]
+        if crc32_slice(chunk, slices) != zlib.crc32(chunk) & 0xFFFFFFFF:
+            print(f"❌ slice-by-{slices} 长度{length} 不匹配")
+            all_ok = False
+print(f"slice-by-1/4/8 与zlib一致: {all_ok}")
+
+print("\n速度对比（Python模拟，只看相对比例，C版本以板上测量为准）:")
+line = image_data[:640 * 24]
+for name, fn in (("逐位", crc32_software),
+                 ("slice-by-1", lambda d: crc32_slice(d, 1)),
+                 ("slice-by-4", lambda d: crc32_slice(d, 4)),
+                 ("slice-by-8", lambda d: crc32_slice(d, 8)),
+                 ("zlib", lambda d: zlib.crc32(d) & 0xFFFFFFFF)):
+    t = time.perf_counter()
+    fn(line)
+    dt = time.perf_counter() - t
+    print(f"  {name:<11} {len(line) / dt / 1e6:8.2f} MB/s")
@@ -0,0 +1,30 @@
+#ifndef __CRC32_H
+#define __CRC32_H
+#include <stdint.h>
+
+//CRC32（zlib/PNG，反射多项式0xEDB88320），结果与Python zlib.crc32一致
+//用法：crc = CRC32_Init(); crc = CRC32_Update(crc, data, len) 可多次调用; crc = CRC32_Final(crc);
+
+//实现方式：软件查表，或STM32的CRC外设（多项式相同，输入输出经位反转后与zlib一致）
+#define CRC32_BACKEND_SOFT	0
+#define CRC32_BACKEND_HW	1
+
+#ifndef CRC32_BACKEND
+#if defined(__CC_ARM)
+#define CRC32_BACKEND		CRC32_BACKEND_HW
+#else
+#define CRC32_BACKEND		CRC32_BACKEND_SOFT		//主机编译
+#endif
+#endif
+
+//软件方式的查表宽度：1 = 1KB表，4 = 4KB表，8 = 8KB表，表越大每字节周期数越少，占用FLASH越多
+#ifndef CRC32_SLICE
+#define CRC32_SLICE			4
+#endif
+
+uint32_t CRC32_Init(void);								//硬件方式下同时复位CRC外设，CRC外设只归本模块使用
+uint32_t CRC32_Update(uint32_t crc, const uint8_t *data, uint32_t length);
+uint32_t CRC32_Final(uint32_t crc);
+uint32_t CRC32_Calc(const uint8_t *data, uint32_t length);	//一次性计算，等于Init+Update+Final
+
+#endif
@@ -1,15 +1,13 @@
 #include "delay.h"
 
-#define AHB_INPUT  72						//请按RCC中设置的AHB时钟频率填写到这里（单位MHz）
-
-//uS微秒级延时程序（参考值即是延时数，72MHz时最大值233015）	
+//uS微秒级延时程序，按DWT周期计数忙等，不占用SysTick（最大值约59秒，DWT回绕周期）
+//须已调用DWT_Init（Boot_Init中调用），不依赖中断，关中断时和中断中都可以使用
 void delay_us(u32 uS)
-{ 
-	SysTick->LOAD=AHB_INPUT*uS;				//重装计数初值（当主频是72MHz，72次为1微秒）
-	SysTick->VAL=0x00;						//清空定时器的计数器
-	SysTick->CTRL=0x00000005;				//时钟源HCLK，打开定时器
-	while(!(SysTick->CTRL&0x00010000));		//等待计数到0
-	SysTick->CTRL=0x00000004;				//关闭定时器
+{
+	u32 start = DWT_CYCCNT;
+	u32 cycles = uS * (SystemCoreClock / 1000000);	//72MHz时72个周期为1微秒
+
+	while(DWT_CYCCNT - start < cycles);
 }
 
 //mS毫秒级延时程序（参考值即是延时数，最大值65535）	
@@ -0,0 +1,235 @@
+#include "sched.h"
+#include <stdio.h>
+#include <string.h>
+
+//中断中投递与任务中投递共用一个队列，写入端用关中断保护；读出端只有调度器
+#if defined(__CC_ARM)
+#include "stm32f10x.h"
+#define SCHED_LOCK(m)		do { (m) = __get_PRIMASK(); __disable_irq(); } while(0)
+#define SCHED_UNLOCK(m)		__set_PRIMASK(m)
+#else
+#define SCHED_LOCK(m)		((m) = 0)			//主机编译：没有中断
+#define SCHED_UNLOCK(m)		((void)(m))
+#endif
+
+#if (SCHED_QUEUE_SIZE & (SCHED_QUEUE_SIZE - 1)) != 0
+#error "SCHED_QUEUE_SIZE must be a power of 2"
+#endif
+
+typedef struct
+{
+	Sched_EventTypeDef events[SCHED_QUEUE_SIZE];
+	volatile uint8_t head;				//投递端修改（关中断）
+	volatile uint8_t tail;				//只由调度器修改
+} Sched_QueueTypeDef;
+
+typedef struct
+{
+	uint32_t due;
+	uint32_t period;
+	uint8_t task;
+	uint8_t sig;
+	uint8_t active;
+} Sched_TimerTypeDef;
+
+static const Sched_ConfigTypeDef * volatile Sched_Cfg;
+static Sched_QueueTypeDef Sched_Queues[SCHED_MAX_TASKS];
+static Sched_TimerTypeDef Sched_Timers[SCHED_MAX_TIMERS];
+static Sched_StatsTypeDef Sched_Stats[SCHED_MAX_TASKS];
+static uint32_t Sched_Last;				//上次读计数器的时刻
+static uint64_t Sched_Elapsed;			//统计起点到Sched_Last的计数，每次RunOnce累加，计数器回绕不影响
+
+//Sched_Cfg最后设置：在此之前中断中的投递直接丢弃
+void Sched_Init(const Sched_ConfigTypeDef *cfg)
+{
+	Sched_Cfg = NULL;
+	memset(Sched_Queues, 0, sizeof(Sched_Queues));
+	memset(Sched_Timers, 0, sizeof(Sched_Timers));
+	memset(Sched_Stats, 0, sizeof(Sched_Stats));
+	Sched_Last = cfg->now();
+	Sched_Elapsed = 0;
+	Sched_Cfg = cfg;
+}
+
+static uint8_t Sched_Push(uint8_t task, uint8_t sig, uint8_t arg, uint16_t param, uint32_t posted)
+{
+	Sched_QueueTypeDef *q = &Sched_Queues[task];
+	Sched_EventTypeDef *ev;
+	uint32_t mask;
+	uint8_t count;
+
+	SCHED_LOCK(mask);
+	count = (uint8_t)(q->head - q->tail);
+	if(count >= SCHED_QUEUE_SIZE)
+	{
+		if(Sched_Stats[task].drops < 0XFF)
+			Sched_Stats[task].drops++;
+		SCHED_UNLOCK(mask);
+		return 1;
+	}
+	ev = &q->events[q->head & (SCHED_QUEUE_SIZE - 1)];
+	ev->sig = sig;
+	ev->arg = arg;
+	ev->param = param;
+	ev->posted = posted;
+	q->head++;
+	if(count + 1 > Sched_Stats[task].queue_peak)
+		Sched_Stats[task].queue_peak = count + 1;
+	SCHED_UNLOCK(mask);
+	return 0;
+}
+
+uint8_t Sched_Post(uint8_t task, uint8_t sig, uint8_t arg, uint16_t param)
+{
+	const Sched_ConfigTypeDef *cfg = Sched_Cfg;
+
+	if(cfg == NULL)
+		return 1;
+	return Sched_Push(task, sig, arg, param, cfg->now());
+}
+
+void Sched_TimerStart(uint8_t timer, uint8_t task, uint8_t sig, uint32_t delay, uint32_t period)
+{
+	Sched_TimerTypeDef *t = &Sched_Timers[timer];
+
+	t->due = Sched_Cfg->now() + delay;
+	t->period = period;
+	t->task = task;
+	t->sig = sig;
+	t->active = 1;
+}
+
+void Sched_TimerStop(uint8_t timer)
+{
+	Sched_Timers[timer].active = 0;
+}
+
+uint8_t Sched_TimerActive(uint8_t timer)
+{
+	return Sched_Timers[timer].active;
+}
+
+//到期的定时器投递事件，投递时刻记为到期时刻，检查不及时的部分计入延迟
+static void Sched_PollTimers(uint32_t now)
+{
+	Sched_TimerTypeDef *t;
+	uint8_t i;
+
+	for(i = 0; i < SCHED_MAX_TIMERS; i++)
+	{
+		t = &Sched_Timers[i];
+		if(!t->active || (int32_t)(now - t->due) < 0)
+			continue;
+		Sched_Push(t->task, t->sig, 0, i, t->due);
+		if(t->period)
+		{
+			t->due += t->period;
+			if((int32_t)(now - t->due) >= 0)
+				t->due = now + t->period;		//错过了不止一个周期，不补发
+		}
+		else
+		{
+			t->active = 0;
+		}
+	}
+}
+
+//读计数器并累加统计时长，两次调用的间隔须小于计数器周期（72MHz的DWT为59.6s）
+static uint32_t Sched_Now(void)
+{
+	uint32_t now = Sched_Cfg->now();
+
+	Sched_Elapsed += now - Sched_Last;
+	Sched_Last = now;
+	return now;
+}
+
+uint8_t Sched_RunOnce(void)
+{
+	Sched_QueueTypeDef *q;
+	Sched_StatsTypeDef *st;
+	Sched_EventTypeDef ev;
+	uint32_t start, run;
+	uint8_t task;
+
+	Sched_PollTimers(Sched_Now());
+
+	for(task = 0; task < Sched_Cfg->task_count; task++)
+	{
+		if(Sched_Queues[task].head != Sched_Queues[task].tail)
+			break;
+	}
+	if(task == Sched_Cfg->task_count)
+	{
+		if(Sched_Cfg->idle)
+			Sched_Cfg->idle();
+		return 0;
+	}
+
+	//先复制再出队，处理函数中可以向自己投递
+	q = &Sched_Queues[task];
+	ev = q->events[q->tail & (SCHED_QUEUE_SIZE - 1)];
+	q->tail++;
+
+	start = Sched_Cfg->now();
+	Sched_Cfg->tasks[task].handler(&ev);
+	run = Sched_Cfg->now() - start;
+
+	st = &Sched_Stats[task];
+	st->runs++;
+	st->cpu += run;
+	if(run > st->max_run)
+		st->max_run = run;
+	if(start - ev.posted > st->max_latency)
+		st->max_latency = start - ev.posted;
+	return 1;
+}
+
+void Sched_Run(void)
+{
+	while(1)
+	{
+		Sched_RunOnce();
+	}
+}
+
+const Sched_StatsTypeDef *Sched_GetStats(uint8_t task)
+{
+	return &Sched_Stats[task];
+}
+
+void Sched_Report(void (*print)(const char *line))
+{
+	char line[128];
+	uint32_t us = Sched_Cfg->ticks_per_us;
+	uint64_t total;
+	uint32_t busy = 0;
+	uint32_t mask;
+	Sched_StatsTypeDef st;
+	uint8_t i;
+
+	for(i = 0; i < Sched_Cfg->task_count; i++)
+	{
+		//queue_peak/drops可能在中断中修改，复制和清零一起进行
+		SCHED_LOCK(mask);
+		st = Sched_Stats[i];
+		memset(&Sched_Stats[i], 0, sizeof(Sched_Stats[i]));
+		SCHED_UNLOCK(mask);
+
+		busy += st.cpu;
+		sprintf(line, "SCHED,%s,runs=%lu,cpu_us=%lu,max_us=%lu,lat_us=%lu,queue=%u,drops=%u",
+			Sched_Cfg->tasks[i].name, (unsigned long)st.runs, (unsigned long)(st.cpu / us),
+			(unsigned long)(st.max_run / us), (unsigned long)(st.max_latency / us), st.queue_peak, st.drops);
+		print(line);
+	}
+	//MicroLIB的sprintf不支持%llu，1s以上分成秒和微秒两段输出
+	Sched_Now();
+	total = Sched_Elapsed / us;
+	if(total >= 1000000)
+		sprintf(line, "SCHED,total,us=%lu%06lu,busy_us=%lu", (unsigned long)(total / 1000000),
+			(unsigned long)(total % 1000000), (unsigned long)(busy / us));
+	else
+		sprintf(line, "SCHED,total,us=%lu,busy_us=%lu", (unsigned long)total, (unsigned long)(busy / us));
+	print(line);
+	Sched_Elapsed = 0;
+}
@@ -0,0 +1,88 @@
+#ifndef __SCHED_H
+#define __SCHED_H
+#include <stdint.h>
+
+/*
+ * 协作式调度器：不依赖RTOS，每个任务是一个事件处理函数，处理完一个事件才返回（run-to-completion）
+ *
+ *   任务     按任务表中的顺序排优先级（0最高），每次从有事件的最高优先级任务取一个事件运行
+ *   事件     每个任务一个队列，Sched_Post可在中断中调用；队列满时丢弃并计数
+ *   定时器   到期时向指定任务投递事件，可单次或周期；只在任务中启动和停止
+ *
+ * 任务之间不会相互打断，同一资源（例如FatFs）只要只在一个任务中访问就不需要加锁。
+ * 每个任务统计运行次数、CPU时间、单次最长运行时间和最大延迟（事件投递或定时器到期到开始处理），
+ * Sched_Report逐行输出，每行以"SCHED,"开头：
+ *   SCHED,<任务>,runs=<次数>,cpu_us=<CPU时间>,max_us=<单次最长>,lat_us=<最大延迟>,queue=<最多排队>,drops=<丢弃>
+ *   SCHED,total,us=<统计时长>,busy_us=<各任务CPU时间之和>
+ * 统计时长在每次Sched_RunOnce时累加，计数器回绕不影响，只要两次调用的间隔小于计数器周期。
+ *
+ * 本模块不直接访问硬件，计时以函数指针接入，主机上可与模拟的外设一起编译运行（中断投递的临界区为空）。
+ */
+
+#define SCHED_MAX_TASKS			6
+#define SCHED_QUEUE_SIZE		8				//每个任务的事件队列长度，2的整数次幂
+#define SCHED_MAX_TIMERS		6
+
+typedef struct
+{
+	uint8_t  sig;						//事件类型，由任务自己定义
+	uint8_t  arg;						//参数
+	uint16_t param;						//参数
+	uint32_t posted;					//投递（或定时器到期）的时刻，统计延迟用
+} Sched_EventTypeDef;
+
+typedef struct
+{
+	const char *name;
+	void (*handler)(const Sched_EventTypeDef *ev);
+} Sched_TaskTypeDef;
+
+typedef struct
+{
+	const Sched_TaskTypeDef *tasks;		//任务表，下标即任务号和优先级
+	uint8_t task_count;					//不超过SCHED_MAX_TASKS
+	uint32_t (*now)(void);				//自由运行的计数器
+	uint32_t ticks_per_us;				//计数器每微秒的计数
+	void (*idle)(void);					//没有事件时调用，可为NULL
+} Sched_ConfigTypeDef;
+
+typedef struct
+{
+	uint32_t runs;						//处理的事件数
+	uint32_t cpu;						//CPU时间（计数）
+	uint32_t max_run;					//单次最长运行时间
+	uint32_t max_latency;				//最大延迟
+	uint8_t  queue_peak;				//队列中最多的事件数
+	uint8_t  drops;						//队列满丢弃的事件数
+} Sched_StatsTypeDef;
+
+/* 设置任务表，清空队列、定时器和统计；在此之前的投递被丢弃 */
+void Sched_Init(const Sched_ConfigTypeDef *cfg);
+
+/*
+ * 向任务投递事件，可在中断中调用
+ * 返回：0 成功；1 队列满（或调度器未初始化），事件丢弃
+ */
+uint8_t Sched_Post(uint8_t task, uint8_t sig, uint8_t arg, uint16_t param);
+
+/*
+ * 启动定时器（已在运行时重新开始）：delay个计数后向task投递sig事件（arg为0，param为定时器号），
+ * period不为0时之后每period个计数投递一次。间隔须小于计数器周期的一半
+ */
+void Sched_TimerStart(uint8_t timer, uint8_t task, uint8_t sig, uint32_t delay, uint32_t period);
+void Sched_TimerStop(uint8_t timer);
+uint8_t Sched_TimerActive(uint8_t timer);
+
+/* 检查定时器并运行一个事件，返回1表示运行了一个事件，0表示空闲（已调用idle） */
+uint8_t Sched_RunOnce(void);
+
+/* 主循环，不返回 */
+void Sched_Run(void);
+
+/* 上次Sched_Report以来的统计 */
+const Sched_StatsTypeDef *Sched_GetStats(uint8_t task);
+
+/* 输出上次输出以来的统计并清零，print输出一行（不含换行符） */
+void Sched_Report(void (*print)(const char *line));
+
+#endif
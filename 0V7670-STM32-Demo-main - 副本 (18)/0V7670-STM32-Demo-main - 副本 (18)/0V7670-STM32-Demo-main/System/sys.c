@@ -4,6 +4,15 @@ void NVIC_Configuration(void){		//嵌套中断向量控制器 的设置
     NVIC_PriorityGroupConfig(NVIC_PriorityGroup_2);		//设置NVIC中断分组2:2位抢占优先级，2位响应优先级
 }
 
+void DWT_Init(void)				//DWT周期计数器，按HCLK(72MHz)计数，约59秒回绕一次；已启动时不清零
+{
+	if(DWT_CTRL & DWT_CTRL_CYCCNTENA)
+		return;
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT_CYCCNT = 0;
+	DWT_CTRL |= DWT_CTRL_CYCCNTENA;
+}
+
 void RCC_Configuration(void)
 {
 	//RCC时钟的设置  
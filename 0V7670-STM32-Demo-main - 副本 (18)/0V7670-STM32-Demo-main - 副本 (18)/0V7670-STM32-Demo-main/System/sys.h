@@ -50,9 +50,22 @@
 #define PGin(n)		BIT_ADDR(GPIOG_IDR_Addr,n)  //输入
 
 
+//DWT周期计数器（CMSIS 1.30的core_cm3.h没有DWT结构体，直接按地址访问）
+#define DWT_CTRL			(*(volatile uint32_t *)0xE0001000)
+#define DWT_CYCCNT			(*(volatile uint32_t *)0xE0001004)
+#define DWT_CTRL_CYCCNTENA	0x00000001
+
+//放到SRAM中执行的函数，由project.sct把RAMCODE段放进RW_IRAM1，启动时随RW数据一起复制
+#if defined(__CC_ARM)
+#define RAMFUNC		__attribute__((section("RAMCODE")))
+#else
+#define RAMFUNC
+#endif
+
 
 void NVIC_Configuration(void);		//嵌套中断控制器的设置
 void RCC_Configuration(void);		//RCC时钟类的设置
+void DWT_Init(void);				//启动DWT周期计数器
 
 
 #endif
@@ -0,0 +1,359 @@
+#include "bench.h"
+
+#if BENCH_ENABLE
+
+#include "SDdriver.h"
+#include "storage.h"
+#include "diskio.h"
+#include "ff_gen_drv.h"
+#include "user_diskio.h"
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_DIR			"BENCH"
+#define BENCH_SEQ_FILE		"BENCH/SEQ.TMP"
+#define BENCH_RAW_FILE		"BENCH/RAW.TMP"
+#define BENCH_RAW_BLOCKS	(BENCH_BUF_SIZE / 512)		//多块测试每次的扇区数
+
+typedef struct
+{
+	uint32_t calls;
+	uint32_t total_us;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t hist[BENCH_HIST_BUCKETS];
+} Bench_StatTypeDef;
+
+static const Bench_ConfigTypeDef *Bench_Cfg;
+static uint32_t Bench_Buf[BENCH_BUF_SIZE / 4];
+static char Bench_Line[200];
+static FIL Bench_Fil;
+static uint32_t Bench_T0;
+
+static const uint16_t Bench_Sizes[] = {512, 640, 1024, 4096};	//640 = 一行图像
+static const uint16_t Bench_DirSteps[] = {0, 16, 32, 64, 128};
+
+static void Bench_Begin(void)
+{
+	Bench_T0 = Bench_Cfg->now();
+}
+
+static uint32_t Bench_Us(void)
+{
+	return (Bench_Cfg->now() - Bench_T0) / Bench_Cfg->ticks_per_us;
+}
+
+static void Bench_StatReset(Bench_StatTypeDef *s)
+{
+	memset(s, 0, sizeof(*s));
+	s->min_us = 0xFFFFFFFF;
+}
+
+static void Bench_StatAdd(Bench_StatTypeDef *s, uint32_t us)
+{
+	uint8_t b = 0;
+
+	while(b < BENCH_HIST_BUCKETS - 1 && us >= (64UL << b))
+		b++;
+	s->hist[b]++;
+	s->calls++;
+	s->total_us += us;
+	if(us < s->min_us) s->min_us = us;
+	if(us > s->max_us) s->max_us = us;
+}
+
+//BENCH,<test>,<param>,bytes=,us=,Bps=,calls=,min=,max=,hist=a/b/...
+static void Bench_Report(const char *test, const char *param, uint32_t bytes, uint32_t us, const Bench_StatTypeDef *s)
+{
+	int n;
+	uint8_t b;
+
+	n = sprintf(Bench_Line, "BENCH,%s,%s,bytes=%lu,us=%lu,Bps=%lu,calls=%lu,min=%lu,max=%lu,hist=",
+		test, param, (unsigned long)bytes, (unsigned long)us,
+		(unsigned long)(us ? (uint64_t)bytes * 1000000 / us : 0),
+		(unsigned long)s->calls, (unsigned long)(s->calls ? s->min_us : 0), (unsigned long)s->max_us);
+	for(b = 0; b < BENCH_HIST_BUCKETS; b++)
+		n += sprintf(Bench_Line + n, b ? "/%lu" : "%lu", (unsigned long)s->hist[b]);
+	Bench_Cfg->print(Bench_Line);
+}
+
+static FRESULT Bench_Error(const char *test, FRESULT res)
+{
+	sprintf(Bench_Line, "BENCH,error,test=%s,res=%d", test, (int)res);
+	Bench_Cfg->print(Bench_Line);
+	return res;
+}
+
+// 顺序写BENCH_FILE_SIZE字节，每次size字节；关闭（写目录项和FAT）的耗时计入总时间
+static FRESULT Bench_SeqWrite(uint16_t size)
+{
+	Bench_StatTypeDef s;
+	char param[16];
+	uint32_t pos, us = 0, t;
+	UINT bw;
+	FRESULT res;
+
+	Bench_StatReset(&s);
+	res = f_open(&Bench_Fil, BENCH_SEQ_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+	if(res != FR_OK)
+		return Bench_Error("fwrite", res);
+
+	for(pos = 0; pos < BENCH_FILE_SIZE; pos += bw)
+	{
+		Bench_Begin();
+		res = f_write(&Bench_Fil, Bench_Buf, (BENCH_FILE_SIZE - pos < size) ? BENCH_FILE_SIZE - pos : size, &bw);
+		t = Bench_Us();
+		if(res != FR_OK || bw == 0)
+		{
+			f_close(&Bench_Fil);
+			return Bench_Error("fwrite", res != FR_OK ? res : FR_DENIED);
+		}
+		Bench_StatAdd(&s, t);
+		us += t;
+	}
+
+	Bench_Begin();
+	res = f_close(&Bench_Fil);
+	us += Bench_Us();
+	if(res != FR_OK)
+		return Bench_Error("fwrite", res);
+
+	sprintf(param, "size=%u", size);
+	Bench_Report("fwrite", param, BENCH_FILE_SIZE, us, &s);
+	return FR_OK;
+}
+
+static FRESULT Bench_SeqRead(uint16_t size)
+{
+	Bench_StatTypeDef s;
+	char param[16];
+	uint32_t pos, us = 0, t;
+	UINT br;
+	FRESULT res;
+
+	Bench_StatReset(&s);
+	res = f_open(&Bench_Fil, BENCH_SEQ_FILE, FA_READ);
+	if(res != FR_OK)
+		return Bench_Error("fread", res);
+
+	for(pos = 0; pos < BENCH_FILE_SIZE; pos += br)
+	{
+		Bench_Begin();
+		res = f_read(&Bench_Fil, Bench_Buf, size, &br);
+		t = Bench_Us();
+		if(res != FR_OK || br == 0)
+		{
+			f_close(&Bench_Fil);
+			return Bench_Error("fread", res != FR_OK ? res : FR_INT_ERR);
+		}
+		Bench_StatAdd(&s, t);
+		us += t;
+	}
+	f_close(&Bench_Fil);
+
+	sprintf(param, "size=%u", size);
+	Bench_Report("fread", param, BENCH_FILE_SIZE, us, &s);
+	return FR_OK;
+}
+
+// SD_WriteDisk/SD_ReadDisk直接读写预分配文件的扇区，每次blocks个扇区；写完后等待编程完成
+static FRESULT Bench_Raw(const Storage_ExtentTypeDef *ext, uint8_t write, uint8_t blocks)
+{
+	Bench_StatTypeDef s;
+	char param[16];
+	uint32_t n, us = 0, t;
+	uint8_t r;
+
+	Bench_StatReset(&s);
+	for(n = 0; n < BENCH_RAW_SECTORS; n += blocks)
+	{
+		Bench_Begin();
+		if(write)
+			r = SD_WriteDisk((uint8_t *)Bench_Buf, ext->sector + n, blocks);
+		else
+			r = SD_ReadDisk((uint8_t *)Bench_Buf, ext->sector + n, blocks);
+		t = Bench_Us();
+		if(r)
+			return Bench_Error(write ? "sdwrite" : "sdread", FR_DISK_ERR);
+		Bench_StatAdd(&s, t);
+		us += t;
+	}
+	Bench_Begin();
+	if(SD_Sync())
+		return Bench_Error("sdsync", FR_DISK_ERR);
+	us += Bench_Us();
+
+	sprintf(param, "blocks=%u", blocks);
+	Bench_Report(write ? "sdwrite" : "sdread", param, BENCH_RAW_SECTORS * 512UL, us, &s);
+	return FR_OK;
+}
+
+static FRESULT Bench_RawAll(void)
+{
+	Storage_ExtentTypeDef ext;
+	FRESULT res;
+	uint8_t r;
+
+	res = f_open(&Bench_Fil, BENCH_RAW_FILE, FA_CREATE_ALWAYS | FA_WRITE);
+	if(res != FR_OK)
+		return Bench_Error("raw", res);
+	res = Storage_Prealloc(&Bench_Fil, BENCH_RAW_SECTORS * 512UL);
+	r = (res == FR_OK) ? Storage_GetExtent(&Bench_Fil, &ext) : 0;
+	f_close(&Bench_Fil);
+	if(res != FR_OK)
+		return Bench_Error("raw", res);
+	if(r)
+		return Bench_Error("raw", r == 1 ? FR_DENIED : FR_DISK_ERR);
+
+	//disk_write缓存中的扇区先写出，之后只剩驱动本身的开销
+	if(disk_ioctl(0, CTRL_SYNC, 0) != RES_OK)
+		return Bench_Error("raw", FR_DISK_ERR);
+
+	if((res = Bench_Raw(&ext, 1, 1)) != FR_OK) return res;
+	if((res = Bench_Raw(&ext, 1, BENCH_RAW_BLOCKS)) != FR_OK) return res;
+	if((res = Bench_Raw(&ext, 0, 1)) != FR_OK) return res;
+	return Bench_Raw(&ext, 0, BENCH_RAW_BLOCKS);
+}
+
+// 完整扫描一次目录，并查找一个不存在的文件（旧的命名方式每次拍照都要这样查找）
+static FRESULT Bench_DirScan(uint16_t files)
+{
+	DIR dir;
+	FILINFO fno;
+	uint32_t scan_us, miss_us;
+	uint16_t entries = 0;
+	FRESULT res;
+
+	Bench_Begin();
+	res = f_opendir(&dir, BENCH_DIR);
+	while(res == FR_OK)
+	{
+		res = f_readdir(&dir, &fno);
+		if(res != FR_OK || fno.fname[0] == 0)
+			break;
+		entries++;
+	}
+	f_closedir(&dir);
+	scan_us = Bench_Us();
+	if(res != FR_OK)
+		return Bench_Error("dirscan", res);
+
+	Bench_Begin();
+	res = f_stat(BENCH_DIR "/NONE.TMP", &fno);
+	miss_us = Bench_Us();
+	if(res != FR_NO_FILE)
+		return Bench_Error("dirscan", res == FR_OK ? FR_EXIST : res);
+
+	sprintf(Bench_Line, "BENCH,dirscan,files=%u,entries=%u,us=%lu,miss_us=%lu",
+		files, entries, (unsigned long)scan_us, (unsigned long)miss_us);
+	Bench_Cfg->print(Bench_Line);
+	return FR_OK;
+}
+
+// 逐个创建空文件（open+close分别计时），在Bench_DirSteps处扫描目录，最后逐个删除
+static FRESULT Bench_Files(void)
+{
+	Bench_StatTypeDef open_s, close_s, unlink_s;
+	char name[20], param[16];
+	uint32_t t;
+	uint16_t n, step = 0;
+	FRESULT res = FR_OK;
+
+	Bench_StatReset(&open_s);
+	Bench_StatReset(&close_s);
+	Bench_StatReset(&unlink_s);
+	sprintf(param, "files=%u", BENCH_DIR_FILES);
+
+	for(n = 0; n <= BENCH_DIR_FILES; n++)
+	{
+		if(step < sizeof(Bench_DirSteps) / sizeof(Bench_DirSteps[0]) && n == Bench_DirSteps[step])
+		{
+			step++;
+			if((res = Bench_DirScan(n)) != FR_OK)
+				break;
+		}
+		if(n == BENCH_DIR_FILES)
+			break;
+
+		sprintf(name, BENCH_DIR "/F%03u.TMP", n);
+		Bench_Begin();
+		res = f_open(&Bench_Fil, name, FA_CREATE_NEW | FA_WRITE);
+		t = Bench_Us();
+		if(res != FR_OK)
+		{
+			res = Bench_Error("create", res);
+			break;
+		}
+		Bench_StatAdd(&open_s, t);
+
+		Bench_Begin();
+		res = f_close(&Bench_Fil);
+		Bench_StatAdd(&close_s, Bench_Us());
+		if(res != FR_OK)
+		{
+			res = Bench_Error("close", res);
+			break;
+		}
+	}
+
+	if(res == FR_OK)
+	{
+		Bench_Report("create", param, 0, open_s.total_us, &open_s);
+		Bench_Report("close", param, 0, close_s.total_us, &close_s);
+	}
+
+	//出错时也删除已创建的文件
+	while(n--)
+	{
+		sprintf(name, BENCH_DIR "/F%03u.TMP", n);
+		Bench_Begin();
+		if(f_unlink(name) == FR_OK)
+			Bench_StatAdd(&unlink_s, Bench_Us());
+	}
+	if(res == FR_OK)
+		Bench_Report("unlink", param, 0, unlink_s.total_us, &unlink_s);
+	return res;
+}
+
+FRESULT Bench_Run(const Bench_ConfigTypeDef *cfg)
+{
+	FRESULT res;
+	DWORD sectors = 0;
+	uint32_t i, start;
+
+	Bench_Cfg = cfg;
+	start = cfg->now();
+
+	for(i = 0; i < BENCH_BUF_SIZE / 4; i++)
+		Bench_Buf[i] = i * 0x9E3779B9;
+	disk_ioctl(0, GET_SECTOR_COUNT, &sectors);
+	sprintf(Bench_Line, "BENCH,begin,version=1,sectors=%lu,cache=%u,file=%lu,raw=%u,dir=%u",
+		(unsigned long)sectors, (unsigned)USER_CACHE_SECTORS, (unsigned long)BENCH_FILE_SIZE,
+		(unsigned)BENCH_RAW_SECTORS, (unsigned)BENCH_DIR_FILES);
+	cfg->print(Bench_Line);
+
+	res = f_mkdir(BENCH_DIR);
+	if(res != FR_OK && res != FR_EXIST)
+		return Bench_Error("mkdir", res);
+
+	for(i = 0, res = FR_OK; res == FR_OK && i < sizeof(Bench_Sizes) / sizeof(Bench_Sizes[0]); i++)
+	{
+		res = Bench_SeqWrite(Bench_Sizes[i]);
+		if(res == FR_OK)
+			res = Bench_SeqRead(Bench_Sizes[i]);
+	}
+	if(res == FR_OK)
+		res = Bench_RawAll();
+	if(res == FR_OK)
+		res = Bench_Files();
+
+	f_unlink(BENCH_SEQ_FILE);
+	f_unlink(BENCH_RAW_FILE);
+	f_unlink(BENCH_DIR);			//目录非空时（删除失败）保留
+
+	sprintf(Bench_Line, "BENCH,end,res=%d,us=%lu", (int)res, (unsigned long)((cfg->now() - start) / cfg->ticks_per_us));
+	cfg->print(Bench_Line);
+	return res;
+}
+
+#endif
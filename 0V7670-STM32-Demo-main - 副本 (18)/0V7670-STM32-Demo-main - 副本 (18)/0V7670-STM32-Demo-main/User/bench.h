@@ -0,0 +1,39 @@
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#include <stdint.h>
+#include "ff.h"
+
+/*
+ * SD卡/FatFs性能测试：f_write/f_read顺序读写速度和每次调用的耗时分布、
+ * SD_WriteDisk/SD_ReadDisk单块与多块、文件创建/关闭/删除耗时、目录扫描耗时随文件数的变化。
+ *
+ * 结果逐行输出，每行以"BENCH,"开头，其后是测试名和key=value字段，用bench_report.py解析和比较。
+ * 本模块不直接访问硬件，计时和输出以函数指针接入，主机上可与SD卡模拟器一起编译运行。
+ * 测试文件在BENCH目录中，结束时删除，卡上已有的文件不受影响。
+ */
+
+#ifndef BENCH_ENABLE
+#define BENCH_ENABLE			0				//1=编译测试程序（占用约5KB RAM），Key5运行
+#endif
+
+#define BENCH_BUF_SIZE			4096			//最大的单次读写长度
+#define BENCH_FILE_SIZE			(256UL * 1024)	//顺序读写的文件大小
+#define BENCH_RAW_SECTORS		256				//单块/多块测试的扇区数
+#define BENCH_DIR_FILES			128				//目录扫描测试的最大文件数
+#define BENCH_HIST_BUCKETS		11				//耗时分布：<64us, <128us, ... <32768us, 其余
+
+typedef struct
+{
+	uint32_t (*now)(void);					//自由运行的计数器
+	uint32_t ticks_per_us;					//计数器每微秒的计数
+	void (*print)(const char *line);		//输出一行（不含换行符）
+} Bench_ConfigTypeDef;
+
+/*
+ * 运行全部测试，文件系统须已挂载
+ * 返回：FR_OK 表示全部完成；出错时输出"BENCH,error,..."并返回错误码
+ */
+FRESULT Bench_Run(const Bench_ConfigTypeDef *cfg);
+
+#endif
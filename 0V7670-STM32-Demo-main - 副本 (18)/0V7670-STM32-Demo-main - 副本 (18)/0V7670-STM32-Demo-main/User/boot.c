@@ -0,0 +1,87 @@
+#include "stm32f10x.h"
+#include "boot.h"
+#include "sys.h"
+#include <stdio.h>
+
+static const char * const Boot_Names[BOOT_PHASES] =
+{
+	"clock", "uart", "sccb", "sd_init", "mount", "catalog", "vsync", "warmup"
+};
+
+static uint32_t Boot_Begin[BOOT_PHASES];
+static uint32_t Boot_Finish[BOOT_PHASES];
+static uint8_t Boot_Done[BOOT_PHASES];
+static uint32_t Boot_T0;
+static uint8_t Boot_Reported;
+
+//main开始时SystemInit已切到72MHz；RCC_Configuration中RCC_DeInit回到HSI，
+//HSE起振和PLL锁定期间按HSI计数，这一段按HSI换算（PLL切换后的几个周期忽略不计）
+static uint32_t Boot_Hz(Boot_PhaseTypeDef phase)
+{
+	return (phase == BOOT_CLOCK) ? HSI_VALUE : SystemCoreClock;
+}
+
+//相对main开始的时刻：时钟阶段之后的部分按SystemCoreClock换算
+static uint32_t Boot_At(uint32_t t)
+{
+	uint32_t clock_end = Boot_Finish[BOOT_CLOCK];
+
+	if(!Boot_Done[BOOT_CLOCK] || (int32_t)(t - clock_end) < 0)
+		return (t - Boot_T0) / (HSI_VALUE / 1000000);
+	return (clock_end - Boot_T0) / (HSI_VALUE / 1000000) + (t - clock_end) / (SystemCoreClock / 1000000);
+}
+
+void Boot_Init(void)
+{
+	DWT_Init();
+	Boot_T0 = DWT_CYCCNT;
+}
+
+uint32_t Boot_Now(void)
+{
+	return DWT_CYCCNT;
+}
+
+void Boot_Start(Boot_PhaseTypeDef phase)
+{
+	if(!Boot_Reported)
+		Boot_Begin[phase] = DWT_CYCCNT;
+}
+
+void Boot_End(Boot_PhaseTypeDef phase)
+{
+	if(!Boot_Reported)
+	{
+		Boot_Finish[phase] = DWT_CYCCNT;
+		Boot_Done[phase] = 1;
+	}
+}
+
+void Boot_Set(Boot_PhaseTypeDef phase, uint32_t start, uint32_t end)
+{
+	if(!Boot_Reported)
+	{
+		Boot_Begin[phase] = start;
+		Boot_Finish[phase] = end;
+		Boot_Done[phase] = 1;
+	}
+}
+
+void Boot_Report(uint32_t ready, void (*print)(const char *line))
+{
+	char line[48];
+	uint8_t i;
+
+	for(i = 0; i < BOOT_PHASES; i++)
+	{
+		if(!Boot_Done[i])
+			continue;
+		sprintf(line, "BOOT,%s,us=%lu,at=%lu", Boot_Names[i],
+			(unsigned long)((Boot_Finish[i] - Boot_Begin[i]) / (Boot_Hz((Boot_PhaseTypeDef)i) / 1000000)),
+			(unsigned long)Boot_At(Boot_Begin[i]));
+		print(line);
+	}
+	sprintf(line, "BOOT,ready,at=%lu", (unsigned long)Boot_At(ready));
+	print(line);
+	Boot_Reported = 1;
+}
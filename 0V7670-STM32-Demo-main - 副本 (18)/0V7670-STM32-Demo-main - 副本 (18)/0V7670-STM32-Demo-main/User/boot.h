@@ -0,0 +1,45 @@
+#ifndef __BOOT_H
+#define __BOOT_H
+
+#include <stdint.h>
+
+/*
+ * 启动各阶段耗时：从main开始，按DWT周期计数器记录每个阶段的开始和结束，
+ * 进入主循环前输出一次，每行以"BOOT,"开头：
+ *   BOOT,<阶段>,us=<耗时>,at=<开始时刻>
+ *   BOOT,ready,at=<可以拍照的时刻>
+ * 时刻均为main开始以来的微秒数，未执行的阶段不输出。
+ */
+
+typedef enum
+{
+	BOOT_CLOCK = 0,					//RCC_Configuration（HSE起振、PLL锁定）
+	BOOT_UART,						//Serial_Init
+	BOOT_SCCB,						//OV7670_Init（复位和寄存器表）
+	BOOT_SD_INIT,					//SD_init（f_mount中，取自SD_InitTicks）
+	BOOT_MOUNT,						//f_mount的其余部分（读引导扇区和FAT信息）
+	BOOT_CATALOG,					//Catalog_Init
+	BOOT_VSYNC,						//寄存器表写完到第一个VSYNC
+	BOOT_WARMUP,					//第一帧（第一个到第二个VSYNC）
+	BOOT_PHASES
+} Boot_PhaseTypeDef;
+
+/* 启动DWT并记下起点，main中第一个调用 */
+void Boot_Init(void);
+
+/* 当前DWT计数，供Boot_Set使用 */
+uint32_t Boot_Now(void);
+
+void Boot_Start(Boot_PhaseTypeDef phase);
+void Boot_End(Boot_PhaseTypeDef phase);
+
+/* 直接设置一个阶段的起止计数（中断中记录的时刻或分段计时） */
+void Boot_Set(Boot_PhaseTypeDef phase, uint32_t start, uint32_t end);
+
+/*
+ * 输出各阶段耗时，ready为可以拍照的时刻（Boot_Now()的值）
+ * 输出后不再记录，之后在主循环中调用的Boot_Start/End不改变结果
+ */
+void Boot_Report(uint32_t ready, void (*print)(const char *line));
+
+#endif
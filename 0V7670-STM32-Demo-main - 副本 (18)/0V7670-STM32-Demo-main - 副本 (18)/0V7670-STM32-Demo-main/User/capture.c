@@ -0,0 +1,147 @@
+#include "capture.h"
+#include "crc32.h"
+
+//等待异步输出端归还行缓冲区时执行，默认空转；主机测试中定义为模拟的发送完成中断
+#ifndef CAPTURE_WAIT
+#define CAPTURE_WAIT()
+#endif
+
+//行缓冲区交给异步输出端的次数和已归还的次数，两者相等时缓冲区空闲
+//Sent只由Capture_Stream修改，Done只由归还回调（可能在中断中）修改，不需要关中断
+static uint8_t *Capture_Bufs[CAPTURE_MAX_LINE_BUFS];
+static uint8_t Capture_BufSent[CAPTURE_MAX_LINE_BUFS];
+static volatile uint8_t Capture_BufDone[CAPTURE_MAX_LINE_BUFS];
+static uint8_t Capture_BufCount;
+
+static void Capture_LineDone(const uint8_t *buf)
+{
+	uint8_t i;
+
+	for(i = 0; i < Capture_BufCount; i++)
+	{
+		if(Capture_Bufs[i] == buf)
+		{
+			Capture_BufDone[i]++;
+			return;
+		}
+	}
+}
+
+static uint32_t Capture_Now(const Capture_ConfigTypeDef *cfg)
+{
+	return cfg->now ? cfg->now() : 0;
+}
+
+uint8_t Capture_Stream(const Capture_ConfigTypeDef *cfg, uint8_t photo_type, uint32_t *crc_out)
+{
+	Capture_StatsTypeDef stats = {0};
+	uint8_t failed = 0;
+	uint8_t all = (uint8_t)((1u << cfg->sink_count) - 1);
+	uint32_t crc = CRC32_Init();
+	uint32_t t0, t;
+	uint16_t line;
+	uint8_t *buf;
+	uint8_t n, b;
+
+	t0 = Capture_Now(cfg);
+
+	Capture_BufCount = cfg->line_buf_count;
+	for(b = 0; b < Capture_BufCount; b++)
+	{
+		Capture_Bufs[b] = cfg->line_bufs[b];
+		Capture_BufSent[b] = 0;
+		Capture_BufDone[b] = 0;
+	}
+
+	// 第1步：依次打开输出端
+	for(n = 0; n < cfg->sink_count; n++)
+	{
+		if(cfg->sinks[n]->open(photo_type) != 0)
+			failed |= 1u << n;
+	}
+	if(failed == all)
+		goto abort;
+
+	// 第2步：复位读指针，每行只从帧源读取一次
+	cfg->source->begin();
+	cfg->source->line_start();
+
+	for(line = 0; line < CAPTURE_HEIGHT; line++)
+	{
+		// 轮流使用行缓冲区，取用前等待异步输出端归还
+		b = line % Capture_BufCount;
+		buf = Capture_Bufs[b];
+		t = Capture_Now(cfg);
+		while(Capture_BufDone[b] != Capture_BufSent[b]) CAPTURE_WAIT();
+		stats.buf_wait += Capture_Now(cfg) - t;
+
+		t = Capture_Now(cfg);
+		cfg->source->line_finish(buf);
+		if(line + 1 < CAPTURE_HEIGHT)
+			cfg->source->line_start();		//下一行在后台读取，与下面的CRC和输出重叠
+		stats.source += Capture_Now(cfg) - t;
+
+		t = Capture_Now(cfg);
+		crc = CRC32_Update(crc, buf, CAPTURE_LINE_SIZE);
+		stats.crc += Capture_Now(cfg) - t;
+
+		for(n = 0; n < cfg->sink_count; n++)
+		{
+			if(failed & (1u << n))
+				continue;
+
+			t = Capture_Now(cfg);
+			if(cfg->sinks[n]->write_async)
+			{
+				if(cfg->sinks[n]->write_async(buf, CAPTURE_LINE_SIZE, Capture_LineDone) == 0)
+					Capture_BufSent[b]++;
+				else
+					failed |= 1u << n;
+			}
+			else if(cfg->sinks[n]->write(buf, CAPTURE_LINE_SIZE) != 0)
+			{
+				failed |= 1u << n;
+			}
+			stats.sink[n] += Capture_Now(cfg) - t;
+		}
+	}
+
+	// 边读边写时读出的数据可能已被覆盖，不写入帧尾，输出端按未完成的帧处理
+	if(cfg->source->end && cfg->source->end() != 0)
+	{
+		failed = all;
+		goto abort;
+	}
+
+	crc = CRC32_Final(crc);
+	if(crc_out)
+		*crc_out = crc;
+
+	// 第3步：按相反顺序关闭，保证后打开的串口帧尾先于其他输出端的提示信息发出
+	for(n = cfg->sink_count; n-- > 0; )
+	{
+		if(failed & (1u << n))
+			continue;
+		if(cfg->sinks[n]->close(crc) != 0)
+			failed |= 1u << n;
+	}
+
+abort:
+	for(n = 0; n < cfg->sink_count; n++)
+	{
+		if((failed & (1u << n)) && cfg->sinks[n]->abort)
+			cfg->sinks[n]->abort();
+	}
+
+	// 行缓冲区全部归还后才能交给调用者复用
+	for(b = 0; b < Capture_BufCount; b++)
+	{
+		while(Capture_BufDone[b] != Capture_BufSent[b]) CAPTURE_WAIT();
+	}
+
+	stats.total = Capture_Now(cfg) - t0;
+	if(cfg->stats)
+		*cfg->stats = stats;
+
+	return failed;
+}
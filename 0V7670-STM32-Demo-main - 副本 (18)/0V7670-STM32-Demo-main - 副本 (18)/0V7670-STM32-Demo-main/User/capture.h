@@ -0,0 +1,78 @@
+#ifndef __CAPTURE_H
+#define __CAPTURE_H
+
+#include <stdint.h>
+
+/*
+ * 单次曝光多路输出：从帧源逐行读取一次，同一行依次交给所有输出端（SD卡文件、串口...），
+ * 并在读取时计算一次共享的CRC32。本模块不直接访问硬件，帧源和输出端均以函数表接入，
+ * 实机使用AL422B FIFO，主机上可换成模拟帧源进行测试。
+ *
+ * 行流水线：帧源在后台读取第N+1行的同时，CPU计算第N行的CRC并交给输出端；
+ * 异步输出端（串口DMA）持有行缓冲区直到发送完成再归还，行缓冲区在各级之间传递所有权而不复制。
+ */
+
+#define CAPTURE_WIDTH			320
+#define CAPTURE_HEIGHT			240
+#define CAPTURE_LINE_SIZE		(CAPTURE_WIDTH * 2)		//RGB565，每行640字节
+#define CAPTURE_FRAME_SIZE		(CAPTURE_LINE_SIZE * CAPTURE_HEIGHT)
+
+#define CAPTURE_MAX_SINKS		4
+#define CAPTURE_MAX_LINE_BUFS	3
+
+/* 帧源 */
+typedef struct
+{
+	void (*begin)(void);					//复位读指针，准备读取新的一帧
+	void (*line_start)(void);				//开始读取下一行，可在后台进行
+	void (*line_finish)(uint8_t *buf);		//等待本行读完，写入buf（CAPTURE_LINE_SIZE字节）
+	uint8_t (*end)(void);					//读完最后一行后检查整帧，返回非0表示数据已损坏；可为NULL
+} Capture_SourceTypeDef;
+
+/* 行缓冲区归还回调，异步输出端发送完成后调用（可在中断中） */
+typedef void (*Capture_DoneTypeDef)(const uint8_t *buf);
+
+/* 输出端，返回0表示成功 */
+typedef struct
+{
+	uint8_t (*open)(uint8_t photo_type);					//写入协议头
+	uint8_t (*write)(const uint8_t *buf, uint16_t len);		//写入一行图像数据，返回后buf即可复用
+	uint8_t (*close)(uint32_t crc);							//写入CRC和帧尾
+	void    (*abort)(void);									//出错时释放资源，可为NULL
+	//异步写入一行，可为NULL（此时用write）。返回0时必须在用完buf后调用一次done
+	uint8_t (*write_async)(const uint8_t *buf, uint16_t len, Capture_DoneTypeDef done);
+} Capture_SinkTypeDef;
+
+/* 每帧各级耗时，单位为now()的计数单位 */
+typedef struct
+{
+	uint32_t buf_wait;						//等待异步输出端归还行缓冲区
+	uint32_t source;						//等待帧源读完一行
+	uint32_t crc;							//CRC计算
+	uint32_t sink[CAPTURE_MAX_SINKS];		//各输出端write/write_async调用
+	uint32_t total;							//整帧（打开到关闭）
+} Capture_StatsTypeDef;
+
+typedef struct
+{
+	const Capture_SourceTypeDef *source;
+	const Capture_SinkTypeDef *sinks[CAPTURE_MAX_SINKS];
+	uint8_t sink_count;
+	uint8_t *line_bufs[CAPTURE_MAX_LINE_BUFS];	//行缓冲区，每个至少CAPTURE_LINE_SIZE字节、4字节对齐
+	uint8_t line_buf_count;					//1~CAPTURE_MAX_LINE_BUFS，1个时不流水
+	uint32_t (*now)(void);					//时间戳，可为NULL（不统计）
+	Capture_StatsTypeDef *stats;			//各级耗时输出，可为NULL
+} Capture_ConfigTypeDef;
+
+/*
+ * 读取一帧并输出到所有输出端
+ * 输入：cfg (帧源/输出端/行缓冲区), photo_type (1=不补光, 2=可见光, 3=红外光)
+ * 输出：crc_out (整帧CRC32，可为NULL)
+ * 返回：失败的输出端位掩码（bit n 对应 sinks[n]），0表示全部成功
+ * 说明：输出端按数组顺序打开、按相反顺序关闭。某一输出端出错后只放弃该输出端，其余继续。
+ *       帧源报告数据损坏时不关闭任何输出端，全部放弃（abort），返回值为全部输出端。
+ *       返回前等待所有异步输出端归还行缓冲区。
+ */
+uint8_t Capture_Stream(const Capture_ConfigTypeDef *cfg, uint8_t photo_type, uint32_t *crc_out);
+
+#endif
@@ -0,0 +1,236 @@
+#include "catalog.h"
+#include "storage.h"
+#include "timer.h"
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#define CATALOG_RECORDS_PER_SECTOR	(512 / sizeof(Catalog_RecordTypeDef))
+#define CATALOG_RECORD_SECTOR		2			//第一个记录扇区
+#define CATALOG_FILE_SECTORS		(CATALOG_RECORD_SECTOR + CATALOG_CAPACITY / CATALOG_RECORDS_PER_SECTOR)
+#define CATALOG_MAX_SEQ				99999		//IMGnnnnn
+
+typedef char Catalog_RecordSizeCheck[(512 % sizeof(Catalog_RecordTypeDef) == 0) ? 1 : -1];
+typedef char Catalog_CapacityCheck[(CATALOG_CAPACITY % CATALOG_RECORDS_PER_SECTOR == 0) ? 1 : -1];
+
+static Storage_ExtentTypeDef Catalog_Extent;
+static Catalog_HeaderTypeDef Catalog_Header;
+static uint32_t Catalog_Sector[512 / 4];		//扇区缓冲区
+static uint8_t Catalog_Ready;
+static uint8_t Catalog_Pending;					//已分配序号，尚未登记
+static uint32_t Catalog_PendingSeq;
+static int32_t Catalog_DirMade = -1;			//本次上电已确认存在的子目录
+
+static uint32_t Catalog_Check(const Catalog_HeaderTypeDef *h)
+{
+	const uint32_t *w = (const uint32_t *)h;
+	uint32_t sum = 0;
+	uint8_t i;
+
+	for(i = 0; i < offsetof(Catalog_HeaderTypeDef, check) / 4; i++)
+		sum += w[i];
+	return ~sum;
+}
+
+static uint8_t Catalog_Valid(const Catalog_HeaderTypeDef *h)
+{
+	return h->magic == CATALOG_MAGIC && h->version == CATALOG_VERSION
+		&& h->record_size == sizeof(Catalog_RecordTypeDef)
+		&& h->capacity == CATALOG_CAPACITY && h->dir_files != 0
+		&& h->check == Catalog_Check(h);
+}
+
+//写入另一个副本，失败时内存中的头部不变
+static FRESULT Catalog_WriteHeader(Catalog_HeaderTypeDef *h)
+{
+	h->generation = Catalog_Header.generation + 1;
+	h->check = Catalog_Check(h);
+
+	memset(Catalog_Sector, 0, sizeof(Catalog_Sector));
+	memcpy(Catalog_Sector, h, sizeof(*h));
+	if(Storage_ExtentWrite(&Catalog_Extent, h->generation & 1, Catalog_Sector))
+		return FR_DISK_ERR;
+
+	Catalog_Header = *h;
+	return FR_OK;
+}
+
+//新建的目录文件：记录区清零，写入第一个头部
+static FRESULT Catalog_Format(void)
+{
+	Catalog_HeaderTypeDef h;
+	DWORD n;
+
+	memset(Catalog_Sector, 0, sizeof(Catalog_Sector));
+	for(n = 0; n < Catalog_Extent.count; n++)
+	{
+		if(Storage_ExtentWrite(&Catalog_Extent, n, Catalog_Sector))
+			return FR_DISK_ERR;
+	}
+
+	memset(&h, 0, sizeof(h));
+	h.magic = CATALOG_MAGIC;
+	h.version = CATALOG_VERSION;
+	h.record_size = sizeof(Catalog_RecordTypeDef);
+	h.next_seq = 1;
+	h.capacity = CATALOG_CAPACITY;
+	h.dir_files = CATALOG_DIR_FILES;
+	Catalog_Header.generation = 0;
+	return Catalog_WriteHeader(&h);
+}
+
+//读取两个副本，取有效且较新的一个
+static FRESULT Catalog_Load(void)
+{
+	Catalog_HeaderTypeDef h;
+	uint8_t found = 0;
+	DWORD n;
+
+	for(n = 0; n < 2; n++)
+	{
+		if(Storage_ExtentRead(&Catalog_Extent, n, Catalog_Sector))
+			return FR_DISK_ERR;
+		memcpy(&h, Catalog_Sector, sizeof(h));
+		if(Catalog_Valid(&h) && (!found || (int32_t)(h.generation - Catalog_Header.generation) > 0))
+		{
+			Catalog_Header = h;
+			found = 1;
+		}
+	}
+	return found ? FR_OK : FR_INT_ERR;
+}
+
+FRESULT Catalog_Init(FIL *fp)
+{
+	FRESULT res;
+	uint8_t created;
+
+	Catalog_Ready = 0;
+	Catalog_Pending = 0;
+
+	res = f_open(fp, CATALOG_FILE, FA_OPEN_ALWAYS | FA_READ | FA_WRITE);
+	if(res != FR_OK)
+		return res;
+
+	created = (fp->fsize == 0);
+	if(created)
+		res = Storage_Prealloc(fp, (DWORD)CATALOG_FILE_SECTORS * 512);
+	else if(fp->fsize != (DWORD)CATALOG_FILE_SECTORS * 512)
+		res = FR_DENIED;			//CATALOG_CAPACITY改变过
+	if(res == FR_OK)
+	{
+		switch(Storage_GetExtent(fp, &Catalog_Extent))
+		{
+			case 0: break;
+			case 1: res = FR_DENIED; break;
+			default: res = FR_DISK_ERR; break;
+		}
+	}
+	if(res == FR_OK)
+		res = created ? Catalog_Format() : Catalog_Load();
+
+	//新文件的目录项在内容写好之后才写入，中途掉电下次重新创建
+	if(res == FR_OK)
+		res = f_close(fp);
+	else
+		f_close(fp);
+
+	Catalog_Ready = (res == FR_OK);
+	return res;
+}
+
+uint8_t Catalog_IsReady(void)
+{
+	return Catalog_Ready;
+}
+
+uint32_t Catalog_NextSeq(void)
+{
+	return Catalog_Header.next_seq;
+}
+
+uint32_t Catalog_Count(void)
+{
+	return Catalog_Header.count;
+}
+
+FRESULT Catalog_NextPath(char *path)
+{
+	Catalog_HeaderTypeDef h = Catalog_Header;
+	uint32_t seq = h.next_seq;
+	uint32_t dir = seq / h.dir_files;
+	FRESULT res;
+
+	if(!Catalog_Ready)
+		return FR_NOT_READY;
+	if(seq > CATALOG_MAX_SEQ)
+		return FR_DENIED;
+
+	//先记下序号已被使用，再创建文件
+	h.next_seq = seq + 1;
+	res = Catalog_WriteHeader(&h);
+	if(res != FR_OK)
+		return res;
+
+	sprintf(path, "P%03lu", (unsigned long)dir);
+	if((int32_t)dir != Catalog_DirMade)
+	{
+		res = f_mkdir(path);
+		if(res != FR_OK && res != FR_EXIST)
+			return res;
+		Catalog_DirMade = (int32_t)dir;
+	}
+	sprintf(path, "P%03lu/IMG%05lu.DAT", (unsigned long)dir, (unsigned long)seq);
+
+	Catalog_PendingSeq = seq;
+	Catalog_Pending = 1;
+	return FR_OK;
+}
+
+FRESULT Catalog_Add(uint8_t light_mode, uint32_t size, uint32_t crc)
+{
+	Catalog_HeaderTypeDef h = Catalog_Header;
+	Catalog_RecordTypeDef *rec;
+	uint32_t slot = h.count % h.capacity;
+	DWORD sector = CATALOG_RECORD_SECTOR + slot / CATALOG_RECORDS_PER_SECTOR;
+	char name[13];
+
+	if(!Catalog_Ready || !Catalog_Pending)
+		return FR_NOT_READY;
+	Catalog_Pending = 0;
+
+	if(Storage_ExtentRead(&Catalog_Extent, sector, Catalog_Sector))
+		return FR_DISK_ERR;
+	rec = (Catalog_RecordTypeDef *)Catalog_Sector + slot % CATALOG_RECORDS_PER_SECTOR;
+	memset(rec, 0, sizeof(*rec));
+	rec->seq = Catalog_PendingSeq;
+	rec->light_mode = light_mode;
+	rec->flags = CATALOG_RECORD_VALID;
+	rec->dir = (uint16_t)(Catalog_PendingSeq / h.dir_files);
+	rec->size = size;
+	rec->crc32 = crc;
+	rec->timestamp_ms = TIMER_Millis();
+	snprintf(name, sizeof(name), "IMG%05u.DAT", (unsigned)(Catalog_PendingSeq % (CATALOG_MAX_SEQ + 1)));	//取余只为让编译器知道不超过5位
+	memcpy(rec->name, name, sizeof(rec->name));
+	if(Storage_ExtentWrite(&Catalog_Extent, sector, Catalog_Sector))
+		return FR_DISK_ERR;
+
+	//头部写入后记录才生效；之前掉电时这一条会被下一张照片覆盖
+	h.count++;
+	return Catalog_WriteHeader(&h);
+}
+
+FRESULT Catalog_Get(uint32_t n, Catalog_RecordTypeDef *rec)
+{
+	uint32_t slot = n % Catalog_Header.capacity;
+
+	if(!Catalog_Ready)
+		return FR_NOT_READY;
+	if(n >= Catalog_Header.count || Catalog_Header.count - n > Catalog_Header.capacity)
+		return FR_NO_FILE;
+
+	if(Storage_ExtentRead(&Catalog_Extent, CATALOG_RECORD_SECTOR + slot / CATALOG_RECORDS_PER_SECTOR, Catalog_Sector))
+		return FR_DISK_ERR;
+	memcpy(rec, (Catalog_RecordTypeDef *)Catalog_Sector + slot % CATALOG_RECORDS_PER_SECTOR, sizeof(*rec));
+	return FR_OK;
+}
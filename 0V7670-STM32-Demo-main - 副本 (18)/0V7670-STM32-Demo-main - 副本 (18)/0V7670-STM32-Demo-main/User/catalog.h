@@ -0,0 +1,80 @@
+#ifndef __CATALOG_H
+#define __CATALOG_H
+
+#include <stdint.h>
+#include "ff.h"
+
+/*
+ * 照片目录文件（PHOTO.IDX）：保存下一个照片序号和已保存照片的记录，
+ * 开机和拍照时不需要扫描目录（_USE_LFN 0，f_readdir的耗时随文件数线性增长）
+ *
+ * 照片按序号命名为 Pddd/IMGnnnnn.DAT，每CATALOG_DIR_FILES张换一个子目录，
+ * 每个目录中的文件数有上限，f_open的查找时间不随卡上照片数增长。
+ *
+ * 布局（预分配的连续文件，扇区直接读写，不经过FatFs）：
+ *   扇区0、1  头部的两个副本，每次更新写入第(generation & 1)个，开机取校验正确且generation较大的一个，
+ *             写入中途掉电只损坏正在写的副本
+ *   扇区2起   记录，每扇区16条，第n张照片位于第(n % capacity)条，写满后覆盖最旧的记录
+ *
+ * 拍照时先分配序号（写头部），再创建文件；保存成功后写记录，再写头部使count加1。
+ * 分配后未保存成功的序号不再使用，不会覆盖已有的照片。
+ */
+
+#define CATALOG_FILE			"PHOTO.IDX"
+#define CATALOG_MAGIC			0x58444950		//"PIDX"
+#define CATALOG_VERSION			1
+#define CATALOG_CAPACITY		1024			//记录条数
+#define CATALOG_DIR_FILES		100				//每个子目录的照片数
+#define CATALOG_PATH_SIZE		18				//"P000/IMG00001.DAT"
+
+#define CATALOG_RECORD_VALID	0x01
+
+typedef struct
+{
+	uint32_t magic;					//0   CATALOG_MAGIC
+	uint16_t version;				//4   CATALOG_VERSION
+	uint16_t record_size;			//6   sizeof(Catalog_RecordTypeDef)
+	uint32_t generation;			//8   每次更新加1
+	uint32_t next_seq;				//12  下一个照片序号
+	uint32_t count;					//16  已登记的照片数（含已被覆盖的记录）
+	uint32_t capacity;				//20  CATALOG_CAPACITY
+	uint32_t dir_files;				//24  CATALOG_DIR_FILES
+	uint32_t check;					//28  以上各字按uint32求和取反（CRC外设在拍照期间被占用）
+} Catalog_HeaderTypeDef;			//32字节
+
+typedef struct
+{
+	uint32_t seq;					//0   照片序号
+	uint8_t  light_mode;			//4   1=不补光, 2=可见光, 3=红外光
+	uint8_t  flags;					//5   CATALOG_RECORD_xx
+	uint16_t dir;					//6   子目录号（Pddd）
+	uint32_t size;					//8   文件大小
+	uint32_t crc32;					//12  像素数据CRC32
+	uint32_t timestamp_ms;			//16  保存时上电以来的毫秒数
+	char     name[12];				//20  8.3文件名，不含目录，12个字符时无结束符
+} Catalog_RecordTypeDef;			//32字节
+
+/*
+ * 打开（不存在时创建）目录文件并读取头部，之后按扇区直接读写，不再占用文件对象
+ * 输入：fp (临时文件对象，只在本函数中使用)
+ * 返回：FR_OK 表示可用；文件不连续（例如被PC改写过）时返回FR_DENIED，调用者改用原来的命名方式
+ */
+FRESULT Catalog_Init(FIL *fp);
+
+uint8_t Catalog_IsReady(void);
+uint32_t Catalog_NextSeq(void);
+uint32_t Catalog_Count(void);
+
+/*
+ * 分配下一个序号并生成路径，需要时创建子目录
+ * 输出：path（至少CATALOG_PATH_SIZE字节）
+ */
+FRESULT Catalog_NextPath(char *path);
+
+/* 登记最近一次Catalog_NextPath分配的照片 */
+FRESULT Catalog_Add(uint8_t light_mode, uint32_t size, uint32_t crc);
+
+/* 读取第n张（0起，按登记顺序）照片的记录，已被覆盖时返回FR_NO_FILE */
+FRESULT Catalog_Get(uint32_t n, Catalog_RecordTypeDef *rec);
+
+#endif
@@ -0,0 +1,164 @@
+#include "frame.h"
+#include <stddef.h>
+
+//快门序号只由Frame_Arm修改，中断在开始写入时记下，写完时不相等说明写入期间又按过快门
+static const Frame_ConfigTypeDef *Frame_Cfg;
+static volatile uint8_t Frame_State;
+static volatile uint8_t Frame_ArmSeq;
+static volatile uint32_t Frame_ArmedAt;
+static volatile uint8_t Frame_StreamReq;		//只由主程序修改：边读边写，写完后直接进入DRAINING
+static uint32_t Frame_Count;
+static Frame_InfoTypeDef Frame_Cur;				//正在写入的帧（中断使用）
+static Frame_InfoTypeDef Frame_Done;			//最近锁存的帧（READY之后主程序使用）
+
+static void Frame_Event(Frame_EventTypeDef ev, const Frame_InfoTypeDef *info)
+{
+	if(Frame_Cfg->event)
+		Frame_Cfg->event(ev, info);
+}
+
+void Frame_Init(const Frame_ConfigTypeDef *cfg)
+{
+	Frame_Cfg = cfg;
+	Frame_State = FRAME_IDLE;
+	Frame_ArmSeq = 0;
+	Frame_StreamReq = 0;
+	Frame_Count = 0;
+	Frame_Done.arm = 0;
+}
+
+void Frame_Vsync(uint32_t now)
+{
+	uint8_t state = Frame_State;
+	uint8_t ready;
+
+	Frame_Count++;
+	if(state == FRAME_WRITING)
+	{
+		Frame_Cfg->write_stop();
+		Frame_Cur.end = now;
+		if(Frame_Cur.arm != Frame_ArmSeq)
+		{
+			state = FRAME_ARMED;
+			Frame_Event(FRAME_EV_DISCARD, &Frame_Cur);
+		}
+		else
+		{
+			Frame_Done = Frame_Cur;
+			state = Frame_StreamReq ? FRAME_DRAINING : FRAME_READY;
+			Frame_Event(FRAME_EV_READY, &Frame_Done);
+		}
+	}
+
+	ready = Frame_Cfg->blanking ? Frame_Cfg->blanking() : 1;
+	if(state == FRAME_ARMED && ready)
+	{
+		Frame_Cfg->write_start();
+		Frame_Cur.armed = Frame_ArmedAt;
+		Frame_Cur.arm = Frame_ArmSeq;
+		Frame_Cur.start = now;
+		Frame_Cur.vsync = Frame_Count;
+		state = FRAME_WRITING;
+		Frame_Event(FRAME_EV_START, &Frame_Cur);
+	}
+	else if(state == FRAME_ARMED)
+	{
+		Frame_Event(FRAME_EV_HOLD, &Frame_Cur);
+	}
+	Frame_State = state;
+}
+
+void Frame_Arm(uint32_t now)
+{
+	uint8_t state;
+
+	Frame_ArmedAt = now;
+	Frame_ArmSeq++;
+	//ARMED/WRITING归中断所有，中断会看到新的序号；READY中的帧开始于快门之前，舍弃
+	state = Frame_State;
+	if(state == FRAME_IDLE || state == FRAME_READY)
+		Frame_State = FRAME_ARMED;
+}
+
+uint8_t Frame_Drain(void)
+{
+	if(Frame_State != FRAME_READY)
+		return 0;
+	Frame_State = FRAME_DRAINING;
+	return 1;
+}
+
+uint8_t Frame_Stream(void)
+{
+	uint8_t state;
+
+	//先置请求再读状态：读到WRITING时中断结束本帧前一定能看到请求
+	Frame_StreamReq = 1;
+	state = Frame_State;
+	if(state == FRAME_WRITING || state == FRAME_DRAINING)
+		return 1;
+	Frame_StreamReq = 0;
+	return Frame_Drain();
+}
+
+void Frame_Release(uint8_t keep)
+{
+	uint8_t state;
+
+	Frame_StreamReq = 0;
+	state = Frame_State;
+	if(state != FRAME_READY && state != FRAME_DRAINING)
+		return;
+	if(Frame_Done.arm != Frame_ArmSeq)
+		state = FRAME_ARMED;
+	else
+		state = keep ? FRAME_READY : FRAME_IDLE;
+	Frame_State = state;
+}
+
+Frame_StateTypeDef Frame_GetState(void)
+{
+	return (Frame_StateTypeDef)Frame_State;
+}
+
+const Frame_InfoTypeDef *Frame_GetInfo(void)
+{
+	//边读边写期间中断不会开始新的一帧，Frame_Cur不变
+	return Frame_StreamReq ? &Frame_Cur : &Frame_Done;
+}
+
+void Frame_PaceInit(Frame_PaceTypeDef *pace)
+{
+	pace->min_time = 0XFFFFFFFF;
+	pace->min_rows = 1;
+}
+
+uint32_t Frame_PaceDue(const Frame_PaceTypeDef *pace, uint16_t row)
+{
+	uint32_t rows = pace->lead + (uint32_t)pace->step * (row + 1) + pace->margin;
+
+	return pace->start + rows * pace->line;
+}
+
+void Frame_PaceRead(Frame_PaceTypeDef *pace, uint16_t row, uint32_t now)
+{
+	uint32_t time = now - pace->start;
+	uint16_t rows = pace->lead + pace->step * (row + 1);
+
+	//比较 time/rows < min_time/min_rows，交叉相乘避免除法
+	if((uint64_t)time * pace->min_rows < (uint64_t)pace->min_time * rows)
+	{
+		pace->min_time = time;
+		pace->min_rows = rows;
+	}
+}
+
+int32_t Frame_PaceSlack(const Frame_PaceTypeDef *pace, uint32_t end)
+{
+	uint32_t written;
+
+	if(pace->min_time == 0XFFFFFFFF)
+		return 0X7FFFFFFF;				//没有读取任何一行
+	written = (uint32_t)((uint64_t)(end - pace->start) * pace->min_rows / pace->lines);
+	return (int32_t)(pace->min_time - written);
+}
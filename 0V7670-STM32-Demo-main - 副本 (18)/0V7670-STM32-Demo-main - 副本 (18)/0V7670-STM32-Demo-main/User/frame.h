@@ -0,0 +1,121 @@
+#ifndef __FRAME_H
+#define __FRAME_H
+
+#include <stdint.h>
+
+/*
+ * 帧状态机：由VSYNC驱动，把一帧锁存到FIFO中，主程序在等待期间可以做其他事情
+ *
+ *   IDLE      FIFO不写入
+ *   ARMED     已按下快门（Frame_Arm），下一个可用的VSYNC开始写入
+ *   WRITING   正在写入FIFO，下一个VSYNC结束
+ *   READY     一帧已锁存，等待读出
+ *   DRAINING  正在读出（Frame_Drain），读完后Frame_Release
+ *
+ * ARMED和WRITING只由VSYNC中断改变，IDLE/READY/DRAINING只由主程序改变，不需要关中断。
+ * 写入期间再次Frame_Arm时，这一帧结束后不进入READY而是重新写入下一帧（帧开始于快门之前）；
+ * 读出期间Frame_Arm时，Frame_Release后进入ARMED。
+ *
+ * 边读边写（Frame_Stream）：AL422B的读写指针相互独立，写入期间就可以开始读出，读出的第k行必须已经写完。
+ * 本帧写完时中断直接进入DRAINING。读出节拍由Frame_Pace按传感器的行时序计算，写完后按实测的帧周期检查。
+ *
+ * 本模块不直接访问硬件，FIFO写控制和消隐期间的工作以函数指针接入，主机上可注入VSYNC测试。
+ * 时刻为调用者的计数单位（实机为DWT_CYCCNT）。
+ */
+
+typedef enum
+{
+	FRAME_IDLE = 0,
+	FRAME_ARMED,
+	FRAME_WRITING,
+	FRAME_READY,
+	FRAME_DRAINING
+} Frame_StateTypeDef;
+
+typedef enum
+{
+	FRAME_EV_START = 0,					//开始写入FIFO
+	FRAME_EV_READY,						//一帧已锁存
+	FRAME_EV_DISCARD,					//写入中途重新按下快门，这一帧舍弃
+	FRAME_EV_HOLD						//已按下快门，blanking返回0，这一帧不写入（例如等待切换传感器配置）
+} Frame_EventTypeDef;
+
+typedef struct
+{
+	uint32_t armed;						//Frame_Arm的时刻
+	uint32_t start;						//开始写入的VSYNC时刻，start - armed为快门延迟
+	uint32_t end;						//写完的VSYNC时刻
+	uint32_t vsync;						//开始写入时的VSYNC序号（Frame_Init以来）
+	uint8_t  arm;						//对应的快门序号（内部使用）
+} Frame_InfoTypeDef;
+
+typedef struct
+{
+	void (*write_start)(void);			//复位写指针并允许写入
+	void (*write_stop)(void);			//停止写入
+	//VSYNC中停止写入之后、开始写入之前调用（例如检查传感器配置是否已切换），返回0时这一帧不开始写入；可为NULL
+	uint8_t (*blanking)(void);
+	//状态变化时在中断中调用，可为NULL
+	void (*event)(Frame_EventTypeDef ev, const Frame_InfoTypeDef *info);
+} Frame_ConfigTypeDef;
+
+/* 设置硬件接口，回到IDLE；在打开VSYNC中断之前调用 */
+void Frame_Init(const Frame_ConfigTypeDef *cfg);
+
+/* VSYNC中断中调用，now为当前时刻 */
+void Frame_Vsync(uint32_t now);
+
+/* 按下快门：锁存在此之后开始的第一帧（FIFO中已有的帧舍弃） */
+void Frame_Arm(uint32_t now);
+
+/* READY时进入DRAINING并返回1，否则返回0 */
+uint8_t Frame_Drain(void);
+
+/*
+ * 边读边写：WRITING时返回1，帧写完后中断进入DRAINING而不是READY；READY时与Frame_Drain相同
+ * 返回1后Frame_GetInfo中的start即有效，end在进入DRAINING后有效。读出期间不要Frame_Arm
+ */
+uint8_t Frame_Stream(void);
+
+/*
+ * 读出结束（也可在READY时直接舍弃）
+ * keep：1 帧仍留在FIFO中，回到READY可以再次读出；0 回到IDLE
+ * 读出期间又按过快门时进入ARMED；边读边写时须在帧写完之后调用
+ */
+void Frame_Release(uint8_t keep);
+
+Frame_StateTypeDef Frame_GetState(void);
+
+/* 最近锁存的一帧，READY/DRAINING期间有效；边读边写时为正在读出的一帧 */
+const Frame_InfoTypeDef *Frame_GetInfo(void);
+
+/*
+ * 读出节拍：第k个输出行在 start + (lead + step*(k+1)) * line 时写完，再留margin行余量开始读取
+ * 各行开始读取的时刻交给Frame_PaceRead，帧写完后Frame_PaceSlack按实测的行时间（(end - start) / lines）
+ * 算出最紧张一行开始读取时超前写完的时间，为负表示读指针追上了写指针（读到上一帧的数据）
+ */
+typedef struct
+{
+	uint32_t start;						//开始写入的时刻
+	uint32_t line;						//预计的传感器行时间
+	uint32_t lines;						//每帧的传感器行数（含帧尾dummy行）
+	uint16_t lead;						//VSYNC到第一个输出行的传感器行数
+	uint16_t step;						//每个输出行占用的传感器行数
+	uint16_t margin;					//余量（传感器行）
+	uint32_t min_time;					//以下内部使用：已读各行中 (开始读取 - start) / 写完所需行数 最小的一行
+	uint16_t min_rows;
+} Frame_PaceTypeDef;
+
+/* 填好start~margin之后调用，清除读取记录 */
+void Frame_PaceInit(Frame_PaceTypeDef *pace);
+
+/* 第row个输出行可以开始读取的时刻 */
+uint32_t Frame_PaceDue(const Frame_PaceTypeDef *pace, uint16_t row);
+
+/* 记录第row个输出行开始读取的时刻 */
+void Frame_PaceRead(Frame_PaceTypeDef *pace, uint16_t row, uint32_t now);
+
+/* 帧写完（end为结束的VSYNC时刻）后检查，返回最紧张一行的余量，负数表示数据已损坏 */
+int32_t Frame_PaceSlack(const Frame_PaceTypeDef *pace, uint32_t end);
+
+#endif
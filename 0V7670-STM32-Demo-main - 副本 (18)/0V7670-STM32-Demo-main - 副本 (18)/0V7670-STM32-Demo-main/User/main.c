@@ -8,17 +8,41 @@
 #include "SDdriver.h"
 #include "ff.h"
 #include "diskio.h"
+#include "ff_gen_drv.h"
+#include "user_diskio.h"
 
 // OV7670相关头文件
 #include "OV7670.h"
+#include "FIFO.h"
 #include "exti.h"
 #include "timer.h"
 #include "Key.h"
 #include "LED.h"
+#include "capture.h"
+#include "replay.h"
+#include "photo.h"
+#include "storage.h"
+#include "session.h"
+#include "catalog.h"
+#include "bench.h"
+#include "boot.h"
+#include "frame.h"
+#include "sched.h"
 
 #include <stdio.h>
 #include <string.h>
 
+#ifndef BOOT_SELFTEST
+#define BOOT_SELFTEST		0		// 1=开机执行SPI/SD/FATFS自检和照片存储测试（约数秒），0=直接进入拍照
+#endif
+#define BOOT_WARMUP_FRAMES	2		// 开机后舍弃的帧数，之后曝光和白平衡已稳定
+#define BOOT_WARMUP_MS		2000	// 等待预热帧的上限（摄像头未接好时不卡在开机阶段）
+#define CAPTURE_FRAME_MS	2000	// 按下快门后等待锁存一帧的上限（含配置切换和舍弃帧，红外模式5fps）
+#ifndef CAPTURE_STREAM
+#define CAPTURE_STREAM		1		// 1=帧开始写入FIFO后即按行时序读出（边读边写），0=整帧写完后再读出
+#endif
+#define STREAM_MARGIN_LINES	8		// 边读边写时读指针落后写指针的余量（传感器行），容许首行晚7行或行时间长约1.4%
+
 // 函数别名定义 - 用于SD卡测试
 #define UART_Init           Serial_Init
 #define UART_SendString     Serial_SendString
@@ -36,14 +60,16 @@ UINT bw;            // Bytes written
 UINT br;            // Bytes read
 
 // 全局变量 - OV7670拍照
-uint8_t g_image_line_buffer[640];  // 320像素 × 2字节 = 640字节
-uint8_t KeyNum;		//定义用于接收按键键码的变量
+uint8_t g_image_line_buffer[640] __attribute__((aligned(4)));  // 320像素 × 2字节 = 640字节，4字节对齐供FIFO按字写入
+uint8_t g_image_line_spare[CAPTURE_MAX_LINE_BUFS - 1][CAPTURE_LINE_SIZE] __attribute__((aligned(4)));  // 拍照流水线的另外两个行缓冲区
+Capture_StatsTypeDef g_capture_stats;  // 最近一帧各级耗时（DWT周期）
 
 // ==================== 阶段1&2新增：SD卡照片存储全局变量 ====================
 
 // 照片文件名管理
-char photo_filename[32];           // 当前照片文件名，格式：IMG_XXX.DAT
-uint16_t photo_counter = 0;        // 照片计数器，用于生成唯一文件名
+char photo_filename[32];           // 当前照片文件名，格式：Pddd/IMGnnnnn.DAT（目录文件不可用时为IMG_XXX.DAT）
+uint16_t photo_counter = 0;        // 照片计数器，目录文件不可用时用于生成文件名
+Photo_HeaderTypeDef photo_header;  // 当前照片文件的v2头部，关闭时回写CRC和耗时
 
 // SD卡读写缓冲区（复用g_image_line_buffer，无需额外内存）
 
@@ -391,27 +417,6 @@ void Test_FATFS(void)
 
 // ==================== OV7670拍照函数区域 ====================
 
-// 软件CRC32计算 - 兼容Python zlib.crc32
-uint32_t crc32_software(uint8_t *data, uint32_t length)
-{
-	uint32_t crc = 0xFFFFFFFF;
-	uint32_t i, j;
-
-	for(i = 0; i < length; i++)
-	{
-		crc ^= data[i];
-		for(j = 0; j < 8; j++)
-		{
-			if(crc & 1)
-				crc = (crc >> 1) ^ 0xEDB88320;
-			else
-				crc >>= 1;
-		}
-	}
-
-	return ~crc;
-}
-
 // 发送图像协议头
 // photo_type: 1=不补光, 2=可见光, 3=红外光
 void Send_Image_Header(uint8_t photo_type)
@@ -428,196 +433,762 @@ void Send_Image_Header(uint8_t photo_type)
 	delay_ms(5);
 }
 
-// 发送图像到PC - 增强版（带CRC校验）
-// photo_type: 1=不补光, 2=可见光, 3=红外光
-void Camera_SendToPC(uint8_t photo_type)
+// ==================== 单次曝光多路输出 ====================
+
+// 输出端选择位
+#define SINK_SD			0x01		// 保存到SD卡
+#define SINK_UART		0x02		// 发送到PC
+
+FRESULT Create_PhotoFile(uint8_t photo_type);
+FRESULT Write_ImageLineToSD(uint8_t* line_data, uint16_t length);
+FRESULT Write_ImageFooterToSD(uint32_t crc_value);
+
+// 帧源：AL422B FIFO，DMA方式下本行在后台读取
+static const Capture_SourceTypeDef FIFO_Source = {FIFO_ReadReset, FIFO_LineStart, FIFO_LineFinish, NULL};
+
+// 边读边写的帧源：帧仍在写入时，每行等到传感器写完（按行时间推算，HREF没有接到MCU）再读取
+// 还没写完的行推迟到line_finish中开始，等待期间流水线先处理上一行
+static Frame_PaceTypeDef Stream_Pace;
+static uint16_t Stream_Row;				// 下一个开始读取的行
+static uint8_t Stream_Pending;			// 本行的读取推迟到line_finish
+static uint8_t Stream_Used;				// 最近一次Camera_Output是边读边写
+static uint8_t Stream_Underrun;			// 最近一帧读指针追上了写指针，已输出的数据作废
+static int32_t Stream_Slack;			// 最近一帧最紧张一行的余量（DWT周期）
+static uint32_t Stream_Underruns;		// 开机以来的次数
+
+static void Stream_Begin(void)
+{
+	Stream_Pace.start = Frame_GetInfo()->start;
+	Stream_Pace.line = OV7670_LineCycles();
+	Stream_Pace.lines = OV7670_FrameLines();
+	Stream_Pace.lead = OV7670_FRAME_LEAD;
+	Stream_Pace.step = OV7670_ROW_LINES;
+	Stream_Pace.margin = STREAM_MARGIN_LINES;
+	Frame_PaceInit(&Stream_Pace);
+	Stream_Row = 0;
+	Stream_Pending = 0;
+	Stream_Used = 1;
+	FIFO_ReadReset();					// 读指针与写指针相互独立，写入期间可以复位
+#if SD_USE_DMA
+	SD_IdleHook = Stream_Service;
+#endif
+}
+
+static void Stream_StartRow(void)
 {
-	uint32_t i, j;
-	uint16_t color;
-	uint16_t colorL, colorH;
-	uint32_t crc_value = 0;
+	Frame_PaceRead(&Stream_Pace, Stream_Row++, DWT_CYCCNT);
+	FIFO_LineStart();
+}
 
-	if(OV7670_STA == 2)
+#if SD_USE_DMA
+// SD卡DMA传输期间调用：推迟的行一到时间就开始读取，不必等这一行的SD写入完成
+static void Stream_Service(void)
+{
+	if(Stream_Pending && (int32_t)(DWT_CYCCNT - Frame_PaceDue(&Stream_Pace, Stream_Row)) >= 0)
 	{
-		// 发送图像数据头（带照片类型标识）
-		Send_Image_Header(photo_type);
-
-		// 复位FIFO读指针
-		FIFO_RRST = 0;
-		delay_us(1);
-		FIFO_RCLK = 0;
-		delay_us(1);
-		FIFO_RCLK = 1;
-		delay_us(1);
-		FIFO_RCLK = 0;
-		delay_us(1);
-		FIFO_RRST = 1;
-		delay_us(1);
-		FIFO_RCLK = 1;
-		delay_us(1);
-
-		// 初始化CRC
-		crc_value = 0xFFFFFFFF;
-
-		// 逐行读取并发送，同时计算CRC
-		for(i = 0; i < 240; i++)  // LCD_HIGH = 240
-		{
-			delay_us(2);
+		Stream_Pending = 0;
+		Stream_StartRow();
+	}
+}
+#endif
 
-			for(j = 0; j < 320; j++)  // LCD_WIDTH = 320
-			{
-				FIFO_RCLK = 0;
-				delay_us(1);
-				colorH = OV7670_RedData();
-
-				FIFO_RCLK = 1;
-				delay_us(1);
-				FIFO_RCLK = 0;
-				delay_us(1);
-				colorL = OV7670_RedData();
-
-				colorL >>= 8;
-				color = colorH | colorL;
-				FIFO_RCLK = 1;
-
-				g_image_line_buffer[j * 2] = (color >> 8) & 0xFF;
-				g_image_line_buffer[j * 2 + 1] = color & 0xFF;
-			}
+static void Stream_LineStart(void)
+{
+	if((int32_t)(DWT_CYCCNT - Frame_PaceDue(&Stream_Pace, Stream_Row)) >= 0)
+		Stream_StartRow();
+	else
+		Stream_Pending = 1;
+}
 
-			// 发送一行数据
-			Serial_SendArray(g_image_line_buffer, 640);
+static void Stream_LineFinish(uint8_t *buf)
+{
+	uint32_t due;
 
-			// 计算CRC（对这一行数据）
-			for(j = 0; j < 640; j++)
-			{
-				crc_value ^= g_image_line_buffer[j];
-				for(uint8_t k = 0; k < 8; k++)
-				{
-					if(crc_value & 1)
-						crc_value = (crc_value >> 1) ^ 0xEDB88320;
-					else
-						crc_value >>= 1;
-				}
-			}
-		}
+	if(Stream_Pending)
+	{
+		Stream_Pending = 0;
+		due = Frame_PaceDue(&Stream_Pace, Stream_Row);
+		while((int32_t)(DWT_CYCCNT - due) < 0);
+		Stream_StartRow();
+	}
+	FIFO_LineFinish(buf);
+}
 
-		// 完成CRC计算
-		crc_value = ~crc_value;
+// 等待本帧写完，按实测的帧周期检查每一行开始读取时是否已经写完
+static uint8_t Stream_End(void)
+{
+	uint64_t deadline = TIMER_Deadline(CAPTURE_FRAME_MS * 1000);
+
+#if SD_USE_DMA
+	SD_IdleHook = NULL;
+#endif
+	Stream_Pending = 0;
+	while(Frame_GetState() == FRAME_WRITING && !TIMER_Expired(deadline));
+	if(Frame_GetState() != FRAME_DRAINING)
+	{
+		Stream_Underrun = 1;			// VSYNC停了，不知道写到了哪里
+		return 1;
+	}
 
-		// 发送CRC32值（4字节）
-		uint8_t crc_bytes[4];
-		crc_bytes[0] = (crc_value >> 24) & 0xFF;
-		crc_bytes[1] = (crc_value >> 16) & 0xFF;
-		crc_bytes[2] = (crc_value >> 8) & 0xFF;
-		crc_bytes[3] = crc_value & 0xFF;
-		Serial_SendArray(crc_bytes, 4);
+	Stream_Slack = Frame_PaceSlack(&Stream_Pace, Frame_GetInfo()->end);
+	if(Stream_Slack < 0)
+	{
+		Stream_Underrun = 1;
+		Stream_Underruns++;
+		return 1;
+	}
+	return 0;
+}
 
-		Serial_SendString("\r\nIMAGE_END\r\n");
+static const Capture_SourceTypeDef FIFO_StreamSource = {Stream_Begin, Stream_LineStart, Stream_LineFinish, Stream_End};
 
-		OV7670_STA = 0;
-		delay_ms(50);
+static uint32_t Capture_Cycles(void)
+{
+	return DWT_CYCCNT;
+}
+
+// 串口输出端：IMG_START头 + 图像 + CRC32(大端) + IMAGE_END
+static uint8_t UART_SinkOpen(uint8_t photo_type)
+{
+	Send_Image_Header(photo_type);
+	return 0;
+}
+
+static uint8_t UART_SinkWrite(const uint8_t *buf, uint16_t len)
+{
+	Serial_SendArray((uint8_t *)buf, len);
+	return 0;
+}
+
+// 行数据不复制，DMA发送完成后归还行缓冲区
+static uint8_t UART_SinkWriteAsync(const uint8_t *buf, uint16_t len, Capture_DoneTypeDef done)
+{
+	Serial_SendArrayAsync(buf, len, done);
+	return 0;
+}
+
+static uint8_t UART_SinkClose(uint32_t crc_value)
+{
+	uint8_t crc_bytes[4];
+
+	crc_bytes[0] = (crc_value >> 24) & 0xFF;
+	crc_bytes[1] = (crc_value >> 16) & 0xFF;
+	crc_bytes[2] = (crc_value >> 8) & 0xFF;
+	crc_bytes[3] = crc_value & 0xFF;
+	Serial_SendArray(crc_bytes, 4);
+
+	Serial_SendString("\r\nIMAGE_END\r\n");
+	return 0;
+}
+
+// 放弃本帧（边读边写时数据损坏）：此时图像数据已全部发出，PC端把随后4字节当作CRC，校验失败后丢弃本帧
+static void UART_SinkAbort(void)
+{
+	Serial_SendString("\r\nIMAGE_ABORT\r\n");
+}
+
+static const Capture_SinkTypeDef UART_Sink = {UART_SinkOpen, UART_SinkWrite, UART_SinkClose, UART_SinkAbort, UART_SinkWriteAsync};
+
+// SD卡输出端：单张照片文件（v2容器）
+// 文件已预分配连续空间时，像素数据用一条CMD25直接写入，不经过FatFs；否则逐行f_write
+static uint8_t SD_Streaming;
+static uint8_t SD_ReuseName;		// 1=沿用photo_filename（放弃后重新读出同一帧），不分配新序号
+
+static uint8_t SD_SinkOpen(uint8_t photo_type)
+{
+	if(Create_PhotoFile(photo_type) != FR_OK)
+		return 1;
+
+	switch(Storage_StreamBegin(&fil, PHOTO_HEADER_SIZE, CAPTURE_FRAME_SIZE))
+	{
+		case 0:
+			SD_Streaming = 1;
+			return 0;
+		case 1:
+			SD_Streaming = 0;		//卡上没有足够大的连续空闲区
+			return 0;
+		default:
+			SD_Streaming = 0;
+			f_close(&fil);
+			f_unlink(photo_filename);
+			return 1;
 	}
 }
 
-// 拍照函数 - 根据补光模式拍照并发送到PC
-// light_mode: 1=不补光, 2=可见光补光, 3=红外光补光
-void Capture_Photo(uint8_t light_mode)
+static uint8_t SD_SinkWrite(const uint8_t *buf, uint16_t len)
+{
+	return Write_ImageLineToSD((uint8_t *)buf, len) != FR_OK;
+}
+
+static uint8_t SD_SinkWriteAsync(const uint8_t *buf, uint16_t len, Capture_DoneTypeDef done)
 {
-	uint8_t light_on = 0;
+	if(SD_Streaming)
+		return Storage_StreamWrite(buf, len, done);
 
-	// 根据模式设置补光
-	switch(light_mode)
+	if(Write_ImageLineToSD((uint8_t *)buf, len) != FR_OK)
+		return 1;
+	done(buf);
+	return 0;
+}
+
+static uint8_t SD_SinkClose(uint32_t crc_value)
+{
+	if(SD_Streaming)
 	{
-		case 1:	// 不补光
-			GPIO_SetBits(GPIOA, GPIO_Pin_15);  // PA15=高，关闭补光
-			GPIO_SetBits(GPIOB, GPIO_Pin_3);   // PB3=高，关闭可见光
-			GPIO_SetBits(GPIOB, GPIO_Pin_4);   // PB4=高，关闭红外
-			Serial_SendString("Mode: No Light\r\n");
-			break;
+		SD_Streaming = 0;
+		if(Storage_StreamEnd() != 0)
+			return 1;				//由SD_SinkAbort关闭文件
+	}
+	return Write_ImageFooterToSD(crc_value) != FR_OK;
+}
 
-		case 2:	// 可见光补光
-			GPIO_SetBits(GPIOA, GPIO_Pin_15);  // PA15=高，关闭补光
-			GPIO_ResetBits(GPIOB, GPIO_Pin_3); // PB3=低，开启可见光
-			GPIO_SetBits(GPIOB, GPIO_Pin_4);   // PB4=高，关闭红外
-			Serial_SendString("Mode: Visible Light\r\n");
-			light_on = 1;
-			break;
+static void SD_SinkAbort(void)
+{
+	if(SD_Streaming)
+	{
+		SD_Streaming = 0;
+		Storage_StreamAbort();
+	}
+	f_close(&fil);
+	f_unlink(photo_filename);		// 不留下没有CRC的半张照片
+}
 
-		case 3:	// 红外光补光
-			GPIO_SetBits(GPIOA, GPIO_Pin_15);  // PA15=高，关闭补光
-			GPIO_SetBits(GPIOB, GPIO_Pin_3);   // PB3=高，关闭可见光
-			GPIO_ResetBits(GPIOB, GPIO_Pin_4); // PB4=低，开启红外
-			Serial_SendString("Mode: Infrared Light\r\n");
-			light_on = 1;
-			break;
+static const Capture_SinkTypeDef SD_Sink = {SD_SinkOpen, SD_SinkWrite, SD_SinkClose, SD_SinkAbort, SD_SinkWriteAsync};
+
+/*
+ * 把FIFO中已锁存的一帧输出到选定的输出端（只读取FIFO一次）
+ * 输入：photo_type (1=不补光, 2=可见光, 3=红外光), sinks (SINK_SD | SINK_UART)
+ * 返回：失败的输出端（SINK_xx位），0表示全部成功
+ * 说明：调用前帧须已锁存并进入读出（Frame_Drain返回1），或者正在写入（Frame_Stream返回1）；
+ *       边读边写时返回前等待本帧写完，读指针追上写指针时Stream_Underrun置1，所有输出端放弃本帧
+ */
+uint8_t Camera_Output(uint8_t photo_type, uint8_t sinks)
+{
+	Capture_ConfigTypeDef cfg;
+	uint8_t sink_bits[CAPTURE_MAX_SINKS];
+	uint8_t failed, result = 0;
+	uint8_t n;
+
+	// 帧还在写入时（Frame_Stream）边读边写，否则整帧已在FIFO中
+	Stream_Used = 0;
+	Stream_Underrun = 0;
+	cfg.source = Frame_GetState() == FRAME_WRITING ? &FIFO_StreamSource : &FIFO_Source;
+	cfg.line_bufs[0] = g_image_line_buffer;
+	cfg.line_bufs[1] = g_image_line_spare[0];
+	cfg.line_bufs[2] = g_image_line_spare[1];
+	cfg.line_buf_count = CAPTURE_MAX_LINE_BUFS;
+	cfg.now = Capture_Cycles;
+	cfg.stats = &g_capture_stats;
+	cfg.sink_count = 0;
+
+	// SD先打开，串口后打开：SD的提示信息在IMG_START之前，串口帧尾在SD提示信息之前
+	// 会话模式下帧追加到会话文件，不单独创建文件
+	if(sinks & SINK_SD)
+	{
+		sink_bits[cfg.sink_count] = SINK_SD;
+		cfg.sinks[cfg.sink_count++] = Session_IsOpen() ? &Session_Sink : &SD_Sink;
+	}
+	if(sinks & SINK_UART)
+	{
+		sink_bits[cfg.sink_count] = SINK_UART;
+		cfg.sinks[cfg.sink_count++] = &UART_Sink;
+	}
+
+	failed = Capture_Stream(&cfg, photo_type, NULL);
+
+	for(n = 0; n < cfg.sink_count; n++)
+	{
+		if(failed & (1u << n))
+			result |= sink_bits[n];
+	}
+
+	return result;
+}
+
+// ==================== SD卡挂载 ====================
+
+static uint8_t SD_Mounted;
+
+/*
+ * 挂载文件系统并打开照片目录文件，已挂载时直接返回
+ * 开机时在摄像头预热期间调用；失败（例如没有插卡）时在下一次用到SD卡时重试，每次约1s（SD_init超时）
+ */
+static FRESULT SD_Mount(void)
+{
+	uint32_t start;
+	FRESULT res;
+
+	if(SD_Mounted)
+		return FR_OK;
+
+	MySPI_Init();
+	start = Boot_Now();
+	res = f_mount(&fs, "", 1);
+	// SD_init在f_mount中（disk_initialize），按其耗时把两部分分开
+	Boot_Set(BOOT_SD_INIT, start, start + SD_InitTicks);
+	Boot_Set(BOOT_MOUNT, start + SD_InitTicks, Boot_Now());
+	if(res != FR_OK)
+	{
+		Serial_Printf("✗ SD mount failed (error: %d)\r\n", res);
+		return res;
+	}
+	SD_Mounted = 1;
+
+	// 照片目录文件：下一个序号和已保存照片的记录，开机不扫描目录
+	Boot_Start(BOOT_CATALOG);
+	res = Catalog_Init(&fil);
+	Boot_End(BOOT_CATALOG);
+	if(res == FR_OK)
+		Serial_Printf("✓ Catalog: %lu photos, next #%lu\r\n", (unsigned long)Catalog_Count(), (unsigned long)Catalog_NextSeq());
+	else
+		Serial_Printf("✗ Catalog unavailable (error: %d), using IMG_XXX.DAT names\r\n", res);
+	return FR_OK;
+}
+
+// 会话模式：连拍的帧追加到一个预分配的SES_XXX.DAT中
+static void SessionMode_Start(void)
+{
+	FRESULT res = SD_Mount();
+
+	if(res == FR_OK)
+		res = Session_Open(SESSION_MAX_FRAMES);
+	if(res != FR_OK)
+	{
+		UART_SendString("✗ Session open failed (error: ");
+		UART_SendNumber(res, 10);
+		UART_SendString("), saving single files\r\n");
+		return;
+	}
+	Serial_Printf("✓ Session: %s, %u frames preallocated\r\n", Session_FileName(), Session_MaxFrames());
+}
+
+// 按键4：打开/关闭会话模式
+static void SessionMode_Toggle(void)
+{
+	FRESULT res;
+
+	if(!Session_IsOpen())
+	{
+		SessionMode_Start();
+		return;
+	}
+
+	Serial_Printf("Session %s closed, %u frames", Session_FileName(), Session_FrameCount());
+	res = Session_Close();
+	if(res != FR_OK)
+	{
+		UART_SendString(" (error: ");
+		UART_SendNumber(res, 10);
+		UART_SendString(")");
+	}
+	UART_SendString("\r\n");
+}
+
+// disk_write缓存：上次报告以来的命中/未命中次数，合并写出的扇区数/次数（见user_diskio.c），由遥测任务定期输出
+// Serial_Printf的缓冲区为100字节，分两行输出
+static void SD_PrintCacheStats(void)
+{
+	USER_CacheStatsTypeDef cache;
+
+	if(!SD_Mounted || disk_ioctl(0, CTRL_CACHE_STATS, &cache) != RES_OK)
+		return;
+	if(cache.write_hits + cache.write_misses + cache.read_misses == 0)
+		return;
+	Serial_Printf("[SD] Cache write %lu/%lu, read %lu/%lu\r\n",
+		cache.write_hits, cache.write_misses, cache.read_hits, cache.read_misses);
+	Serial_Printf("[SD] Cache flush %lu sectors in %lu runs\r\n",
+		cache.flushed_sectors, cache.flushes);
+	disk_ioctl(0, CTRL_CACHE_RESET, 0);
+}
+
+// 打印刚保存的位置；会话写满后换到新的会话文件
+static void SD_PrintSaved(void)
+{
+	if(!Session_IsOpen())
+	{
+		UART_SendString("[SD] ✓ Save Complete! File: ");
+		UART_SendString(photo_filename);
+		UART_SendString("\r\n");
+		return;
+	}
+
+	Serial_Printf("[SD] ✓ Save Complete! Session: %s frame %u/%u\r\n",
+		Session_FileName(), Session_FrameCount() - 1, Session_MaxFrames());
+	if(Session_IsFull())
+	{
+		Session_Close();
+		SessionMode_Start();
 	}
+}
+
+#if BENCH_ENABLE
+// SD卡性能测试（Key5），结果为BENCH,开头的行，用bench_report.py解析
+static void Bench_PrintLine(const char *line)
+{
+	Serial_SendString((char *)line);
+	Serial_SendString("\r\n");
+}
+
+static void Bench_Start(void)
+{
+	Bench_ConfigTypeDef cfg;
+
+	cfg.now = Capture_Cycles;
+	cfg.ticks_per_us = SystemCoreClock / 1000000;
+	cfg.print = Bench_PrintLine;
+
+	Serial_SendString("\r\n=== SD Benchmark ===\r\n");
+	if(SD_Mount() == FR_OK && Bench_Run(&cfg) == FR_OK)
+		Serial_SendString("✓ Benchmark complete\r\n");
+	else
+		Serial_SendString("✗ Benchmark failed\r\n");
+}
+#endif
+
+// ==================== 任务 ====================
+
+// 任务号即优先级（0最高）：按键扫描最先；拍照任务只处理快门和帧事件，很快返回；
+// 存储任务独占FatFs（_FS_REENTRANT为0），挂载、会话、读出FIFO并保存，一次可能运行数百毫秒；遥测最低
+enum
+{
+	TASK_KEY = 0,
+	TASK_CAMERA,
+	TASK_STORAGE,
+	TASK_TELEMETRY,
+	TASK_COUNT
+};
+
+// 定时器
+enum
+{
+	TIMER_KEY = 0,			// 按键扫描，周期KEY_SCAN_MS
+	TIMER_FRAME,			// 按下快门后等待帧的超时
+	TIMER_TELEMETRY			// 调度统计输出
+};
+
+// 事件
+#define KEY_EV_SCAN			0
+#define CAMERA_EV_SHUTTER	0		// arg=补光模式，param=输出端
+#define CAMERA_EV_FRAME		1		// 帧状态机事件（VSYNC中断投递），arg=Frame_EventTypeDef
+#define CAMERA_EV_TIMEOUT	2
+#define CAMERA_EV_DONE		3		// 存储任务已输出这一帧
+#define STORAGE_EV_MOUNT	0
+#define STORAGE_EV_OUTPUT	1		// 读出FIFO中的帧，arg=补光模式，param=输出端
+#define STORAGE_EV_SESSION	2		// 打开/关闭会话模式
+#define STORAGE_EV_BENCH	3
+#define TELEMETRY_EV_REPORT	0
+
+#define TELEMETRY_PERIOD_MS	10000	// 调度统计和SD卡写缓存统计的输出间隔（有活动时才输出）
+
+static void Boot_PrintLine(const char *line);
+
+static uint32_t Sched_Ms(uint32_t ms)
+{
+	return ms * (SystemCoreClock / 1000);
+}
+
+// DWT周期换算为微秒（打印用）
+static unsigned long Cycles_Us(uint32_t cycles)
+{
+	return cycles / (SystemCoreClock / 1000000);
+}
+
+static long Cycles_SignedUs(int32_t cycles)
+{
+	return (long)cycles / (long)(SystemCoreClock / 1000000);
+}
 
-	// 等待补光稳定（如果需要补光）
-	if(light_on)
+// 发送图像到PC - 增强版（带CRC校验）
+// photo_type: 1=不补光, 2=可见光, 3=红外光
+void Camera_SendToPC(uint8_t photo_type)
+{
+	if(Frame_Drain())
 	{
-		delay_ms(200);
+		Camera_Output(photo_type, SINK_UART);
+
+		Frame_Release(0);
+		delay_ms(50);
 	}
+}
 
-	// 通过串口显示拍照状态
+// 各补光模式的传感器配置（按键1~3），拍照前在VSYNC消隐期间切换，只写入变化的寄存器
+// {白平衡, 色度, 亮度, 对比度, 特效, 窗口, 增益上限, 曝光目标上限, 下限, 帧率x10（0=时钟允许的最高帧率）}
+static const OV7670_ProfileTypeDef Capture_Profiles[3] =
+{
+	// 不补光：与开机配置（OV7670_DefaultConfig）相同
+	{"No Light",       {0, 3, 2, 4, 0, OV7670_QVGA_WINDOW, 2, 0x75, 0x63, 0}},
+	// 可见光补光：近处被照亮，降低曝光目标和增益上限，避免过曝和噪点
+	{"Visible Light",  {0, 3, 2, 4, 0, OV7670_QVGA_WINDOW, 1, 0x60, 0x50, 0}},
+	// 红外补光：只有亮度信息，固定白平衡增益（自动白平衡在红外下漂移），黑白输出，
+	// 增益上限提高到32x；帧率降到5fps（插入dummy行），曝光时间上限加倍，同样亮度下增益和噪点更低
+	{"Infrared Light", {1, 0, 2, 4, 2, OV7670_QVGA_WINDOW, 4, 0x75, 0x63, 50}},
+};
+static uint8_t Capture_LastMode = 1;	// 当前的补光模式，开机时补光关闭
+
+// 拍照任务的状态：一次只拍一张，进行中按下的快门记下最后一次，完成后再拍
+static uint8_t Camera_Mode;				// 进行中的补光模式，0为空闲
+static uint8_t Camera_Sinks;
+static uint8_t Camera_Handed;			// 帧已交给存储任务
+static uint8_t Camera_NextMode;			// 进行中按下的快门
+static uint8_t Camera_NextSinks;
+
+// 按下快门 - 先切换补光，再锁存一帧（拍照任务）
+// light_mode: 1=不补光, 2=可见光补光, 3=红外光补光
+// sinks: SINK_SD | SINK_UART
+static void Capture_Shutter(uint8_t light_mode, uint8_t sinks)
+{
+	const OV7670_ProfileTypeDef *profile = &Capture_Profiles[light_mode - 1];
+
+	// 根据模式设置补光，传感器配置在下一个VSYNC之后的帧事件中切换
+	// 补光改变时多舍弃一帧：VSYNC之后第一帧开头几行的曝光在补光切换之前就开始了
+	LED_SetFillLight(light_mode);
+	OV7670_RequestConfig(&profile->cfg, light_mode != Capture_LastMode);
+	Capture_LastMode = light_mode;
+
+	// 中断在配置生效后的第一帧开始写入FIFO；等待配置时、开始写入（边读边写）或写完时投递帧事件
+	Frame_Arm(DWT_CYCCNT);
+	Camera_Mode = light_mode;
+	Camera_Sinks = sinks;
+	Camera_Handed = 0;
+	Sched_TimerStart(TIMER_FRAME, TASK_CAMERA, CAMERA_EV_TIMEOUT, Sched_Ms(CAPTURE_FRAME_MS), 0);
+	Serial_Printf("Mode: %s\r\n", profile->name);
 	Serial_SendString("Capturing...\r\n");
 
-	// 舍弃当前FIFO中的图像，等待下一张
-	if(OV7670_STA == 2)
+	// 开机时没有挂载成功（例如后插入的卡）时由存储任务重试，与曝光和写入FIFO同时进行
+	if(sinks & SINK_SD)
+		Sched_Post(TASK_STORAGE, STORAGE_EV_MOUNT, 0, 0);
+}
+
+// 帧可以读出（边读边写时开始写入即可）时交给存储任务，一次读出同时保存到SD卡并发送到PC
+static void Capture_FrameEvent(void)
+{
+	if(!Camera_Mode || Camera_Handed)
+		return;
+	if(!(CAPTURE_STREAM ? Frame_Stream() : Frame_Drain()))
+		return;
+	Sched_TimerStop(TIMER_FRAME);
+	Camera_Handed = 1;
+	Sched_Post(TASK_STORAGE, STORAGE_EV_OUTPUT, Camera_Mode, Camera_Sinks);
+}
+
+// 本次拍照结束，有进行中按下的快门时接着拍
+static void Capture_Finish(void)
+{
+	Camera_Mode = 0;
+	if(Camera_NextMode)
 	{
-		// 当前有图像，清零等待下一张
-		OV7670_STA = 0;
+		Capture_Shutter(Camera_NextMode, Camera_NextSinks);
+		Camera_NextMode = 0;
 	}
+}
 
-	// 等待新的下一帧图像
-	while(OV7670_STA != 2)
+// VSYNC中断中调用：帧状态变化投递给拍照任务
+static void Capture_PostFrameEvent(Frame_EventTypeDef ev, const Frame_InfoTypeDef *info)
+{
+	(void)info;
+	Sched_Post(TASK_CAMERA, CAMERA_EV_FRAME, (uint8_t)ev, 0);
+}
+
+// 读出FIFO中的帧并输出（存储任务），结束后通知拍照任务
+static void Capture_Save(uint8_t light_mode, uint8_t sinks)
+{
+	const Frame_InfoTypeDef *info = Frame_GetInfo();
+	uint32_t done;
+	uint8_t failed;
+
+	// 挂载失败时只发送到PC
+	if(!SD_Mounted)
+		sinks &= ~SINK_SD;
+
+	// 一次读出，同时输出到所有选定的输出端
+	failed = Camera_Output(light_mode, sinks);
+	if(Stream_Underrun)
 	{
-		delay_ms(10);
+		if(Frame_GetState() != FRAME_DRAINING)
+		{
+			Serial_SendString("✗ Frame lost while streaming\r\n");
+			Frame_Release(0);
+			Sched_Post(TASK_CAMERA, CAMERA_EV_DONE, 0, 0);
+			return;
+		}
+		// 读出跟得太紧，此时整帧已写完，从头再读一次
+		Serial_Printf("✗ Stream underrun (slack %ld us), re-reading frame\r\n", Cycles_SignedUs(Stream_Slack));
+		SD_ReuseName = 1;
+		failed = Camera_Output(light_mode, sinks);
+		SD_ReuseName = 0;
 	}
+	done = DWT_CYCCNT;
 
-	// 发送到PC（传入照片类型）
-	Camera_SendToPC(light_mode);
+	Frame_Release(0);
+	Sched_Post(TASK_CAMERA, CAMERA_EV_DONE, 0, 0);
 
-	// 关闭所有补光
-//	GPIO_SetBits(GPIOA, GPIO_Pin_15);  // PA15=高
-//	GPIO_SetBits(GPIOB, GPIO_Pin_3);   // PB3=高
-//	GPIO_SetBits(GPIOB, GPIO_Pin_4);   // PB4=高
+	if(failed & SINK_SD)
+	{
+		UART_SendString("✗ SD save failed!\r\n");
+	}
+	else if(sinks & SINK_SD)
+	{
+		SD_PrintSaved();
+	}
 
 	// 通过串口显示完成状态
 	Serial_SendString("Capture Complete!\r\n");
+	Serial_Printf("Shutter: lag %lu us, frame at VSYNC %lu\r\n",
+		Cycles_Us(info->start - info->armed), (unsigned long)info->vsync);
+	Serial_Printf("Profile: applied at VSYNC %lu in %lu us\r\n",
+		(unsigned long)OV7670_ConfigFrame, Cycles_Us(OV7670_ConfigCycles));
+	Serial_Printf("FIFO read: %lu cycles/line (max %lu), sensor %lu cycles/line\r\n",
+		(unsigned long)FIFO_LineCycles, (unsigned long)FIFO_LineCyclesMax, (unsigned long)OV7670_LineCycles());
+	Serial_Printf("Frame: %lu us (nominal %lu us)\r\n",
+		Cycles_Us(OV7670_VsyncPeriod), Cycles_Us(OV7670_FrameCycles()));
+	// VSYNC到最后一个字节送出：边读边写时约为一帧时间，否则为一帧时间加整帧读出时间
+	Serial_Printf("Latency: %lu us from VSYNC, %s\r\n",
+		Cycles_Us(done - info->start), Stream_Used ? "streamed" : "after frame");
+	if(Stream_Used)
+		Serial_Printf("Stream: slack %ld us, underruns %lu\r\n",
+			Cycles_SignedUs(Stream_Slack), (unsigned long)Stream_Underruns);
+	// 各级耗时：输出端在stats.sink[]中的顺序与Camera_Output中的打开顺序一致（SD在前）
+	Serial_Printf("Pipeline(us): total %lu, source %lu, crc %lu, buf wait %lu\r\n",
+		Cycles_Us(g_capture_stats.total), Cycles_Us(g_capture_stats.source),
+		Cycles_Us(g_capture_stats.crc), Cycles_Us(g_capture_stats.buf_wait));
+	if(sinks & SINK_SD)
+		Serial_Printf("  sd write %lu\r\n", Cycles_Us(g_capture_stats.sink[0]));
+	if(sinks & SINK_UART)
+		Serial_Printf("  uart queue %lu\r\n", Cycles_Us(g_capture_stats.sink[(sinks & SINK_SD) ? 1 : 0]));
+}
+
+// 按键任务：每KEY_SCAN_MS扫描一次，按下即投递，不等待松手
+// 按键1：不补光拍照,PA8,PA15
+// 按键2：可见光补光拍照,PC14,PB3
+// 按键3：红外光补光拍照,PC15,PB4
+static void Key_Task(const Sched_EventTypeDef *ev)
+{
+	uint8_t key = Key_Scan();
 
-	// 短暂显示结果
-	delay_ms(1000);
+	(void)ev;
+	if(key >= 1 && key <= 3)
+	{
+		// 同一次曝光保存到SD卡并发送到PC
+		Sched_Post(TASK_CAMERA, CAMERA_EV_SHUTTER, key, SINK_SD | SINK_UART);
+	}
+	else if(key == 4)
+	{
+		Sched_Post(TASK_STORAGE, STORAGE_EV_SESSION, 0, 0);
+	}
+#if BENCH_ENABLE
+	else if(key == 5)
+	{
+		Sched_Post(TASK_STORAGE, STORAGE_EV_BENCH, 0, 0);
+	}
+#endif
 }
 
+// 拍照任务：快门、帧事件和超时
+static void Camera_Task(const Sched_EventTypeDef *ev)
+{
+	switch(ev->sig)
+	{
+		case CAMERA_EV_SHUTTER:
+			if(Camera_Mode)
+			{
+				Camera_NextMode = ev->arg;		// 进行中，完成后再拍
+				Camera_NextSinks = (uint8_t)ev->param;
+				break;
+			}
+			Capture_Shutter(ev->arg, (uint8_t)ev->param);
+			break;
+		case CAMERA_EV_FRAME:
+			OV7670_ConfigService();			// VSYNC之后写入待切换的传感器配置（中断中不访问SCCB）
+			Capture_FrameEvent();
+			break;
+		case CAMERA_EV_TIMEOUT:
+			// 快门仍有效，之后锁存的帧留到下次按下快门时舍弃
+			if(Camera_Mode && !Camera_Handed)
+			{
+				Serial_SendString("✗ No frame from camera\r\n");
+				Capture_Finish();
+			}
+			break;
+		case CAMERA_EV_DONE:
+			Capture_Finish();
+			break;
+	}
+}
+
+// 存储任务：所有FatFs操作都在这里，其他任务投递事件
+static void Storage_Task(const Sched_EventTypeDef *ev)
+{
+	switch(ev->sig)
+	{
+		case STORAGE_EV_MOUNT:
+			SD_Mount();
+			break;
+		case STORAGE_EV_OUTPUT:
+			Capture_Save(ev->arg, (uint8_t)ev->param);
+			break;
+		case STORAGE_EV_SESSION:
+			SessionMode_Toggle();
+			break;
+#if BENCH_ENABLE
+		case STORAGE_EV_BENCH:
+			Bench_Start();
+			break;
+#endif
+	}
+}
+
+// 遥测任务：有拍照或存储活动时输出调度统计，格式见sched.h
+static void Telemetry_Task(const Sched_EventTypeDef *ev)
+{
+	(void)ev;
+	if(Sched_GetStats(TASK_CAMERA)->runs || Sched_GetStats(TASK_STORAGE)->runs)
+		Sched_Report(Boot_PrintLine);
+	SD_PrintCacheStats();
+}
+
+static const Sched_TaskTypeDef App_Tasks[TASK_COUNT] =
+{
+	{"key",       Key_Task},
+	{"camera",    Camera_Task},
+	{"storage",   Storage_Task},
+	{"telemetry", Telemetry_Task},
+};
+static Sched_ConfigTypeDef App_Sched;
+
 // ==================== 阶段1&2新增：SD卡照片存储函数 ====================
 
 /*
  * 生成照片文件名
- * 格式：IMG_XXX.DAT (XXX = 001, 002, 003...)
+ * 格式：Pddd/IMGnnnnn.DAT，序号由目录文件PHOTO.IDX分配，重启后继续递增
+ *       目录文件不可用时为IMG_XXX.DAT (XXX = 类型*100 + 本次上电的计数)
  * 输入：photo_type (1=不补光, 2=可见光, 3=红外光)
  * 输出：filename (生成的文件名字符串)
  */
 void Generate_PhotoFilename(char* filename, uint8_t photo_type)
 {
+	if(Catalog_IsReady() && Catalog_NextPath(filename) == FR_OK)
+		return;
+
 	photo_counter++;  // 计数器递增，确保文件名唯一
 	sprintf(filename, "IMG_%03d.DAT", photo_type * 100 + photo_counter);
 }
 
 /*
- * 创建照片文件并写入协议头
+ * 创建照片文件并写入v2头部（512字节，像素从第1个扇区开始）
  * 输入：photo_type (1=不补光, 2=可见光, 3=红外光)
  * 返回：FR_OK 表示成功，其他表示失败
  */
 FRESULT Create_PhotoFile(uint8_t photo_type)
 {
 	FRESULT res;
-	char header[50];
 
-	// 生成唯一文件名
-	Generate_PhotoFilename(photo_filename, photo_type);
+	// 生成唯一文件名；重新读出同一帧时沿用放弃的文件名（目录文件的序号已分配，尚未登记）
+	if(!SD_ReuseName)
+		Generate_PhotoFilename(photo_filename, photo_type);
 
-	// 创建/覆盖文件
-	res = f_open(&fil, photo_filename, FA_CREATE_ALWAYS | FA_WRITE);
+	// 创建/覆盖文件，写入头部（CRC在关闭时回写）
+	Photo_HeaderInit(&photo_header, photo_type);
+	res = Photo_Create(&fil, photo_filename, &photo_header);
 	if(res != FR_OK)
 	{
 		UART_SendString("✗ File create failed: ");
@@ -628,16 +1199,6 @@ FRESULT Create_PhotoFile(uint8_t photo_type)
 		return res;
 	}
 
-	// 写入协议头：IMG_START,320,240,16,type,1\r\n
-	// 长度：26字节 (24字符 + \r\n)
-	sprintf(header, "IMG_START,320,240,16,%d,1\r\n", photo_type);
-	res = f_write(&fil, header, strlen(header), &bw);
-	if(res != FR_OK)
-	{
-		f_close(&fil);
-		return res;
-	}
-
 	UART_SendString("✓ SD File Created: ");
 	UART_SendString(photo_filename);
 	UART_SendString(" (Header written)\r\n");
@@ -656,45 +1217,54 @@ FRESULT Write_ImageLineToSD(uint8_t* line_data, uint16_t length)
 }
 
 /*
- * 写入CRC32和帧尾到SD卡，并关闭文件
+ * 把CRC32和耗时回写到头部，并关闭文件
  * 输入：crc_value (CRC32校验值)
  * 返回：FR_OK 表示成功
  */
 FRESULT Write_ImageFooterToSD(uint32_t crc_value)
 {
-	uint8_t crc_bytes[4];
-	const char* frame_end = "\r\nIMAGE_END\r\n";
-
-	// 写入CRC32（4字节）
-	crc_bytes[0] = (crc_value >> 24) & 0xFF;
-	crc_bytes[1] = (crc_value >> 16) & 0xFF;
-	crc_bytes[2] = (crc_value >> 8) & 0xFF;
-	crc_bytes[3] = crc_value & 0xFF;
-	f_write(&fil, crc_bytes, 4, &bw);
+	FRESULT res;
 
-	// 写入帧尾
-	f_write(&fil, frame_end, strlen(frame_end), &bw);
+	res = Photo_Finish(&fil, &photo_header, crc_value);
+	if(res != FR_OK)
+	{
+		UART_SendString("✗ Header update failed (error: ");
+		UART_SendNumber(res, 10);
+		UART_SendString(")\r\n");
+		return res;
+	}
 
-	// 关闭文件
-	f_close(&fil);
+	UART_SendString("✓ CRC written to header, file closed\r\n");
 
-	UART_SendString("✓ CRC and Frame End written, file closed\r\n");
+	// 登记到目录文件（失败不影响已保存的照片）
+	if(Catalog_IsReady() && Catalog_Add(photo_header.light_mode, PHOTO_HEADER_SIZE + photo_header.data_size, crc_value) != FR_OK)
+		UART_SendString("⚠ Catalog update failed\r\n");
 
 	return FR_OK;
 }
 
+// 回放输出端：串口DMA直接发送读缓冲区，发送完成后归还
+static uint8_t UART_ReplayWriteAsync(const uint8_t *buf, uint16_t len, Replay_DoneTypeDef done)
+{
+	Serial_SendArrayAsync(buf, len, done);
+	return 0;
+}
+
 /*
  * 从SD卡读取文件并发送到PC
  * 输入：filename (要读取的文件名)
  * 返回：FR_OK 表示成功
+ * 说明：v1文件与串口协议相同，原样发送；v2文件发送IMG_START头 + 像素 + 头部中的CRC + IMAGE_END。
+ *       像素整扇区读入两个行缓冲区轮流发送，速度只受串口波特率限制
  */
 FRESULT ReadAndSendToPC(char* filename)
 {
+	Replay_ConfigTypeDef cfg;
+	Photo_HeaderTypeDef hdr;
 	FRESULT res;
-	uint8_t read_buf[640];
-	UINT br;
+	uint32_t sent;
+	uint8_t version;
 
-	// 打开文件
 	res = f_open(&fil, filename, FA_READ);
 	if(res != FR_OK)
 	{
@@ -705,156 +1275,71 @@ FRESULT ReadAndSendToPC(char* filename)
 		UART_SendString(")\r\n");
 		return res;
 	}
+	version = Photo_ReadHeader(&fil, &hdr);
+	f_close(&fil);
 
 	UART_SendString("✓ Reading from SD: ");
 	UART_SendString(filename);
-	UART_SendString("\r\n");
+	UART_SendString(version == 2 ? " (v2)\r\n" : " (v1)\r\n");
 
-	// 循环读取并发送（每次最多640字节）
-	while(1)
-	{
-		res = f_read(&fil, read_buf, sizeof(read_buf), &br);
-		if(res != FR_OK)
-		{
-			UART_SendString("✗ Read error\r\n");
-			f_close(&fil);
-			return res;
-		}
+	cfg.write_async = UART_ReplayWriteAsync;
+	cfg.bufs[0] = g_image_line_buffer;
+	cfg.bufs[1] = g_image_line_spare[0];
+	cfg.buf_size = 512;					//行缓冲区640字节，每次读1个扇区
+	cfg.offset = 0;
 
-		if(br == 0) break;  // 文件结束
+	if(version == 2)
+	{
+		if(!(hdr.flags & PHOTO_FLAG_COMPLETE))
+			UART_SendString("⚠ File was not closed, CRC invalid\r\n");
+		Send_Image_Header(hdr.light_mode);
+		cfg.offset = hdr.header_size;
+	}
 
-		// 发送到PC
-		Serial_SendArray(read_buf, br);
+	res = Replay_File(&cfg, filename, &sent);
+	if(res != FR_OK)
+	{
+		UART_SendString("✗ Read error (error: ");
+		UART_SendNumber(res, 10);
+		UART_SendString(", sent: ");
+		UART_SendNumber(sent, 6);
+		UART_SendString(")\r\n");
+		return res;
 	}
 
-	f_close(&fil);
+	if(version == 2)
+		UART_SinkClose(hdr.crc32);		//CRC(大端) + IMAGE_END，与实时发送相同
+
 	UART_SendString("✓ File read complete, sent to PC\r\n");
 
 	return FR_OK;
 }
 
 /*
- * 拍照并保存到SD卡（核心函数）
+ * 拍照并保存到SD卡
  * 输入：photo_type (1=不补光, 2=可见光, 3=红外光)
  * 功能：读取摄像头数据，计算CRC，保存到SD卡
  */
 void Camera_SaveToSD(uint8_t photo_type)
 {
-	uint32_t i, j;
-	uint16_t color;
-	uint16_t colorL, colorH;
-	uint32_t crc_value = 0;
-	FRESULT res;
-
-	if(OV7670_STA == 2)
+	if(Frame_Drain())
 	{
-		// 第1步：创建文件并写入协议头
-		UART_SendString("\r\n[SD] Creating file...\r\n");
-		res = Create_PhotoFile(photo_type);
-		if(res != FR_OK)
-		{
-			UART_SendString("✗ File creation failed!\r\n");
-			return;
-		}
+		UART_SendString("\r\n[SD] Capturing to SD...\r\n");
 
-		// 第2步：复位FIFO读指针（同原Camera_SendToPC）
-		FIFO_RRST = 0;
-		delay_us(1);
-		FIFO_RCLK = 0;
-		delay_us(1);
-		FIFO_RCLK = 1;
-		delay_us(1);
-		FIFO_RCLK = 0;
-		delay_us(1);
-		FIFO_RRST = 1;
-		delay_us(1);
-		FIFO_RCLK = 1;
-		delay_us(1);
-
-		// 初始化CRC
-		crc_value = 0xFFFFFFFF;
-
-		UART_SendString("[SD] Capturing to SD...\r\n");
-
-		// 第3步：逐行读取并写入SD卡，同时计算CRC
-		for(i = 0; i < 240; i++)  // 240行
+		if(Camera_Output(photo_type, SINK_SD) != 0)
 		{
-			delay_us(2);
-
-			// 读取一行320像素（640字节）
-			for(j = 0; j < 320; j++)
-			{
-				FIFO_RCLK = 0;
-				delay_us(1);
-				colorH = OV7670_RedData();
-
-				FIFO_RCLK = 1;
-				delay_us(1);
-				FIFO_RCLK = 0;
-				delay_us(1);
-				colorL = OV7670_RedData();
-
-				colorL >>= 8;
-				color = colorH | colorL;
-				FIFO_RCLK = 1;
-
-				g_image_line_buffer[j * 2] = (color >> 8) & 0xFF;
-				g_image_line_buffer[j * 2 + 1] = color & 0xFF;
-			}
-
-			// 写入一行数据到SD卡
-			res = Write_ImageLineToSD(g_image_line_buffer, 640);
-			if(res != FR_OK)
-			{
-				UART_SendString("✗ Write error at line ");
-				UART_SendNumber(i, 10);
-				UART_SendString("\r\n");
-				f_close(&fil);
-				return;
-			}
-
-			// 计算CRC（对这一行数据）
-			for(j = 0; j < 640; j++)
-			{
-				crc_value ^= g_image_line_buffer[j];
-				for(uint8_t k = 0; k < 8; k++)
-				{
-					if(crc_value & 1)
-						crc_value = (crc_value >> 1) ^ 0xEDB88320;
-					else
-						crc_value >>= 1;
-				}
-			}
-
-			// 每50行显示进度
-			if(i % 50 == 0 && i > 0)
-			{
-				UART_SendString("  Progress: ");
-				UART_SendNumber(i, 10);
-				UART_SendString("/240 lines (");
-				UART_SendNumber((i * 640) / 1536, 10);
-				UART_SendString("%)\r\n");
-			}
-		}
-
-		// 第4步：完成CRC计算
-		crc_value = ~crc_value;
-
-		// 第5步：写入CRC和帧尾，并关闭文件
-		res = Write_ImageFooterToSD(crc_value);
-		if(res != FR_OK)
-		{
-			UART_SendString("✗ Footer write failed!\r\n");
+			UART_SendString("✗ SD save failed!\r\n");
+			Frame_Release(1);		// 帧仍在FIFO中，可以重试
 			return;
 		}
 
-		OV7670_STA = 0;
+		Frame_Release(0);
 		delay_ms(50);
 
-		UART_SendString("\r\n[SD] ✓ Save Complete! File: ");
-		UART_SendString(photo_filename);
-		UART_SendString("\r\n[SD] Total bytes: ");
-		UART_SendNumber(153600 + 4 + 14, 10);  // 图像+CRC+帧尾
+		UART_SendString("\r\n");
+		SD_PrintSaved();
+		UART_SendString("[SD] Total bytes: ");
+		UART_SendNumber(PHOTO_HEADER_SIZE + CAPTURE_FRAME_SIZE, 10);  // 头部+图像
 		UART_SendString("\r\n");
 	}
 }
@@ -889,8 +1374,8 @@ void Test_SD_PhotoStorage(void)
 	}
 	UART_SendString("  ✓ 写入10行测试数据\r\n");
 
-	// 测试3：写入CRC和帧尾
-	UART_SendString("测试3：写入CRC和帧尾\r\n");
+	// 测试3：回写CRC到头部
+	UART_SendString("测试3：回写CRC到头部\r\n");
 	uint32_t test_crc = 0x12345678;  // 测试CRC值
 	Write_ImageFooterToSD(test_crc);
 
@@ -915,7 +1400,8 @@ void Test_SD_PhotoStorage(void)
 		UART_SendNumber(fno.fsize, 10);
 		UART_SendString(" bytes\r\n");
 
-		if(fno.fsize == (10 * 640 + 4 + 14))
+		// 预分配了连续空间时文件长度为整帧，否则为实际写入的10行
+		if(fno.fsize == (PHOTO_HEADER_SIZE + CAPTURE_FRAME_SIZE) || fno.fsize == (PHOTO_HEADER_SIZE + 10 * 640))
 		{
 			UART_SendString("  ✓ 文件大小正确！\r\n");
 		}
@@ -935,16 +1421,22 @@ void Test_SD_PhotoStorage(void)
 void Test_FullCaptureFlow(void)
 {
 	FRESULT res;
+	uint64_t deadline;
 
 	UART_SendString("\r\n=== 完整拍照流程测试 ===\r\n");
 
-	// 检查摄像头状态
-	if(OV7670_STA != 2)
+	// 检查摄像头状态：没有已锁存的帧时按下快门，等待锁存
+	if(Frame_GetState() != FRAME_READY)
 	{
 		UART_SendString("⚠ 等待摄像头数据...\r\n");
-		while(OV7670_STA != 2)
+		if(Frame_GetState() == FRAME_IDLE)
+			Frame_Arm(DWT_CYCCNT);
+		deadline = TIMER_Deadline(CAPTURE_FRAME_MS * 1000);
+		while(Frame_GetState() != FRAME_READY && !TIMER_Expired(deadline));
+		if(Frame_GetState() != FRAME_READY)
 		{
-			delay_ms(10);
+			UART_SendString("✗ 等待摄像头数据超时\r\n");
+			return;
 		}
 	}
 
@@ -995,18 +1487,17 @@ void Test_FullCaptureFlow(void)
 
 // ==================== 主函数 ====================
 
-int main(void)
+// 启动各阶段耗时输出，格式见boot.h
+static void Boot_PrintLine(const char *line)
 {
-	/* 模块初始化 */
-	RCC_Configuration();			// 时钟设置
-	Serial_Init();					// 串口初始化（921600波特率）
-
-	/* 打印启动信息 */
-	Serial_SendString("\r\n=== STM32F103 Combined Project ===\r\n");
-	Serial_SendString("Phase 1: SD Card Test\r\n");
-	Serial_SendString("Phase 2: OV7670 Camera\r\n");
-	Serial_SendString("Baud Rate: 921600\r\n\r\n");
+	Serial_SendString((char *)line);
+	Serial_SendString("\r\n");
+}
 
+#if BOOT_SELFTEST
+// 开机自检：SPI/SD卡驱动/FATFS测试和照片存储测试，结果通过串口查看
+static void Boot_SelfTest(void)
+{
 	// ==================== 第一阶段：SD卡测试 ====================
 
 	Serial_SendString("\r\n========== PHASE 1: SD CARD TEST ==========\r\n");
@@ -1026,6 +1517,9 @@ int main(void)
 	// FATFS文件系统测试
 	Test_FATFS();
 
+	// 重新挂载并打开照片目录文件
+	SD_Mount();
+
 	// ==================== 阶段1&2新增：SD卡照片存储功能测试 ====================
 
 	Serial_SendString("\r\n========== 阶段1&2新增：SD卡照片存储测试 ==========\r\n");
@@ -1036,57 +1530,92 @@ int main(void)
 	// 等待用户查看测试结果
 	delay_ms(2000);
 
-	// ==================== 第二阶段：OV7670拍照 ====================
-
 	Serial_SendString("\r\n========== PHASE 2: OV7670 CAMERA ==========\r\n");
+}
+#endif
+
+int main(void)
+{
+	uint64_t deadline;
+	uint32_t vsync_start;
+
+	/* 模块初始化 */
+	Boot_Init();
+	Boot_Start(BOOT_CLOCK);
+	RCC_Configuration();			// 时钟设置
+	Boot_End(BOOT_CLOCK);
+	TIMER_Init();					// 时间基准，之后各驱动的超时才会走
+	Boot_Start(BOOT_UART);
+	Serial_Init();					// 串口初始化（921600波特率）
+	Boot_End(BOOT_UART);
+
+	/* 打印启动信息 */
+	Serial_SendString("\r\n=== STM32F103 Combined Project ===\r\n");
+#if BOOT_SELFTEST
+	Serial_SendString("Phase 1: SD Card Test\r\n");
+	Serial_SendString("Phase 2: OV7670 Camera\r\n");
+#endif
+	Serial_SendString("Baud Rate: 921600\r\n\r\n");
+
+#if BOOT_SELFTEST
+	Boot_SelfTest();
+#endif
 
 	// OV7670相关初始化
+	Boot_Start(BOOT_SCCB);
 	OV7670_Init();										// 摄像头初始化
-	mEXTI_Init();										// 外部中断初始化
-	TIMER_Init();										// 定时器初始化
+	Boot_End(BOOT_SCCB);
+	vsync_start = Boot_Now();
+	mEXTI_Init(Capture_PostFrameEvent);					// 外部中断初始化，帧事件在Sched_Init之后才投递
+	Frame_Arm(vsync_start);								// 锁存第一帧，用于记录VSYNC和预热耗时
 	LED_Init();
 	Key_Init();
 
+	// 摄像头预热期间挂载SD卡；没有插卡时在第一次拍照时重试
+	SD_Mount();
+
+	// 等待摄像头稳定：舍弃最初的几帧（代替固定延时）
+	deadline = TIMER_Deadline(BOOT_WARMUP_MS * 1000);
+	while(OV7670_FrameCount < BOOT_WARMUP_FRAMES && !TIMER_Expired(deadline));
+	if(Frame_GetState() == FRAME_READY)
+	{
+		// 第一个VSYNC开始写入，第二个VSYNC（第一帧写完）锁存；预热帧不使用
+		Boot_Set(BOOT_VSYNC, vsync_start, Frame_GetInfo()->start);
+		Boot_Set(BOOT_WARMUP, Frame_GetInfo()->start, Frame_GetInfo()->end);
+		Frame_Release(0);
+	}
+	else if(OV7670_FrameCount == 0)
+	{
+		Serial_SendString("✗ No VSYNC from camera\r\n");
+	}
+	Boot_Report(Boot_Now(), Boot_PrintLine);
+	// 寄存器表写入：次数、重试、耗时；有失败时打印最后一个失败的寄存器
+	Serial_Printf("SCCB: %u regs in %lu us, %u retries, %u failed\r\n",
+		OV7670_SccbStats.writes, Cycles_Us(OV7670_SccbStats.cycles),
+		OV7670_SccbStats.retries, OV7670_SccbStats.failed);
+	if(OV7670_SccbStats.failed)
+		Serial_Printf("✗ SCCB reg 0x%02X not written (nack %u, mismatch %u)\r\n",
+			OV7670_SccbStats.last_failed, OV7670_SccbStats.nacks, OV7670_SccbStats.mismatches);
+	// 传感器时钟和帧周期：标称值按时钟计算，实测值为预热期间两次VSYNC的间隔
+	Serial_Printf("Clock: %lu Hz, max %u.%u fps, frame %lu us (measured %lu us)\r\n",
+		(unsigned long)OV7670_IntClockHz(&OV7670_Clock), OV7670_MaxFps() / 10, OV7670_MaxFps() % 10,
+		Cycles_Us(OV7670_FrameCycles()), Cycles_Us(OV7670_VsyncPeriod));
+
 	Serial_SendString("\r\n=== OV7670 Camera System ===\r\n");
 	Serial_SendString("Multi-Type Capture Mode\r\n");
 	Serial_SendString("Resolution: 320x240 RGB565\r\n");
-	Serial_SendString("Key1: No Light | Key2: Visible | Key3: Infrared\r\n");
+	Serial_SendString("Key1: No Light | Key2: Visible | Key3: Infrared | Key4: Session on/off\r\n");
 	Serial_SendString("Protocol: IMG_START,width,height,bpp,type,crc\r\n\r\n");
 
-	// 等待摄像头稳定
-	delay_ms(1000);
-
-	// ==================== 主循环：拍照功能 ====================
-
-	while(1)
-	{
-		KeyNum = Key_GetNum();		//获取按键键码（阻塞式，等待按键）
-
-		// 根据按键值执行不同的拍照模式
-		if(KeyNum == 1)
-		{
-			// 按键1：不补光拍照,PA8,PA15
-			// 保存到SD卡
-			Camera_SaveToSD(1);
-			// 发送到PC
-			Capture_Photo(1);
-		}
-		else if(KeyNum == 2)
-		{
-			// 按键2：可见光补光拍照,PC14,PB3
-			// 保存到SD卡
-			Camera_SaveToSD(2);
-			// 发送到PC
-			Capture_Photo(2);
-		}
-		else if(KeyNum == 3)
-		{
-			// 按键3：红外光补光拍照,PC15,PB4
-			// 保存到SD卡
-			Camera_SaveToSD(3);
-			// 发送到PC
-			Capture_Photo(3);
-		}
-		// KeyNum == 0 时不做任何操作，继续等待按键
-	}
+	// ==================== 主循环：任务调度 ====================
+
+	App_Sched.tasks = App_Tasks;
+	App_Sched.task_count = TASK_COUNT;
+	App_Sched.now = Capture_Cycles;
+	App_Sched.ticks_per_us = SystemCoreClock / 1000000;
+	App_Sched.idle = NULL;
+	Sched_Init(&App_Sched);
+	Sched_TimerStart(TIMER_KEY, TASK_KEY, KEY_EV_SCAN, Sched_Ms(KEY_SCAN_MS), Sched_Ms(KEY_SCAN_MS));
+	Sched_TimerStart(TIMER_TELEMETRY, TASK_TELEMETRY, TELEMETRY_EV_REPORT, Sched_Ms(TELEMETRY_PERIOD_MS), Sched_Ms(TELEMETRY_PERIOD_MS));
+	Sched_Run();
 }
@@ -0,0 +1,135 @@
+#include "photo.h"
+#include "capture.h"
+#include "storage.h"
+#include "OV7670.h"
+#include "frame.h"
+#include "SCCB.h"
+#include "FIFO.h"
+#include "sys.h"
+#include <stdio.h>
+#include <string.h>
+
+typedef char Photo_HeaderSizeCheck[(sizeof(Photo_HeaderTypeDef) <= PHOTO_HEADER_SIZE) ? 1 : -1];
+
+static const uint8_t Photo_Pad[PHOTO_HEADER_SIZE - sizeof(Photo_HeaderTypeDef)];	//头部填充，全0
+static uint32_t Photo_OpenCycles;
+
+void Photo_HeaderInit(Photo_HeaderTypeDef *hdr, uint8_t light_mode)
+{
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->magic = PHOTO_MAGIC;
+	hdr->version = PHOTO_VERSION;
+	hdr->header_size = PHOTO_HEADER_SIZE;
+	hdr->width = CAPTURE_WIDTH;
+	hdr->height = CAPTURE_HEIGHT;
+	hdr->pixel_format = PHOTO_FORMAT_RGB565;
+	hdr->bpp = 16;
+	hdr->light_mode = light_mode;
+	hdr->data_size = CAPTURE_FRAME_SIZE;
+
+	hdr->frame_counter = Frame_GetInfo()->vsync;
+
+	//帧已锁存在FIFO中，此时读到的就是这一帧使用的曝光和增益
+	hdr->reg_gain = SCCB_RD_Reg(0x00);
+	hdr->reg_vref = SCCB_RD_Reg(0x03);
+	hdr->reg_com1 = SCCB_RD_Reg(0x04);
+	hdr->reg_aech = SCCB_RD_Reg(0x10);
+	hdr->reg_aechh = SCCB_RD_Reg(0x07);
+	hdr->reg_com8 = SCCB_RD_Reg(0x13);
+	hdr->reg_blue = SCCB_RD_Reg(0x01);
+	hdr->reg_red = SCCB_RD_Reg(0x02);
+}
+
+FRESULT Photo_Create(FIL *fp, const char *path, const Photo_HeaderTypeDef *hdr)
+{
+	FRESULT res;
+	UINT bw;
+
+	Photo_Begin();
+
+	res = f_open(fp, path, FA_CREATE_ALWAYS | FA_WRITE);
+	if(res != FR_OK)
+		return res;
+
+	//预分配整个文件的连续空间，像素数据可以用Storage_Stream*直接写入；没有连续空间时照常写入
+	res = Storage_Prealloc(fp, hdr->header_size + hdr->data_size);
+	if(res != FR_OK && res != FR_DENIED)
+	{
+		f_close(fp);
+		return res;
+	}
+
+	res = f_write(fp, hdr, sizeof(*hdr), &bw);
+	if(res == FR_OK)
+		res = f_write(fp, Photo_Pad, sizeof(Photo_Pad), &bw);
+	if(res != FR_OK)
+		f_close(fp);
+	return res;
+}
+
+void Photo_Begin(void)
+{
+	Photo_OpenCycles = DWT_CYCCNT;
+}
+
+void Photo_Complete(Photo_HeaderTypeDef *hdr, uint32_t crc)
+{
+	const Frame_InfoTypeDef *info = Frame_GetInfo();
+
+	//边读边写时打开文件还在写入期间，end要到帧写完（读出结束之前）才有效
+	hdr->frame_us = (info->end - info->start) / (SystemCoreClock / 1000000);
+	hdr->crc32 = crc;
+	hdr->readout_us = (DWT_CYCCNT - Photo_OpenCycles) / (SystemCoreClock / 1000000);
+	hdr->line_cycles_max = FIFO_LineCyclesMax;
+	hdr->flags |= PHOTO_FLAG_COMPLETE;
+}
+
+FRESULT Photo_Finish(FIL *fp, Photo_HeaderTypeDef *hdr, uint32_t crc)
+{
+	FRESULT res;
+	UINT bw;
+
+	Photo_Complete(hdr, crc);
+
+	//只回写头部字段，填充部分不变
+	res = f_lseek(fp, 0);
+	if(res == FR_OK)
+		res = f_write(fp, hdr, sizeof(*hdr), &bw);
+	if(res == FR_OK)
+		return f_close(fp);
+
+	f_close(fp);
+	return res;
+}
+
+uint8_t Photo_ReadHeader(FIL *fp, Photo_HeaderTypeDef *hdr)
+{
+	char line[48];
+	char *end;
+	unsigned int w, h, bpp, type;
+	UINT br;
+
+	memset(hdr, 0, sizeof(*hdr));
+	if(f_lseek(fp, 0) != FR_OK || f_read(fp, hdr, sizeof(*hdr), &br) != FR_OK)
+		return 0;
+
+	if(br == sizeof(*hdr) && hdr->magic == PHOTO_MAGIC && hdr->version == PHOTO_VERSION)
+		return f_lseek(fp, hdr->header_size) == FR_OK ? 2 : 0;
+
+	//v1：ASCII头部以\r\n结束
+	memcpy(line, hdr, sizeof(line) - 1);
+	line[sizeof(line) - 1] = 0;
+	end = strstr(line, "\r\n");
+	memset(hdr, 0, sizeof(*hdr));
+	if(end == NULL || sscanf(line, "IMG_START,%u,%u,%u,%u", &w, &h, &bpp, &type) != 4)
+		return 0;
+
+	hdr->header_size = (uint16_t)(end + 2 - line);
+	hdr->width = (uint16_t)w;
+	hdr->height = (uint16_t)h;
+	hdr->pixel_format = PHOTO_FORMAT_RGB565;
+	hdr->bpp = (uint8_t)bpp;
+	hdr->light_mode = (uint8_t)type;
+	hdr->data_size = (uint32_t)w * h * (bpp / 8);
+	return f_lseek(fp, hdr->header_size) == FR_OK ? 1 : 0;
+}
@@ -0,0 +1,77 @@
+#ifndef __PHOTO_H
+#define __PHOTO_H
+
+#include <stdint.h>
+#include "ff.h"
+
+/*
+ * 照片文件（IMG_XXX.DAT）格式
+ *
+ * v1：IMG_START,320,240,16,type,1\r\n（26字节ASCII） + 像素 + CRC32(大端) + \r\nIMAGE_END\r\n
+ *     像素从第26字节开始，每行都跨扇区边界
+ * v2：512字节二进制头 + 像素，像素从第1个扇区开始，整扇区直接写入不经过FatFs扇区缓存
+ *     头部字段均为小端，未使用部分填0；文件关闭前flags为0，可据此识别未写完的文件
+ */
+
+#define PHOTO_HEADER_SIZE		512				//v2头部在文件中占用的大小，像素数据起始偏移
+#define PHOTO_MAGIC				0x32474D49		//"IMG2"
+#define PHOTO_VERSION			2
+#define PHOTO_FORMAT_RGB565		1
+
+#define PHOTO_FLAG_COMPLETE		0x01			//像素和CRC已写完
+
+typedef struct
+{
+	uint32_t magic;					//0   PHOTO_MAGIC
+	uint16_t version;				//4   PHOTO_VERSION
+	uint16_t header_size;			//6   PHOTO_HEADER_SIZE
+	uint16_t width;					//8
+	uint16_t height;				//10
+	uint8_t  pixel_format;			//12  PHOTO_FORMAT_xx
+	uint8_t  bpp;					//13
+	uint8_t  light_mode;			//14  1=不补光, 2=可见光, 3=红外光
+	uint8_t  flags;					//15  PHOTO_FLAG_xx
+	uint32_t data_size;				//16  像素数据字节数
+	uint32_t crc32;					//20  像素数据CRC32
+	uint32_t frame_counter;			//24  锁存帧开始写入时的VSYNC序号（上电以来）
+	uint8_t  reg_gain;				//28  GAIN(0x00)，AGC[7:0]
+	uint8_t  reg_vref;				//29  VREF(0x03)，bit7:6为AGC[9:8]
+	uint8_t  reg_com1;				//30  COM1(0x04)，bit1:0为AEC[1:0]
+	uint8_t  reg_aech;				//31  AECH(0x10)，AEC[9:2]
+	uint8_t  reg_aechh;				//32  AECHH(0x07)，AEC[15:10]
+	uint8_t  reg_com8;				//33  COM8(0x13)，AGC/AEC/AWB使能
+	uint8_t  reg_blue;				//34  BLUE(0x01)，AWB蓝色增益
+	uint8_t  reg_red;				//35  RED(0x02)，AWB红色增益
+	uint32_t frame_us;				//36  锁存帧两次VSYNC的间隔
+	uint32_t readout_us;			//40  打开文件到写完像素
+	uint32_t line_cycles_max;		//44  单行FIFO读出的最大周期数
+	uint32_t session_id;			//48  所在会话文件的ID（见session.h），单独的文件为0
+	uint32_t session_frame;			//52  在会话文件中的帧序号
+} Photo_HeaderTypeDef;				//56字节，其后填0到PHOTO_HEADER_SIZE
+
+/*
+ * 填写头部：几何、格式、帧计数、曝光/增益寄存器（经SCCB读取）
+ * 输入：light_mode (1=不补光, 2=可见光, 3=红外光)
+ * 说明：在锁存一帧之后（边读边写时为开始写入之后）、读出之前调用，crc32、frame_us和耗时由Photo_Complete填写
+ */
+void Photo_HeaderInit(Photo_HeaderTypeDef *hdr, uint8_t light_mode);
+
+/* 创建文件（尽量预分配连续空间）并写入v2头部（flags为0），文件指针停在像素起始处 */
+FRESULT Photo_Create(FIL *fp, const char *path, const Photo_HeaderTypeDef *hdr);
+
+/* 开始计时，Photo_Complete据此填写readout_us（Photo_Create中已调用） */
+void Photo_Begin(void);
+
+/* 填写CRC、帧间隔和耗时，置PHOTO_FLAG_COMPLETE，不访问文件；在帧写完之后、Frame_Release之前调用 */
+void Photo_Complete(Photo_HeaderTypeDef *hdr, uint32_t crc);
+
+/* Photo_Complete后回写头部并关闭文件 */
+FRESULT Photo_Finish(FIL *fp, Photo_HeaderTypeDef *hdr, uint32_t crc);
+
+/*
+ * 读取已打开文件的头部，文件指针停在像素起始处
+ * 返回：2 (v2，hdr有效), 1 (v1，hdr只填写几何和light_mode), 0 (无法识别)
+ */
+uint8_t Photo_ReadHeader(FIL *fp, Photo_HeaderTypeDef *hdr);
+
+#endif
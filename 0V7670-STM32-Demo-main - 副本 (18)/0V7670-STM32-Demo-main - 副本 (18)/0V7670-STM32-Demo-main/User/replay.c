@@ -0,0 +1,85 @@
+#include "replay.h"
+
+//等待输出端归还缓冲区时执行，默认空转；主机测试中定义为模拟的发送完成中断（同capture.c）
+#ifndef REPLAY_WAIT
+#define REPLAY_WAIT()
+#endif
+
+static FIL Replay_Fil;
+static DWORD Replay_Clmt[REPLAY_CLMT_SIZE];
+
+//缓冲区交给输出端的次数和已归还的次数，两者相等时缓冲区空闲（同capture.c）
+static uint8_t *Replay_Bufs[2];
+static uint8_t Replay_BufSent[2];
+static volatile uint8_t Replay_BufDone[2];
+
+static void Replay_BufDoneCallback(const uint8_t *buf)
+{
+	if(buf == Replay_Bufs[0])
+		Replay_BufDone[0]++;
+	else if(buf == Replay_Bufs[1])
+		Replay_BufDone[1]++;
+}
+
+FRESULT Replay_File(const Replay_ConfigTypeDef *cfg, const char *path, uint32_t *sent)
+{
+	FRESULT res;
+	uint32_t total = 0;
+	UINT br;
+	uint8_t b;
+
+	if(sent)
+		*sent = 0;
+	res = f_open(&Replay_Fil, path, FA_READ);
+	if(res != FR_OK)
+		return res;
+
+	// 建立簇表；文件碎片太多时放弃快速定位，f_read退回沿FAT链查找
+	Replay_Clmt[0] = REPLAY_CLMT_SIZE;
+	Replay_Fil.cltbl = Replay_Clmt;
+	if(f_lseek(&Replay_Fil, CREATE_LINKMAP) != FR_OK)
+		Replay_Fil.cltbl = 0;
+	res = f_lseek(&Replay_Fil, cfg->offset);
+	if(res != FR_OK)
+	{
+		f_close(&Replay_Fil);
+		return res;
+	}
+
+	for(b = 0; b < 2; b++)
+	{
+		Replay_Bufs[b] = cfg->bufs[b];
+		Replay_BufSent[b] = 0;
+		Replay_BufDone[b] = 0;
+	}
+
+	for(b = 0; ; b ^= 1)
+	{
+		// 等待输出端归还本缓冲区，此时另一个缓冲区正在发送
+		while(Replay_BufDone[b] != Replay_BufSent[b]) REPLAY_WAIT();
+
+		res = f_read(&Replay_Fil, Replay_Bufs[b], cfg->buf_size, &br);
+		if(res != FR_OK || br == 0)
+			break;
+
+		Replay_BufSent[b]++;
+		if(cfg->write_async(Replay_Bufs[b], (uint16_t)br, Replay_BufDoneCallback) != 0)
+		{
+			Replay_BufSent[b]--;
+			res = FR_INT_ERR;
+			break;
+		}
+		total += br;
+	}
+
+	// 缓冲区全部归还后才能交给调用者复用
+	for(b = 0; b < 2; b++)
+	{
+		while(Replay_BufDone[b] != Replay_BufSent[b]) REPLAY_WAIT();
+	}
+
+	f_close(&Replay_Fil);
+	if(sent)
+		*sent = total;
+	return res;
+}
@@ -0,0 +1,38 @@
+#ifndef __REPLAY_H
+#define __REPLAY_H
+
+#include <stdint.h>
+#include "ff.h"
+
+/*
+ * 照片回放：把SD卡上的文件原样发送到输出端（串口DMA）。
+ * 文件按整扇区直接读入两个缓冲区之一（f_read整扇区时直接调用disk_read多块读，不经过FIL的扇区缓存），
+ * 输出端在后台发送一个缓冲区的同时读取另一个，两者都不复制数据。
+ * 打开文件后建立快速定位簇表（_USE_FASTSEEK），跨簇时查表而不是沿FAT链查找。
+ * 本模块不直接访问硬件，输出端以函数指针接入，主机上可换成pty或文件进行测试。
+ */
+
+#define REPLAY_CLMT_SIZE		32		//簇表长度（DWORD），可容纳(32-1)/2=15段不连续的簇链
+
+/* 缓冲区归还回调，输出端发送完成后调用（可在中断中） */
+typedef void (*Replay_DoneTypeDef)(const uint8_t *buf);
+
+typedef struct
+{
+	//异步发送，返回0时必须在发完buf后调用一次done，非0表示出错
+	uint8_t (*write_async)(const uint8_t *buf, uint16_t len, Replay_DoneTypeDef done);
+	uint8_t *bufs[2];						//读缓冲区，4字节对齐
+	uint16_t buf_size;						//每个缓冲区的大小，扇区大小（512）的整数倍
+	uint32_t offset;						//从文件的这个位置发送到结尾，扇区对齐时不复制
+} Replay_ConfigTypeDef;
+
+/*
+ * 把文件从cfg->offset到结尾发送到输出端
+ * 输入：cfg (输出端/缓冲区/起始位置), path (文件名)
+ * 输出：sent (已交给输出端的字节数，可为NULL)
+ * 返回：FR_OK 表示成功；输出端出错时返回FR_INT_ERR
+ * 说明：返回前等待输出端归还全部缓冲区
+ */
+FRESULT Replay_File(const Replay_ConfigTypeDef *cfg, const char *path, uint32_t *sent);
+
+#endif
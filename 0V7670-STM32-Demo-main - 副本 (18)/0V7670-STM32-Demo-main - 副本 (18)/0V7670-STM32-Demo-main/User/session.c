@@ -0,0 +1,218 @@
+#include "session.h"
+#include "storage.h"
+#include "timer.h"
+#include "sys.h"
+#include <stdio.h>
+#include <string.h>
+
+#define SESSION_ENTRIES_PER_SECTOR	(512 / sizeof(Session_EntryTypeDef))
+
+typedef char Session_HeaderSizeCheck[(sizeof(Session_HeaderTypeDef) <= SESSION_HEADER_SIZE) ? 1 : -1];
+typedef char Session_SlotSizeCheck[(SESSION_SLOT_SIZE % 512 == 0) ? 1 : -1];
+
+static FIL Session_Fil;
+static char Session_Name[16];
+static uint8_t Session_Opened;
+static Session_HeaderTypeDef Session_Header;
+static Session_EntryTypeDef Session_Index[SESSION_ENTRIES_PER_SECTOR];	//当前索引扇区
+static Photo_HeaderTypeDef Session_Photo;		//正在写入的帧的头部
+static uint32_t Session_FrameMs;
+
+static DWORD Session_SlotOffset(uint32_t frame)
+{
+	return Session_Header.data_offset + frame * Session_Header.slot_size;
+}
+
+static DWORD Session_DataOffset(uint32_t max_frames)
+{
+	return SESSION_HEADER_SIZE + (max_frames * sizeof(Session_EntryTypeDef) + 511) / 512 * 512;
+}
+
+FRESULT Session_Open(uint16_t max_frames)
+{
+	FRESULT res;
+	FILINFO fno;
+	uint16_t num;
+	DWORD off;
+
+	if(Session_Opened)
+		return FR_OK;
+
+	//第一个不存在的文件名
+	for(num = 1; num < 1000; num++)
+	{
+		sprintf(Session_Name, "SES_%03u.DAT", num);
+		res = f_stat(Session_Name, &fno);
+		if(res == FR_NO_FILE)
+			break;
+		if(res != FR_OK)
+			return res;
+	}
+	if(num == 1000)
+		return FR_EXIST;
+
+	res = f_open(&Session_Fil, Session_Name, FA_CREATE_NEW | FA_WRITE);
+	if(res != FR_OK)
+		return res;
+
+	//一次预分配全部帧槽，之后每帧只写数据扇区
+	for(res = FR_DENIED; max_frames >= SESSION_MIN_FRAMES; max_frames /= 2)
+	{
+		res = Storage_Prealloc(&Session_Fil, Session_DataOffset(max_frames) + (DWORD)max_frames * SESSION_SLOT_SIZE);
+		if(res != FR_DENIED)
+			break;
+	}
+	if(res != FR_OK)
+		goto fail;
+
+	memset(&Session_Header, 0, sizeof(Session_Header));
+	Session_Header.magic = SESSION_MAGIC;
+	Session_Header.version = SESSION_VERSION;
+	Session_Header.header_size = SESSION_HEADER_SIZE;
+	Session_Header.session_id = ((uint32_t)num << 16) ^ DWT_CYCCNT;	//区分预分配区中残留的旧帧头
+	Session_Header.slot_size = SESSION_SLOT_SIZE;
+	Session_Header.max_frames = max_frames;
+	Session_Header.index_offset = SESSION_HEADER_SIZE;
+	Session_Header.data_offset = Session_DataOffset(max_frames);
+	Session_Header.created_ms = TIMER_Millis();
+
+	//会话头和清零的索引表，预分配区原有内容不可信
+	if(Storage_WriteSector(&Session_Fil, 0, &Session_Header, sizeof(Session_Header)))
+	{
+		res = FR_DISK_ERR;
+		goto fail;
+	}
+	for(off = Session_Header.index_offset; off < Session_Header.data_offset; off += 512)
+	{
+		if(Storage_WriteSector(&Session_Fil, off, 0, 0))
+		{
+			res = FR_DISK_ERR;
+			goto fail;
+		}
+	}
+
+	//目录项和FAT链只在这里写入一次
+	res = f_sync(&Session_Fil);
+	if(res != FR_OK)
+		goto fail;
+
+	memset(Session_Index, 0, sizeof(Session_Index));
+	Session_Opened = 1;
+	return FR_OK;
+
+fail:
+	f_close(&Session_Fil);
+	f_unlink(Session_Name);
+	return res;
+}
+
+FRESULT Session_Close(void)
+{
+	if(!Session_Opened)
+		return FR_OK;
+	Session_Opened = 0;
+
+	Session_Header.flags |= SESSION_FLAG_CLOSED;
+	if(Storage_WriteSector(&Session_Fil, 0, &Session_Header, sizeof(Session_Header)))
+	{
+		f_close(&Session_Fil);
+		return FR_DISK_ERR;
+	}
+	return f_close(&Session_Fil);
+}
+
+uint8_t Session_IsOpen(void)
+{
+	return Session_Opened;
+}
+
+uint8_t Session_IsFull(void)
+{
+	return Session_Header.frame_count >= Session_Header.max_frames;
+}
+
+uint16_t Session_FrameCount(void)
+{
+	return (uint16_t)Session_Header.frame_count;
+}
+
+uint16_t Session_MaxFrames(void)
+{
+	return (uint16_t)Session_Header.max_frames;
+}
+
+const char *Session_FileName(void)
+{
+	return Session_Name;
+}
+
+// 输出端：像素直接写入第frame_count个帧槽，关闭时写帧头和索引
+static uint8_t Session_SinkOpen(uint8_t photo_type)
+{
+	uint32_t n = Session_Header.frame_count;
+
+	if(!Session_Opened || Session_IsFull())
+		return 1;
+
+	Session_FrameMs = TIMER_Millis();
+	Photo_HeaderInit(&Session_Photo, photo_type);
+	Session_Photo.session_id = Session_Header.session_id;
+	Session_Photo.session_frame = n;
+	Photo_Begin();
+
+	return Storage_StreamBegin(&Session_Fil, Session_SlotOffset(n) + PHOTO_HEADER_SIZE, CAPTURE_FRAME_SIZE) != 0;
+}
+
+// 行缓冲区末尾不足一个扇区时被保留到下一行，只能异步写入
+static uint8_t Session_SinkWrite(const uint8_t *buf, uint16_t len)
+{
+	(void)buf;
+	(void)len;
+	return 1;
+}
+
+static uint8_t Session_SinkWriteAsync(const uint8_t *buf, uint16_t len, Capture_DoneTypeDef done)
+{
+	return Storage_StreamWrite(buf, len, done);
+}
+
+static uint8_t Session_SinkClose(uint32_t crc)
+{
+	uint32_t n = Session_Header.frame_count;
+	Session_EntryTypeDef *entry;
+	DWORD index_sector;
+
+	if(Storage_StreamEnd() != 0)
+		return 1;
+
+	Photo_Complete(&Session_Photo, crc);
+	if(Storage_WriteSector(&Session_Fil, Session_SlotOffset(n), &Session_Photo, sizeof(Session_Photo)))
+		return 1;
+
+	//索引扇区写入后该帧才算存在；换到新扇区时从全0开始
+	if(n % SESSION_ENTRIES_PER_SECTOR == 0)
+		memset(Session_Index, 0, sizeof(Session_Index));
+	entry = &Session_Index[n % SESSION_ENTRIES_PER_SECTOR];
+	entry->offset = Session_SlotOffset(n);
+	entry->light_mode = Session_Photo.light_mode;
+	entry->flags = SESSION_ENTRY_VALID;
+	entry->timestamp_ms = Session_FrameMs;
+	entry->crc32 = crc;
+
+	index_sector = Session_Header.index_offset + n / SESSION_ENTRIES_PER_SECTOR * 512;
+	if(Storage_WriteSector(&Session_Fil, index_sector, Session_Index, sizeof(Session_Index)))
+	{
+		memset(entry, 0, sizeof(*entry));
+		return 1;
+	}
+
+	Session_Header.frame_count = n + 1;
+	return 0;
+}
+
+static void Session_SinkAbort(void)
+{
+	Storage_StreamAbort();			//本帧槽下次重写
+}
+
+const Capture_SinkTypeDef Session_Sink = {Session_SinkOpen, Session_SinkWrite, Session_SinkClose, Session_SinkAbort, Session_SinkWriteAsync};
@@ -0,0 +1,79 @@
+#ifndef __SESSION_H
+#define __SESSION_H
+
+#include <stdint.h>
+#include "ff.h"
+#include "capture.h"
+#include "photo.h"
+
+/*
+ * 会话文件（SES_XXX.DAT）：连拍时多帧追加到一个预分配的大文件中，每帧不再创建文件、目录项和FAT链
+ *
+ * 布局（均按扇区对齐，字段小端）：
+ *   0             会话头 Session_HeaderTypeDef，其后填0到512字节
+ *   index_offset  索引表，max_frames个Session_EntryTypeDef（每扇区32项）
+ *   data_offset   帧槽，第n帧位于 data_offset + n * slot_size，
+ *                 每个槽是一个完整的v2照片（512字节头 + 像素），头部session_id/session_frame指向本会话
+ *
+ * 写入顺序：像素（CMD25直接写入）→ 帧头（置COMPLETE）→ 所在的索引扇区，索引项有效即表示该帧完整。
+ * 会话头的frame_count只在关闭时写入；掉电后以索引为准，索引之后的槽可按帧头中的
+ * session_id/session_frame/COMPLETE继续恢复（见dat_format.py）。
+ * 文件创建时一次性预分配并同步目录项，之后只写数据扇区，FatFs的元数据不再变化。
+ */
+
+#define SESSION_MAGIC			0x31534553		//"SES1"
+#define SESSION_VERSION			1
+#define SESSION_HEADER_SIZE		512
+#define SESSION_MAX_FRAMES		64				//预分配的帧槽数，连续空间不足时减半重试
+#define SESSION_MIN_FRAMES		8
+#define SESSION_SLOT_SIZE		(PHOTO_HEADER_SIZE + CAPTURE_FRAME_SIZE)	//每帧占用的字节数，扇区对齐
+
+#define SESSION_FLAG_CLOSED		0x01			//会话头的frame_count有效
+
+#define SESSION_ENTRY_VALID		0x01			//帧已完整写入
+
+typedef struct
+{
+	uint32_t magic;					//0   SESSION_MAGIC
+	uint16_t version;				//4   SESSION_VERSION
+	uint16_t header_size;			//6   SESSION_HEADER_SIZE
+	uint32_t session_id;			//8   与各帧头部的session_id相同
+	uint32_t flags;					//12  SESSION_FLAG_xx
+	uint32_t slot_size;				//16  SESSION_SLOT_SIZE
+	uint32_t max_frames;			//20  帧槽数
+	uint32_t frame_count;			//24  已写入的帧数，关闭时写入
+	uint32_t index_offset;			//28  索引表起始位置
+	uint32_t data_offset;			//32  第0帧起始位置
+	uint32_t created_ms;			//36  创建时上电以来的毫秒数
+} Session_HeaderTypeDef;			//40字节
+
+typedef struct
+{
+	uint32_t offset;				//0   帧（v2头部）在文件中的位置
+	uint8_t  light_mode;			//4   1=不补光, 2=可见光, 3=红外光
+	uint8_t  flags;					//5   SESSION_ENTRY_xx
+	uint16_t reserved;				//6
+	uint32_t timestamp_ms;			//8   上电以来的毫秒数
+	uint32_t crc32;					//12  像素数据CRC32
+} Session_EntryTypeDef;				//16字节
+
+/* 会话输出端，用法同SD卡单文件输出端；会话未打开或已满时open返回失败 */
+extern const Capture_SinkTypeDef Session_Sink;
+
+/*
+ * 创建新的会话文件并预分配max_frames个帧槽（连续空间不足时减半，最少SESSION_MIN_FRAMES）
+ * 返回：FR_OK 表示成功
+ * 说明：文件名为第一个不存在的SES_XXX.DAT
+ */
+FRESULT Session_Open(uint16_t max_frames);
+
+/* 写入frame_count并关闭会话文件 */
+FRESULT Session_Close(void);
+
+uint8_t Session_IsOpen(void);
+uint8_t Session_IsFull(void);
+uint16_t Session_FrameCount(void);
+uint16_t Session_MaxFrames(void);
+const char *Session_FileName(void);
+
+#endif
@@ -0,0 +1,211 @@
+#include "storage.h"
+#include "SDdriver.h"
+#include "diskio.h"
+
+static const uint8_t Storage_Zero[512];		//Storage_WriteSector的填充
+
+static uint8_t Storage_Active;
+static uint32_t Storage_Left;					//还未交给Storage_StreamWrite的字节数
+
+//上一段末尾不足一个扇区的部分，Owner在拼完扇区后归还
+static const uint8_t *Storage_TailOwner;
+static const uint8_t *Storage_TailData;
+static uint16_t Storage_TailLen;
+static Storage_DoneTypeDef Storage_TailDone;
+
+static void Storage_ReleaseTail(void)
+{
+	if(Storage_TailOwner && Storage_TailDone)
+		Storage_TailDone(Storage_TailOwner);
+	Storage_TailOwner = 0;
+	Storage_TailLen = 0;
+}
+
+//文件中offset处的物理扇区号，簇链连续时（Storage_CheckContiguous）直接由起始簇计算
+static DWORD Storage_Sector(FIL *fp, DWORD offset)
+{
+	return fp->fs->database + (fp->sclust - 2) * fp->fs->csize + offset / 512;
+}
+
+//直接读写扇区之前，先写出disk_write缓存中的扇区（user_diskio.c）
+static uint8_t Storage_Flush(void)
+{
+	return disk_ioctl(0, CTRL_SYNC, 0) != RES_OK;
+}
+
+//用快速定位簇表确认文件只有一段连续簇链，返回：0 连续；1 为空或不连续；2 SD卡错误
+//每次直接写扇区前都检查，不保存结果（同一个FIL重新创建的文件起始簇和长度可能不变）
+static uint8_t Storage_CheckContiguous(FIL *fp)
+{
+	DWORD clmt[4];					//一段簇链：长度、起始簇、结束标记
+	FRESULT res;
+
+	if(fp->sclust < 2 || fp->fsize == 0)
+		return 1;
+
+	clmt[0] = 4;
+	fp->cltbl = clmt;
+	res = f_lseek(fp, CREATE_LINKMAP);
+	fp->cltbl = 0;
+	if(res == FR_NOT_ENOUGH_CORE)
+		return 1;					//多于一段
+	if(res != FR_OK)
+		return 2;
+	return 0;
+}
+
+FRESULT Storage_Prealloc(FIL *fp, DWORD size)
+{
+	return f_expand(fp, size, 1);
+}
+
+uint8_t Storage_StreamBegin(FIL *fp, DWORD offset, DWORD size)
+{
+	uint8_t r;
+
+	Storage_Active = 0;
+	Storage_TailOwner = 0;
+	Storage_TailLen = 0;
+
+	if((offset | size) % 512 || size == 0 || fp->fsize < offset + size)
+		return 1;
+	r = Storage_CheckContiguous(fp);
+	if(r)
+		return r;
+
+	//先把完整长度和簇链写入目录项和FAT，中途掉电也能找到这个文件
+	if(f_sync(fp) != FR_OK || Storage_Flush())
+		return 2;
+
+	if(SD_WriteMultiStart(Storage_Sector(fp, offset), size / 512))
+		return 2;
+
+	Storage_Left = size;
+	Storage_Active = 1;
+	return 0;
+}
+
+uint8_t Storage_StreamWrite(const uint8_t *buf, uint16_t len, Storage_DoneTypeDef done)
+{
+	uint16_t pos = 0;
+	uint8_t r;
+
+	if(!Storage_Active || len < 512 || len > Storage_Left)
+		return 1;
+	Storage_Left -= len;
+
+	//上一段的尾部 + 本段开头拼成一个扇区
+	if(Storage_TailLen)
+	{
+		pos = 512 - Storage_TailLen;
+		r = SD_WriteMultiBlockParts(Storage_TailData, Storage_TailLen, buf);
+		Storage_ReleaseTail();
+		if(r)
+			goto fail;
+	}
+
+	while(len - pos >= 512)
+	{
+		if(SD_WriteMultiBlock(buf + pos))
+			goto fail;
+		pos += 512;
+	}
+
+	if(pos < len)
+	{
+		Storage_TailOwner = buf;
+		Storage_TailData = buf + pos;
+		Storage_TailLen = len - pos;
+		Storage_TailDone = done;
+	}
+	else if(done)
+	{
+		done(buf);
+	}
+	return 0;
+
+fail:
+	Storage_Active = 0;
+	SD_WriteMultiStop();
+	return 2;
+}
+
+uint8_t Storage_StreamEnd(void)
+{
+	uint8_t r;
+
+	if(!Storage_Active)
+		return 1;
+	Storage_Active = 0;
+
+	r = Storage_TailLen || Storage_Left;	//数据不足size，最后一个扇区没有写出
+	Storage_ReleaseTail();
+	if(SD_WriteMultiStop())
+		r = 2;
+	return r;
+}
+
+void Storage_StreamAbort(void)
+{
+	Storage_ReleaseTail();
+	if(Storage_Active)
+	{
+		Storage_Active = 0;
+		SD_WriteMultiStop();
+	}
+}
+
+uint8_t Storage_WriteSector(FIL *fp, DWORD offset, const void *head, uint16_t head_len)
+{
+	uint8_t r;
+
+	if(Storage_Active || offset % 512 || head_len > 512 || (head == 0 && head_len))
+		return 1;
+	if(fp->fsize < offset + 512)
+		return 1;
+	r = Storage_CheckContiguous(fp);
+	if(r)
+		return r;
+	if(Storage_Flush())
+		return 2;
+
+	if(SD_WriteMultiStart(Storage_Sector(fp, offset), 1))
+		return 2;
+	r = SD_WriteMultiBlockParts((const uint8_t *)head, head_len, Storage_Zero);
+	if(SD_WriteMultiStop() || r)
+		return 2;
+	return 0;
+}
+
+uint8_t Storage_GetExtent(FIL *fp, Storage_ExtentTypeDef *ext)
+{
+	uint8_t r;
+
+	if(fp->fsize < 512)
+		return 1;
+	r = Storage_CheckContiguous(fp);
+	if(r)
+		return r;
+
+	ext->sector = Storage_Sector(fp, 0);
+	ext->count = fp->fsize / 512;
+	return 0;
+}
+
+uint8_t Storage_ExtentRead(const Storage_ExtentTypeDef *ext, DWORD n, void *buf)
+{
+	if(Storage_Active || n >= ext->count)
+		return 1;
+	if(Storage_Flush())
+		return 2;
+	return SD_ReadDisk((uint8_t *)buf, ext->sector + n, 1) ? 2 : 0;
+}
+
+uint8_t Storage_ExtentWrite(const Storage_ExtentTypeDef *ext, DWORD n, const void *buf)
+{
+	if(Storage_Active || n >= ext->count)
+		return 1;
+	if(Storage_Flush())
+		return 2;
+	return SD_WriteDisk((uint8_t *)buf, ext->sector + n, 1) ? 2 : 0;
+}
@@ -0,0 +1,71 @@
+#ifndef __STORAGE_H
+#define __STORAGE_H
+
+#include <stdint.h>
+#include "ff.h"
+
+/*
+ * 连续文件的原始多块写入
+ * 文件创建后先用f_expand预分配一段连续簇，数据区用一条CMD25（ACMD23预擦除）直接写入SD卡，
+ * 不经过FatFs：FAT和目录项只在开始（f_sync，文件已是完整长度）和关闭时更新，
+ * 写入耗时与卡上碎片无关。
+ *
+ * 写入的缓冲区不复制：一行的末尾不足一个扇区时保留该缓冲区，与下一行的开头拼成一个扇区发出后再归还。
+ * 数据流进行期间SD卡保持选中，不能调用任何FatFs函数。
+ */
+
+/* 连续文件占用的物理扇区，文件关闭后仍可直接读写（文件不能被删除或截断） */
+typedef struct
+{
+	DWORD sector;					//第一个扇区
+	DWORD count;					//扇区数
+} Storage_ExtentTypeDef;
+
+/* 缓冲区归还回调（与Capture_DoneTypeDef相同） */
+typedef void (*Storage_DoneTypeDef)(const uint8_t *buf);
+
+/*
+ * 为刚创建（长度为0）的文件预分配size字节的连续空间
+ * 返回：FR_OK；FR_DENIED 表示没有足够大的连续空闲区，文件不变，可按普通方式写入
+ */
+FRESULT Storage_Prealloc(FIL *fp, DWORD size);
+
+/*
+ * 开始写入文件中[offset, offset+size)的数据区
+ * 输入：offset、size均为512的整数倍，文件长度不小于offset+size
+ * 返回：0 成功；1 文件不连续或长度不够（调用者改用f_write）；2 SD卡错误
+ * 说明：每次都遍历簇链确认只有一段（与Storage_GetExtent相同），FAT按簇数读取
+ */
+uint8_t Storage_StreamBegin(FIL *fp, DWORD offset, DWORD size);
+
+/*
+ * 写入下一段数据，len >= 512
+ * 返回：0 成功，buf用完后调用一次done（可能在下一次调用或Storage_StreamEnd中）；非0 出错，不调用done
+ */
+uint8_t Storage_StreamWrite(const uint8_t *buf, uint16_t len, Storage_DoneTypeDef done);
+
+/* 结束写入，返回0表示size字节已全部写入 */
+uint8_t Storage_StreamEnd(void);
+
+/* 放弃写入并归还保留的缓冲区 */
+void Storage_StreamAbort(void);
+
+/*
+ * 把head（head_len字节，其余填0）作为一个扇区写到文件offset处，不经过FatFs
+ * 输入：offset为512的整数倍；head可为NULL（整扇区填0）
+ * 返回：0 成功；1 参数错误、文件不连续或长度不够；2 SD卡错误
+ * 说明：不能在Storage_StreamBegin和Storage_StreamEnd之间调用
+ */
+uint8_t Storage_WriteSector(FIL *fp, DWORD offset, const void *head, uint16_t head_len);
+
+/*
+ * 取得已打开文件的扇区范围，用快速定位簇表确认文件只有一段连续簇链
+ * 返回：0 成功；1 文件为空或不连续；2 SD卡错误
+ */
+uint8_t Storage_GetExtent(FIL *fp, Storage_ExtentTypeDef *ext);
+
+/* 读写扇区范围内的第n个扇区（512字节），返回：0 成功；1 超出范围；2 SD卡错误 */
+uint8_t Storage_ExtentRead(const Storage_ExtentTypeDef *ext, DWORD n, void *buf);
+uint8_t Storage_ExtentWrite(const Storage_ExtentTypeDef *ext, DWORD n, const void *buf);
+
+#endif
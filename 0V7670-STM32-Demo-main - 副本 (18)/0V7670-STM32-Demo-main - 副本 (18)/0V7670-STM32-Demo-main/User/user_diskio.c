@@ -35,8 +35,9 @@
 /* Includes ------------------------------------------------------------------*/
 #include <string.h>
 #include "ff_gen_drv.h"
+#include "user_diskio.h"
 #include "SDdriver.h"
-#include "Delay.h"
+#include "delay.h"
 
 /* Private typedef -----------------------------------------------------------*/
 /* Private define ------------------------------------------------------------*/
@@ -45,6 +46,26 @@
 /* Disk status */
 static volatile DSTATUS Stat = STA_NOINIT;
 
+static USER_CacheStatsTypeDef Cache_Stats;
+
+#if USER_CACHE_SECTORS > 0
+/*
+ * Write-behind cache for single-sector writes (FAT, directory, FSINFO and the
+ * partial data sectors flushed from a file buffer). Only dirty sectors are held;
+ * CTRL_SYNC writes them all and empties the cache, so everything FatFs has
+ * synced (f_sync/f_close) is on the card exactly as without the cache.
+ *
+ * Sectors leave the cache oldest-first, each together with the run of cached
+ * sectors adjacent to it, in one CMD25 (CMD24 for a lone sector). Keeping the
+ * order of first write keeps FatFs's data -> FAT -> directory order on the card
+ * if power is lost mid-way.
+ */
+static uint8_t Cache_Data[USER_CACHE_SECTORS][512];
+static DWORD Cache_Sector[USER_CACHE_SECTORS];
+static DWORD Cache_Age[USER_CACHE_SECTORS];   /* 0 = slot free */
+static DWORD Cache_Clock;
+#endif
+
 /* USER CODE END DECL */
 
 /* Private function prototypes -----------------------------------------------*/
@@ -73,6 +94,126 @@ Diskio_drvTypeDef  USER_Driver =
 
 /* Private functions ---------------------------------------------------------*/
 
+/* USER CODE BEGIN CACHE */
+#if USER_CACHE_SECTORS > 0
+static int Cache_Find(DWORD sector)
+{
+  int i;
+  for(i = 0; i < USER_CACHE_SECTORS; i++)
+  {
+    if(Cache_Age[i] && Cache_Sector[i] == sector)
+      return i;
+  }
+  return -1;
+}
+
+static int Cache_Oldest(void)
+{
+  int i, oldest = -1;
+  for(i = 0; i < USER_CACHE_SECTORS; i++)
+  {
+    if(Cache_Age[i] && (oldest < 0 || Cache_Age[i] < Cache_Age[oldest]))
+      oldest = i;
+  }
+  return oldest;
+}
+
+/* Write slot i and its cached neighbours in one go; slots stay dirty on error */
+static uint8_t Cache_FlushRun(int i)
+{
+  DWORD first = Cache_Sector[i];
+  DWORD n, k;
+  uint8_t r1;
+
+  while(first > 0 && Cache_Find(first - 1) >= 0)
+    first--;
+  for(n = 1; Cache_Find(first + n) >= 0; n++);
+
+  if(n == 1)
+  {
+    r1 = SD_WriteDisk(Cache_Data[i], first, 1);  /* CMD24, no ACMD23/stop token */
+  }
+  else
+  {
+    r1 = SD_WriteMultiStart(first, n);
+    for(k = 0; r1 == 0 && k < n; k++)
+      r1 = SD_WriteMultiBlock(Cache_Data[Cache_Find(first + k)]);
+    if(SD_WriteMultiStop() && r1 == 0) r1 = 1;
+  }
+  if(r1)
+    return r1;
+
+  for(k = 0; k < n; k++)
+    Cache_Age[Cache_Find(first + k)] = 0;
+  Cache_Stats.flushes++;
+  Cache_Stats.flushed_sectors += n;
+  return 0;
+}
+
+static uint8_t Cache_Flush(void)
+{
+  int i;
+  while((i = Cache_Oldest()) >= 0)
+  {
+    if(Cache_FlushRun(i))
+      return 1;
+  }
+  return 0;
+}
+
+/* A single-sector write: update or take a slot, making room by flushing the oldest run */
+static uint8_t Cache_Write(const BYTE *buff, DWORD sector)
+{
+  int i = Cache_Find(sector);
+
+  if(i >= 0)
+  {
+    Cache_Stats.write_hits++;
+  }
+  else
+  {
+    Cache_Stats.write_misses++;
+    for(i = 0; i < USER_CACHE_SECTORS && Cache_Age[i]; i++);
+    if(i == USER_CACHE_SECTORS)
+    {
+      i = Cache_Oldest();
+      if(Cache_FlushRun(i))
+        return 1;
+    }
+    Cache_Sector[i] = sector;
+    Cache_Age[i] = ++Cache_Clock;
+  }
+  memcpy(Cache_Data[i], buff, 512);
+  return 0;
+}
+
+/* A multi-sector write goes straight to the card and replaces any cached copy */
+static void Cache_Drop(DWORD sector, UINT count)
+{
+  int i;
+  for(i = 0; i < USER_CACHE_SECTORS; i++)
+  {
+    if(Cache_Age[i] && Cache_Sector[i] - sector < count)
+      Cache_Age[i] = 0;
+  }
+}
+
+/* Cached sectors are newer than the card */
+static void Cache_Read(BYTE *buff, DWORD sector, UINT count)
+{
+  int i;
+  for(i = 0; i < USER_CACHE_SECTORS; i++)
+  {
+    if(Cache_Age[i] && Cache_Sector[i] - sector < count)
+    {
+      memcpy(buff + (Cache_Sector[i] - sector) * 512, Cache_Data[i], 512);
+      Cache_Stats.read_hits++;
+    }
+  }
+}
+#endif
+/* USER CODE END CACHE */
+
 /**
   * @brief  Initializes a Drive
   * @param  pdrv: Physical drive number (0..)
@@ -84,12 +225,14 @@ DSTATUS USER_initialize (
 {
   /* USER CODE BEGIN INIT */
   uint8_t res;
+#if USER_CACHE_SECTORS > 0
+	memset(Cache_Age, 0, sizeof(Cache_Age));  // Unsynced sectors of a previous mount are lost
+#endif
 	res = SD_init();
  	if(res)
 		{
-			SPI_setspeed(0x00);  // 256 prescaler (low speed)
+			SPI_setspeed(SPI_BaudRatePrescaler_256);  // Back to identification speed
 			spi_readwrite(0xff); // Provide extra 8 clocks
-			SPI_setspeed(0x08);  // 2 prescaler (high speed)
 		}
 	if(res)return  STA_NOINIT;
 	else return RES_OK; // Init successful
@@ -144,7 +287,18 @@ DRESULT USER_read (
 	switch (pdrv)
 	{
 		case 0:
+#if USER_CACHE_SECTORS > 0
+			if(count == 1 && Cache_Find(sector) >= 0)
+			{
+				Cache_Read(buff, sector, 1);
+				return RES_OK;
+			}
+#endif
+			Cache_Stats.read_misses++;
 	    res=SD_ReadDisk(buff,sector,count);
+#if USER_CACHE_SECTORS > 0
+			if(res == 0) Cache_Read(buff, sector, count);
+#endif
 			if(res == 0){
 				return RES_OK;
 			}else{
@@ -182,6 +336,11 @@ DRESULT USER_write (
 	switch (pdrv)
 	{
 		case 0:
+#if USER_CACHE_SECTORS > 0
+			if(count == 1)
+				return Cache_Write(buff, sector) ? RES_ERROR : RES_OK;
+			Cache_Drop(sector, count);
+#endif
 	    res=SD_WriteDisk((uint8_t *)buff,sector,count);
 			if(res == 0){
 				return RES_OK;
@@ -210,23 +369,25 @@ DRESULT USER_ioctl (
 {
   /* USER CODE BEGIN IOCTL */
     DRESULT res;
-    uint16_t timeout;
 	 switch(cmd)
 	    {
 		    case CTRL_SYNC:
-						SD_CS(1);
-						timeout = 0;
-						do{
-							delay_ms(20);
-							timeout++;
-							if(timeout > 100) {
-								res = RES_ERROR;
-								SD_CS(0);
-								return res;
-							}
-						}while(spi_readwrite(0xFF)!=0xFF);
-						res=RES_OK;
-						SD_CS(0);
+#if USER_CACHE_SECTORS > 0
+						if(Cache_Flush())
+						{
+							res = RES_ERROR;
+							break;
+						}
+#endif
+						res = SD_Sync() ? RES_ERROR : RES_OK;	// Wait for the last write to finish programming
+		        break;
+		    case CTRL_CACHE_STATS:
+		        memcpy(buff, &Cache_Stats, sizeof(Cache_Stats));
+		        res = RES_OK;
+		        break;
+		    case CTRL_CACHE_RESET:
+		        memset(&Cache_Stats, 0, sizeof(Cache_Stats));
+		        res = RES_OK;
 		        break;
 		    case GET_SECTOR_SIZE:
 		        *(WORD*)buff = 512;
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+SD卡性能测试结果解析 - 读取串口日志中以"BENCH,"开头的行（见 User/bench.h）
+
+用法:
+    python bench_report.py log.txt               显示结果
+    python bench_report.py base.txt new.txt      与基准比较，变慢超过阈值时返回1
+    python bench_report.py base.txt new.txt 20   阈值（百分比，默认10）
+"""
+
+import sys
+from pathlib import Path
+
+# 耗时分布的上界（微秒），最后一格为其余
+HIST_EDGES_US = [64 << i for i in range(10)]
+
+
+def parse_line(line: str):
+    """解析一行，返回 (测试名, 参数, 字段dict)；不是BENCH行时返回None"""
+    line = line.strip()
+    start = line.find("BENCH,")
+    if start < 0:
+        return None
+    parts = line[start:].split(",")
+    test = parts[1]
+    fields = {}
+    param = ""
+    for part in parts[2:]:
+        key, _, value = part.partition("=")
+        if key == "hist":
+            fields[key] = [int(v) for v in value.split("/")]
+        elif key == "test":
+            fields[key] = value
+        else:
+            fields[key] = int(value)
+        if not param and key in ("size", "blocks", "files"):
+            param = part
+    return test, param, fields
+
+
+def load(path) -> dict:
+    """读取日志，返回 {(测试名, 参数): 字段}，同一测试出现多次时取最后一次"""
+    results = {}
+    text = Path(path).read_text(encoding="utf-8", errors="replace")
+    for line in text.splitlines():
+        parsed = parse_line(line)
+        if parsed:
+            test, param, fields = parsed
+            results[(test, param)] = fields
+    return results
+
+
+def metric(test: str, fields: dict):
+    """用于比较的指标 (名称, 数值, 越大越好)"""
+    if "Bps" in fields and fields.get("bytes"):
+        return "kB/s", fields["Bps"] / 1000, True
+    if test == "dirscan":
+        return "us", fields["us"], False
+    if "calls" in fields and fields["calls"]:
+        return "us/call", fields["us"] / fields["calls"], False
+    return None
+
+
+def format_hist(hist) -> str:
+    labels = [f"<{e}" for e in HIST_EDGES_US] + [f">={HIST_EDGES_US[-1]}"]
+    return " ".join(f"{label}:{n}" for label, n in zip(labels, hist) if n)
+
+
+def show(results: dict):
+    for (test, param), fields in results.items():
+        if test in ("begin", "end", "error"):
+            print(f"{test:8s} " + " ".join(f"{k}={v}" for k, v in fields.items()))
+            continue
+        m = metric(test, fields)
+        value = f"{m[1]:10.1f} {m[0]}" if m else ""
+        extra = ""
+        if "max" in fields:
+            extra = f"  min {fields['min']} max {fields['max']} us"
+        elif "miss_us" in fields:
+            extra = f"  entries {fields['entries']}, miss lookup {fields['miss_us']} us"
+        print(f"{test:8s} {param:12s} {value}{extra}")
+        if "hist" in fields:
+            print(f"{'':21s} {format_hist(fields['hist'])}")
+
+
+def compare(base: dict, new: dict, threshold: float) -> int:
+    """逐项比较，返回变慢超过threshold%的项数"""
+    regressions = 0
+    for key, fields in new.items():
+        if key not in base:
+            continue
+        m_new, m_base = metric(key[0], fields), metric(key[0], base[key])
+        if not m_new or not m_base or not m_base[1]:
+            continue
+        change = (m_new[1] - m_base[1]) / m_base[1] * 100
+        worse = -change if m_new[2] else change
+        flag = "SLOWER" if worse > threshold else ""
+        regressions += bool(flag)
+        print(f"{key[0]:8s} {key[1]:12s} {m_base[1]:10.1f} -> {m_new[1]:10.1f} {m_new[0]:8s} {change:+6.1f}%  {flag}")
+    return regressions
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        print(__doc__)
+        sys.exit(2)
+
+    new = load(sys.argv[-1] if len(sys.argv) == 2 else sys.argv[2])
+    if not new:
+        print("未找到BENCH行")
+        sys.exit(2)
+    if "error" in {k[0] for k in new}:
+        print("警告: 测试中出现错误")
+
+    if len(sys.argv) == 2:
+        show(new)
+        sys.exit(0)
+
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 10.0
+    count = compare(load(sys.argv[1]), new, threshold)
+    print(f"\n{count} 项变慢超过 {threshold:g}%")
+    sys.exit(1 if count else 0)
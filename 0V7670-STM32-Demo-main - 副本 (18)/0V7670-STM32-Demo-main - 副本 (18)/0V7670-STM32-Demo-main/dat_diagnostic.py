@@ -7,6 +7,103 @@ DAT文件诊断工具 - 分析文件结构和内容
 import sys
 from pathlib import Path
 
+import dat_format
+
+
+def diagnose_v2(raw_data):
+    """诊断v2文件（512字节二进制头 + 像素）"""
+    try:
+        header = dat_format.parse_v2_header(raw_data)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return
+
+    print("格式: v2 (二进制头)")
+    print(f"\n头部字段:")
+    for name in ('version', 'header_size', 'width', 'height', 'pixel_format', 'bpp',
+                 'light_mode', 'flags', 'data_size', 'frame_counter',
+                 'frame_us', 'readout_us', 'line_cycles_max', 'session_id', 'session_frame'):
+        print(f"   {name:16s} {header[name]}")
+    print(f"   {'crc32':16s} 0x{header['crc32']:08X}")
+    print(f"\n传感器寄存器:")
+    for name in ('reg_gain', 'reg_vref', 'reg_com1', 'reg_aech', 'reg_aechh',
+                 'reg_com8', 'reg_blue', 'reg_red'):
+        print(f"   {name:16s} 0x{header[name]:02X}")
+    print(f"   曝光 AEC = {header['exposure_lines']} 行, 增益 AGC = {header['gain']}")
+
+    if not header['complete']:
+        print("\n警告: flags未置位，文件未正常关闭，CRC无效")
+
+    data = raw_data[header['header_size']:header['header_size'] + header['data_size']]
+    print(f"\n数据段信息:")
+    print(f"   数据起始: {header['header_size']}")
+    print(f"   数据长度: {len(data)} 字节")
+    print(f"   期望长度: {header['data_size']} 字节")
+    extra = len(raw_data) - header['header_size'] - header['data_size']
+    if extra:
+        print(f"   文件多出/缺少: {extra} 字节")
+    if len(data) < header['data_size']:
+        print(f"\n警告: 数据不完整!")
+        print(f"   完成度: {len(data)/header['data_size']*100:.2f}%")
+    elif header['complete']:
+        crc = dat_format.crc32(data)
+        print(f"\nCRC32: 计算 0x{crc:08X} / 头部 0x{header['crc32']:08X} -> "
+              f"{'OK' if crc == header['crc32'] else '不匹配'}")
+
+    if data:
+        print(f"\n数据前50字节 (HEX):")
+        print(f"   {data[:50].hex(' ', 2)}")
+
+def diagnose_session(raw_data):
+    """诊断会话文件（会话头 + 索引表 + v2帧槽）"""
+    try:
+        session = dat_format.parse_session(raw_data)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return
+
+    print("格式: 会话文件")
+    for name in ('session_id', 'slot_size', 'max_frames', 'frame_count',
+                 'index_offset', 'data_offset', 'created_ms'):
+        print(f"   {name:16s} {session[name]}")
+    if not session['closed']:
+        print("\n警告: 会话未正常关闭（掉电？），帧数以索引表和帧头扫描为准")
+
+    frames = session['frames']
+    print(f"\n帧 ({len(frames)}/{session['max_frames']}):")
+    for entry in frames:
+        try:
+            frame = dat_format.load_session_frame(raw_data, entry['index'])
+            status = 'OK'
+        except ValueError as e:
+            frame, status = None, str(e)
+        ts = '-' if entry['timestamp_ms'] is None else f"{entry['timestamp_ms']} ms"
+        print(f"   #{entry['index']:3d} @{entry['offset']:10d}  mode {entry['light_mode']}  "
+              f"{ts:>12s}  crc 0x{entry['crc32']:08X}  {entry['source']:5s}  {status}")
+    recovered = sum(1 for e in frames if e['source'] == 'scan')
+    if recovered:
+        print(f"\n从帧头恢复了 {recovered} 帧（索引表中缺失）")
+
+
+def diagnose_catalog(raw_data):
+    """诊断目录文件 PHOTO.IDX"""
+    try:
+        catalog = dat_format.parse_catalog(raw_data)
+    except ValueError as e:
+        print(f"ERROR: {e}")
+        return
+
+    print(f"格式: 照片目录文件（使用头部副本 {catalog['header_slot']}）")
+    for name in ('generation', 'next_seq', 'count', 'capacity', 'dir_files'):
+        print(f"   {name:16s} {catalog[name]}")
+
+    records = catalog['records']
+    print(f"\n记录 ({len(records)}):")
+    for rec in records:
+        print(f"   #{rec['index']:5d}  {rec['path']:18s}  mode {rec['light_mode']}  "
+              f"{rec['size']:8d} B  crc 0x{rec['crc32']:08X}  {rec['timestamp_ms']} ms")
+
+
 def diagnose_dat_file(filepath):
     """诊断DAT文件的结构"""
     filepath = Path(filepath)
@@ -26,6 +123,23 @@ def diagnose_dat_file(filepath):
     file_size = len(raw_data)
     print(f"文件大小: {file_size} 字节 ({file_size/1024:.2f} KB)\n")
 
+    if raw_data[:4] == dat_format.CATALOG_MAGIC or raw_data[512:516] == dat_format.CATALOG_MAGIC:
+        diagnose_catalog(raw_data)
+        print(f"\n{'='*60}\n")
+        return
+
+    if dat_format.is_session(raw_data):
+        diagnose_session(raw_data)
+        print(f"\n{'='*60}\n")
+        return
+
+    if dat_format.detect_version(raw_data) == 2:
+        diagnose_v2(raw_data)
+        print(f"\n{'='*60}\n")
+        return
+
+    print("格式: v1 (ASCII头)")
+
     # 查找协议头
     header_start = raw_data.find(b'IMG_START,')
     print(f"IMG_START 位置: {header_start}")
@@ -107,6 +221,14 @@ def diagnose_dat_file(filepath):
         print(f"\n数据前50字节 (HEX):")
         print(f"   {hex_data}")
 
+    # v1的CRC32(大端)紧跟在像素之后
+    if len(header_parts) >= 6 and data_size == expected_size + 4:
+        data = raw_data[data_start:data_start + expected_size]
+        crc_stored = int.from_bytes(raw_data[data_start + expected_size:footer_start], 'big')
+        crc = dat_format.crc32(data)
+        print(f"\nCRC32: 计算 0x{crc:08X} / 文件 0x{crc_stored:08X} -> "
+              f"{'OK' if crc == crc_stored else '不匹配'}")
+
     # 显示文件末尾
     if footer_start != -1:
         footer = raw_data[footer_start:footer_start+20]
@@ -0,0 +1,289 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+STM32 IMG_XXX.DAT 文件格式解析（v1 / v2），供 dat_viewer.py 和 dat_diagnostic.py 使用
+
+v1: IMG_START,width,height,bpp,type,1\r\n + RGB565数据 + CRC32(大端4字节) + \r\nIMAGE_END\r\n
+v2: 512字节二进制头(小端, 见 User/photo.h) + RGB565数据，像素从第512字节开始
+会话文件 SES_XXX.DAT: 会话头 + 索引表 + 连续的v2帧槽 (见 User/session.h)，第n帧位于 data_offset + n*slot_size
+目录文件 PHOTO.IDX: 两个头部副本 + 照片记录 (见 User/catalog.h)，照片位于 Pddd/IMGnnnnn.DAT
+"""
+
+import struct
+import zlib
+
+V2_MAGIC = b'IMG2'
+V2_HEADER_SIZE = 512
+V2_FLAG_COMPLETE = 0x01
+PIXEL_FORMATS = {1: 'RGB565'}
+
+# 与 User/photo.h 中 Photo_HeaderTypeDef 一一对应（56字节）
+_V2_STRUCT = struct.Struct('<4sHHHHBBBBIII8BIIIII')
+_V2_FIELDS = (
+    'magic', 'version', 'header_size', 'width', 'height',
+    'pixel_format', 'bpp', 'light_mode', 'flags',
+    'data_size', 'crc32', 'frame_counter',
+    'reg_gain', 'reg_vref', 'reg_com1', 'reg_aech',
+    'reg_aechh', 'reg_com8', 'reg_blue', 'reg_red',
+    'frame_us', 'readout_us', 'line_cycles_max',
+    'session_id', 'session_frame',
+)
+V1_FOOTER = b'\r\nIMAGE_END\r\n'
+
+SESSION_MAGIC = b'SES1'
+SESSION_FLAG_CLOSED = 0x01
+SESSION_ENTRY_VALID = 0x01
+# 与 User/session.h 中 Session_HeaderTypeDef（40字节）/ Session_EntryTypeDef（16字节）对应
+_SESSION_STRUCT = struct.Struct('<4sHHIIIIIIII')
+_SESSION_FIELDS = (
+    'magic', 'version', 'header_size', 'session_id', 'flags',
+    'slot_size', 'max_frames', 'frame_count', 'index_offset', 'data_offset', 'created_ms',
+)
+_ENTRY_STRUCT = struct.Struct('<IBBHII')
+
+CATALOG_MAGIC = b'PIDX'
+CATALOG_RECORD_VALID = 0x01
+# 与 User/catalog.h 中 Catalog_HeaderTypeDef / Catalog_RecordTypeDef 对应（各32字节）
+_CATALOG_STRUCT = struct.Struct('<4sHHIIIIII')
+_CATALOG_FIELDS = (
+    'magic', 'version', 'record_size', 'generation', 'next_seq',
+    'count', 'capacity', 'dir_files', 'check',
+)
+_RECORD_STRUCT = struct.Struct('<IBBHIII12s')
+
+
+def crc32(data: bytes) -> int:
+    """CRC32 (与STM32 crc32.c一致, 即zlib CRC32)"""
+    return zlib.crc32(data) & 0xFFFFFFFF
+
+
+def detect_version(raw: bytes) -> int:
+    """返回 2 / 1，无法识别时返回 0"""
+    if raw[:4] == V2_MAGIC:
+        return 2
+    if raw.find(b'IMG_START,') != -1:
+        return 1
+    return 0
+
+
+def parse_v2_header(raw: bytes) -> dict:
+    """解析v2头部字段"""
+    if len(raw) < _V2_STRUCT.size:
+        raise ValueError(f"文件太短，不足v2头部 {_V2_STRUCT.size} 字节")
+    header = dict(zip(_V2_FIELDS, _V2_STRUCT.unpack_from(raw)))
+    if header['magic'] != V2_MAGIC:
+        raise ValueError(f"v2魔数错误: {header['magic']!r}")
+    if header['version'] != 2:
+        raise ValueError(f"不支持的版本: {header['version']}")
+    header['complete'] = bool(header['flags'] & V2_FLAG_COMPLETE)
+    # 曝光行数 AEC[15:0] 和增益 AGC[9:0]
+    header['exposure_lines'] = ((header['reg_aechh'] & 0x3F) << 10) | (header['reg_aech'] << 2) | (header['reg_com1'] & 0x03)
+    header['gain'] = ((header['reg_vref'] & 0xC0) << 2) | header['reg_gain']
+    return header
+
+
+def parse_v1_header(raw: bytes) -> dict:
+    """解析v1 ASCII头部，返回字段及像素起始位置"""
+    header_start = raw.find(b'IMG_START,')
+    if header_start == -1:
+        raise ValueError("未找到IMG_START协议头，文件格式可能错误")
+    header_end = raw.find(b'\r\n', header_start)
+    if header_end == -1:
+        raise ValueError("未找到协议头结束符")
+
+    parts = raw[header_start:header_end].decode('ascii').split(',')
+    if len(parts) != 6:
+        raise ValueError(f"协议头格式错误: {parts}")
+    _, width, height, bpp, img_type, _crc_flag = parts
+    width, height, bpp = int(width), int(height), int(bpp)
+    return {
+        'version': 1,
+        'header_start': header_start,
+        'header_size': header_end + 2,
+        'width': width,
+        'height': height,
+        'bpp': bpp,
+        'pixel_format': 1,
+        'light_mode': int(img_type),
+        'data_size': width * height * (bpp // 8),
+    }
+
+
+def load(raw: bytes, verify_crc: bool = True) -> dict:
+    """
+    解析v1或v2文件
+
+    Returns:
+        dict: width/height/bpp/type/crc/data/version 以及v2头部全部字段
+
+    Raises:
+        ValueError: 格式错误、数据不完整或CRC校验失败
+    """
+    version = detect_version(raw)
+    if version == 2:
+        header = parse_v2_header(raw)
+        data_start = header['header_size']
+        data = raw[data_start:data_start + header['data_size']]
+        if len(data) != header['data_size']:
+            raise ValueError(f"数据长度不匹配: 期望{header['data_size']}字节, 实际{len(data)}字节")
+        crc_stored = header['crc32'] if header['complete'] else None
+    elif version == 1:
+        header = parse_v1_header(raw)
+        data_start = header['header_size']
+        footer_start = raw.find(V1_FOOTER, data_start)
+        if footer_start == -1:
+            raise ValueError("未找到IMAGE_END协议尾")
+        payload = raw[data_start:footer_start]
+        if len(payload) == header['data_size'] + 4:
+            # 像素后紧跟CRC32(大端)
+            data = payload[:header['data_size']]
+            crc_stored = struct.unpack('>I', payload[-4:])[0]
+        elif len(payload) == header['data_size']:
+            data = payload
+            crc_stored = None
+        else:
+            raise ValueError(f"数据长度不匹配: 期望{header['data_size']}字节, 实际{len(payload)}字节")
+    else:
+        raise ValueError("无法识别的文件格式（既不是IMG2也没有IMG_START）")
+
+    crc_calc = crc32(data)
+    if verify_crc and crc_stored is not None and crc_calc != crc_stored:
+        raise ValueError(f"CRC校验失败: 文件CRC=0x{crc_stored:08X}, 计算CRC=0x{crc_calc:08X}")
+
+    result = dict(header)
+    result.update({
+        'version': version,
+        'type': header['light_mode'],
+        'crc': crc_stored if crc_stored is not None else crc_calc,
+        'crc_stored': crc_stored,
+        'crc_calc': crc_calc,
+        'data_start': data_start,
+        'data': data,
+    })
+    return result
+
+
+def is_session(raw: bytes) -> bool:
+    """是否为会话文件 (SES_XXX.DAT)"""
+    return raw[:4] == SESSION_MAGIC
+
+
+def session_frame_offset(session: dict, n: int) -> int:
+    """第n帧（v2头部）在文件中的位置"""
+    return session['data_offset'] + n * session['slot_size']
+
+
+def _session_slot_ok(raw: bytes, session: dict, n: int) -> bool:
+    """帧槽n的v2头部属于本会话、序号正确且已写完"""
+    off = session_frame_offset(session, n)
+    if off + session['slot_size'] > len(raw):
+        return False
+    try:
+        header = parse_v2_header(raw[off:off + V2_HEADER_SIZE])
+    except ValueError:
+        return False
+    return (header['complete'] and header['session_id'] == session['session_id']
+            and header['session_frame'] == n)
+
+
+def parse_session(raw: bytes) -> dict:
+    """
+    解析会话头和索引表
+
+    未正常关闭（掉电）的会话以索引表为准，再从索引之后的帧槽按v2头部的
+    session_id/session_frame/COMPLETE继续恢复，恢复的帧 source 为 'scan'
+
+    Returns:
+        dict: 会话头字段, closed, frames（每帧 index/offset/light_mode/timestamp_ms/crc32/source）
+    """
+    if len(raw) < _SESSION_STRUCT.size or not is_session(raw):
+        raise ValueError("不是会话文件（缺少SES1魔数）")
+    session = dict(zip(_SESSION_FIELDS, _SESSION_STRUCT.unpack_from(raw)))
+    if session['version'] != 1:
+        raise ValueError(f"不支持的会话版本: {session['version']}")
+    session['closed'] = bool(session['flags'] & SESSION_FLAG_CLOSED)
+
+    frames = []
+    for n in range(session['max_frames']):
+        pos = session['index_offset'] + n * _ENTRY_STRUCT.size
+        if pos + _ENTRY_STRUCT.size > len(raw):
+            break
+        offset, light_mode, flags, _, timestamp_ms, crc = _ENTRY_STRUCT.unpack_from(raw, pos)
+        if not flags & SESSION_ENTRY_VALID:
+            break
+        frames.append({'index': n, 'offset': offset, 'light_mode': light_mode,
+                       'timestamp_ms': timestamp_ms, 'crc32': crc, 'source': 'index'})
+
+    if session['closed']:
+        frames = frames[:session['frame_count']]
+    else:
+        n = len(frames)
+        while n < session['max_frames'] and _session_slot_ok(raw, session, n):
+            off = session_frame_offset(session, n)
+            header = parse_v2_header(raw[off:off + V2_HEADER_SIZE])
+            frames.append({'index': n, 'offset': off, 'light_mode': header['light_mode'],
+                           'timestamp_ms': None, 'crc32': header['crc32'], 'source': 'scan'})
+            n += 1
+
+    session['frames'] = frames
+    return session
+
+
+def load_session_frame(raw: bytes, n: int, verify_crc: bool = True) -> dict:
+    """按索引直接定位并解析会话文件中的第n帧，返回值同load()，另含 frame_index/timestamp_ms"""
+    session = parse_session(raw)
+    if not 0 <= n < len(session['frames']):
+        raise ValueError(f"帧序号超出范围: {n}（共{len(session['frames'])}帧）")
+    entry = session['frames'][n]
+    result = load(raw[entry['offset']:entry['offset'] + session['slot_size']], verify_crc)
+    if result['session_id'] != session['session_id'] or result['session_frame'] != n:
+        raise ValueError(f"帧{n}的头部不属于本会话")
+    if verify_crc and result['crc_calc'] != entry['crc32']:
+        raise ValueError(f"帧{n} CRC与索引不一致: 索引0x{entry['crc32']:08X}, 计算0x{result['crc_calc']:08X}")
+    result['frame_index'] = n
+    result['timestamp_ms'] = entry['timestamp_ms']
+    result['data_start'] += entry['offset']
+    return result
+
+
+def _catalog_check(raw: bytes) -> int:
+    """头部校验：前7个uint32求和取反"""
+    return ~sum(struct.unpack_from('<7I', raw)) & 0xFFFFFFFF
+
+
+def parse_catalog(raw: bytes) -> dict:
+    """
+    解析目录文件 PHOTO.IDX
+
+    两个头部副本取校验正确且generation较大的一个；记录按登记顺序返回（最多capacity条）
+
+    Returns:
+        dict: 头部字段, header_slot（所用副本）, records（每条 seq/light_mode/dir/size/crc32/timestamp_ms/name/path）
+    """
+    header = None
+    for slot in (0, 1):
+        sector = raw[slot * 512:slot * 512 + _CATALOG_STRUCT.size]
+        if len(sector) < _CATALOG_STRUCT.size or sector[:4] != CATALOG_MAGIC:
+            continue
+        fields = dict(zip(_CATALOG_FIELDS, _CATALOG_STRUCT.unpack(sector)))
+        if fields['check'] != _catalog_check(sector) or fields['version'] != 1:
+            continue
+        if header is None or ((fields['generation'] - header['generation']) & 0xFFFFFFFF) < 0x80000000:
+            header = fields
+            header['header_slot'] = slot
+    if header is None:
+        raise ValueError("不是有效的目录文件（两个头部副本均无效）")
+
+    records = []
+    first = max(0, header['count'] - header['capacity'])
+    for n in range(first, header['count']):
+        pos = 2 * 512 + (n % header['capacity']) * _RECORD_STRUCT.size
+        seq, light_mode, flags, directory, size, crc, timestamp_ms, name = _RECORD_STRUCT.unpack_from(raw, pos)
+        if not flags & CATALOG_RECORD_VALID:
+            continue
+        name = name.rstrip(b'\0').decode('ascii')
+        records.append({'index': n, 'seq': seq, 'light_mode': light_mode, 'dir': directory,
+                        'size': size, 'crc32': crc, 'timestamp_ms': timestamp_ms,
+                        'name': name, 'path': f"P{directory:03d}/{name}"})
+    header['records'] = records
+    return header
@@ -8,12 +8,13 @@ STM32 OV7670 DAT文件查看器
 版本: 1.0
 """
 
-import struct
 import numpy as np
 import cv2
 from pathlib import Path
 from typing import Tuple, Dict, Optional
 
+import dat_format
+
 
 class DATImageLoader:
     """STM32 DAT文件加载器 - 解析并显示自定义协议图像文件"""
@@ -30,17 +31,24 @@ class DATImageLoader:
         self.height = height
         self.bpp = 16  # RGB565格式
 
-    def parse_dat_file(self, filepath: str) -> Dict:
+    def parse_dat_file(self, filepath: str, frame: int = 0) -> Dict:
         """
-        解析DAT文件，提取图像数据和元信息
+        解析DAT文件，提取图像数据和元信息（v1和v2格式均支持，见dat_format.py）
 
-        协议格式:
-        IMG_START,width,height,bpp,type,crc\r\n
-        [RGB565二进制数据]
+        v1格式:
+        IMG_START,width,height,bpp,type,1\r\n
+        [RGB565二进制数据][CRC32大端4字节]
         \r\nIMAGE_END\r\n
 
+        v2格式:
+        [512字节二进制头: 几何/格式/补光模式/CRC/帧计数/曝光增益寄存器/耗时]
+        [RGB565二进制数据]
+
+        会话文件(SES_XXX.DAT)按索引表直接定位第frame帧
+
         Args:
             filepath: DAT文件路径
+            frame: 会话文件中的帧序号（单帧文件忽略）
 
         Returns:
             dict: 包含图像数据和元信息的字典
@@ -55,71 +63,16 @@ class DATImageLoader:
         with open(filepath, 'rb') as f:
             raw_data = f.read()
 
-        # 查找协议头
-        header_start = raw_data.find(b'IMG_START,')
-        if header_start == -1:
-            raise ValueError("未找到IMG_START协议头，文件格式可能错误")
-
-        header_end = raw_data.find(b'\r\n', header_start)
-        if header_end == -1:
-            raise ValueError("未找到协议头结束符")
-
-        # 解析协议头: IMG_START,width,height,bpp,type,crc
-        header_str = raw_data[header_start:header_end].decode('ascii')
-        header_parts = header_str.split(',')
-
-        if len(header_parts) != 6:
-            raise ValueError(f"协议头格式错误: {header_parts}")
-
-        # 提取元信息
-        img_start, width, height, bpp, img_type, crc_str = header_parts
-        width = int(width)
-        height = int(height)
-        bpp = int(bpp)
-        img_type = int(img_type)
-        crc_stored = int(crc_str, 16) if crc_str.startswith('0x') else int(crc_str)
-
-        # 查找数据结束符
-        data_start = header_end + 2  # 跳过\r\n
-        footer_start = raw_data.find(b'\r\nIMAGE_END\r\n', data_start)
-        if footer_start == -1:
-            raise ValueError("未找到IMAGE_END协议尾")
-
-        # 提取二进制图像数据
-        image_data = raw_data[data_start:footer_start]
-
-        # 验证数据长度（允许153600或153604，后者包含CRC）
-        expected_size = width * height * (bpp // 8)
-        actual_size = len(image_data)
-
-        if actual_size == expected_size + 4:
-            # 数据段包含了CRC，提取纯图像数据
-            print(f"WARN:  检测到数据段包含CRC，自动分离...")
-            image_data = image_data[:expected_size]
-            # CRC在数据段末尾4字节，但我们已经在header中提取了CRC
-        elif actual_size != expected_size:
-            raise ValueError(
-                f"数据长度不匹配: 期望{expected_size}字节, 实际{actual_size}字节"
-            )
-
-        # 计算CRC32并验证
-        calculated_crc = self._calculate_crc32(image_data)
-        if calculated_crc != crc_stored:
-            raise ValueError(
-                f"CRC校验失败: 文件CRC=0x{crc_stored:08X}, "
-                f"计算CRC=0x{calculated_crc:08X}"
-            )
-
-        return {
-            'width': width,
-            'height': height,
-            'bpp': bpp,
-            'type': img_type,
-            'crc': crc_stored,
-            'data': image_data,
-            'filename': filepath.name,
-            'filepath': str(filepath)
-        }
+        if dat_format.is_session(raw_data):
+            metadata = dat_format.load_session_frame(raw_data, frame)
+            metadata['filename'] = f"{filepath.name}#{frame}"
+        else:
+            metadata = dat_format.load(raw_data)
+            if metadata['version'] == 2 and not metadata['complete']:
+                print("WARN:  v2文件未正常关闭，CRC无效")
+            metadata['filename'] = filepath.name
+        metadata['filepath'] = str(filepath)
+        return metadata
 
     def _calculate_crc32(self, data: bytes) -> int:
         """
@@ -131,15 +84,7 @@ class DATImageLoader:
         Returns:
             int: CRC32校验值
         """
-        crc = 0xFFFFFFFF
-        for byte in data:
-            crc ^= byte
-            for _ in range(8):
-                if crc & 1:
-                    crc = (crc >> 1) ^ 0xEDB88320
-                else:
-                    crc >>= 1
-        return crc ^ 0xFFFFFFFF
+        return dat_format.crc32(data)
 
     def rgb565_to_rgb888(self, rgb565_data: bytes, width: int, height: int) -> np.ndarray:
         """
@@ -192,7 +137,7 @@ class DATImageLoader:
 
     def load_and_display(self, filepath: str, display: bool = True,
                         save_output: Optional[str] = None,
-                        window_delay: int = 0) -> Tuple[np.ndarray, Dict]:
+                        window_delay: int = 0, frame: int = 0) -> Tuple[np.ndarray, Dict]:
         """
         加载DAT文件并显示图像
 
@@ -201,6 +146,7 @@ class DATImageLoader:
             display: 是否显示图像窗口
             save_output: 保存路径 (可选, 如 "output.jpg")
             window_delay: 窗口显示延迟(毫秒), 0表示等待按键
+            frame: 会话文件中的帧序号
 
         Returns:
             tuple: (RGB888图像数据, 元信息字典)
@@ -210,7 +156,7 @@ class DATImageLoader:
         print(f"FILE: 正在加载: {filepath}")
         print(f"{'='*60}")
 
-        metadata = self.parse_dat_file(filepath)
+        metadata = self.parse_dat_file(filepath, frame)
 
         # 2. 显示元信息
         print(f"OK: 解析成功!")
@@ -220,6 +166,14 @@ class DATImageLoader:
         print(f"   拍照模式:   {self.get_type_name(metadata['type'])}")
         print(f"   CRC32:      0x{metadata['crc']:08X}")
         print(f"   数据大小:   {len(metadata['data'])} 字节")
+        print(f"   文件格式:   v{metadata['version']}")
+        if metadata['version'] == 2:
+            print(f"   帧计数:     {metadata['frame_counter']}")
+            print(f"   曝光/增益:  AEC={metadata['exposure_lines']} 行, AGC={metadata['gain']}")
+            print(f"   帧周期:     {metadata['frame_us']} us")
+            print(f"   读出耗时:   {metadata['readout_us']} us")
+        if 'frame_index' in metadata:
+            print(f"   会话帧:     #{metadata['frame_index']}, {metadata['timestamp_ms']} ms")
 
         # 3. RGB565转RGB888
         print(f"\n🎨 正在转换RGB565 → RGB888...")
@@ -276,12 +230,21 @@ class DATImageLoader:
         if not folder.exists():
             raise FileNotFoundError(f"文件夹不存在: {folder_path}")
 
-        dat_files = list(folder.glob("IMG_*.DAT"))
-        if not dat_files:
-            print(f"WARN:  未找到IMG_*.DAT文件: {folder_path}")
+        # 单帧文件每个一项，会话文件每帧一项
+        # 照片按序号分在Pddd子目录中，旧的IMG_XXX.DAT在根目录
+        jobs = [(f, 0, f.stem) for f in sorted(folder.rglob("IMG*.DAT"))]
+        for ses in sorted(folder.rglob("SES_*.DAT")):
+            try:
+                count = len(dat_format.parse_session(ses.read_bytes())['frames'])
+            except ValueError as e:
+                print(f"WARN:  {ses.name}: {e}")
+                continue
+            jobs += [(ses, n, f"{ses.stem}_{n:03d}") for n in range(count)]
+        if not jobs:
+            print(f"WARN:  未找到IMG*.DAT/SES_*.DAT文件: {folder_path}")
             return
 
-        print(f"\n📂 发现 {len(dat_files)} 个DAT文件")
+        print(f"\n📂 发现 {len(jobs)} 帧图像")
         print(f"{'='*60}")
 
         if output_folder:
@@ -293,18 +256,19 @@ class DATImageLoader:
         success_count = 0
         fail_count = 0
 
-        for i, dat_file in enumerate(dat_files, 1):
+        for i, (dat_file, frame, stem) in enumerate(jobs, 1):
             try:
-                print(f"\n[{i}/{len(dat_files)}] 处理: {dat_file.name}")
+                print(f"\n[{i}/{len(jobs)}] 处理: {dat_file.name}#{frame}")
 
-                output_name = dat_file.stem + "_converted.jpg"
+                output_name = stem + "_converted.jpg"
                 output_file = output_path / output_name
 
                 self.load_and_display(
                     filepath=str(dat_file),
                     display=display,
                     save_output=str(output_file),
-                    window_delay=500 if display else 0
+                    window_delay=500 if display else 0,
+                    frame=frame
                 )
 
                 success_count += 1
@@ -386,7 +350,9 @@ if __name__ == "__main__":
                 loader.batch_process(folder, output, display=False)
             else:
                 # 单文件模式: python dat_viewer.py IMG_101.DAT
-                loader.load_and_display(filepath, display=True)
+                # 会话文件:   python dat_viewer.py SES_001.DAT 5  (第5帧)
+                frame = int(sys.argv[2]) if len(sys.argv) > 2 else 0
+                loader.load_and_display(filepath, display=True, frame=frame)
         except Exception as e:
             print(f"❌ 错误: {e}")
             sys.exit(1)
@@ -0,0 +1,52 @@
+//CRC32的吞吐量：make bench按CRC32_SLICE=1/4/8分别编译，计算整帧（按行分段）若干次，输出MB/s
+//计时用主机的时钟，只用来比较查表宽度，Cortex-M3上的绝对速度要在板子上测
+#include "crc32.h"
+#include <stdio.h>
+#include <time.h>
+#include <zlib.h>
+
+#define LINE		640
+#define FRAME		(LINE * 240)
+#define ROUNDS		200
+
+static uint8_t Data[FRAME];
+
+static double Seconds(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void)
+{
+	volatile uint32_t sink = 0;
+	uint32_t crc, i, r;
+	double t0, t;
+
+	for(i = 0; i < FRAME; i++) Data[i] = (uint8_t)(i * 7 + i / LINE);
+
+	crc = CRC32_Init();
+	for(i = 0; i < FRAME; i += LINE)
+		crc = CRC32_Update(crc, Data + i, LINE);
+	if(CRC32_Final(crc) != (uint32_t)crc32(0, Data, FRAME))
+	{
+		printf("CRC32_SLICE=%d: mismatch\n", CRC32_SLICE);
+		return 1;
+	}
+
+	t0 = Seconds();
+	for(r = 0; r < ROUNDS; r++)
+	{
+		crc = CRC32_Init();
+		for(i = 0; i < FRAME; i += LINE)
+			crc = CRC32_Update(crc, Data + i, LINE);
+		sink ^= CRC32_Final(crc);
+	}
+	t = Seconds() - t0;
+
+	printf("CRC32_SLICE=%d  %7.1f MB/s  %6.1f us/frame\n", CRC32_SLICE,
+		(double)FRAME * ROUNDS / t / 1e6, t * 1e6 / ROUNDS);
+	return 0;
+}
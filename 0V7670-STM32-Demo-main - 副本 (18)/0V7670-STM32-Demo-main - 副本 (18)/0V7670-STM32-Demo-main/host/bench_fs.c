@@ -0,0 +1,43 @@
+//FatFs/SD卡性能测试（User/bench.c）在SD卡模型上运行，输出与固件相同的BENCH,行，可用bench_report.py比较
+//计时用模拟时钟，SD卡编程时间见sd_emu.h；测试结束后根目录应为空（BENCH目录已删除）
+#include "stm32f10x.h"
+#include "bench.h"
+#include "sd_emu.h"
+#include "fs_host.h"
+#include <stdio.h>
+
+static uint32_t Now(void)
+{
+	return (uint32_t)Host_Cycles;
+}
+
+static void Print(const char *line)
+{
+	puts(line);
+}
+
+int main(void)
+{
+	Bench_ConfigTypeDef cfg = {Now, 72, Print};
+	static DIR dir;
+	FILINFO fno;
+	FRESULT res;
+	uint32_t left = 0;
+
+	Host_Reset();
+	if(FsHost_Format(2048) != FR_OK)
+	{
+		printf("format failed\n");
+		return 1;
+	}
+	res = Bench_Run(&cfg);
+
+	f_opendir(&dir, "");
+	while(f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+		left++;
+	f_closedir(&dir);
+	if(left)
+		printf("%lu entries left in the root directory\n", (unsigned long)left);
+
+	return res != FR_OK || left || SdEmu_Errors;
+}
@@ -0,0 +1,63 @@
+//SD卡驱动的吞吐量（模拟时钟）：make bench分别用逐字节查询和DMA编译，对比两种方式
+//DMA方式下SD_IdleHook每次做100个周期的“其他工作”，统计传输期间CPU能做多少事
+#include "stm32f10x.h"
+#include "SDdriver.h"
+#include "sd_emu.h"
+#include <stdio.h>
+
+#define SECTORS		64
+#define WORK		100
+
+static uint8_t Buf[SECTORS * 512];
+static uint64_t Work;
+
+static void Idle(void)
+{
+	Host_Advance(WORK);
+	Work += WORK;
+}
+
+static void Report(const char *name, uint64_t cycles, uint32_t bytes, uint64_t work)
+{
+	printf("%-24s %6lu us  %5lu KB/s  cpu free %2lu%%\n", name, (unsigned long)(cycles / 72),
+		(unsigned long)((uint64_t)bytes * 72000000 / 1024 / cycles), (unsigned long)(work * 100 / cycles));
+}
+
+static void Run(const char *name, uint8_t write, uint32_t count)
+{
+	uint64_t t0 = Host_Cycles, w0 = Work;
+	uint32_t i;
+
+	for(i = 0; i < SECTORS; i += count)
+	{
+		if(write) SD_WriteDisk(Buf + i * 512, 1000 + i, count);
+		else SD_ReadDisk(Buf + i * 512, 1000 + i, count);
+	}
+	SD_Sync();
+	Report(name, Host_Cycles - t0, SECTORS * 512, Work - w0);
+}
+
+int main(void)
+{
+	Host_Reset();
+	SdEmu_Attach(1);
+	if(SD_init())
+	{
+		printf("SD_init failed\n");
+		return 1;
+	}
+#if SD_USE_DMA
+	SD_IdleHook = Idle;
+	printf("SD_USE_DMA=1, SPI %lu Hz\n", (unsigned long)SD_SpiHz);
+#else
+	(void)Idle;
+	printf("SD_USE_DMA=0, SPI %lu Hz\n", (unsigned long)SD_SpiHz);
+#endif
+
+	Run("write 1 sector x64", 1, 1);
+	Run("write 64 sectors", 1, SECTORS);
+	Run("read 1 sector x64", 0, 1);
+	Run("read 64 sectors", 0, SECTORS);
+
+	return SdEmu_Errors != 0;
+}
@@ -0,0 +1,64 @@
+#include "fs_host.h"
+#include "fatfs.h"
+#include "sd_emu.h"
+#include <stddef.h>
+
+static uint8_t FsHost_Linked;
+
+FRESULT FsHost_Format(UINT au)
+{
+	FRESULT res;
+
+	SdEmu_Attach(1);
+	if(!FsHost_Linked)
+	{
+		MX_FATFS_Init();
+		FsHost_Linked = 1;
+	}
+	f_mount(NULL, USERPath, 0);
+	res = f_mount(&USERFatFS, USERPath, 0);
+	if(res == FR_OK)
+		res = f_mkfs(USERPath, 1, au);
+	if(res == FR_OK)
+		res = f_mount(&USERFatFS, USERPath, 1);
+	return res;
+}
+
+FRESULT FsHost_Remount(void)
+{
+	f_mount(NULL, USERPath, 0);
+	return f_mount(&USERFatFS, USERPath, 1);
+}
+
+uint32_t FsHost_Fragments(const char *path)
+{
+	static DWORD tbl[512];
+	static FIL f;
+
+	if(f_open(&f, path, FA_READ) != FR_OK)
+		return 0;
+	tbl[0] = sizeof(tbl) / sizeof(tbl[0]);
+	f.cltbl = tbl;
+	if(f_lseek(&f, CREATE_LINKMAP) != FR_OK)
+		tbl[0] = 0;
+	f_close(&f);
+	return tbl[0] ? (tbl[0] - 1) / 2 : 0;
+}
+
+FRESULT FsHost_WriteFile(const char *path, const void *data, UINT len)
+{
+	FRESULT res;
+	static FIL f;
+	UINT bw;
+
+	res = f_open(&f, path, FA_CREATE_ALWAYS | FA_WRITE);
+	if(res != FR_OK)
+		return res;
+	res = f_write(&f, data, len, &bw);
+	if(res == FR_OK && bw != len)
+		res = FR_DENIED;
+	if(res == FR_OK)
+		return f_close(&f);
+	f_close(&f);
+	return res;
+}
@@ -0,0 +1,15 @@
+#ifndef __FS_HOST_H
+#define __FS_HOST_H
+#include "ff.h"
+
+/*
+ * FatFs测试的公共部分：FatFs、diskio/user_diskio（含写缓存）、SD卡驱动都用固件原文件，
+ * 接在sd_emu.c的卡模型上。FatFs直接用DMA读写FIL和FATFS中的扇区缓冲区，测试中的FIL须为静态变量
+ */
+
+FRESULT FsHost_Format(UINT au);							//SD卡模型上电，建立文件系统（au为簇大小，字节）并挂载
+FRESULT FsHost_Remount(void);							//卸载后重新挂载，丢弃内存中的一切状态
+uint32_t FsHost_Fragments(const char *path);			//文件的不连续簇链段数，打不开时为0
+FRESULT FsHost_WriteFile(const char *path, const void *data, UINT len);
+
+#endif
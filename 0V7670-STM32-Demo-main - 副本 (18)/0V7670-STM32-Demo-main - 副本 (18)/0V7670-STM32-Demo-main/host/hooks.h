@@ -0,0 +1,15 @@
+#ifndef __HOOKS_H
+#define __HOOKS_H
+
+//固件中可替换的等待钩子在测试里的实现，编译固件源文件时用-include强制包含
+
+#include <stdint.h>
+
+void Test_CaptureWait(void);
+void Test_ReplayWait(void);
+
+void Test_RclkLow(void);
+void Test_RclkHigh(void);
+uint32_t Test_FifoData(void);
+
+#endif
@@ -0,0 +1,11 @@
+#ifndef __DELAY_H
+#define __DELAY_H
+#include "sys.h"
+
+//主机端的System/delay.h：延时只推进模拟时钟
+
+void delay_s(u16 s);
+void delay_ms(u16 ms);
+void delay_us(u32 us);
+
+#endif
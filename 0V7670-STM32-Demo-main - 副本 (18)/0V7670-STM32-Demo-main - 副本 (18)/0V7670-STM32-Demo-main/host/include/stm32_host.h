@@ -0,0 +1,64 @@
+#ifndef __STM32_HOST_H
+#define __STM32_HOST_H
+#include <stdint.h>
+
+/*
+ * 主机端外设模拟（由include/stm32f10x.h引入，也可以单独包含）
+ *
+ *   Host_Cycles      模拟的72MHz周期数。读DWT_CYCCNT、delay、SPI字节传输时推进，
+ *                    推进时调用Host_TickHook（测试中的外部器件模型在这里采样引脚）
+ *   Host_PinOut/In   PAout/PAin等位带访问对应的引脚，[0]=GPIOA [1]=GPIOB [2]=GPIOC
+ *   Host_DmaHook     访问DMA1寄存器时调用，由外设模型启动和完成传输
+ *   Host_SpiHook     SPI_I2S_SendData发送的字节，返回同时收到的字节
+ *   Host_GpioHook    GPIO_SetBits/ResetBits之后调用
+ *   Host_Tim2Hook    每次访问TIM2寄存器前调用，测试中由此推进计数器、设置溢出标志
+ *   Host_CRC         CRC外设（多项式0x04C11DB7，MSB优先，复位值0xFFFFFFFF），每次访问前处理上一次写入的DR/CR，
+ *                    DR高32位为1表示没有新写入；Host_CrcWords为处理的字数
+ *   Host_IrqHook     模拟中断：开中断时和开着中断推进时钟时调用，在这里执行挂起的中断函数
+ *
+ * DMA地址寄存器只有32位：测试用-no-pie链接，DMA缓冲区用静态变量，
+ * Host_DmaPtr检查地址是否在程序映像内
+ */
+
+extern uint64_t Host_Cycles;
+extern volatile uint32_t Host_Primask;
+extern uint8_t Host_PinOut[3][16];
+extern uint8_t Host_PinIn[3][16];
+
+extern void (*Host_TickHook)(void);
+extern void (*Host_DmaHook)(void);
+extern uint8_t (*Host_SpiHook)(uint8_t tx);
+extern void (*Host_GpioHook)(void);
+extern void (*Host_IrqHook)(void);
+extern void (*Host_Tim2Hook)(void);
+
+#ifdef __STM32F10x_H
+extern GPIO_TypeDef Host_GPIOA, Host_GPIOB, Host_GPIOC;
+extern AFIO_TypeDef Host_AFIO;
+extern SPI_TypeDef Host_SPI1;
+extern USART_TypeDef Host_USART1;
+extern TIM_TypeDef Host_TIM2, Host_TIM3, Host_TIM4;
+extern DMA_TypeDef Host_DMA1;
+extern DMA_Channel_TypeDef Host_DMA1_Channel[8];
+#endif
+
+typedef struct
+{
+	volatile uint64_t DR;							//写入的32位值高位为0，据此区分写入和未改变
+	volatile uint8_t  IDR;
+	volatile uint32_t CR;
+} Host_CrcTypeDef;
+
+extern Host_CrcTypeDef Host_CRC;
+extern uint32_t Host_CrcWords;
+
+void Host_Reset(void);								//清零外设、时钟和钩子
+void Host_Advance(uint32_t cycles);
+void Host_SetPrimask(uint32_t primask);
+volatile uint32_t *Host_Dwt(void);
+void Host_DmaService(void);
+void Host_Tim2Service(void);
+void Host_CrcService(void);
+void *Host_DmaPtr(uint32_t addr);					//DMA地址寄存器 -> 指针，不在程序映像内时退出
+
+#endif
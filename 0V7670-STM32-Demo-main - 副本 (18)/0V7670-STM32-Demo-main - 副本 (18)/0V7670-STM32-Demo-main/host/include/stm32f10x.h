@@ -0,0 +1,66 @@
+#ifndef __HOST_STM32F10X_H
+#define __HOST_STM32F10X_H
+
+/*
+ * 主机端的器件头文件：类型、寄存器位定义和标准库声明都用工程里的原文件，
+ * 只把外设基地址换成stm32_host.c中的模拟实例，关中断换成Host_Primask
+ */
+
+#ifndef STM32F10X_MD
+#define STM32F10X_MD
+#endif
+#ifndef USE_STDPERIPH_DRIVER
+#define USE_STDPERIPH_DRIVER
+#endif
+
+#include "../../Start/stm32f10x.h"
+#include "stm32_host.h"
+
+#undef GPIOA
+#undef GPIOB
+#undef GPIOC
+#undef AFIO
+#undef SPI1
+#undef USART1
+#undef TIM2
+#undef TIM3
+#undef TIM4
+#undef CRC
+#undef DMA1
+#undef DMA1_Channel1
+#undef DMA1_Channel2
+#undef DMA1_Channel3
+#undef DMA1_Channel4
+#undef DMA1_Channel5
+#undef DMA1_Channel6
+#undef DMA1_Channel7
+
+#define GPIOA				(&Host_GPIOA)
+#define GPIOB				(&Host_GPIOB)
+#define GPIOC				(&Host_GPIOC)
+#define AFIO				(&Host_AFIO)
+#define SPI1				(&Host_SPI1)
+#define USART1				(&Host_USART1)
+#define TIM2				(Host_Tim2Service(), &Host_TIM2)	//访问前调用Host_Tim2Hook（测试中模拟计数和溢出）
+#define TIM3				(&Host_TIM3)
+#define TIM4				(&Host_TIM4)
+#define CRC					(Host_CrcService(), &Host_CRC)		//访问前处理上一次的写入
+
+//每次访问DMA寄存器前先推进模拟的DMA（处理IFCR、完成到时的传输）
+#define DMA1				(Host_DmaService(), &Host_DMA1)
+#define DMA1_Channel1		(Host_DmaService(), &Host_DMA1_Channel[1])
+#define DMA1_Channel2		(Host_DmaService(), &Host_DMA1_Channel[2])
+#define DMA1_Channel3		(Host_DmaService(), &Host_DMA1_Channel[3])
+#define DMA1_Channel4		(Host_DmaService(), &Host_DMA1_Channel[4])
+#define DMA1_Channel5		(Host_DmaService(), &Host_DMA1_Channel[5])
+#define DMA1_Channel6		(Host_DmaService(), &Host_DMA1_Channel[6])
+#define DMA1_Channel7		(Host_DmaService(), &Host_DMA1_Channel[7])
+
+#undef __disable_irq
+#undef __enable_irq
+#define __get_PRIMASK()		(Host_Primask)
+#define __set_PRIMASK(m)	Host_SetPrimask(m)
+#define __disable_irq()		(Host_Primask = 1)
+#define __enable_irq()		Host_SetPrimask(0)
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef __SYS_H
+#define __SYS_H
+#include "stm32f10x.h"
+
+//主机端的System/sys.h：位带IO映射到Host_PinOut/Host_PinIn，DWT周期计数器映射到模拟时钟
+
+#define PAout(n)	(Host_PinOut[0][n])
+#define PAin(n)		(Host_PinIn[0][n])
+
+#define PBout(n)	(Host_PinOut[1][n])
+#define PBin(n)		(Host_PinIn[1][n])
+
+#define PCout(n)	(Host_PinOut[2][n])
+#define PCin(n)		(Host_PinIn[2][n])
+
+//每次读取推进几个周期，忙等DWT的循环可以结束
+#define DWT_CTRL			(Host_DwtCtrl)
+#define DWT_CYCCNT			(*Host_Dwt())
+#define DWT_CTRL_CYCCNTENA	0x00000001
+
+extern volatile uint32_t Host_DwtCtrl;
+
+#define RAMFUNC
+
+void NVIC_Configuration(void);
+void RCC_Configuration(void);
+void DWT_Init(void);
+
+#endif
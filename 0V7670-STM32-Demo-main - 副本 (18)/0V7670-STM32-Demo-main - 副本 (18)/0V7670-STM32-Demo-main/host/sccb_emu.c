@@ -0,0 +1,175 @@
+#include "stm32f10x.h"
+#include "sccb_emu.h"
+#include <string.h>
+
+uint8_t SccbEmu_Reg[256];
+uint8_t SccbEmu_Nack[256];
+uint8_t SccbEmu_Drop[256];
+uint8_t SccbEmu_Mask[256];
+
+uint32_t SccbEmu_Errors;
+uint32_t SccbEmu_Writes, SccbEmu_Reads;
+uint32_t SccbEmu_Nacks;
+uint32_t SccbEmu_Starts;
+uint32_t SccbEmu_MinLow, SccbEmu_MinHigh;
+
+#define SCCB_EMU_ID		0x42
+
+enum { ST_IDLE, ST_RX, ST_TX, ST_STOP };		//ST_STOP：本次传输结束，等待停止条件
+
+static uint8_t Scl, Sda;						//上一次采样时的总线电平
+static uint8_t Drive;							//1=从机拉低SDA
+static uint8_t State, Next, Bits, Shift, Byte, Tx, Cur;
+static uint64_t Edge;							//上一个SCL边沿的时间
+
+//收到一个字节（第8个时钟之后），返回1为应答，Next为第9个时钟之后的状态
+static uint8_t SccbEmu_Receive(uint8_t b)
+{
+	uint8_t ack = 1;
+
+	Next = ST_STOP;
+	if(Byte == 0)
+	{
+		if((b & 0xFE) != SCCB_EMU_ID)
+			ack = 0;
+		else if(b & 1)
+		{
+			Tx = SccbEmu_Reg[Cur] & SccbEmu_Mask[Cur];
+			Next = ST_TX;
+		}
+		else
+			Next = ST_RX;
+	}
+	else if(Byte == 1)
+	{
+		Cur = b;
+		Next = ST_RX;
+	}
+	else if(SccbEmu_Nack[Cur])
+	{
+		if(SccbEmu_Nack[Cur] != 0xFF) SccbEmu_Nack[Cur]--;
+		SccbEmu_Nacks++;
+		ack = 0;
+	}
+	else
+	{
+		if(SccbEmu_Drop[Cur])
+			SccbEmu_Drop[Cur]--;
+		else
+			SccbEmu_Reg[Cur] = b;
+		SccbEmu_Writes++;
+	}
+	Byte++;
+	return ack;
+}
+
+//SCL上升沿：主机或从机的数据位在此被采样
+static void SccbEmu_Rise(uint8_t sda)
+{
+	if(State == ST_RX)
+	{
+		if(Bits < 8)
+			Shift = (uint8_t)(Shift << 1) | sda;
+		Bits++;
+	}
+	else if(State == ST_TX)
+	{
+		if(Bits++ < 8) return;
+		if(!sda) SccbEmu_Errors++;				//读出一个字节后主机应发NACK
+		SccbEmu_Reads++;
+		State = ST_STOP;
+	}
+}
+
+//SCL下降沿：从机在此改变SDA
+static void SccbEmu_Fall(void)
+{
+	if(State == ST_RX)
+	{
+		if(Bits == 8)
+			Drive = SccbEmu_Receive(Shift);
+		else if(Bits == 9)
+		{
+			Drive = 0;
+			State = Next;
+			Bits = Shift = 0;
+			if(State == ST_TX) Drive = !(Tx & 0x80);
+		}
+	}
+	else if(State == ST_TX)
+	{
+		Drive = Bits < 8 ? !((Tx >> (7 - Bits)) & 1) : 0;
+	}
+}
+
+static void SccbEmu_Tick(void)
+{
+	uint8_t scl = Host_PinOut[0][0];
+	uint8_t out = (Host_GPIOA.CRL & 0xF0) != 0x80;		//SDA为推挽输出
+	uint8_t sda;
+	uint32_t t;
+
+	if(scl != Scl)
+	{
+		t = (uint32_t)(Host_Cycles - Edge);
+		Edge = Host_Cycles;
+		if(State != ST_IDLE)
+		{
+			if(scl && t < SccbEmu_MinLow) SccbEmu_MinLow = t;
+			if(!scl && t < SccbEmu_MinHigh) SccbEmu_MinHigh = t;
+		}
+		if(!scl) SccbEmu_Fall();
+	}
+
+	if(out)
+	{
+		sda = Host_PinOut[0][1];
+		if(Drive && sda) SccbEmu_Errors++;				//主机输出高电平时从机拉低
+	}
+	else
+		sda = !Drive;
+	Host_PinIn[0][1] = sda;
+
+	if(scl && !Scl)
+		SccbEmu_Rise(sda);
+	else if(scl && Scl && sda != Sda)
+	{
+		if(!sda)										//起始
+		{
+			if(State == ST_RX || State == ST_TX) SccbEmu_Errors++;
+			SccbEmu_Starts++;
+			State = ST_RX;
+			Bits = Shift = Byte = 0;
+			Drive = 0;
+		}
+		else											//停止
+		{
+			if((State == ST_RX && Bits > 1) || State == ST_TX) SccbEmu_Errors++;	//停止条件前的一个时钟不是数据位
+			State = ST_IDLE;
+		}
+	}
+	Scl = scl;
+	Sda = sda;
+}
+
+void SccbEmu_ClearFaults(void)
+{
+	memset(SccbEmu_Nack, 0, sizeof(SccbEmu_Nack));
+	memset(SccbEmu_Drop, 0, sizeof(SccbEmu_Drop));
+	memset(SccbEmu_Mask, 0xFF, sizeof(SccbEmu_Mask));
+}
+
+void SccbEmu_Attach(void)
+{
+	memset(SccbEmu_Reg, 0, sizeof(SccbEmu_Reg));
+	SccbEmu_ClearFaults();
+	SccbEmu_Errors = SccbEmu_Writes = SccbEmu_Reads = SccbEmu_Nacks = SccbEmu_Starts = 0;
+	SccbEmu_MinLow = SccbEmu_MinHigh = 0xFFFFFFFF;
+	State = ST_IDLE;
+	Drive = 0;
+	Scl = Host_PinOut[0][0];
+	Sda = 1;
+	Edge = Host_Cycles;
+	Host_PinIn[0][1] = 1;
+	Host_TickHook = SccbEmu_Tick;
+}
@@ -0,0 +1,35 @@
+#ifndef __SCCB_EMU_H
+#define __SCCB_EMU_H
+#include <stdint.h>
+
+/*
+ * SCCB从机模型（OV7670，器件ID 0x42），在Host_TickHook中采样SCL=PA0、SDA=PA1，
+ * SDA方向按GPIOA->CRL判断（输入时总线上拉为高，从机拉低时PAin(1)读到0）
+ *
+ *   写：起始、0x42、寄存器地址、数据、停止
+ *   读：起始、0x42、寄存器地址、停止，起始、0x43、读出数据、主机NACK、停止（不支持重复起始）
+ *   检查：SCL高电平期间SDA变化以外的起始/停止位置、读数据后主机ACK、
+ *         主机和从机同时驱动SDA，出错时SccbEmu_Errors加一
+ *   时序：记录SCL高、低电平的最短时间（周期），测试与SCCB_SetTiming的设置比较
+ *
+ * 故障注入（SccbEmu_ClearFaults清除）：
+ *   SccbEmu_Nack[reg]    写该寄存器时数据字节NACK的次数，0xFF为一直NACK
+ *   SccbEmu_Drop[reg]    写该寄存器时应答但不写入的次数（读回不一致）
+ *   SccbEmu_Mask[reg]    读回时与寄存器值相与（默认0xFF），不为0xFF时读回一直不一致
+ */
+
+extern uint8_t SccbEmu_Reg[256];
+extern uint8_t SccbEmu_Nack[256];
+extern uint8_t SccbEmu_Drop[256];
+extern uint8_t SccbEmu_Mask[256];
+
+extern uint32_t SccbEmu_Errors;
+extern uint32_t SccbEmu_Writes, SccbEmu_Reads;		//完成的写入、读出
+extern uint32_t SccbEmu_Nacks;						//数据字节NACK的次数
+extern uint32_t SccbEmu_Starts;						//起始条件的次数（总线上的全部传输）
+extern uint32_t SccbEmu_MinLow, SccbEmu_MinHigh;	//SCL低、高电平的最短时间（周期）
+
+void SccbEmu_Attach(void);		//上电：寄存器清零，计数清零，接到Host_TickHook
+void SccbEmu_ClearFaults(void);
+
+#endif
@@ -0,0 +1,407 @@
+#include "stm32f10x.h"
+#include "SDdriver.h"
+#include "sd_emu.h"
+#include <string.h>
+
+uint8_t SdEmu_NoResponse;
+uint8_t SdEmu_StuckBusy;
+uint8_t SdEmu_WriteResp;
+uint8_t SdEmu_ReadToken;
+
+uint16_t SdEmu_ReadLatency = 20;
+uint32_t SdEmu_ProgCycles = 72 * 300;			//每块编程300us
+
+uint32_t SdEmu_Errors;
+uint32_t SdEmu_CmdCount[64 + 64];
+uint8_t SdEmu_Log[64];
+uint8_t SdEmu_LogLen;
+uint32_t SdEmu_PreErase;
+uint32_t SdEmu_BlocksRead, SdEmu_BlocksWritten;
+uint32_t SdEmu_DmaBytes;
+
+void (*SdEmu_ReadHook)(uint32_t sector);
+void (*SdEmu_WriteHook)(uint32_t sector);
+
+static uint8_t Disk[SD_EMU_SECTORS][512];
+
+enum { MODE_CMD, MODE_READ_MULTI, MODE_WRITE_TOKEN, MODE_WRITE_DATA };
+
+static uint8_t Hc, Idle, App, Mode, Multi, Polls;
+static uint8_t Cmd[6], CmdLen;
+static uint8_t Out[600];
+static uint16_t OutLen, OutPos;
+static uint64_t BusyUntil, PendingBusy;
+static uint32_t Addr;
+static uint8_t WriteBuf[514];
+static uint16_t WritePos;
+
+//DMA：按SPI时钟逐字节推进
+static uint8_t DmaActive;
+static uint16_t DmaLen;
+static uint64_t DmaNext;
+
+static void Push(uint8_t b)
+{
+	if(OutLen < sizeof(Out)) Out[OutLen++] = b;
+}
+
+static void Respond(uint8_t r1)
+{
+	Push(0xFF);							//NCR：命令后一个字节再应答
+	Push(r1);
+}
+
+static void QueueData(const uint8_t *data, uint16_t len)
+{
+	uint16_t i;
+
+	for(i = 0; i < SdEmu_ReadLatency; i++) Push(0xFF);
+	if(SdEmu_ReadToken == 0xFF) return;
+	if(SdEmu_ReadToken)
+	{
+		Push(SdEmu_ReadToken);
+		return;
+	}
+	Push(0xFE);
+	memcpy(Out + OutLen, data, len);
+	OutLen += len;
+	Push(0x5A);							//CRC，驱动不检查
+	Push(0xA5);
+}
+
+static void QueueBlock(void)
+{
+	if(Addr >= SD_EMU_SECTORS)
+	{
+		Push(0x09);						//错误令牌：地址超出范围
+		return;
+	}
+	QueueData(Disk[Addr], 512);
+	if(!SdEmu_ReadToken)
+	{
+		SdEmu_BlocksRead++;
+		if(SdEmu_ReadHook) SdEmu_ReadHook(Addr);
+	}
+	Addr++;
+}
+
+//数据命令的地址，超出范围时应答ADDRESS_ERROR
+static uint8_t Address(uint32_t arg)
+{
+	if(!Hc)
+	{
+		if(arg & 511) SdEmu_Errors++;
+		arg >>= 9;
+	}
+	Addr = arg;
+	return arg < SD_EMU_SECTORS ? 0x00 : MSD_ADDRESS_ERROR;
+}
+
+static void Csd(uint8_t *csd)
+{
+	uint32_t size;
+
+	memset(csd, 0, 16);
+	csd[3] = 0x32;									//TRAN_SPEED 25MHz
+	csd[5] = 0x59;									//CCC，READ_BL_LEN=9
+	csd[15] = 0x01;
+	if(Hc)
+	{
+		size = SD_EMU_SECTORS / 1024 - 1;			//(C_SIZE+1)*512KB
+		csd[0] = 0x40;
+		csd[7] = (uint8_t)(size >> 16) & 0x3F;
+		csd[8] = (uint8_t)(size >> 8);
+		csd[9] = (uint8_t)size;
+	}
+	else
+	{
+		size = SD_EMU_SECTORS / 512 - 1;			//C_SIZE_MULT=7：(C_SIZE+1)*512个扇区
+		csd[6] = (uint8_t)(size >> 10) & 0x03;
+		csd[7] = (uint8_t)(size >> 2);
+		csd[8] = (uint8_t)(size << 6);
+		csd[9] = 0x03;
+		csd[10] = 0x80;
+	}
+}
+
+static void Command(void)
+{
+	static const uint8_t cid[16] = {0x03, 'S', 'D', 'E', 'M', 'U', 'L', 0x10, 0x12, 0x34, 0x56, 0x78, 0x01, 0x8A, 0x00, 0x01};
+	uint8_t cmd = Cmd[0] & 0x3F, app = App;
+	uint32_t arg = (uint32_t)Cmd[1] << 24 | (uint32_t)Cmd[2] << 16 | (uint32_t)Cmd[3] << 8 | Cmd[4];
+	uint8_t idle = Idle ? MSD_IN_IDLE_STATE : 0;
+	uint8_t buf[16];
+
+	App = 0;
+	OutLen = OutPos = 0;
+	SdEmu_CmdCount[(app ? 64 : 0) + cmd]++;
+	if(SdEmu_LogLen < sizeof(SdEmu_Log)) SdEmu_Log[SdEmu_LogLen++] = (app ? 0x80 : 0) | cmd;
+
+	if(cmd == CMD12)
+	{
+		if(Mode != MODE_READ_MULTI)
+		{
+			Respond(MSD_ILLEGAL_COMMAND);
+			return;
+		}
+		Mode = MODE_CMD;
+		Push(0xFF);						//填充字节
+		Respond(0x00);
+		PendingBusy = 72 * 20;
+		return;
+	}
+	if(Mode == MODE_READ_MULTI || Host_Cycles < BusyUntil) SdEmu_Errors++;
+	if(Idle && ((Host_SPI1.CR1 & SPI_CR1_BR) >> 3) != 7) SdEmu_Errors++;		//识别阶段须低于400kHz
+
+	switch(cmd)
+	{
+	case CMD0:
+		if(Cmd[5] != 0x95) { SdEmu_Errors++; Respond(MSD_COM_CRC_ERROR | idle); break; }
+		Idle = 1;
+		Polls = 0;
+		Respond(MSD_IN_IDLE_STATE);
+		break;
+	case CMD8:
+		if(Cmd[5] != 0x87) { SdEmu_Errors++; Respond(MSD_COM_CRC_ERROR | idle); break; }
+		Respond(idle);
+		Push(0x00);
+		Push(0x00);
+		Push((uint8_t)(arg >> 8) & 0x0F);
+		Push((uint8_t)arg);
+		break;
+	case CMD55:
+		App = 1;
+		Respond(idle);
+		break;
+	case 41:
+		if(!app) { SdEmu_Errors++; Respond(MSD_ILLEGAL_COMMAND | idle); break; }
+		//SDHC要求主机声明HCS，否则一直停在空闲状态；其他卡ACMD41轮询几次后完成初始化
+		if(!Hc || (arg & 0x40000000)) { if(++Polls > 4) Idle = 0; }
+		Respond(Idle ? MSD_IN_IDLE_STATE : 0);
+		break;
+	case CMD58:
+		Respond(idle);
+		Push(0x80 | (Hc ? 0x40 : 0));
+		Push(0xFF);
+		Push(0x80);
+		Push(0x00);
+		break;
+	case CMD16:
+		Respond(arg == 512 ? idle : (idle | MSD_PARAMETER_ERROR));
+		break;
+	case CMD9:
+	case CMD10:
+		if(Idle) { Respond(MSD_ILLEGAL_COMMAND | idle); break; }
+		Respond(0x00);
+		if(cmd == CMD9) Csd(buf); else memcpy(buf, cid, 16);
+		QueueData(buf, 16);
+		break;
+	case CMD17:
+	case CMD18:
+		if(Idle) { Respond(MSD_ILLEGAL_COMMAND | idle); break; }
+		Respond(Address(arg));
+		if(OutLen && Out[OutLen - 1]) break;
+		QueueBlock();
+		if(cmd == CMD18) Mode = MODE_READ_MULTI;
+		break;
+	case 23:
+		if(!app || Idle) { Respond(MSD_ILLEGAL_COMMAND | idle); break; }
+		SdEmu_PreErase = arg;
+		Respond(0x00);
+		break;
+	case CMD24:
+	case CMD25:
+		if(Idle) { Respond(MSD_ILLEGAL_COMMAND | idle); break; }
+		Respond(Address(arg));
+		if(Out[OutLen - 1]) break;
+		Mode = MODE_WRITE_TOKEN;
+		Multi = cmd == CMD25;
+		break;
+	default:
+		Respond(MSD_ILLEGAL_COMMAND | idle);
+		break;
+	}
+}
+
+//数据块收完：回数据响应，然后忙
+static void BlockReceived(void)
+{
+	uint8_t resp = SdEmu_WriteResp ? SdEmu_WriteResp : MSD_DATA_OK;
+
+	if(resp == MSD_DATA_OK)
+	{
+		if(Addr < SD_EMU_SECTORS)
+		{
+			memcpy(Disk[Addr], WriteBuf, 512);
+			if(SdEmu_WriteHook) SdEmu_WriteHook(Addr);
+		}
+		else
+		{
+			resp = MSD_DATA_WRITE_ERROR;
+		}
+		Addr++;
+		SdEmu_BlocksWritten++;
+	}
+	OutLen = OutPos = 0;
+	Push(resp);
+	PendingBusy = SdEmu_StuckBusy ? ~0ULL : Multi ? SdEmu_ProgCycles / 8 : SdEmu_ProgCycles;	//多块写入时卡内有缓冲
+	Mode = Multi && resp == MSD_DATA_OK ? MODE_WRITE_TOKEN : MODE_CMD;
+}
+
+//SPI上的一个字节：tx为主机发出的字节，返回同时从DO收到的字节
+static uint8_t SdEmu_Byte(uint8_t tx)
+{
+	uint8_t b;
+
+	if(Host_GPIOA.ODR & GPIO_Pin_4)
+	{
+		//释放片选：丢弃没发完的应答
+		CmdLen = 0;
+		OutLen = OutPos = 0;
+		if(Mode == MODE_READ_MULTI) Mode = MODE_CMD;
+		return 0xFF;
+	}
+	if(SdEmu_NoResponse) return 0xFF;
+
+	if(Mode == MODE_WRITE_DATA)
+	{
+		WriteBuf[WritePos++] = tx;
+		if(WritePos == sizeof(WriteBuf)) BlockReceived();
+		return 0xFF;
+	}
+
+	if(Mode != MODE_WRITE_TOKEN && (CmdLen || (tx & 0xC0) == 0x40))
+	{
+		Cmd[CmdLen++] = tx;
+		if(CmdLen == 6)
+		{
+			CmdLen = 0;
+			Command();
+		}
+		return 0xFF;
+	}
+
+	if(OutPos < OutLen)
+	{
+		b = Out[OutPos++];
+		if(OutPos == OutLen)
+		{
+			OutLen = OutPos = 0;
+			if(PendingBusy) BusyUntil = PendingBusy == ~0ULL ? ~0ULL : Host_Cycles + PendingBusy;
+			PendingBusy = 0;
+			if(Mode == MODE_READ_MULTI) QueueBlock();
+		}
+		return b;
+	}
+
+	if(Host_Cycles < BusyUntil) return 0x00;
+
+	if(Mode == MODE_WRITE_TOKEN)
+	{
+		if(tx == (Multi ? 0xFC : 0xFE))
+		{
+			Mode = MODE_WRITE_DATA;
+			WritePos = 0;
+		}
+		else if(tx == 0xFD && Multi)
+		{
+			Mode = MODE_CMD;
+			BusyUntil = SdEmu_StuckBusy ? ~0ULL : Host_Cycles + 100 + SdEmu_ProgCycles;	//停止令牌后约一个字节开始忙
+		}
+		else if(tx != 0xFF)
+		{
+			SdEmu_Errors++;
+		}
+	}
+	return 0xFF;
+}
+
+static uint8_t SdEmu_Spi(uint8_t tx)
+{
+	if(DmaActive) SdEmu_Errors++;			//DMA传输中不能再查询收发
+	return SdEmu_Byte(tx);
+}
+
+/*
+ * SPI1的DMA：CR2的RXDMAEN和TXDMAEN都打开、两个通道都使能后开始，
+ * 每字节8<<(BR+1)个周期，收完最后一个字节置TC2/TC3
+ */
+static void SdEmu_Dma(void)
+{
+	DMA_Channel_TypeDef *rx = &Host_DMA1_Channel[2], *tx = &Host_DMA1_Channel[3];
+	uint32_t byte = 8UL << (((Host_SPI1.CR1 & SPI_CR1_BR) >> 3) + 1);
+	uint16_t i;
+	uint8_t r;
+
+	if(!DmaActive)
+	{
+		if(!(Host_SPI1.CR2 & SPI_I2S_DMAReq_Tx) || !(tx->CCR & DMA_CCR3_EN) || tx->CNDTR == 0) return;
+		if(!(Host_SPI1.CR2 & SPI_I2S_DMAReq_Rx) || !(rx->CCR & DMA_CCR2_EN) || rx->CNDTR != tx->CNDTR
+			|| rx->CPAR != (uint32_t)&Host_SPI1.DR || tx->CPAR != (uint32_t)&Host_SPI1.DR
+			|| (rx->CCR & DMA_CCR2_DIR) || !(tx->CCR & DMA_CCR3_DIR)
+			|| (rx->CCR & (DMA_CCR2_PSIZE | DMA_CCR2_MSIZE)) || (tx->CCR & (DMA_CCR3_PSIZE | DMA_CCR3_MSIZE)))
+		{
+			SdEmu_Errors++;
+			return;
+		}
+		DmaActive = 1;
+		DmaLen = tx->CNDTR;
+		DmaNext = Host_Cycles + byte;
+	}
+
+	while(DmaActive && Host_Cycles >= DmaNext)
+	{
+		i = DmaLen - tx->CNDTR;
+		r = SdEmu_Byte(((uint8_t *)Host_DmaPtr(tx->CMAR))[(tx->CCR & DMA_CCR3_MINC) ? i : 0]);
+		((uint8_t *)Host_DmaPtr(rx->CMAR))[(rx->CCR & DMA_CCR2_MINC) ? i : 0] = r;
+		tx->CNDTR--;
+		rx->CNDTR--;
+		SdEmu_DmaBytes++;
+		DmaNext += byte;
+		if(tx->CNDTR == 0)
+		{
+			DmaActive = 0;
+			Host_DMA1.ISR |= DMA1_FLAG_TC2 | DMA1_FLAG_GL2 | DMA1_FLAG_TC3 | DMA1_FLAG_GL3;
+		}
+	}
+}
+
+void SdEmu_Attach(uint8_t hc)
+{
+	Hc = hc;
+	Idle = 1;
+	App = 0;
+	Mode = MODE_CMD;
+	Polls = 0;
+	CmdLen = 0;
+	OutLen = OutPos = 0;
+	BusyUntil = PendingBusy = 0;
+	DmaActive = 0;
+	SdEmu_Errors = 0;
+	memset(SdEmu_CmdCount, 0, sizeof(SdEmu_CmdCount));
+	SdEmu_LogLen = 0;
+	SdEmu_PreErase = 0;
+	SdEmu_BlocksRead = SdEmu_BlocksWritten = 0;
+	SdEmu_DmaBytes = 0;
+	SdEmu_ReadHook = 0;
+	SdEmu_WriteHook = 0;
+	SdEmu_ClearFaults();
+	Host_GPIOA.ODR |= GPIO_Pin_4;
+	Host_SpiHook = SdEmu_Spi;
+	Host_DmaHook = SdEmu_Dma;
+}
+
+void SdEmu_ClearFaults(void)
+{
+	SdEmu_NoResponse = 0;
+	SdEmu_StuckBusy = 0;
+	SdEmu_WriteResp = 0;
+	SdEmu_ReadToken = 0;
+	BusyUntil = 0;
+	PendingBusy = 0;
+}
+
+uint8_t *SdEmu_Sector(uint32_t sector)
+{
+	return Disk[sector];
+}
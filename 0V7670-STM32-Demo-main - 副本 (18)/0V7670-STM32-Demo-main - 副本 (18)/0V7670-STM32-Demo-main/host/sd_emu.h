@@ -0,0 +1,48 @@
+#ifndef __SD_EMU_H
+#define __SD_EMU_H
+#include <stdint.h>
+
+/*
+ * SPI模式SD卡模型，接在模拟的SPI1（查询和DMA1通道2/3）上，片选为PA4
+ *
+ *   命令：CMD0/8/9/10/12/16/17/18/24/25/55/58，ACMD23/41
+ *   时序：读数据令牌前有SdEmu_ReadLatency个0xFF，单块写入和多块停止后忙SdEmu_ProgCycles个周期，
+ *         多块写入每块之间忙其1/8
+ *   检查：识别阶段SPI时钟超过400kHz、ACMD41前没有CMD55、CMD0/CMD8的CRC、
+ *         SDSC字节地址不对齐、卡忙时发命令、DMA通道配置，出错时SdEmu_Errors加一
+ *
+ * 故障注入（SdEmu_ClearFaults清除）：
+ *   SdEmu_NoResponse   卡不应答，DO一直为高
+ *   SdEmu_StuckBusy    下一次写入后一直忙
+ *   SdEmu_WriteResp    数据响应，0为正常的0x05，0x0B为CRC错误，0x0D为写错误
+ *   SdEmu_ReadToken    读数据令牌，0为正常的0xFE，0xFF为不发令牌，其他为错误令牌
+ */
+
+#ifndef SD_EMU_SECTORS
+#define SD_EMU_SECTORS		8192				//4MB，须为1024的倍数
+#endif
+
+extern uint8_t SdEmu_NoResponse;
+extern uint8_t SdEmu_StuckBusy;
+extern uint8_t SdEmu_WriteResp;
+extern uint8_t SdEmu_ReadToken;
+
+extern uint16_t SdEmu_ReadLatency;
+extern uint32_t SdEmu_ProgCycles;
+
+extern uint32_t SdEmu_Errors;
+extern uint32_t SdEmu_CmdCount[64 + 64];			//[cmd]，ACMD在[64 + cmd]
+extern uint8_t SdEmu_Log[64];						//上电后的命令顺序，ACMD加0x80
+extern uint8_t SdEmu_LogLen;
+extern uint32_t SdEmu_PreErase;						//最后一次ACMD23的参数
+extern uint32_t SdEmu_BlocksRead, SdEmu_BlocksWritten;
+extern uint32_t SdEmu_DmaBytes;
+
+extern void (*SdEmu_ReadHook)(uint32_t sector);	//每读出/写入一个扇区调用（写入在卡接受数据时）
+extern void (*SdEmu_WriteHook)(uint32_t sector);
+
+void SdEmu_Attach(uint8_t hc);		//上电（hc=1为SDHC，0为字节寻址的SDSC V2），接到Host_SpiHook/Host_DmaHook
+void SdEmu_ClearFaults(void);
+uint8_t *SdEmu_Sector(uint32_t sector);
+
+#endif
@@ -0,0 +1,334 @@
+#include "stm32f10x.h"
+#include "sys.h"
+#include "delay.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+uint32_t SystemCoreClock = 72000000;
+
+uint64_t Host_Cycles;
+volatile uint32_t Host_Primask;
+volatile uint32_t Host_DwtCtrl;
+uint8_t Host_PinOut[3][16];
+uint8_t Host_PinIn[3][16];
+
+void (*Host_TickHook)(void);
+void (*Host_DmaHook)(void);
+uint8_t (*Host_SpiHook)(uint8_t tx);
+void (*Host_GpioHook)(void);
+void (*Host_IrqHook)(void);
+void (*Host_Tim2Hook)(void);
+
+GPIO_TypeDef Host_GPIOA, Host_GPIOB, Host_GPIOC;
+AFIO_TypeDef Host_AFIO;
+SPI_TypeDef Host_SPI1;
+USART_TypeDef Host_USART1;
+TIM_TypeDef Host_TIM2, Host_TIM3, Host_TIM4;
+DMA_TypeDef Host_DMA1;
+DMA_Channel_TypeDef Host_DMA1_Channel[8];
+Host_CrcTypeDef Host_CRC;
+uint32_t Host_CrcWords;
+
+static volatile uint32_t Host_DwtValue;
+static uint8_t Host_InTick, Host_InDma, Host_InIrq, Host_InTim2;
+static uint16_t Host_SpiLast;
+static uint32_t Host_CrcValue;
+
+extern char __executable_start;
+
+void Host_Reset(void)
+{
+	Host_Cycles = 0;
+	Host_Primask = 0;
+	memset(Host_PinOut, 0, sizeof(Host_PinOut));
+	memset(Host_PinIn, 0, sizeof(Host_PinIn));
+	Host_TickHook = 0;
+	Host_DmaHook = 0;
+	Host_SpiHook = 0;
+	Host_GpioHook = 0;
+	Host_IrqHook = 0;
+	Host_Tim2Hook = 0;
+	memset(&Host_GPIOA, 0, sizeof(Host_GPIOA));
+	memset(&Host_GPIOB, 0, sizeof(Host_GPIOB));
+	memset(&Host_GPIOC, 0, sizeof(Host_GPIOC));
+	memset(&Host_SPI1, 0, sizeof(Host_SPI1));
+	memset(&Host_USART1, 0, sizeof(Host_USART1));
+	memset(&Host_TIM2, 0, sizeof(Host_TIM2));
+	memset(&Host_TIM3, 0, sizeof(Host_TIM3));
+	memset(&Host_TIM4, 0, sizeof(Host_TIM4));
+	memset(&Host_DMA1, 0, sizeof(Host_DMA1));
+	memset(Host_DMA1_Channel, 0, sizeof(Host_DMA1_Channel));
+	memset(&Host_CRC, 0, sizeof(Host_CRC));
+	Host_CrcValue = 0xFFFFFFFF;
+	Host_CRC.DR = (1ULL << 32) | Host_CrcValue;
+	Host_CrcWords = 0;
+}
+
+//中断函数中不再响应中断（不模拟嵌套）
+static void Host_Irq(void)
+{
+	if(Host_IrqHook && !Host_InIrq && Host_Primask == 0)
+	{
+		Host_InIrq = 1;
+		Host_IrqHook();
+		Host_InIrq = 0;
+	}
+}
+
+//推进时钟；钩子中再推进时钟不会重入
+void Host_Advance(uint32_t cycles)
+{
+	Host_Cycles += cycles;
+	if(Host_TickHook && !Host_InTick)
+	{
+		Host_InTick = 1;
+		Host_TickHook();
+		Host_InTick = 0;
+	}
+	Host_Irq();
+}
+
+void Host_SetPrimask(uint32_t primask)
+{
+	Host_Primask = primask;
+	Host_Irq();
+}
+
+volatile uint32_t *Host_Dwt(void)
+{
+	Host_Advance(4);
+	Host_DwtValue = (uint32_t)Host_Cycles;
+	return &Host_DwtValue;
+}
+
+//IFCR写1清除：CGIFx清除该通道全部4个标志
+void Host_DmaService(void)
+{
+	uint32_t ifcr = Host_DMA1.IFCR;
+	uint8_t ch;
+
+	Host_DMA1.IFCR = 0;
+	for(ch = 0; ch < 7; ch++)
+	{
+		if(ifcr & (1UL << (ch * 4))) ifcr |= 0xFUL << (ch * 4);
+	}
+	Host_DMA1.ISR &= ~ifcr;
+
+	Host_Advance(1);
+	if(Host_DmaHook && !Host_InDma)
+	{
+		Host_InDma = 1;
+		Host_DmaHook();
+		Host_InDma = 0;
+	}
+}
+
+void Host_Tim2Service(void)
+{
+	if(Host_Tim2Hook && !Host_InTim2)
+	{
+		Host_InTim2 = 1;
+		Host_Tim2Hook();
+		Host_InTim2 = 0;
+	}
+}
+
+//CRC外设：写入DR的字与当前值异或后按位左移32次（MSB优先），CR写RESET后DR回到0xFFFFFFFF
+void Host_CrcService(void)
+{
+	uint32_t crc = Host_CrcValue;
+	uint8_t i;
+
+	if(!(Host_CRC.DR >> 32))
+	{
+		crc ^= (uint32_t)Host_CRC.DR;
+		for(i = 0; i < 32; i++)
+			crc = (crc & 0x80000000) ? (crc << 1) ^ 0x04C11DB7 : crc << 1;
+		Host_CrcWords++;
+	}
+	if(Host_CRC.CR & CRC_CR_RESET)
+	{
+		crc = 0xFFFFFFFF;
+		Host_CRC.CR = 0;
+	}
+	Host_CrcValue = crc;
+	Host_CRC.DR = (1ULL << 32) | crc;
+}
+
+uint32_t __RBIT(uint32_t value)
+{
+	uint32_t r = 0;
+	uint8_t i;
+
+	for(i = 0; i < 32; i++, value >>= 1)
+		r = (r << 1) | (value & 1);
+	return r;
+}
+
+void *Host_DmaPtr(uint32_t addr)
+{
+	if((uintptr_t)addr < (uintptr_t)&__executable_start || (uintptr_t)addr >= (uintptr_t)sbrk(0))
+	{
+		printf("DMA address 0x%08lX outside the program image\n", (unsigned long)addr);
+		exit(2);
+	}
+	return (void *)(uintptr_t)addr;
+}
+
+/* System/delay.c */
+void delay_us(u32 us)	{ Host_Advance(us * (SystemCoreClock / 1000000)); }
+void delay_ms(u16 ms)	{ while(ms--) delay_us(1000); }
+void delay_s(u16 s)		{ while(s--) delay_ms(1000); }
+
+/* System/sys.c */
+void DWT_Init(void)				{ Host_DwtCtrl |= DWT_CTRL_CYCCNTENA; }
+void NVIC_Configuration(void)	{ }
+void RCC_Configuration(void)	{ }
+
+/* GPIO */
+static uint8_t Host_Port(GPIO_TypeDef *GPIOx)
+{
+	return GPIOx == &Host_GPIOA ? 0 : GPIOx == &Host_GPIOB ? 1 : 2;
+}
+
+void GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_InitStruct) { (void)GPIOx; (void)GPIO_InitStruct; }
+
+void GPIO_SetBits(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	uint8_t n;
+	GPIOx->ODR |= GPIO_Pin;
+	for(n = 0; n < 16; n++) if(GPIO_Pin & (1 << n)) Host_PinOut[Host_Port(GPIOx)][n] = 1;
+	if(Host_GpioHook) Host_GpioHook();
+}
+
+void GPIO_ResetBits(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	uint8_t n;
+	GPIOx->ODR &= ~GPIO_Pin;
+	for(n = 0; n < 16; n++) if(GPIO_Pin & (1 << n)) Host_PinOut[Host_Port(GPIOx)][n] = 0;
+	if(Host_GpioHook) Host_GpioHook();
+}
+
+uint8_t GPIO_ReadInputDataBit(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin)
+{
+	return (GPIOx->IDR & GPIO_Pin) ? 1 : 0;
+}
+
+uint16_t GPIO_ReadInputData(GPIO_TypeDef *GPIOx) { return GPIOx->IDR; }
+void GPIO_PinRemapConfig(uint32_t GPIO_Remap, FunctionalState NewState) { (void)GPIO_Remap; (void)NewState; }
+void GPIO_EXTILineConfig(uint8_t GPIO_PortSource, uint8_t GPIO_PinSource) { (void)GPIO_PortSource; (void)GPIO_PinSource; }
+
+/* RCC / NVIC / EXTI */
+void RCC_APB1PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+void RCC_APB2PeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+void RCC_AHBPeriphClockCmd(uint32_t p, FunctionalState s) { (void)p; (void)s; }
+void RCC_MCOConfig(uint8_t src) { (void)src; }
+void NVIC_PriorityGroupConfig(uint32_t g) { (void)g; }
+void NVIC_Init(NVIC_InitTypeDef *n) { (void)n; }
+void EXTI_Init(EXTI_InitTypeDef *e) { (void)e; }
+void EXTI_ClearITPendingBit(uint32_t line) { (void)line; }
+ITStatus EXTI_GetITStatus(uint32_t line) { (void)line; return SET; }
+
+/* SPI：每字节按CR1的分频推进时钟，另加约30个周期的查询开销 */
+void SPI_Init(SPI_TypeDef *SPIx, SPI_InitTypeDef *i)
+{
+	SPIx->CR1 = i->SPI_Direction | i->SPI_Mode | i->SPI_DataSize | i->SPI_CPOL | i->SPI_CPHA
+	          | i->SPI_NSS | i->SPI_BaudRatePrescaler | i->SPI_FirstBit;
+}
+
+void SPI_Cmd(SPI_TypeDef *SPIx, FunctionalState s)
+{
+	if(s) SPIx->CR1 |= SPI_CR1_SPE; else SPIx->CR1 &= ~SPI_CR1_SPE;
+}
+
+void SPI_I2S_DMACmd(SPI_TypeDef *SPIx, uint16_t req, FunctionalState s)
+{
+	if(s) SPIx->CR2 |= req; else SPIx->CR2 &= ~req;
+}
+
+FlagStatus SPI_I2S_GetFlagStatus(SPI_TypeDef *SPIx, uint16_t flag) { (void)SPIx; (void)flag; return SET; }
+
+void SPI_I2S_SendData(SPI_TypeDef *SPIx, uint16_t data)
+{
+	uint32_t br = (SPIx->CR1 & SPI_CR1_BR) >> 3;
+	Host_Advance((8UL << (br + 1)) + 30);
+	Host_SpiLast = Host_SpiHook ? Host_SpiHook((uint8_t)data) : 0xFF;
+}
+
+uint16_t SPI_I2S_ReceiveData(SPI_TypeDef *SPIx) { (void)SPIx; return Host_SpiLast; }
+
+/* DMA */
+void DMA_DeInit(DMA_Channel_TypeDef *c)
+{
+	c->CCR = 0;
+	c->CNDTR = 0;
+	c->CPAR = 0;
+	c->CMAR = 0;
+}
+
+void DMA_Init(DMA_Channel_TypeDef *c, DMA_InitTypeDef *i)
+{
+	c->CCR = i->DMA_DIR | i->DMA_Mode | i->DMA_PeripheralInc | i->DMA_MemoryInc
+	       | i->DMA_PeripheralDataSize | i->DMA_MemoryDataSize | i->DMA_Priority | i->DMA_M2M;
+	c->CNDTR = i->DMA_BufferSize;
+	c->CPAR = i->DMA_PeripheralBaseAddr;
+	c->CMAR = i->DMA_MemoryBaseAddr;
+}
+
+void DMA_Cmd(DMA_Channel_TypeDef *c, FunctionalState s)
+{
+	if(s) c->CCR |= DMA_CCR1_EN; else c->CCR &= ~DMA_CCR1_EN;
+}
+
+void DMA_ITConfig(DMA_Channel_TypeDef *c, uint32_t it, FunctionalState s)
+{
+	if(s) c->CCR |= it; else c->CCR &= ~it;
+}
+
+void DMA_SetCurrDataCounter(DMA_Channel_TypeDef *c, uint16_t n) { c->CNDTR = n; }
+uint16_t DMA_GetCurrDataCounter(DMA_Channel_TypeDef *c) { return c->CNDTR; }
+FlagStatus DMA_GetFlagStatus(uint32_t flag) { return (DMA1->ISR & flag) ? SET : RESET; }
+void DMA_ClearFlag(uint32_t flag) { DMA1->IFCR = flag; }
+ITStatus DMA_GetITStatus(uint32_t it) { return (DMA1->ISR & it) ? SET : RESET; }
+void DMA_ClearITPendingBit(uint32_t it) { DMA1->IFCR = it; }
+
+/* USART */
+void USART_Init(USART_TypeDef *u, USART_InitTypeDef *i) { (void)u; (void)i; }
+void USART_Cmd(USART_TypeDef *u, FunctionalState s) { if(s) u->CR1 |= USART_CR1_UE; else u->CR1 &= ~USART_CR1_UE; }
+void USART_ITConfig(USART_TypeDef *u, uint16_t it, FunctionalState s) { (void)u; (void)it; (void)s; }
+void USART_DMACmd(USART_TypeDef *u, uint16_t req, FunctionalState s) { if(s) u->CR3 |= req; else u->CR3 &= ~req; }
+void USART_SendData(USART_TypeDef *u, uint16_t d) { u->DR = d; }
+uint16_t USART_ReceiveData(USART_TypeDef *u) { return u->DR; }
+FlagStatus USART_GetFlagStatus(USART_TypeDef *u, uint16_t f) { (void)u; (void)f; return SET; }
+ITStatus USART_GetITStatus(USART_TypeDef *u, uint16_t it) { (void)u; (void)it; return RESET; }
+void USART_ClearITPendingBit(USART_TypeDef *u, uint16_t it) { (void)u; (void)it; }
+
+/* TIM：溢出标志、计数器由测试直接操作寄存器 */
+void TIM_TimeBaseInit(TIM_TypeDef *t, TIM_TimeBaseInitTypeDef *i)
+{
+	t->ARR = i->TIM_Period;
+	t->PSC = i->TIM_Prescaler;
+	t->CNT = 0;
+}
+
+void TIM_TimeBaseStructInit(TIM_TimeBaseInitTypeDef *i) { memset(i, 0, sizeof(*i)); i->TIM_Period = 0xFFFF; }
+void TIM_OCStructInit(TIM_OCInitTypeDef *i) { memset(i, 0, sizeof(*i)); }
+void TIM_OC1Init(TIM_TypeDef *t, TIM_OCInitTypeDef *i) { t->CCR1 = i->TIM_Pulse; }
+void TIM_OC2Init(TIM_TypeDef *t, TIM_OCInitTypeDef *i) { t->CCR2 = i->TIM_Pulse; }
+void TIM_OC1PreloadConfig(TIM_TypeDef *t, uint16_t p) { (void)t; (void)p; }
+void TIM_OC2PreloadConfig(TIM_TypeDef *t, uint16_t p) { (void)t; (void)p; }
+void TIM_SelectOnePulseMode(TIM_TypeDef *t, uint16_t m) { if(m) t->CR1 |= TIM_CR1_OPM; else t->CR1 &= ~TIM_CR1_OPM; }
+void TIM_SelectOutputTrigger(TIM_TypeDef *t, uint16_t s) { (void)t; (void)s; }
+void TIM_SelectSlaveMode(TIM_TypeDef *t, uint16_t m) { (void)t; (void)m; }
+void TIM_SelectInputTrigger(TIM_TypeDef *t, uint16_t s) { (void)t; (void)s; }
+void TIM_SelectMasterSlaveMode(TIM_TypeDef *t, uint16_t m) { (void)t; (void)m; }
+void TIM_DMACmd(TIM_TypeDef *t, uint16_t s, FunctionalState n) { if(n) t->DIER |= s; else t->DIER &= ~s; }
+void TIM_ARRPreloadConfig(TIM_TypeDef *t, FunctionalState s) { (void)t; (void)s; }
+void TIM_Cmd(TIM_TypeDef *t, FunctionalState s) { if(s) t->CR1 |= TIM_CR1_CEN; else t->CR1 &= ~TIM_CR1_CEN; }
+void TIM_ITConfig(TIM_TypeDef *t, uint16_t it, FunctionalState s) { if(s) t->DIER |= it; else t->DIER &= ~it; }
+void TIM_ClearFlag(TIM_TypeDef *t, uint16_t f) { t->SR &= (uint16_t)~f; }
+FlagStatus TIM_GetFlagStatus(TIM_TypeDef *t, uint16_t f) { return (t->SR & f) ? SET : RESET; }
+ITStatus TIM_GetITStatus(TIM_TypeDef *t, uint16_t it) { return ((t->SR & it) && (t->DIER & it)) ? SET : RESET; }
+void TIM_ClearITPendingBit(TIM_TypeDef *t, uint16_t it) { t->SR &= (uint16_t)~it; }
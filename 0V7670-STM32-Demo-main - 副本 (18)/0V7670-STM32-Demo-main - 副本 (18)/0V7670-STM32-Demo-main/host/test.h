@@ -0,0 +1,18 @@
+#ifndef __TEST_H
+#define __TEST_H
+#include <stdio.h>
+
+//主机测试的检查宏：失败时打印位置继续执行，main返回TEST_RESULT()
+static int Test_Fails;
+
+#define CHECK(c) do { if(!(c)) { printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #c); Test_Fails++; } } while(0)
+#define CHECK_EQ(a, b) do { long long _a = (long long)(a), _b = (long long)(b); \
+	if(_a != _b) { printf("%s:%d: %s == %s failed (%lld != %lld)\n", __FILE__, __LINE__, #a, #b, _a, _b); Test_Fails++; } } while(0)
+
+#ifndef TEST_NAME
+#define TEST_NAME __FILE__
+#endif
+
+#define TEST_RESULT() (printf("%s: %s\n", TEST_NAME, Test_Fails ? "FAILED" : "OK"), Test_Fails != 0)
+
+#endif
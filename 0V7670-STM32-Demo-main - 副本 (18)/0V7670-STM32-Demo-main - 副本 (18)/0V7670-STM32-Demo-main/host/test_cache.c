@@ -0,0 +1,290 @@
+//user_diskio.c的写缓存：单扇区写入的命中/未命中、读取时用缓存中较新的内容、多扇区写入丢弃旧副本、
+//缓存满时最旧的扇区连同相邻扇区一次写出、CTRL_SYNC清空；
+//掉电一致性：在写入过程中的各个位置断电，重新挂载后已关闭的文件完整，簇不交叉链接
+#include "stm32f10x.h"
+#include "fatfs.h"
+#include "diskio.h"
+#include "user_diskio.h"
+#include "SDdriver.h"
+#include "sd_emu.h"
+#include "fs_host.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAW			(SD_EMU_SECTORS - 1000)		//文件系统用不到的扇区
+
+static uint8_t Sec[4][512], Back[3 * 512];
+
+static USER_CacheStatsTypeDef Stats(void)
+{
+	USER_CacheStatsTypeDef st;
+	CHECK_EQ(disk_ioctl(0, CTRL_CACHE_STATS, &st), RES_OK);
+	return st;
+}
+
+static void Test_HitMiss(void)
+{
+	USER_CacheStatsTypeDef st;
+	uint32_t written, c25;
+	uint8_t i;
+
+	for(i = 0; i < 4; i++) memset(Sec[i], 0x10 + i, 512);
+	disk_ioctl(0, CTRL_SYNC, 0);
+	disk_ioctl(0, CTRL_CACHE_RESET, 0);
+	written = SdEmu_BlocksWritten;
+
+	//单扇区写入留在缓存中，同一扇区再写为命中
+	CHECK_EQ(disk_write(0, Sec[0], RAW, 1), RES_OK);
+	CHECK_EQ(disk_write(0, Sec[1], RAW, 1), RES_OK);
+	st = Stats();
+	CHECK_EQ(st.write_misses, 1);
+	CHECK_EQ(st.write_hits, 1);
+	CHECK_EQ(SdEmu_BlocksWritten, written);
+	CHECK(SdEmu_Sector(RAW)[0] != 0x11);
+
+	//读取：缓存中的扇区不访问卡；多扇区读取时用缓存中的内容覆盖
+	CHECK_EQ(disk_read(0, Back, RAW, 1), RES_OK);
+	CHECK_EQ(Back[0], 0x11);
+	st = Stats();
+	CHECK_EQ(st.read_hits, 1);
+	CHECK_EQ(st.read_misses, 0);
+	CHECK_EQ(disk_read(0, Back, RAW - 1, 3), RES_OK);
+	CHECK_EQ(Back[512], 0x11);
+	st = Stats();
+	CHECK_EQ(st.read_hits, 2);
+	CHECK_EQ(st.read_misses, 1);
+
+	//缓存满（4个扇区）后再写新扇区：最旧的RAW连同相邻的RAW+1、RAW+2用一条CMD25写出
+	CHECK_EQ(disk_write(0, Sec[2], RAW + 1, 1), RES_OK);
+	CHECK_EQ(disk_write(0, Sec[3], RAW + 2, 1), RES_OK);
+	CHECK_EQ(disk_write(0, Sec[0], RAW + 100, 1), RES_OK);
+	c25 = SdEmu_CmdCount[25];
+	CHECK_EQ(SdEmu_BlocksWritten, written);
+	CHECK_EQ(disk_write(0, Sec[1], RAW + 200, 1), RES_OK);
+	CHECK_EQ(SdEmu_CmdCount[25] - c25, 1);
+	CHECK_EQ(SdEmu_BlocksWritten - written, 3);
+	CHECK(SdEmu_Sector(RAW)[0] == 0x11 && SdEmu_Sector(RAW + 1)[0] == 0x12 && SdEmu_Sector(RAW + 2)[0] == 0x13);
+	st = Stats();
+	CHECK_EQ(st.write_misses, 5);
+	CHECK_EQ(st.flushes, 1);
+	CHECK_EQ(st.flushed_sectors, 3);
+
+	//多扇区写入直接写卡，缓存中的旧副本作废
+	CHECK_EQ(disk_write(0, Sec[2], RAW + 99, 2), RES_OK);
+	CHECK_EQ(disk_read(0, Back, RAW + 100, 1), RES_OK);
+	CHECK_EQ(Back[0], 0x13);
+	CHECK_EQ(Stats().read_hits, 2);
+
+	//CTRL_SYNC写出全部（单独的扇区用CMD24），之后读取都访问卡
+	written = SdEmu_BlocksWritten;
+	CHECK_EQ(disk_ioctl(0, CTRL_SYNC, 0), RES_OK);
+	CHECK_EQ(SdEmu_BlocksWritten - written, 1);
+	CHECK_EQ(SdEmu_Sector(RAW + 200)[0], 0x11);
+	CHECK_EQ(disk_read(0, Back, RAW + 200, 1), RES_OK);
+	st = Stats();
+	CHECK_EQ(st.read_hits, 2);
+	CHECK_EQ(st.flushes, 2);
+
+	//写出失败时扇区留在缓存中，不会丢失
+	CHECK_EQ(disk_write(0, Sec[3], RAW + 300, 1), RES_OK);
+	SdEmu_WriteResp = MSD_DATA_WRITE_ERROR;
+	CHECK_EQ(disk_ioctl(0, CTRL_SYNC, 0), RES_ERROR);
+	SdEmu_ClearFaults();
+	CHECK_EQ(disk_ioctl(0, CTRL_SYNC, 0), RES_OK);
+	CHECK_EQ(SdEmu_Sector(RAW + 300)[0], 0x13);
+
+	disk_ioctl(0, CTRL_CACHE_RESET, 0);
+	st = Stats();
+	CHECK_EQ(st.write_hits + st.write_misses + st.read_hits + st.read_misses + st.flushes, 0);
+}
+
+/* ---------------- 掉电一致性 ---------------- */
+
+#define OLD_FILES	12
+#define NEW_FILES	4
+#define NEW_LINES	60
+
+static FIL File;
+static uint8_t Line[640];
+static uint32_t Writes, Cut;					//卡接受第Cut个扇区后断电，0为不断电
+static uint32_t ClosedAt[NEW_FILES];			//f_close返回时已写入的扇区数
+
+static void Write_Hook(uint32_t sector)
+{
+	(void)sector;
+	if(++Writes == Cut) SdEmu_NoResponse = 1;
+}
+
+//卡重新上电（数据保留），文件系统重新挂载，内存中的缓存丢失
+static void PowerCycle(void)
+{
+	SdEmu_Attach(1);
+	SdEmu_WriteHook = Write_Hook;
+	CHECK_EQ(FsHost_Remount(), FR_OK);
+}
+
+static void Fill(uint8_t file, uint16_t l)
+{
+	uint16_t i;
+	for(i = 0; i < sizeof(Line); i++) Line[i] = (uint8_t)(file * 31 + l * 7 + i);
+}
+
+//删除旧文件、写新文件（每20行f_sync），任一步出错即停止（断电）
+static void Workload(void)
+{
+	char name[16];
+	uint16_t l;
+	uint8_t k;
+	UINT bw;
+
+	memset(ClosedAt, 0, sizeof(ClosedAt));
+	for(k = 0; k < NEW_FILES; k++)
+	{
+		sprintf(name, "OLD%02u.BIN", k * 3);
+		if(f_unlink(name) != FR_OK) return;
+		sprintf(name, "NEW%u.BIN", k);
+		if(f_open(&File, name, FA_CREATE_ALWAYS | FA_WRITE) != FR_OK) return;
+		for(l = 0; l < NEW_LINES; l++)
+		{
+			Fill(k, l);
+			if(f_write(&File, Line, sizeof(Line), &bw) != FR_OK) return;
+			if(l % 20 == 19 && f_sync(&File) != FR_OK) return;
+		}
+		if(f_close(&File) != FR_OK) return;
+		ClosedAt[k] = Writes;
+	}
+}
+
+//返回发现的问题数
+static uint32_t Verify(void)
+{
+	static uint8_t buf[640], used[SD_EMU_SECTORS];
+	static DWORD clmt[64];
+	uint32_t bad = 0;
+	FILINFO fno;
+	char name[16];
+	DWORD *p, c;
+	uint16_t l;
+	uint8_t k;
+	DIR dir;
+	UINT br;
+
+	//断电前关闭的新文件完整
+	for(k = 0; k < NEW_FILES; k++)
+	{
+		if(!ClosedAt[k] || (Cut && ClosedAt[k] > Cut)) continue;
+		sprintf(name, "NEW%u.BIN", k);
+		if(f_open(&File, name, FA_READ) != FR_OK || f_size(&File) != NEW_LINES * sizeof(Line))
+		{
+			bad++;
+			continue;
+		}
+		for(l = 0; l < NEW_LINES; l++)
+		{
+			Fill(k, l);
+			if(f_read(&File, buf, sizeof(buf), &br) != FR_OK || br != sizeof(buf) || memcmp(buf, Line, sizeof(buf)))
+			{
+				bad++;
+				break;
+			}
+		}
+		f_close(&File);
+	}
+
+	//不删除的旧文件不受影响
+	for(k = 0; k < OLD_FILES; k++)
+	{
+		if(k % 3 == 0 && k / 3 < NEW_FILES) continue;
+		sprintf(name, "OLD%02u.BIN", k);
+		if(f_open(&File, name, FA_READ) != FR_OK || f_read(&File, buf, sizeof(buf), &br) != FR_OK || buf[0] != k)
+			bad++;
+		f_close(&File);
+	}
+
+	//每个簇最多属于一个文件，簇链完整
+	memset(used, 0, sizeof(used));
+	CHECK_EQ(f_opendir(&dir, ""), FR_OK);
+	while(f_readdir(&dir, &fno) == FR_OK && fno.fname[0])
+	{
+		if(f_open(&File, fno.fname, FA_READ) != FR_OK)
+		{
+			bad++;
+			continue;
+		}
+		if(f_size(&File))
+		{
+			clmt[0] = sizeof(clmt) / sizeof(clmt[0]);
+			File.cltbl = clmt;
+			if(f_lseek(&File, CREATE_LINKMAP) != FR_OK)
+				bad++;
+			else
+				for(p = clmt + 1; *p; p += 2)
+					for(c = p[1]; c < p[1] + p[0]; c++)
+						if(c >= SD_EMU_SECTORS || used[c]++) bad++;
+			File.cltbl = 0;
+		}
+		f_close(&File);
+	}
+	f_closedir(&dir);
+	return bad;
+}
+
+static void Test_PowerLoss(void)
+{
+	static uint8_t snap[SD_EMU_SECTORS * 512];
+	uint32_t total, cut, cuts = 0, fails = 0;
+	char name[16];
+	uint8_t k;
+
+	for(k = 0; k < OLD_FILES; k++)
+	{
+		sprintf(name, "OLD%02u.BIN", k);
+		memset(Line, k, sizeof(Line));
+		CHECK_EQ(FsHost_WriteFile(name, Line, sizeof(Line)), FR_OK);
+	}
+	CHECK_EQ(FsHost_Remount(), FR_OK);
+	memcpy(snap, SdEmu_Sector(0), sizeof(snap));
+
+	//不断电跑一遍，得到写入的扇区总数
+	Writes = Cut = 0;
+	SdEmu_WriteHook = Write_Hook;
+	Workload();
+	total = Writes;
+	CHECK(ClosedAt[NEW_FILES - 1] != 0);
+	CHECK_EQ(FsHost_Remount(), FR_OK);
+	CHECK_EQ(Verify(), 0);
+
+	//在每隔几个扇区的位置断电
+	for(cut = 1; cut < total; cut += 7)
+	{
+		memcpy(SdEmu_Sector(0), snap, sizeof(snap));
+		PowerCycle();
+		Writes = 0;
+		Cut = cut;
+		Workload();
+		PowerCycle();
+		CHECK_EQ(SdEmu_Errors, 0);
+		if(Verify())
+		{
+			printf("power cut after sector %lu of %lu\n", (unsigned long)cut, (unsigned long)total);
+			fails++;
+		}
+		cuts++;
+	}
+	SdEmu_WriteHook = 0;
+	CHECK(cuts > 20);
+	CHECK_EQ(fails, 0);
+}
+
+int main(void)
+{
+	Host_Reset();
+	CHECK_EQ(FsHost_Format(2048), FR_OK);
+
+	Test_HitMiss();
+	Test_PowerLoss();
+
+	return TEST_RESULT();
+}
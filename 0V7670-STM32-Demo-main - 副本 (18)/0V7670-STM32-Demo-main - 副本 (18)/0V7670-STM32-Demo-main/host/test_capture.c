@@ -0,0 +1,243 @@
+//Capture_Stream：行缓冲区轮换、异步输出端持有缓冲区、输出端出错和帧源损坏的处理，
+//以及按模拟时钟计时的流水线重叠（帧源后台读取、同步输出端、异步输出端同时进行）
+#include "stm32f10x.h"
+#include "capture.h"
+#include "crc32.h"
+#include "test.h"
+#include <string.h>
+#include <zlib.h>
+
+void Test_CaptureWait(void);
+
+static uint8_t Frame[CAPTURE_FRAME_SIZE];
+static uint8_t Bufs[CAPTURE_MAX_LINE_BUFS][CAPTURE_LINE_SIZE];
+
+/* 模拟帧源：line_start/line_finish必须交替调用，写入的缓冲区不能被异步输出端持有 */
+static uint16_t SrcLine;
+static uint8_t SrcStarted, SrcCorrupt, SrcErrors;
+static uint8_t *SrcLast[CAPTURE_HEIGHT];
+
+/* 异步输出端：按交出顺序归还缓冲区，记录最多同时持有几个 */
+static const uint8_t *AsyncQueue[CAPTURE_HEIGHT];
+static Capture_DoneTypeDef AsyncDone;
+static uint16_t AsyncHead, AsyncTail, AsyncMaxHeld;
+static uint8_t AsyncFrame[CAPTURE_FRAME_SIZE];
+static uint32_t AsyncBytes;
+
+static uint8_t BufHeld(const uint8_t *buf)
+{
+	uint16_t i;
+	for(i = AsyncTail; i != AsyncHead; i++)
+		if(AsyncQueue[i] == buf) return 1;
+	return 0;
+}
+
+static void Src_Begin(void) { SrcLine = 0; SrcStarted = 0; }
+static void Src_LineStart(void) { if(SrcStarted) SrcErrors++; SrcStarted = 1; }
+
+static void Src_LineFinish(uint8_t *buf)
+{
+	if(!SrcStarted || BufHeld(buf)) SrcErrors++;
+	SrcStarted = 0;
+	memcpy(buf, Frame + SrcLine * CAPTURE_LINE_SIZE, CAPTURE_LINE_SIZE);
+	SrcLast[SrcLine++] = buf;
+}
+
+static uint8_t Src_End(void) { return SrcCorrupt; }
+
+static const Capture_SourceTypeDef Source = {Src_Begin, Src_LineStart, Src_LineFinish, Src_End};
+
+/* 同步输出端，记录调用顺序 */
+static char Order[32];
+static uint8_t OrderLen;
+static uint8_t SyncFrame[CAPTURE_FRAME_SIZE];
+static uint32_t SyncBytes, SyncCrc;
+static uint8_t SyncFailAt;		//第几行写入失败，0表示不失败
+
+static uint8_t Sync_Open(uint8_t t) { (void)t; Order[OrderLen++] = 'o'; SyncBytes = 0; return 0; }
+static uint8_t Sync_Write(const uint8_t *buf, uint16_t len)
+{
+	if(SyncFailAt && SyncBytes / CAPTURE_LINE_SIZE + 1 == SyncFailAt) return 1;
+	memcpy(SyncFrame + SyncBytes, buf, len);
+	SyncBytes += len;
+	return 0;
+}
+static uint8_t Sync_Close(uint32_t crc) { Order[OrderLen++] = 'c'; SyncCrc = crc; return 0; }
+static void Sync_Abort(void) { Order[OrderLen++] = 'a'; }
+
+static const Capture_SinkTypeDef SyncSink = {Sync_Open, Sync_Write, Sync_Close, Sync_Abort, NULL};
+
+static uint8_t Async_Open(uint8_t t) { (void)t; Order[OrderLen++] = 'O'; AsyncBytes = 0; return 0; }
+static uint8_t Async_Write(const uint8_t *buf, uint16_t len, Capture_DoneTypeDef done)
+{
+	memcpy(AsyncFrame + AsyncBytes, buf, len);	//“发送”的数据在交出时取走，归还前缓冲区不能被改写
+	AsyncBytes += len;
+	AsyncDone = done;
+	AsyncQueue[AsyncHead++] = buf;
+	if((uint16_t)(AsyncHead - AsyncTail) > AsyncMaxHeld) AsyncMaxHeld = AsyncHead - AsyncTail;
+	return 0;
+}
+static uint8_t Async_Close(uint32_t crc) { (void)crc; Order[OrderLen++] = 'C'; return 0; }
+static void Async_Abort(void) { Order[OrderLen++] = 'A'; }
+
+static const Capture_SinkTypeDef AsyncSink = {Async_Open, NULL, Async_Close, Async_Abort, Async_Write};
+
+/*
+ * 计时模型（单位为72MHz周期）：帧源每行在后台读T_SRC，SD卡同步写入占用CPU T_SD，
+ * 串口DMA每行T_UART，一行发完才发下一行
+ */
+#define T_SRC		23040			//RCLK 2MHz读640字节
+#define T_SD		30000
+#define T_UART		40000			//921600波特
+
+static uint8_t Timed;
+static uint64_t SrcReadyAt;
+static uint64_t AsyncDoneAt[CAPTURE_HEIGHT];
+
+static void TSrc_LineStart(void) { Src_LineStart(); SrcReadyAt = Host_Cycles + T_SRC; }
+static void TSrc_LineFinish(uint8_t *buf)
+{
+	if(Host_Cycles < SrcReadyAt) Host_Advance((uint32_t)(SrcReadyAt - Host_Cycles));
+	Src_LineFinish(buf);
+}
+
+static const Capture_SourceTypeDef TimedSource = {Src_Begin, TSrc_LineStart, TSrc_LineFinish, Src_End};
+
+static uint8_t TSync_Write(const uint8_t *buf, uint16_t len) { Host_Advance(T_SD); return Sync_Write(buf, len); }
+
+static uint8_t TAsync_Write(const uint8_t *buf, uint16_t len, Capture_DoneTypeDef done)
+{
+	uint64_t start = Host_Cycles;
+
+	if(AsyncTail != AsyncHead && AsyncDoneAt[(uint16_t)(AsyncHead - 1)] > start)
+		start = AsyncDoneAt[(uint16_t)(AsyncHead - 1)];
+	AsyncDoneAt[AsyncHead] = start + T_UART;
+	return Async_Write(buf, len, done);
+}
+
+static const Capture_SinkTypeDef TimedSyncSink = {Sync_Open, TSync_Write, Sync_Close, Sync_Abort, NULL};
+static const Capture_SinkTypeDef TimedAsyncSink = {Async_Open, NULL, Async_Close, Async_Abort, TAsync_Write};
+
+static uint32_t Now(void) { return (uint32_t)Host_Cycles; }
+
+//Capture_Stream等待缓冲区时“发送完成”最早交出的一行；计时模式下等到该行发完
+void Test_CaptureWait(void)
+{
+	if(AsyncTail == AsyncHead) return;
+	if(Timed)
+	{
+		Host_Advance(100);
+		if(Host_Cycles < AsyncDoneAt[AsyncTail]) return;
+	}
+	AsyncDone(AsyncQueue[AsyncTail++]);
+}
+
+static void Reset(void)
+{
+	SrcCorrupt = 0;
+	SrcErrors = 0;
+	SyncFailAt = 0;
+	OrderLen = 0;
+	memset(Order, 0, sizeof(Order));
+	AsyncHead = AsyncTail = AsyncMaxHeld = 0;
+}
+
+static uint8_t Run(uint8_t nbufs, uint8_t async, uint32_t *crc)
+{
+	Capture_ConfigTypeDef cfg = {0};
+	uint8_t i;
+
+	cfg.source = &Source;
+	cfg.sinks[cfg.sink_count++] = &SyncSink;
+	if(async) cfg.sinks[cfg.sink_count++] = &AsyncSink;
+	for(i = 0; i < nbufs; i++) cfg.line_bufs[i] = Bufs[i];
+	cfg.line_buf_count = nbufs;
+	return Capture_Stream(&cfg, 1, crc);
+}
+
+int main(void)
+{
+	uint32_t crc, ref, i;
+	uint16_t l;
+
+	for(i = 0; i < CAPTURE_FRAME_SIZE; i++) Frame[i] = (uint8_t)(i * 7 + i / CAPTURE_LINE_SIZE);
+	ref = (uint32_t)crc32(0, Frame, CAPTURE_FRAME_SIZE);	//参考值用zlib，不用被测的CRC32_Calc
+
+	//三个缓冲区轮换，异步端持有的缓冲区不会被帧源改写
+	Reset();
+	CHECK_EQ(Run(3, 1, &crc), 0);
+	CHECK_EQ(SrcErrors, 0);
+	CHECK_EQ(crc, ref);
+	CHECK_EQ(SyncCrc, ref);
+	CHECK(memcmp(SyncFrame, Frame, CAPTURE_FRAME_SIZE) == 0);
+	CHECK(AsyncBytes == CAPTURE_FRAME_SIZE && memcmp(AsyncFrame, Frame, CAPTURE_FRAME_SIZE) == 0);
+	for(l = 0; l < CAPTURE_HEIGHT; l++) CHECK(SrcLast[l] == Bufs[l % 3]);
+	CHECK(AsyncMaxHeld >= 2 && AsyncMaxHeld <= 3);
+	CHECK_EQ(AsyncTail, AsyncHead);				//返回前全部归还
+	CHECK(strcmp(Order, "oOCc") == 0);			//按相反顺序关闭
+
+	//只有一个缓冲区时不流水，仍然正确
+	Reset();
+	CHECK_EQ(Run(1, 1, &crc), 0);
+	CHECK_EQ(crc, ref);
+	CHECK_EQ(SrcErrors, 0);
+	for(l = 0; l < CAPTURE_HEIGHT; l++) CHECK(SrcLast[l] == Bufs[0]);
+	CHECK_EQ(AsyncMaxHeld, 1);
+
+	//一个输出端出错只放弃该输出端
+	Reset();
+	SyncFailAt = 100;
+	CHECK_EQ(Run(2, 1, &crc), 1);
+	CHECK_EQ(crc, ref);
+	CHECK(strcmp(Order, "oOCa") == 0);
+	CHECK(memcmp(AsyncFrame, Frame, CAPTURE_FRAME_SIZE) == 0);
+
+	//帧源报告数据损坏：全部放弃，不写帧尾
+	Reset();
+	SrcCorrupt = 1;
+	CHECK_EQ(Run(3, 1, &crc), 3);
+	CHECK(strcmp(Order, "oOaA") == 0);
+	CHECK_EQ(AsyncTail, AsyncHead);
+
+	//流水线：单缓冲时各级串行，三个缓冲区时串口发送与下一行的SD写入重叠，帧源读取总是在后台
+	{
+		Capture_StatsTypeDef st1, st3;
+		Capture_ConfigTypeDef cfg = {0};
+		uint64_t serial = (uint64_t)CAPTURE_HEIGHT * (T_SD + T_UART);
+		uint64_t overlap = (uint64_t)CAPTURE_HEIGHT * T_UART;
+
+		Timed = 1;
+		cfg.source = &TimedSource;
+		cfg.sinks[0] = &TimedSyncSink;
+		cfg.sinks[1] = &TimedAsyncSink;
+		cfg.sink_count = 2;
+		cfg.line_bufs[0] = Bufs[0];
+		cfg.line_bufs[1] = Bufs[1];
+		cfg.line_bufs[2] = Bufs[2];
+		cfg.now = Now;
+
+		Reset();
+		cfg.line_buf_count = 1;
+		cfg.stats = &st1;
+		CHECK_EQ(Capture_Stream(&cfg, 1, &crc), 0);
+		CHECK_EQ(crc, ref);
+		CHECK(st1.total >= serial && st1.total < serial + serial / 20);
+
+		Reset();
+		cfg.line_buf_count = 3;
+		cfg.stats = &st3;
+		CHECK_EQ(Capture_Stream(&cfg, 1, &crc), 0);
+		CHECK_EQ(crc, ref);
+		CHECK_EQ(SrcErrors, 0);
+		CHECK(AsyncBytes == CAPTURE_FRAME_SIZE && memcmp(AsyncFrame, Frame, CAPTURE_FRAME_SIZE) == 0);
+		CHECK(st3.total >= overlap && st3.total < overlap + overlap / 20);
+
+		//帧源比输出端快，读取完全藏在后台；等待时间是串口比SD卡慢的部分
+		CHECK(st3.source < CAPTURE_HEIGHT * 100);
+		CHECK(st3.sink[0] >= CAPTURE_HEIGHT * T_SD);
+		CHECK(st3.buf_wait + st3.sink[0] + st3.source + st3.crc <= st3.total);
+		CHECK(st3.buf_wait > CAPTURE_HEIGHT * (T_UART - T_SD) / 2);
+	}
+
+	return TEST_RESULT();
+}
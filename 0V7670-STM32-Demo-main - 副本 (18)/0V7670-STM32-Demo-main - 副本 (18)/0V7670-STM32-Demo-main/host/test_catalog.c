@@ -0,0 +1,224 @@
+//照片目录文件：序号分配和子目录分片，登记和读回记录，重新开机后恢复，
+//头部副本损坏或写入中途掉电时退回上一代，记录写满后覆盖最旧的，文件不连续时不可用
+#include "stm32f10x.h"
+#include "catalog.h"
+#include "timer.h"
+#include "fatfs.h"
+#include "sd_emu.h"
+#include "fs_host.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+uint32_t TIMER_Millis(void) { return (uint32_t)(Host_Cycles / 72000); }
+
+static FIL File;
+
+/* 拍一张：分配序号、创建文件、登记 */
+static uint32_t Shoot(uint8_t light_mode)
+{
+	static uint8_t data[1024];
+	char path[CATALOG_PATH_SIZE];
+	uint32_t seq = Catalog_NextSeq();
+	UINT bw;
+
+	CHECK_EQ(Catalog_NextPath(path), FR_OK);
+	CHECK_EQ(f_open(&File, path, FA_CREATE_NEW | FA_WRITE), FR_OK);	//不会覆盖已有的照片
+	CHECK_EQ(f_write(&File, data, sizeof(data), &bw), FR_OK);
+	CHECK_EQ(f_close(&File), FR_OK);
+	CHECK_EQ(Catalog_Add(light_mode, sizeof(data), 0xABC00000 + seq), FR_OK);
+	return seq;
+}
+
+/* 重新开机：丢弃内存中的状态，重新读目录文件 */
+static FRESULT Reboot(void)
+{
+	CHECK_EQ(FsHost_Remount(), FR_OK);
+	return Catalog_Init(&File);
+}
+
+/* 直接读写目录文件的第n个扇区（0、1为头部） */
+static void RawSector(uint32_t n, void *buf, uint8_t write)
+{
+	UINT br;
+
+	CHECK_EQ(f_open(&File, CATALOG_FILE, FA_READ | FA_WRITE), FR_OK);
+	CHECK_EQ(f_lseek(&File, n * 512), FR_OK);
+	if(write)
+		CHECK_EQ(f_write(&File, buf, 512, &br), FR_OK);
+	else
+		CHECK_EQ(f_read(&File, buf, 512, &br), FR_OK);
+	CHECK_EQ(f_close(&File), FR_OK);
+}
+
+/* 卡接受第FailAfter个扇区后不再应答，模拟写到一半掉电 */
+static uint32_t Writes, FailAfter;
+static void Write_Hook(uint32_t sector)
+{
+	(void)sector;
+	if(++Writes == FailAfter) SdEmu_NoResponse = 1;
+}
+
+static void Test_Append(void)
+{
+	Catalog_RecordTypeDef rec;
+	char path[CATALOG_PATH_SIZE];
+	FILINFO fno;
+	uint32_t n;
+
+	CHECK_EQ(Catalog_Init(&File), FR_OK);
+	CHECK(Catalog_IsReady());
+	CHECK_EQ(Catalog_Count(), 0);
+	CHECK_EQ(Catalog_NextSeq(), 1);
+
+	//跨过子目录边界：P000/IMG00099.DAT之后是P001/IMG00100.DAT
+	for(n = 0; n < 105; n++) CHECK_EQ(Shoot(1 + n % 3), n + 1);
+	CHECK_EQ(f_stat("P000/IMG00099.DAT", &fno), FR_OK);
+	CHECK_EQ(f_stat("P001/IMG00100.DAT", &fno), FR_OK);
+	CHECK_EQ(f_stat("P001/IMG00105.DAT", &fno), FR_OK);
+
+	//分配后没有保存成功：序号不再使用
+	CHECK_EQ(Catalog_NextPath(path), FR_OK);
+	CHECK_EQ(strcmp(path, "P001/IMG00106.DAT"), 0);
+	CHECK_EQ(Catalog_Count(), 105);
+
+	//重新开机后不扫描目录就知道下一个序号
+	CHECK_EQ(Reboot(), FR_OK);
+	CHECK_EQ(Catalog_Count(), 105);
+	CHECK_EQ(Catalog_NextSeq(), 107);
+	CHECK_EQ(Catalog_Add(1, 0, 0), FR_NOT_READY);	//没有分配序号
+	CHECK_EQ(Catalog_Get(104, &rec), FR_OK);
+	CHECK_EQ(rec.seq, 105);
+	CHECK_EQ(rec.dir, 1);
+	CHECK_EQ(rec.light_mode, 1 + 104 % 3);
+	CHECK_EQ(rec.size, 1024);
+	CHECK_EQ(rec.crc32, 0xABC00000 + 105);
+	CHECK_EQ(rec.flags, CATALOG_RECORD_VALID);
+	CHECK(memcmp(rec.name, "IMG00105.DAT", 12) == 0);
+	CHECK_EQ(Catalog_Get(0, &rec), FR_OK);
+	CHECK_EQ(rec.seq, 1);
+	CHECK_EQ(Catalog_Get(105, &rec), FR_NO_FILE);
+	CHECK_EQ(Shoot(2), 107);
+}
+
+static void Test_Recovery(void)
+{
+	static uint32_t s[512 / 4];					//FatFs直接DMA到整扇区的缓冲区
+	Catalog_HeaderTypeDef h[2];
+	Catalog_RecordTypeDef rec;
+	char path[CATALOG_PATH_SIZE];
+	uint8_t newer;
+
+	//较新的头部副本损坏（写入中途掉电）：退回上一代，最后一条登记丢失，下一张覆盖它的记录
+	CHECK_EQ(Catalog_Count(), 106);
+	RawSector(0, s, 0);
+	memcpy(&h[0], s, sizeof(h[0]));
+	RawSector(1, s, 0);
+	memcpy(&h[1], s, sizeof(h[1]));
+	newer = h[1].generation > h[0].generation;
+	CHECK_EQ(h[newer].count, 106);
+	CHECK_EQ(h[!newer].count, 105);
+	CHECK_EQ(h[!newer].generation + 1, h[newer].generation);
+	RawSector(newer, s, 0);
+	((uint8_t *)s)[12] ^= 0xFF;						//next_seq，校验和不再相符
+	RawSector(newer, s, 1);
+	CHECK_EQ(Reboot(), FR_OK);
+	CHECK_EQ(Catalog_Count(), 105);
+	CHECK_EQ(Catalog_NextSeq(), 108);				//上一代头部在登记之前写入，序号已经分配
+	CHECK_EQ(Shoot(3), 108);
+	CHECK_EQ(Catalog_Get(105, &rec), FR_OK);
+	CHECK_EQ(rec.seq, 108);
+
+	//记录写入后、头部写入前掉电：记录不生效
+	CHECK_EQ(Catalog_NextPath(path), FR_OK);
+	Writes = 0;
+	FailAfter = 1;									//记录扇区写入后
+	SdEmu_WriteHook = Write_Hook;
+	CHECK_EQ(Catalog_Add(1, 1024, 0), FR_DISK_ERR);
+	SdEmu_WriteHook = 0;
+	SdEmu_ClearFaults();
+	CHECK_EQ(Reboot(), FR_OK);
+	CHECK_EQ(Catalog_Count(), 106);
+	CHECK_EQ(Catalog_NextSeq(), 110);
+	CHECK_EQ(Catalog_Get(106, &rec), FR_NO_FILE);
+	CHECK_EQ(Shoot(2), 110);
+	CHECK_EQ(Catalog_Get(106, &rec), FR_OK);
+	CHECK_EQ(rec.seq, 110);
+
+	//两个副本都损坏：无法使用
+	memset(s, 0, sizeof(s));
+	RawSector(0, s, 1);
+	RawSector(1, s, 1);
+	CHECK(Reboot() != FR_OK);
+	CHECK_EQ(Catalog_IsReady(), 0);
+	CHECK_EQ(Catalog_NextPath(path), FR_NOT_READY);
+}
+
+static void Test_Wrap(void)
+{
+	Catalog_RecordTypeDef rec;
+	char path[CATALOG_PATH_SIZE];
+	uint32_t n;
+
+	//记录写满后覆盖最旧的（只登记，不创建文件）
+	CHECK_EQ(f_unlink(CATALOG_FILE), FR_OK);
+	CHECK_EQ(Catalog_Init(&File), FR_OK);
+	CHECK_EQ(Catalog_Count(), 0);
+	for(n = 0; n < CATALOG_CAPACITY + 10; n++)
+	{
+		CHECK_EQ(Catalog_NextPath(path), FR_OK);
+		CHECK_EQ(Catalog_Add(1, n, n), FR_OK);
+	}
+	CHECK_EQ(Reboot(), FR_OK);
+	CHECK_EQ(Catalog_Count(), CATALOG_CAPACITY + 10);
+	CHECK_EQ(Catalog_Get(9, &rec), FR_NO_FILE);
+	CHECK_EQ(Catalog_Get(10, &rec), FR_OK);
+	CHECK_EQ(rec.size, 10);
+	CHECK_EQ(Catalog_Get(CATALOG_CAPACITY + 9, &rec), FR_OK);
+	CHECK_EQ(rec.size, CATALOG_CAPACITY + 9);
+}
+
+static void Test_Rejected(void)
+{
+	static uint8_t z[2048];
+	static FIL fill;
+	UINT bw;
+	uint8_t i;
+
+	//PC改写过的目录文件：长度不对
+	CHECK_EQ(FsHost_WriteFile(CATALOG_FILE, z, sizeof(z)), FR_OK);
+	CHECK_EQ(Catalog_Init(&File), FR_DENIED);
+	CHECK_EQ(Catalog_IsReady(), 0);
+
+	//长度正确但簇链不连续
+	CHECK_EQ(f_open(&File, CATALOG_FILE, FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+	CHECK_EQ(f_open(&fill, "FILL.BIN", FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+	for(i = 0; i * sizeof(z) < (2 + CATALOG_CAPACITY / 16) * 512; i++)
+	{
+		f_write(&File, z, sizeof(z), &bw);
+		f_sync(&File);
+		f_write(&fill, z, sizeof(z), &bw);
+		f_sync(&fill);
+	}
+	CHECK_EQ(f_lseek(&File, (2 + CATALOG_CAPACITY / 16) * 512), FR_OK);
+	CHECK_EQ(f_truncate(&File), FR_OK);
+	f_close(&File);
+	f_close(&fill);
+	CHECK(FsHost_Fragments(CATALOG_FILE) > 1);
+	CHECK_EQ(Catalog_Init(&File), FR_DENIED);
+	CHECK_EQ(Catalog_IsReady(), 0);
+}
+
+int main(void)
+{
+	Host_Reset();
+	CHECK_EQ(FsHost_Format(2048), FR_OK);
+
+	Test_Append();
+	Test_Recovery();
+	Test_Wrap();
+	Test_Rejected();
+
+	CHECK_EQ(SdEmu_Errors, 0);
+	return TEST_RESULT();
+}
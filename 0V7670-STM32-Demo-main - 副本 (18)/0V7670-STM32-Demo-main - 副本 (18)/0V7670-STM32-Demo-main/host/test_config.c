@@ -0,0 +1,127 @@
+//传感器配置的切换：VSYNC中断（EXTI2_IRQHandler）只记下待切换，不访问SCCB，投递FRAME_EV_HOLD；
+//拍照任务中OV7670_ConfigService写入后，下一个VSYNC开始写入FIFO。settle、任务来晚、切换前再次请求
+#include "stm32f10x.h"
+#include "OV7670.h"
+#include "exti.h"
+#include "frame.h"
+#include "sccb_emu.h"
+#include "test.h"
+#include <string.h>
+
+void EXTI2_IRQHandler(void);
+
+/* OV7670_Init用到的其他模块 */
+void FIFO_Init(void) { }
+
+//与开机配置不同：固定白平衡、黑白、增益上限32x
+static const OV7670_ConfigTypeDef Infrared = {1, 0, 2, 4, 2, OV7670_QVGA_WINDOW, 4, 0x75, 0x63, 0};
+
+static Frame_EventTypeDef Events[8];
+static uint8_t EventCount;
+static uint32_t IsrStarts;						//中断中发生的SCCB传输
+
+static void Frame_EventCb(Frame_EventTypeDef ev, const Frame_InfoTypeDef *info)
+{
+	(void)info;
+	if(EventCount < 8) Events[EventCount++] = ev;
+}
+
+//一帧过去后进入VSYNC中断，返回中断投递的最后一个事件（没有时为-1）
+static int Vsync(void)
+{
+	uint32_t starts;
+
+	Host_Advance(72000);
+	EventCount = 0;
+	starts = SccbEmu_Starts;
+	EXTI2_IRQHandler();
+	IsrStarts += SccbEmu_Starts - starts;
+	return EventCount ? (int)Events[EventCount - 1] : -1;
+}
+
+static void Test_Switch(const OV7670_ConfigTypeDef *cfg, u8 settle)
+{
+	uint32_t starts;
+
+	OV7670_RequestConfig(cfg, settle);
+	Frame_Arm(DWT_CYCCNT);
+	CHECK_EQ(OV7670_ConfigReady(), 0);
+
+	//VSYNC之前不写入
+	starts = SccbEmu_Starts;
+	CHECK_EQ(OV7670_ConfigService(), 0);
+	CHECK_EQ(SccbEmu_Starts, starts);
+
+	//VSYNC：这一帧不写入FIFO，拍照任务收到HOLD后写入配置
+	CHECK_EQ(Vsync(), FRAME_EV_HOLD);
+	CHECK_EQ(Frame_GetState(), FRAME_ARMED);
+	CHECK_EQ(OV7670_ConfigService(), 1);
+	CHECK_EQ(OV7670_ConfigFrame, OV7670_FrameCount);
+	CHECK_EQ(OV7670_ConfigService(), 0);
+	CHECK_EQ(OV7670_ConfigReady(), settle <= 1);
+
+	//舍弃帧（HOLD算作第一帧）之后开始写入
+	while(settle-- > 1)
+	{
+		CHECK_EQ(Vsync(), FRAME_EV_HOLD);
+		CHECK_EQ(OV7670_ConfigService(), 0);
+	}
+	CHECK_EQ(OV7670_ConfigReady(), 1);
+	CHECK_EQ(Vsync(), FRAME_EV_START);
+	CHECK_EQ(Vsync(), FRAME_EV_READY);
+	Frame_Release(0);
+}
+
+int main(void)
+{
+	uint32_t writes;
+
+	Host_Reset();
+	SccbEmu_Attach();
+	CHECK_EQ(OV7670_Init(), 0);
+	CHECK(SccbEmu_Writes > 100);
+	mEXTI_Init(Frame_EventCb);
+
+	//没有请求：快门后的第一个VSYNC开始写入
+	Frame_Arm(DWT_CYCCNT);
+	CHECK_EQ(Vsync(), FRAME_EV_START);
+	CHECK_EQ(Vsync(), FRAME_EV_READY);
+	Frame_Release(0);
+
+	//切换配置，寄存器写到传感器
+	writes = SccbEmu_Writes;
+	Test_Switch(&Infrared, 1);
+	CHECK(SccbEmu_Writes > writes);
+	CHECK_EQ(SccbEmu_Reg[0x14], (4 << 4) | 0x08);	//COM9：增益上限32x
+	CHECK(OV7670_ConfigCycles > 0);
+
+	//切回开机配置，不舍弃；舍弃两帧
+	Test_Switch(&OV7670_DefaultConfig, 0);
+	Test_Switch(&Infrared, 2);
+
+	//任务来晚：下一个VSYNC时配置仍未切换，那一帧也不写入
+	OV7670_RequestConfig(&OV7670_DefaultConfig, 0);
+	Frame_Arm(DWT_CYCCNT);
+	CHECK_EQ(Vsync(), FRAME_EV_HOLD);
+	CHECK_EQ(Vsync(), FRAME_EV_HOLD);
+	CHECK_EQ(OV7670_ConfigService(), 1);
+	CHECK_EQ(Vsync(), FRAME_EV_START);
+	CHECK_EQ(Vsync(), FRAME_EV_READY);
+	Frame_Release(0);
+
+	//VSYNC之后、写入之前又请求：等下一个VSYNC再写入
+	OV7670_RequestConfig(&Infrared, 0);
+	Frame_Arm(DWT_CYCCNT);
+	CHECK_EQ(Vsync(), FRAME_EV_HOLD);
+	OV7670_RequestConfig(&OV7670_DefaultConfig, 0);
+	CHECK_EQ(OV7670_ConfigService(), 0);
+	CHECK_EQ(Vsync(), FRAME_EV_HOLD);
+	CHECK_EQ(OV7670_ConfigService(), 1);
+	CHECK_EQ(Vsync(), FRAME_EV_START);
+
+	//中断中没有任何SCCB传输
+	CHECK_EQ(IsrStarts, 0);
+	CHECK_EQ(OV7670_SccbStats.failed, 0);
+	CHECK_EQ(SccbEmu_Errors, 0);
+	return TEST_RESULT();
+}
@@ -0,0 +1,130 @@
+//CRC32与zlib的crc32()比较：标准校验值、空输入、各种长度和起始对齐、按行（640字节）分段计算整帧、
+//0~3字节的尾部、从任意中间值继续计算（外设方式下先把中间值装回外设）。
+//Makefile按CRC32_SLICE=1/4/8和CRC32_BACKEND_HW分别编译，外设方式用stm32_host.c中的CRC模型
+#include "crc32.h"
+#if CRC32_BACKEND == CRC32_BACKEND_HW
+#include "stm32f10x.h"
+#endif
+#include "test.h"
+#include <string.h>
+#include <zlib.h>
+
+#define LINE		640						//QVGA RGB565一行
+#define FRAME		(LINE * 240)
+
+static uint8_t Data[FRAME + 8];
+
+static uint32_t Zlib(uint32_t crc, const uint8_t *data, uint32_t length)
+{
+	return (uint32_t)crc32(crc, data, length);
+}
+
+static void Test_Vectors(void)
+{
+	CHECK_EQ(CRC32_Calc((const uint8_t *)"123456789", 9), 0XCBF43926);
+	CHECK_EQ(CRC32_Calc(Data, 0), 0);
+	CHECK_EQ(CRC32_Final(CRC32_Update(CRC32_Init(), Data, 0)), 0);
+	CHECK_EQ(CRC32_Calc((const uint8_t *)"a", 1), 0XE8B7BE43);
+}
+
+/* 每个长度0~300、每种起始对齐0~7一次算完 */
+static void Test_Lengths(void)
+{
+	uint32_t len, off, fails = 0;
+
+	for(off = 0; off < 8; off++)
+	{
+		for(len = 0; len <= 300; len++)
+		{
+			if(CRC32_Calc(Data + off, len) != Zlib(0, Data + off, len))
+				fails++;
+		}
+	}
+	CHECK_EQ(fails, 0);
+}
+
+/* 整帧：一次算完，按行分段，各行起始不对齐，每段后面留下0~3字节的尾部 */
+static void Test_Frame(void)
+{
+	uint32_t ref = Zlib(0, Data, FRAME);
+	uint32_t crc, i, off, tail;
+
+	CHECK_EQ(CRC32_Calc(Data, FRAME), ref);
+#if CRC32_BACKEND == CRC32_BACKEND_HW
+	//对齐的整帧全部由外设计算
+	Host_CrcWords = 0;
+	CHECK_EQ(CRC32_Calc(Data, FRAME), ref);
+	CHECK_EQ(Host_CrcWords, FRAME / 4);
+#endif
+
+	crc = CRC32_Init();
+	for(i = 0; i < FRAME; i += LINE)
+		crc = CRC32_Update(crc, Data + i, LINE);
+	CHECK_EQ(CRC32_Final(crc), ref);
+
+	for(off = 1; off < 4; off++)
+	{
+		crc = CRC32_Init();
+		for(i = 0; i < FRAME; i += LINE)
+			crc = CRC32_Update(crc, Data + off + i, LINE);
+		CHECK_EQ(CRC32_Final(crc), Zlib(0, Data + off, FRAME));
+	}
+
+	for(tail = 0; tail < 4; tail++)
+	{
+		crc = CRC32_Init();
+		for(i = 0; i + LINE + tail <= FRAME; i += LINE + tail)
+		{
+			crc = CRC32_Update(crc, Data + i, LINE);
+			crc = CRC32_Update(crc, Data + i + LINE, tail);
+		}
+		CHECK_EQ(CRC32_Final(crc), Zlib(0, Data, i));
+	}
+}
+
+/* 从任意中间值继续计算（例如交替计算两个数据流），与zlib从同一个值继续的结果相同 */
+static void Test_State(void)
+{
+	static const uint32_t states[] = {0, 1, 0X80000000, 0XFFFFFFFF, 0X12345678, 0XDEADBEEF};
+	uint32_t a, b, za, zb, i, n;
+
+	for(i = 0; i < sizeof(states) / sizeof(states[0]); i++)
+	{
+		for(n = 0; n < 12; n++)
+			CHECK_EQ(CRC32_Final(CRC32_Update(~states[i], Data + 3, 64 + n)), Zlib(states[i], Data + 3, 64 + n));
+	}
+
+	//两个数据流交替
+	a = b = CRC32_Init();
+	za = zb = 0;
+	for(i = 0; i < 16; i++)
+	{
+		n = 37 * i + 5;
+		a = CRC32_Update(a, Data + i, n);
+		za = Zlib(za, Data + i, n);
+		b = CRC32_Update(b, Data + 1000 + i, n + 1);
+		zb = Zlib(zb, Data + 1000 + i, n + 1);
+	}
+	CHECK_EQ(CRC32_Final(a), za);
+	CHECK_EQ(CRC32_Final(b), zb);
+}
+
+int main(void)
+{
+	uint32_t i, x = 1;
+
+#if CRC32_BACKEND == CRC32_BACKEND_HW
+	Host_Reset();
+#endif
+	for(i = 0; i < sizeof(Data); i++)
+	{
+		x = x * 1103515245 + 12345;
+		Data[i] = (uint8_t)(x >> 16);
+	}
+
+	Test_Vectors();
+	Test_Lengths();
+	Test_Frame();
+	Test_State();
+	return TEST_RESULT();
+}
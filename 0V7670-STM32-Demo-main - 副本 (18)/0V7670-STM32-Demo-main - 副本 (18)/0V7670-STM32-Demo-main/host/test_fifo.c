@@ -0,0 +1,266 @@
+//AL422B读出：模拟FIFO的读指针（RCLK上升沿推进，RRST为低时复位），逐行读出整帧并比较
+#include "FIFO.h"
+#include "OV7670.h"
+#include "test.h"
+#include <string.h>
+
+#define FRAME_SIZE		(FIFO_LINE_SIZE * FIFO_IMG_HEIGHT)
+
+static uint8_t Fifo[FRAME_SIZE];
+static uint32_t FifoRead;			//读指针
+static uint8_t FifoOut;				//数据输出
+static uint32_t FifoClocks;			//RRST为高时的RCLK上升沿个数
+
+//上升沿输出读指针处的字节并推进读指针；RRST为低时只复位读指针
+static void Fifo_Rise(void)
+{
+	if(Host_PinOut[0][11] == 0)
+	{
+		FifoRead = 0;
+		return;
+	}
+	FifoOut = FifoRead < FRAME_SIZE ? Fifo[FifoRead] : 0;
+	FifoRead++;
+	FifoClocks++;
+}
+
+static uint32_t Fifo_Idr(void)
+{
+	return (uint32_t)FifoOut << 8 | 0x5A;	//低字节是PB0-PB7上的其他信号
+}
+
+//PB5配置为通用输出时由软件翻转的RCLK
+static uint8_t RclkPin;
+
+static void Fifo_Tick(void)
+{
+	uint8_t pin = Host_PinOut[1][5];
+
+	if(((Host_GPIOB.CRL >> 20) & 0xF) == 0x3)
+	{
+		if(pin && !RclkPin) Fifo_Rise();
+	}
+	RclkPin = pin;
+}
+
+#if FIFO_READ_MODE == FIFO_READ_DMA
+
+/*
+ * TIM3/TIM4/DMA1通道6的模型，按FIFO_Init写入的寄存器计算时序：
+ * 门控打开后第k个RCLK周期从 k*(ARR3+1) 开始，CNT=CCR1时DMA按字读IDR、写入半字，
+ * CNT=CCR2时PWM2输出变高（上升沿推进读指针），TIM4计满ARR4+1后关闭门控
+ */
+static uint8_t DmaActive;
+static uint64_t DmaStart;
+static uint32_t DmaEvents;			//已处理的RCLK周期数
+static uint8_t DmaSampled;
+static uint32_t DmaBadStart;
+
+static void Dma_Hook(void)
+{
+	DMA_Channel_TypeDef *ch = &Host_DMA1_Channel[6];
+	uint32_t period = Host_TIM3.ARR + 1;
+	uint32_t cycles = (Host_TIM4.ARR + 1) / period;
+	uint64_t t;
+
+	if(DmaActive && DmaEvents > 0 && ch->CNDTR == FIFO_LINE_SIZE) DmaBadStart++;	//上一行的门控还没结束就启动了下一行
+	if(!DmaActive && (Host_TIM4.CR1 & TIM_CR1_CEN))
+	{
+		if(!(ch->CCR & DMA_CCR6_EN) || Host_TIM3.CNT != 0 || Host_TIM4.CNT != 0) DmaBadStart++;
+		DmaActive = 1;
+		DmaStart = Host_Cycles;
+		DmaEvents = 0;
+		DmaSampled = 0;
+	}
+
+	//按时间顺序补做上次调用以来的采样和上升沿
+	while(DmaActive)
+	{
+		t = DmaStart + (uint64_t)DmaEvents * period;
+		if(!DmaSampled)
+		{
+			if(Host_Cycles < t + Host_TIM3.CCR1) break;
+			if(!(ch->CCR & DMA_CCR6_EN) || ch->CNDTR == 0)
+			{
+				DmaBadStart++;
+			}
+			else
+			{
+				uint16_t *dst = (uint16_t *)Host_DmaPtr(ch->CMAR) + (FIFO_LINE_SIZE - ch->CNDTR);
+				*dst = (uint16_t)Fifo_Idr();			//字读、半字写，只保留低16位
+				if(--ch->CNDTR == 0) Host_DMA1.ISR |= DMA1_FLAG_TC6 | DMA1_FLAG_GL6;
+			}
+			DmaSampled = 1;
+		}
+		if(Host_Cycles < t + Host_TIM3.CCR2) break;
+		if(((Host_GPIOB.CRL >> 20) & 0xF) == 0xB) Fifo_Rise();		//PB5为复用输出时才送到FIFO
+		DmaSampled = 0;
+		if(++DmaEvents == cycles)
+		{
+			DmaActive = 0;
+			Host_TIM4.CR1 &= ~TIM_CR1_CEN;		//单脉冲
+		}
+	}
+}
+
+static void Test_Init(void)
+{
+	Host_DmaHook = Dma_Hook;
+	FIFO_Init();
+
+	//RCLK：2MHz，低电平中间采样，上升沿在半周期
+	CHECK_EQ(Host_TIM3.ARR + 1, FIFO_RCLK_PERIOD);
+	CHECK(Host_TIM3.CCR1 > 0 && Host_TIM3.CCR1 < Host_TIM3.CCR2);
+	CHECK(Host_TIM3.CCR2 < Host_TIM3.ARR + 1);
+	CHECK_EQ(Host_TIM4.ARR + 1, FIFO_LINE_SIZE * FIFO_RCLK_PERIOD);
+	CHECK(Host_TIM4.CR1 & TIM_CR1_OPM);
+	CHECK_EQ(FIFO_LINE_TIME_US * 72, FIFO_LINE_SIZE * FIFO_RCLK_PERIOD);
+
+	//DMA：外设到内存，字读半字写，内存递增
+	CHECK_EQ(Host_DMA1_Channel[6].CPAR, (uint32_t)&Host_GPIOB.IDR);
+	CHECK_EQ(Host_DMA1_Channel[6].CCR & (DMA_CCR6_DIR | DMA_CCR6_PINC | DMA_CCR6_MINC | DMA_CCR6_PSIZE | DMA_CCR6_MSIZE | DMA_CCR6_CIRC),
+		DMA_CCR6_MINC | DMA_CCR6_PSIZE_1 | DMA_CCR6_MSIZE_0);
+	CHECK(Host_DMA1_Channel[6].CNDTR == FIFO_LINE_SIZE);
+
+	//TIM3部分重映射，只关JTAG，保留SWD
+	CHECK_EQ(Host_AFIO.MAPR & AFIO_MAPR_TIM3_REMAP, AFIO_MAPR_TIM3_REMAP_PARTIALREMAP);
+	CHECK_EQ(Host_AFIO.MAPR & AFIO_MAPR_SWJ_CFG, AFIO_MAPR_SWJ_CFG_JTAGDISABLE);
+}
+
+static void Test_Mode(void)
+{
+	static uint8_t buf[FIFO_LINE_SIZE];
+	uint64_t t0;
+
+	CHECK(((Host_GPIOB.CRL >> 20) & 0xF) == 0xB);			//读指针复位后RCLK交给TIM3
+
+	//启动后立即返回，读取在后台进行，期间CPU可做其他事
+	t0 = Host_Cycles;
+	FIFO_LineStart();
+	CHECK(Host_Cycles - t0 < 200);
+	CHECK(FIFO_LineBusy());
+	Host_Advance(FIFO_LINE_SIZE * FIFO_RCLK_PERIOD / 2);
+	CHECK(FIFO_LineBusy());
+	FIFO_LineFinish(buf);
+	//最后一次采样之后完成，最后一个上升沿在压缩数据期间发出
+	CHECK(Host_Cycles - t0 >= (FIFO_LINE_SIZE - 1) * FIFO_RCLK_PERIOD + FIFO_RCLK_SAMPLE);
+	CHECK(Host_Cycles - t0 < FIFO_LINE_SIZE * FIFO_RCLK_PERIOD + 2000);
+	CHECK(memcmp(buf, Fifo, FIFO_LINE_SIZE) == 0);
+	Host_Advance(FIFO_RCLK_PERIOD);
+	CHECK(!FIFO_LineBusy());
+	CHECK(!(Host_TIM4.CR1 & TIM_CR1_CEN));
+	CHECK_EQ(DmaBadStart, 0);
+}
+
+//DMA写入的半字在高字节，低字节是无关引脚
+static void Test_Pack(void)
+{
+	static const uint16_t s[4] = {0x12A5, 0x345A, 0xFF00, 0x00FF};
+	uint8_t out[4];
+
+	FIFO_PackLine(s, out, 4);
+	CHECK(out[0] == 0x12 && out[1] == 0x34 && out[2] == 0xFF && out[3] == 0x00);
+}
+
+#elif FIFO_READ_MODE == FIFO_READ_CPU
+
+/*
+ * CPU方式：FIFO_ReadLineCPU的三个GPIO访问宏在Makefile中替换为下面的函数，
+ * 检查每个字节都在RCLK低电平期间读取，写入缓冲区的字节顺序与FIFO输出顺序一致
+ */
+static uint32_t CpuBadRead;
+
+void Test_RclkLow(void)
+{
+	Host_PinOut[1][5] = 0;
+	RclkPin = 0;
+}
+
+void Test_RclkHigh(void)
+{
+	if(!RclkPin) Fifo_Rise();
+	Host_PinOut[1][5] = 1;
+	RclkPin = 1;
+}
+
+uint32_t Test_FifoData(void)
+{
+	if(RclkPin) CpuBadRead++;
+	return Fifo_Idr();
+}
+
+static void Test_Init(void)
+{
+	Host_GPIOB.CRL = 0x00300000;			//PB5通用推挽输出（OV7670_Init中配置）
+	FIFO_Init();
+	CHECK(Host_DwtCtrl & DWT_CTRL_CYCCNTENA);
+}
+
+static void Test_Mode(void)
+{
+	static uint8_t buf[FIFO_LINE_SIZE] __attribute__((aligned(4)));
+	uint32_t clocks = FifoClocks;
+
+	//没有后台读取，LineStart不做事，LineFinish中读完一行
+	FIFO_LineStart();
+	CHECK(!FIFO_LineBusy());
+	CHECK_EQ(FifoClocks, clocks);
+	FIFO_LineFinish(buf);
+	CHECK_EQ(FifoClocks - clocks, FIFO_LINE_SIZE);
+	CHECK(memcmp(buf, Fifo, FIFO_LINE_SIZE) == 0);
+	CHECK_EQ(CpuBadRead, 0);
+	CHECK(FIFO_LineCycles > 0);
+}
+
+static void Test_Pack(void)
+{
+	CHECK_EQ(CpuBadRead, 0);
+}
+
+#endif
+
+int main(void)
+{
+	static uint8_t buf[FIFO_LINE_SIZE] __attribute__((aligned(4)));
+	uint32_t i;
+	uint16_t line;
+	uint8_t ok;
+
+	Host_Reset();
+	Host_TickHook = Fifo_Tick;
+	Host_PinOut[0][11] = 1;
+	for(i = 0; i < FRAME_SIZE; i++) Fifo[i] = (uint8_t)(i * 31 + i / 1000);
+
+	Test_Init();
+
+	//先把读指针移开，验证复位
+	FifoRead = 12345;
+	FIFO_ReadReset();
+	CHECK_EQ(FifoRead, 1);
+	CHECK_EQ(FifoOut, Fifo[0]);
+	CHECK_EQ(Host_PinOut[0][11], 1);
+	Test_Mode();
+
+	//整帧：每行恰好640个RCLK，字节顺序与FIFO中一致
+	FIFO_ReadReset();
+	FifoClocks = 0;
+	ok = 1;
+	for(line = 0; line < FIFO_IMG_HEIGHT; line++)
+	{
+		FIFO_ReadLine(buf);
+		Host_Advance(FIFO_LINE_SIZE);			//压缩一行至少640个周期，主机上不计时
+		if(memcmp(buf, Fifo + line * FIFO_LINE_SIZE, FIFO_LINE_SIZE)) ok = 0;
+	}
+	CHECK(ok);
+	CHECK(!FIFO_LineBusy());
+	CHECK_EQ(FifoRead, FRAME_SIZE + 1);
+	CHECK_EQ(FifoClocks, FRAME_SIZE);
+	CHECK(FIFO_LineCyclesMax > 0 && FIFO_LineCycles <= FIFO_LineCyclesMax);
+#if FIFO_READ_MODE == FIFO_READ_DMA
+	CHECK_EQ(DmaBadStart, 0);
+#endif
+
+	Test_Pack();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,218 @@
+//帧状态机：快门到下一个VSYNC开始写入、锁存后FIFO不再写入、读出后保留或释放、
+//配置未就绪时等待（FRAME_EV_HOLD）、写入/锁存/读出期间再次按下快门、边读边写
+#include "frame.h"
+#include "test.h"
+
+#define FRAME_TIME	1000
+
+static uint8_t Wen, HoldReady = 1;
+static uint32_t Starts, Stops, Events[4];
+static uint32_t Now;
+
+static void Write_Start(void) { Wen = 1; Starts++; }
+static void Write_Stop(void) { Wen = 0; Stops++; }
+static uint8_t Blanking(void) { return HoldReady; }
+static void Event(Frame_EventTypeDef ev, const Frame_InfoTypeDef *info) { (void)info; Events[ev]++; }
+
+static const Frame_ConfigTypeDef Cfg = {Write_Start, Write_Stop, Blanking, Event};
+
+//VSYNC在FRAME_TIME的整数倍时刻
+static void Vsync(void)
+{
+	Now = (Now / FRAME_TIME + 1) * FRAME_TIME;
+	Frame_Vsync(Now);
+}
+
+/* 锁存一帧后释放，回到IDLE */
+static void Latch(void)
+{
+	Frame_Arm(Now);
+	Vsync();
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK(Frame_Drain());
+	Frame_Release(0);
+	CHECK_EQ(Frame_GetState(), FRAME_IDLE);
+}
+
+static void Test_Basic(void)
+{
+	const Frame_InfoTypeDef *info = Frame_GetInfo();
+
+	//没有快门时不写入
+	Vsync();
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_IDLE);
+	CHECK_EQ(Starts, 0);
+
+	//帧中间按下快门：下一个VSYNC开始写入，再下一个锁存
+	Now += 300;
+	Frame_Arm(Now);
+	CHECK_EQ(Frame_GetState(), FRAME_ARMED);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_WRITING);
+	CHECK(Wen);
+	CHECK_EQ(Frame_Drain(), 0);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK(!Wen);
+	CHECK_EQ(Events[FRAME_EV_START], 1);
+	CHECK_EQ(Events[FRAME_EV_READY], 1);
+	CHECK_EQ(info->start - info->armed, FRAME_TIME - 300);
+	CHECK_EQ(info->end - info->start, FRAME_TIME);
+	CHECK_EQ(info->vsync, 3);
+
+	//锁存的帧保留，读出期间FIFO不写入
+	Vsync();
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK_EQ(Starts, 1);
+	CHECK(Frame_Drain());
+	CHECK_EQ(Frame_GetState(), FRAME_DRAINING);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_DRAINING);
+	CHECK(!Wen);
+
+	//保留后可以再次读出
+	Frame_Release(1);
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK(Frame_Drain());
+	Frame_Release(0);
+	CHECK_EQ(Frame_GetState(), FRAME_IDLE);
+}
+
+static void Test_Hold(void)
+{
+	uint32_t holds = Events[FRAME_EV_HOLD];
+
+	//blanking返回0：不开始写入，每个VSYNC投递HOLD
+	HoldReady = 0;
+	Frame_Arm(Now);
+	Vsync();
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_ARMED);
+	CHECK(!Wen);
+	CHECK_EQ(Events[FRAME_EV_HOLD] - holds, 2);
+
+	//就绪后的第一个VSYNC开始写入，不再投递HOLD
+	HoldReady = 1;
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_WRITING);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK_EQ(Events[FRAME_EV_HOLD] - holds, 2);
+
+	//没有快门时blanking返回0也不投递
+	CHECK(Frame_Drain());
+	Frame_Release(0);
+	HoldReady = 0;
+	Vsync();
+	HoldReady = 1;
+	CHECK_EQ(Events[FRAME_EV_HOLD] - holds, 2);
+}
+
+static void Test_Rearm(void)
+{
+	const Frame_InfoTypeDef *info = Frame_GetInfo();
+	uint32_t starts, old;
+
+	//写入期间按下快门：开始于快门之前的这一帧舍弃，接着写下一帧
+	Frame_Arm(Now);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_WRITING);
+	Now += 10;
+	Frame_Arm(Now);
+	starts = Starts;
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_WRITING);
+	CHECK_EQ(Events[FRAME_EV_DISCARD], 1);
+	CHECK_EQ(Starts, starts + 1);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK_EQ(info->armed, Now - 2 * FRAME_TIME + 10);
+	CHECK_EQ(info->start, Now - FRAME_TIME);
+	CHECK(info->start > info->armed);
+
+	//锁存后按下快门：旧帧舍弃
+	old = info->start;
+	Frame_Arm(Now);
+	CHECK_EQ(Frame_GetState(), FRAME_ARMED);
+	Vsync();
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK(info->start > old);
+
+	//读出期间按下快门：释放后进入ARMED
+	CHECK(Frame_Drain());
+	Frame_Arm(Now);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_DRAINING);
+	CHECK(!Wen);
+	Frame_Release(1);
+	CHECK_EQ(Frame_GetState(), FRAME_ARMED);
+	Vsync();
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK(Frame_Drain());
+	Frame_Release(0);
+}
+
+static void Test_Stream(void)
+{
+	const Frame_InfoTypeDef *info;
+
+	//IDLE和ARMED时不能边读边写
+	CHECK_EQ(Frame_Stream(), 0);
+	Frame_Arm(Now);
+	CHECK_EQ(Frame_Stream(), 0);
+	CHECK_EQ(Frame_GetState(), FRAME_ARMED);
+
+	//写入期间开始读出，写完后直接进入DRAINING
+	Vsync();
+	CHECK(Frame_Stream());
+	CHECK_EQ(Frame_GetState(), FRAME_WRITING);
+	info = Frame_GetInfo();
+	CHECK_EQ(info->start, Now);
+	CHECK(Frame_Stream());
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_DRAINING);
+	CHECK(!Wen);
+	CHECK_EQ(info->end - info->start, FRAME_TIME);
+	Frame_Release(0);
+	CHECK_EQ(Frame_GetState(), FRAME_IDLE);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_IDLE);
+
+	//已锁存时与Frame_Drain相同，之后照常锁存
+	Frame_Arm(Now);
+	Vsync();
+	Vsync();
+	CHECK(Frame_Stream());
+	CHECK_EQ(Frame_GetState(), FRAME_DRAINING);
+	Frame_Release(0);
+	Latch();
+
+	//写完之前放弃读出：请求取消，这一帧照常进入READY
+	Frame_Arm(Now);
+	Vsync();
+	CHECK(Frame_Stream());
+	Frame_Release(0);
+	CHECK_EQ(Frame_GetState(), FRAME_WRITING);
+	Vsync();
+	CHECK_EQ(Frame_GetState(), FRAME_READY);
+	CHECK(Frame_Drain());
+	Frame_Release(0);
+}
+
+int main(void)
+{
+	Frame_Init(&Cfg);
+
+	Test_Basic();
+	Test_Hold();
+	Test_Rearm();
+	Test_Stream();
+
+	CHECK_EQ(Starts, Stops + Wen);
+	return TEST_RESULT();
+}
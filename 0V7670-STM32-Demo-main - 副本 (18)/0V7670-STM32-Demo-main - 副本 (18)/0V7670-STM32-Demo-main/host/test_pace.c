@@ -0,0 +1,70 @@
+//边读边写的读出节拍：各行开始读取的时刻，按时读取时余量等于margin行，传感器比预计慢时余量为负，
+//读取晚于节拍时余量变大，个别行读早了以该行为准，DWT计数器回绕，没有读取任何一行
+#include "frame.h"
+#include "test.h"
+
+#define LINE		14112					//8MHz内部时钟下一行784tp（RGB565每tp两个时钟）= 196us
+#define LINES		510
+#define LEAD		20
+#define STEP		2
+#define MARGIN		8
+#define ROWS		240
+
+static Frame_PaceTypeDef Pace;
+
+static void Init(uint32_t start)
+{
+	Pace.start = start;
+	Pace.line = LINE;
+	Pace.lines = LINES;
+	Pace.lead = LEAD;
+	Pace.step = STEP;
+	Pace.margin = MARGIN;
+	Frame_PaceInit(&Pace);
+}
+
+/* 每行在节拍时刻之后late个周期开始读取，传感器每行实际用line个周期，返回余量 */
+static int32_t Run(uint32_t start, uint32_t line, uint32_t late)
+{
+	uint16_t row;
+
+	Init(start);
+	for(row = 0; row < ROWS; row++)
+		Frame_PaceRead(&Pace, row, Frame_PaceDue(&Pace, row) + late);
+	return Frame_PaceSlack(&Pace, start + line * LINES);
+}
+
+int main(void)
+{
+	uint32_t slow = LINE + LINE / 50;		//传感器比预计慢2%
+
+	//没有读取任何一行
+	Init(1000);
+	CHECK_EQ(Frame_PaceSlack(&Pace, 1000 + LINE * LINES), 0X7FFFFFFF);
+
+	//第k行在VSYNC之后 lead + step*(k+1) 行写完，再加margin行
+	CHECK_EQ(Frame_PaceDue(&Pace, 0), 1000 + (LEAD + STEP + MARGIN) * LINE);
+	CHECK_EQ(Frame_PaceDue(&Pace, ROWS - 1), 1000 + (LEAD + STEP * ROWS + MARGIN) * LINE);
+
+	//按节拍读取，传感器准时：最后一行最紧张，余量为margin行
+	CHECK_EQ(Run(1000, LINE, 0), MARGIN * LINE);
+
+	//传感器慢2%：最后一行写完晚了500*2%=10行，超过margin，读到上一帧的数据
+	CHECK_EQ(Run(1000, slow, 0), (int32_t)(LEAD + STEP * ROWS + MARGIN) * LINE - (int32_t)(LEAD + STEP * ROWS) * (int32_t)slow);
+	CHECK(Run(1000, slow, 0) < 0);
+
+	//每行都晚读：余量增加同样的时间
+	CHECK_EQ(Run(1000, LINE, 5000), MARGIN * LINE + 5000);
+
+	//第5行读早了：写完需要32行，31行时就开始读取
+	Run(1000, LINE, 0);
+	Frame_PaceRead(&Pace, 5, 1000 + 31 * LINE);
+	CHECK_EQ(Frame_PaceSlack(&Pace, 1000 + LINE * LINES), -LINE);
+
+	//DWT_CYCCNT在帧中间回绕：结果相同
+	CHECK_EQ(Run(0XFFFFFFFF - 100 * LINE, LINE, 0), MARGIN * LINE);
+	CHECK_EQ(Run(0XFFFFFFFF - 100 * LINE, slow, 0), Run(1000, slow, 0));
+	CHECK_EQ(Run(0XFFFFFFFF - 100 * LINE, LINE, 5000), MARGIN * LINE + 5000);
+
+	return TEST_RESULT();
+}
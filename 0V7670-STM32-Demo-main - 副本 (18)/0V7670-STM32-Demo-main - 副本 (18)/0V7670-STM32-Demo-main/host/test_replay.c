@@ -0,0 +1,231 @@
+//Replay_File：碎片化的文件从扇区对齐和不对齐的位置回放，快速定位簇表建立成功和放弃两种情况，
+//输出端出错时返回FR_INT_ERR并归还缓冲区；Photo_ReadHeader识别v1/v2头部
+#include "stm32f10x.h"
+#include "replay.h"
+#include "photo.h"
+#include "capture.h"
+#include "fatfs.h"
+#include "frame.h"
+#include "sd_emu.h"
+#include "fs_host.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define IMG_SIZE		(PHOTO_HEADER_SIZE + CAPTURE_FRAME_SIZE)
+
+/* photo.c用到的其他模块 */
+static Frame_InfoTypeDef Info;
+const Frame_InfoTypeDef *Frame_GetInfo(void) { return &Info; }
+u8 SCCB_RD_Reg(u8 reg) { return reg ^ 0x5A; }
+uint32_t FIFO_LineCyclesMax;
+
+static uint8_t Img[IMG_SIZE];
+static uint8_t Out[IMG_SIZE];
+static uint32_t OutLen;
+
+/* 异步输出端：交出的缓冲区排队，REPLAY_WAIT中按顺序“发送完成” */
+static const uint8_t *Queue[4];
+static Replay_DoneTypeDef QueueDone;
+static uint8_t Head, Tail, MaxHeld;
+static uint32_t Calls, FailAt;
+
+void Test_ReplayWait(void)
+{
+	if(Head == Tail) return;
+	QueueDone(Queue[Tail++ % 4]);
+}
+
+static uint8_t Sink(const uint8_t *buf, uint16_t len, Replay_DoneTypeDef done)
+{
+	if(++Calls == FailAt) return 1;
+	CHECK((uint8_t)(Head - Tail) < 2);				//两个缓冲区都在发送时不会再交出
+	memcpy(Out + OutLen, buf, len);
+	OutLen += len;
+	QueueDone = done;
+	Queue[Head++ % 4] = buf;
+	if((uint8_t)(Head - Tail) > MaxHeld) MaxHeld = Head - Tail;
+	return 0;
+}
+
+static uint8_t Buf0[1024] __attribute__((aligned(4))), Buf1[1024] __attribute__((aligned(4)));
+
+/* 统计开始发送之后从FAT区和根目录读出的扇区（打开文件、建立簇表时的读取不算） */
+static uint32_t FatReads;
+static void Read_Hook(uint32_t sector)
+{
+	if(Calls && sector < USERFatFS.database) FatReads++;
+}
+
+static FRESULT Replay(const char *path, uint32_t offset, uint32_t *sent)
+{
+	Replay_ConfigTypeDef cfg = {Sink, {Buf0, Buf1}, sizeof(Buf0), offset};
+	FRESULT res;
+
+	OutLen = 0;
+	Head = Tail = MaxHeld = 0;
+	Calls = 0;
+	FatReads = 0;
+	SdEmu_ReadHook = Read_Hook;
+	res = Replay_File(&cfg, path, sent);
+	SdEmu_ReadHook = 0;
+	CHECK_EQ(Head, Tail);							//返回前全部归还
+	return res;
+}
+
+//两个文件交替写入并每次f_sync，path的簇链被分成多段，每段之间隔开gap字节
+static void WriteInterleaved(const char *path, const uint8_t *data, uint32_t size, UINT chunk, UINT gap)
+{
+	static uint8_t junk[32768];
+	static FIL a, b;
+	UINT bw;
+	uint32_t o;
+
+	CHECK_EQ(f_open(&a, path, FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+	CHECK_EQ(f_open(&b, "JUNK.BIN", FA_OPEN_ALWAYS | FA_WRITE), FR_OK);
+	f_lseek(&b, f_size(&b));
+	for(o = 0; o < size; o += chunk)
+	{
+		CHECK_EQ(f_write(&a, data + o, size - o < chunk ? size - o : chunk, &bw), FR_OK);
+		CHECK_EQ(f_write(&b, junk, gap, &bw), FR_OK);
+		f_sync(&a);
+		f_sync(&b);
+	}
+	f_close(&a);
+	f_close(&b);
+}
+
+static void Test_V2(void)
+{
+	Photo_HeaderTypeDef hdr;
+	static FIL f;
+	UINT bw;
+	uint32_t sent;
+	uint32_t frags;
+
+	//v2文件：Photo_Create/Photo_Finish，像素用f_write写入
+	Info.vsync = 77;
+	Photo_HeaderInit(&hdr, 2);
+	CHECK_EQ(f_open(&f, "JUNK.BIN", FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+	f_close(&f);
+	CHECK_EQ(Photo_Create(&f, "IMG_1.DAT", &hdr), FR_OK);
+	CHECK_EQ(f_write(&f, Img + PHOTO_HEADER_SIZE, CAPTURE_FRAME_SIZE, &bw), FR_OK);
+	CHECK_EQ(Photo_Finish(&f, &hdr, 0x12345678), FR_OK);
+
+	//回放像素部分：扇区对齐，不经过FIL的扇区缓存
+	CHECK_EQ(Replay("IMG_1.DAT", PHOTO_HEADER_SIZE, &sent), FR_OK);
+	CHECK_EQ(sent, CAPTURE_FRAME_SIZE);
+	CHECK_EQ(OutLen, CAPTURE_FRAME_SIZE);
+	CHECK(memcmp(Out, Img + PHOTO_HEADER_SIZE, CAPTURE_FRAME_SIZE) == 0);
+	CHECK_EQ(MaxHeld, 2);							//读取与发送重叠
+
+	//整个文件，头部读回
+	CHECK_EQ(Replay("IMG_1.DAT", 0, &sent), FR_OK);
+	CHECK_EQ(sent, IMG_SIZE);
+	memcpy(&hdr, Out, sizeof(hdr));
+	CHECK_EQ(hdr.magic, PHOTO_MAGIC);
+	CHECK_EQ(hdr.crc32, 0x12345678);
+	CHECK_EQ(hdr.frame_counter, 77);
+	CHECK(hdr.flags & PHOTO_FLAG_COMPLETE);
+	CHECK_EQ(hdr.reg_gain, 0x00 ^ 0x5A);
+
+	//碎片化的文件：簇表可以容纳，回放期间不再读FAT
+	WriteInterleaved("IMG_2.DAT", Img, IMG_SIZE, 20000, 1024);
+	frags = FsHost_Fragments("IMG_2.DAT");
+	CHECK(frags > 4 && frags <= (REPLAY_CLMT_SIZE - 1) / 2);
+	CHECK_EQ(Replay("IMG_2.DAT", PHOTO_HEADER_SIZE, &sent), FR_OK);
+	CHECK_EQ(sent, CAPTURE_FRAME_SIZE);
+	CHECK(memcmp(Out, Img + PHOTO_HEADER_SIZE, CAPTURE_FRAME_SIZE) == 0);
+	CHECK_EQ(FatReads, 0);
+	CHECK(SdEmu_CmdCount[18] > 0);					//整扇区多块读
+
+	//碎片太多：放弃簇表，沿FAT链查找（簇链跨几个FAT扇区），结果相同
+	WriteInterleaved("IMG_3.DAT", Img, IMG_SIZE, 4096, 32768);
+	frags = FsHost_Fragments("IMG_3.DAT");
+	CHECK(frags > (REPLAY_CLMT_SIZE - 1) / 2);
+	CHECK_EQ(Replay("IMG_3.DAT", PHOTO_HEADER_SIZE, &sent), FR_OK);
+	CHECK_EQ(sent, CAPTURE_FRAME_SIZE);
+	CHECK(memcmp(Out, Img + PHOTO_HEADER_SIZE, CAPTURE_FRAME_SIZE) == 0);
+	CHECK(FatReads > 0);
+
+	//从不对齐的位置开始
+	CHECK_EQ(Replay("IMG_2.DAT", 1000, &sent), FR_OK);
+	CHECK_EQ(sent, IMG_SIZE - 1000);
+	CHECK(memcmp(Out, Img + 1000, IMG_SIZE - 1000) == 0);
+
+	//起始位置在结尾：什么都不发
+	CHECK_EQ(Replay("IMG_2.DAT", IMG_SIZE, &sent), FR_OK);
+	CHECK_EQ(sent, 0);
+}
+
+static void Test_Errors(void)
+{
+	uint32_t sent;
+
+	//输出端第3次出错：已交出的缓冲区全部归还后返回
+	FailAt = 3;
+	CHECK_EQ(Replay("IMG_2.DAT", PHOTO_HEADER_SIZE, &sent), FR_INT_ERR);
+	CHECK_EQ(sent, 2 * sizeof(Buf0));
+	CHECK_EQ(OutLen, 2 * sizeof(Buf0));
+	FailAt = 0;
+
+	//文件不存在
+	CHECK_EQ(Replay("NONE.DAT", 0, &sent), FR_NO_FILE);
+	CHECK_EQ(sent, 0);
+
+	//读出错
+	SdEmu_ReadToken = 0x08;
+	CHECK(Replay("IMG_2.DAT", PHOTO_HEADER_SIZE, &sent) != FR_OK);
+	SdEmu_ClearFaults();
+	CHECK_EQ(FsHost_Remount(), FR_OK);
+}
+
+static void Test_Header(void)
+{
+	static const char v1[] = "IMG_START,320,240,16,3,1\r\n";
+	Photo_HeaderTypeDef hdr;
+	static FIL f;
+	UINT br;
+	uint8_t first[4];
+
+	CHECK_EQ(sizeof(v1) - 1, 26);
+	memcpy(Img, v1, 26);
+	CHECK_EQ(FsHost_WriteFile("IMG_V1.DAT", Img, 26 + CAPTURE_FRAME_SIZE), FR_OK);
+	CHECK_EQ(f_open(&f, "IMG_V1.DAT", FA_READ), FR_OK);
+	CHECK_EQ(Photo_ReadHeader(&f, &hdr), 1);
+	CHECK_EQ(hdr.header_size, 26);
+	CHECK_EQ(hdr.width, 320);
+	CHECK_EQ(hdr.height, 240);
+	CHECK_EQ(hdr.light_mode, 3);
+	CHECK_EQ(hdr.data_size, CAPTURE_FRAME_SIZE);
+	CHECK_EQ(f_read(&f, first, 4, &br), FR_OK);		//文件指针在像素起始处
+	CHECK(memcmp(first, Img + 26, 4) == 0);
+	f_close(&f);
+
+	CHECK_EQ(f_open(&f, "IMG_1.DAT", FA_READ), FR_OK);
+	CHECK_EQ(Photo_ReadHeader(&f, &hdr), 2);
+	CHECK_EQ(hdr.light_mode, 2);
+	CHECK_EQ(f_tell(&f), PHOTO_HEADER_SIZE);
+	f_close(&f);
+
+	CHECK_EQ(f_open(&f, "JUNK.BIN", FA_READ), FR_OK);
+	CHECK_EQ(Photo_ReadHeader(&f, &hdr), 0);
+	f_close(&f);
+}
+
+int main(void)
+{
+	uint32_t i;
+
+	Host_Reset();
+	srand(1);
+	for(i = 0; i < IMG_SIZE; i++) Img[i] = (uint8_t)rand();
+	CHECK_EQ(FsHost_Format(1024), FR_OK);			//两个扇区一簇，碎片多
+
+	Test_V2();
+	Test_Errors();
+	Test_Header();
+
+	CHECK_EQ(SdEmu_Errors, 0);
+	return TEST_RESULT();
+}
@@ -0,0 +1,158 @@
+//SCCB_WR_Table接在从机模型上：正常写入、NACK后重试成功、一直NACK时记为失败但其余寄存器照常写入、
+//读回不一致的重试和失败、no_verify跳过读回、不读回时没有读操作；总线时序不短于SCCB_SetTiming的设置
+#include "stm32f10x.h"
+#include "SCCB.h"
+#include "sccb_emu.h"
+#include "test.h"
+#include <string.h>
+
+static const u8 Table[][2] =
+{
+	{0x12, 0x14},
+	{0x40, 0xD0},
+	{0x3A, 0x04},
+	{0x8C, 0x00},
+	{0x11, 0x81},
+};
+#define TABLE_SIZE	(sizeof(Table) / sizeof(Table[0]))
+
+static SCCB_LoadTypeDef Opt = {1, SCCB_RETRIES, 0};
+static SCCB_StatsTypeDef Stats;
+
+static u8 Load(void)
+{
+	memset(&Stats, 0, sizeof(Stats));
+	memset(SccbEmu_Reg, 0, sizeof(SccbEmu_Reg));
+	SccbEmu_Writes = SccbEmu_Reads = SccbEmu_Nacks = 0;
+	return SCCB_WR_Table(&Table[0][0], TABLE_SIZE, &Opt, &Stats);
+}
+
+static uint8_t Written(void)
+{
+	uint8_t i, n = 0;
+	for(i = 0; i < TABLE_SIZE; i++)
+		if(SccbEmu_Reg[Table[i][0]] == Table[i][1]) n++;
+	return n;
+}
+
+//0x12（COM7）的复位位读回为0
+static u8 No_Verify(u8 reg, u8 val)
+{
+	(void)val;
+	return reg == 0x12;
+}
+
+static void Test_Clean(void)
+{
+	CHECK_EQ(Load(), 0);
+	CHECK_EQ(Written(), TABLE_SIZE);
+	CHECK_EQ(Stats.writes, TABLE_SIZE);
+	CHECK_EQ(Stats.retries + Stats.nacks + Stats.mismatches + Stats.failed, 0);
+	CHECK_EQ(SccbEmu_Writes, TABLE_SIZE);
+	CHECK_EQ(SccbEmu_Reads, TABLE_SIZE);			//每个寄存器读回一次
+	CHECK(Stats.cycles > 0);
+
+	//单独读写
+	CHECK_EQ(SCCB_WR_Reg(0x55, 0xA5), 0);
+	CHECK_EQ(SCCB_RD_Reg(0x55), 0xA5);
+	CHECK_EQ(SCCB_RD_Reg(0x40), 0xD0);
+}
+
+static void Test_Nack(void)
+{
+	//NACK一次：重试一次后成功
+	SccbEmu_Nack[0x40] = 1;
+	CHECK_EQ(Load(), 0);
+	CHECK_EQ(Written(), TABLE_SIZE);
+	CHECK_EQ(Stats.nacks, 1);
+	CHECK_EQ(Stats.retries, 1);
+	CHECK_EQ(Stats.failed, 0);
+	CHECK_EQ(SccbEmu_Nacks, 1);
+
+	//一直NACK：重试opt.retries次后记为失败，后面的寄存器照常写入
+	SccbEmu_Nack[0x3A] = 0xFF;
+	CHECK_EQ(Load(), 1);
+	CHECK_EQ(Stats.failed, 1);
+	CHECK_EQ(Stats.last_failed, 0x3A);
+	CHECK_EQ(Stats.retries, SCCB_RETRIES);
+	CHECK_EQ(Stats.nacks, SCCB_RETRIES + 1);
+	CHECK_EQ(Stats.writes, TABLE_SIZE);
+	CHECK_EQ(Written(), TABLE_SIZE - 1);
+	CHECK_EQ(SccbEmu_Reg[0x11], 0x81);
+
+	//不重试：只写一次
+	Opt.retries = 0;
+	CHECK_EQ(Load(), 1);
+	CHECK_EQ(Stats.nacks, 1);
+	CHECK_EQ(Stats.retries, 0);
+	Opt.retries = SCCB_RETRIES;
+	SccbEmu_ClearFaults();
+}
+
+static void Test_Mismatch(void)
+{
+	//第一次写入丢失：读回不一致，重写后成功
+	SccbEmu_Drop[0x8C] = 1;
+	SccbEmu_Reg[0x8C] = 0x55;
+	memset(&Stats, 0, sizeof(Stats));
+	CHECK_EQ(SCCB_WR_Table(&Table[3][0], 1, &Opt, &Stats), 0);
+	CHECK_EQ(Stats.mismatches, 1);
+	CHECK_EQ(Stats.retries, 1);
+	CHECK_EQ(SccbEmu_Reg[0x8C], 0x00);
+
+	//读回一直不一致：记为失败
+	SccbEmu_Mask[0x12] = 0xEF;
+	CHECK_EQ(Load(), 1);
+	CHECK_EQ(Stats.mismatches, SCCB_RETRIES + 1);
+	CHECK_EQ(Stats.failed, 1);
+	CHECK_EQ(Stats.last_failed, 0x12);
+	CHECK_EQ(Stats.nacks, 0);
+
+	//no_verify跳过该寄存器：不读回，不重试
+	Opt.no_verify = No_Verify;
+	CHECK_EQ(Load(), 0);
+	CHECK_EQ(Stats.mismatches + Stats.retries + Stats.failed, 0);
+	CHECK_EQ(SccbEmu_Reads, TABLE_SIZE - 1);
+	Opt.no_verify = 0;
+
+	//不读回：没有读操作，写入丢失也发现不了
+	Opt.verify = 0;
+	SccbEmu_Drop[0x40] = 1;
+	CHECK_EQ(Load(), 0);
+	CHECK_EQ(SccbEmu_Reads, 0);
+	CHECK_EQ(Written(), TABLE_SIZE - 1);
+	Opt.verify = 1;
+	SccbEmu_ClearFaults();
+}
+
+static void Test_Timing(void)
+{
+	SCCB_TimingTypeDef slow = {5000, 4000, 5000};
+
+	//默认时序：快速模式的最小值
+	CHECK(SccbEmu_MinLow >= (SCCB_LOW_NS * 72 + 999) / 1000);
+	CHECK(SccbEmu_MinHigh >= (SCCB_HIGH_NS * 72 + 999) / 1000);
+
+	//放慢后重新测量
+	SCCB_SetTiming(&slow);
+	SccbEmu_MinLow = SccbEmu_MinHigh = 0xFFFFFFFF;
+	CHECK_EQ(Load(), 0);
+	CHECK(SccbEmu_MinLow >= 5000 * 72 / 1000);
+	CHECK(SccbEmu_MinHigh >= 4000 * 72 / 1000);
+	CHECK(SccbEmu_MinHigh < 4000 * 72 / 1000 + 40);
+}
+
+int main(void)
+{
+	Host_Reset();
+	SccbEmu_Attach();
+	SCCB_Init();
+
+	Test_Clean();
+	Test_Nack();
+	Test_Mismatch();
+	Test_Timing();
+
+	CHECK_EQ(SccbEmu_Errors, 0);
+	return TEST_RESULT();
+}
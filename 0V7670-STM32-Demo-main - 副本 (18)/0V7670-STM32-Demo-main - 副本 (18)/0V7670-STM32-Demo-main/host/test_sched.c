@@ -0,0 +1,247 @@
+//调度器：按任务表顺序的优先级、处理函数中向自己投递、定时器到期（单次/周期/错过不补发）和延迟统计、
+//队列满丢弃、初始化之前的投递、Sched_Report的格式，计数器多次回绕的100s空闲后统计时长仍正确
+#include "sched.h"
+#include "test.h"
+#include <stdio.h>
+#include <string.h>
+
+#define US			72						//72MHz的DWT_CYCCNT
+
+enum { T_KEY, T_CAMERA, T_STORAGE, T_TELEMETRY, T_COUNT };
+
+static uint32_t Now = 0XFFFFFFFF - 1000 * US;	//1ms后回绕
+static uint32_t Cost[T_COUNT];					//每个事件的处理时间
+static uint8_t Order[32], Sigs[32], Ran;
+static uint32_t Idles;
+
+static char Lines[8][128];
+static uint8_t LineCount;
+
+static uint32_t Clock(void) { return Now; }
+static void Idle(void) { Idles++; }
+
+static void Run(uint8_t task, const Sched_EventTypeDef *ev)
+{
+	if(Ran < 32)
+	{
+		Order[Ran] = task;
+		Sigs[Ran] = ev->sig;
+		Ran++;
+	}
+	Now += Cost[task];
+}
+
+static void Key_Task(const Sched_EventTypeDef *ev) { Run(T_KEY, ev); }
+static void Storage_Task(const Sched_EventTypeDef *ev) { Run(T_STORAGE, ev); }
+static void Telemetry_Task(const Sched_EventTypeDef *ev) { Run(T_TELEMETRY, ev); }
+
+//sig为1时再向自己投递一个sig为2的事件
+static void Camera_Task(const Sched_EventTypeDef *ev)
+{
+	Run(T_CAMERA, ev);
+	if(ev->sig == 1)
+		CHECK_EQ(Sched_Post(T_CAMERA, 2, 0, 0), 0);
+}
+
+static const Sched_TaskTypeDef Tasks[T_COUNT] =
+{
+	{"key", Key_Task}, {"camera", Camera_Task}, {"storage", Storage_Task}, {"telemetry", Telemetry_Task}
+};
+static const Sched_ConfigTypeDef Cfg = {Tasks, T_COUNT, Clock, US, Idle};
+
+static void Print(const char *line)
+{
+	if(LineCount < 8)
+		strcpy(Lines[LineCount], line);
+	LineCount++;
+}
+
+/* 运行到空闲为止 */
+static void Drain(void)
+{
+	Ran = 0;
+	while(Sched_RunOnce())
+		;
+}
+
+static void Report(void)
+{
+	LineCount = 0;
+	Sched_Report(Print);
+	CHECK_EQ(LineCount, T_COUNT + 1);
+}
+
+static void Test_Order(void)
+{
+	//投递顺序与优先级相反：按任务号运行，同一任务先进先出
+	CHECK_EQ(Sched_Post(T_TELEMETRY, 0, 0, 0), 0);
+	CHECK_EQ(Sched_Post(T_STORAGE, 0, 0, 0), 0);
+	CHECK_EQ(Sched_Post(T_STORAGE, 1, 0, 0), 0);
+	CHECK_EQ(Sched_Post(T_CAMERA, 1, 0, 0), 0);
+	CHECK_EQ(Sched_Post(T_KEY, 0, 0, 0), 0);
+	Drain();
+	CHECK_EQ(Ran, 6);
+	CHECK_EQ(Order[0], T_KEY);
+	CHECK_EQ(Order[1], T_CAMERA);
+	CHECK_EQ(Order[2], T_CAMERA);				//向自己投递的事件优先于低优先级任务
+	CHECK_EQ(Sigs[2], 2);
+	CHECK_EQ(Order[3], T_STORAGE);
+	CHECK_EQ(Sigs[3], 0);
+	CHECK_EQ(Sigs[4], 1);
+	CHECK_EQ(Order[5], T_TELEMETRY);
+	CHECK_EQ(Sched_GetStats(T_CAMERA)->runs, 2);
+
+	//存储任务运行时投递的按键事件排在剩下的存储事件之前
+	Sched_Post(T_STORAGE, 0, 0, 0);
+	Sched_Post(T_STORAGE, 1, 0, 0);
+	CHECK_EQ(Sched_RunOnce(), 1);
+	Sched_Post(T_KEY, 0, 0, 0);
+	Drain();
+	CHECK_EQ(Ran, 2);
+	CHECK_EQ(Order[0], T_KEY);
+	CHECK_EQ(Order[1], T_STORAGE);
+
+	//空闲时调用idle
+	Idles = 0;
+	CHECK_EQ(Sched_RunOnce(), 0);
+	CHECK_EQ(Idles, 1);
+}
+
+static void Test_Timer(void)
+{
+	const Sched_StatsTypeDef *key = Sched_GetStats(T_KEY);
+	uint32_t start;
+
+	//单次：到期前不投递，晚检查的部分计入延迟
+	Sched_Report(Print);
+	Sched_TimerStart(0, T_KEY, 5, 100 * US, 0);
+	CHECK(Sched_TimerActive(0));
+	Now += 99 * US;
+	Drain();
+	CHECK_EQ(Ran, 0);
+	Now += 50 * US;
+	Drain();
+	CHECK_EQ(Ran, 1);
+	CHECK_EQ(Sigs[0], 5);
+	CHECK_EQ(key->max_latency, 49 * US);
+	CHECK(!Sched_TimerActive(0));
+	Now += 1000 * US;
+	Drain();
+	CHECK_EQ(Ran, 0);
+
+	//周期：按到期时刻排，检查晚了不累积
+	start = Now;
+	Sched_TimerStart(1, T_TELEMETRY, 0, 1000 * US, 1000 * US);
+	Now = start + 1010 * US;
+	Drain();
+	Now = start + 2005 * US;
+	Drain();
+	CHECK_EQ(Ran, 1);
+	CHECK_EQ(Sched_GetStats(T_TELEMETRY)->runs, 2);
+
+	//错过了几个周期：只投递一次，从检查时刻重新计时
+	Now = start + 5500 * US;
+	Drain();
+	CHECK_EQ(Ran, 1);
+	Now = start + 6000 * US;
+	Drain();
+	CHECK_EQ(Ran, 0);
+	Now = start + 6500 * US;
+	Drain();
+	CHECK_EQ(Ran, 1);
+
+	//停止后不再投递
+	Sched_TimerStop(1);
+	CHECK(!Sched_TimerActive(1));
+	Now += 10000 * US;
+	Drain();
+	CHECK_EQ(Ran, 0);
+
+	//处理时间计入运行时间，排在后面的事件计入延迟
+	Sched_Report(Print);
+	Cost[T_KEY] = 300 * US;
+	Sched_Post(T_KEY, 0, 0, 0);
+	Sched_Post(T_KEY, 0, 0, 0);
+	Drain();
+	Cost[T_KEY] = 0;
+	CHECK_EQ(key->runs, 2);
+	CHECK_EQ(key->cpu, 600 * US);
+	CHECK_EQ(key->max_run, 300 * US);
+	CHECK_EQ(key->max_latency, 300 * US);
+}
+
+static void Test_Overflow(void)
+{
+	const Sched_StatsTypeDef *st = Sched_GetStats(T_TELEMETRY);
+	uint16_t i;
+
+	//队列满后丢弃并计数，已排队的事件不受影响
+	Sched_Report(Print);
+	for(i = 0; i < SCHED_QUEUE_SIZE + 2; i++)
+		CHECK_EQ(Sched_Post(T_TELEMETRY, i, 0, 0), i >= SCHED_QUEUE_SIZE);
+	CHECK_EQ(st->drops, 2);
+	CHECK_EQ(st->queue_peak, SCHED_QUEUE_SIZE);
+	Drain();
+	CHECK_EQ(Ran, SCHED_QUEUE_SIZE);
+	CHECK_EQ(Sigs[SCHED_QUEUE_SIZE - 1], SCHED_QUEUE_SIZE - 1);
+
+	//丢弃数到255为止
+	for(i = 0; i < SCHED_QUEUE_SIZE + 300; i++)
+		Sched_Post(T_TELEMETRY, 0, 0, 0);
+	CHECK_EQ(st->drops, 255);
+
+	//输出后统计清零
+	Drain();
+	Report();
+	CHECK(strstr(Lines[T_TELEMETRY], "SCHED,telemetry,runs=16,") == Lines[T_TELEMETRY]);
+	CHECK(strstr(Lines[T_TELEMETRY], ",queue=8,drops=255") != NULL);
+	CHECK_EQ(st->runs, 0);
+	CHECK_EQ(st->drops, 0);
+}
+
+static void Test_Report(void)
+{
+	Sched_Report(Print);
+
+	//1s以下
+	Cost[T_CAMERA] = 250 * US;
+	Sched_Post(T_CAMERA, 0, 0, 0);
+	Drain();
+	Now += 750 * US;
+	Drain();
+	Report();
+	CHECK(strcmp(Lines[T_CAMERA], "SCHED,camera,runs=1,cpu_us=250,max_us=250,lat_us=0,queue=1,drops=0") == 0);
+	CHECK(strcmp(Lines[T_COUNT], "SCHED,total,us=1000,busy_us=250") == 0);
+
+	//1s以上：微秒部分补零
+	Now += 1000005 * US;
+	Drain();
+	Report();
+	CHECK(strcmp(Lines[T_COUNT], "SCHED,total,us=1000005,busy_us=0") == 0);
+
+	//运行一次后空闲100s（每毫秒查询一次），计数器回绕了一次
+	Sched_Post(T_CAMERA, 0, 0, 0);
+	Idles = 0;
+	while(Idles < 100000)
+	{
+		if(!Sched_RunOnce())
+			Now += 1000 * US;
+	}
+	Cost[T_CAMERA] = 0;
+	Report();
+	CHECK(strcmp(Lines[T_COUNT], "SCHED,total,us=100000250,busy_us=250") == 0);
+}
+
+int main(void)
+{
+	//初始化之前的投递丢弃
+	CHECK_EQ(Sched_Post(T_KEY, 0, 0, 0), 1);
+	Sched_Init(&Cfg);
+	CHECK_EQ(Sched_GetStats(T_KEY)->drops, 0);
+
+	Test_Order();
+	Test_Timer();
+	Test_Overflow();
+	Test_Report();
+	return TEST_RESULT();
+}
@@ -0,0 +1,214 @@
+//SD卡SPI驱动：在sd_emu.c的卡模型上检查初始化命令顺序、读写令牌、多块传输，
+//以及卡忙超时、CRC错误响应、不应答和错误令牌时SD_ReadDisk/SD_WriteDisk的返回值
+#include "stm32f10x.h"
+#include "SDdriver.h"
+#include "sd_emu.h"
+#include "test.h"
+#include <string.h>
+
+#define MS			72000ULL
+
+static uint8_t Buf[8 * 512], Back[8 * 512];
+
+static void Fill(uint8_t seed)
+{
+	uint16_t i;
+	for(i = 0; i < sizeof(Buf); i++) Buf[i] = (uint8_t)(i * 13 + seed + i / 512);
+}
+
+#if SD_USE_DMA
+static uint32_t IdleCalls, IdleOutside;
+
+static void Idle(void)
+{
+	IdleCalls++;
+	if(!(Host_DMA1_Channel[2].CCR & DMA_CCR2_EN)) IdleOutside++;
+	Host_Advance(50);
+}
+#endif
+
+static uint8_t Logged(const uint8_t *expect, uint8_t n)
+{
+	return SdEmu_LogLen >= n && memcmp(SdEmu_Log, expect, n) == 0;
+}
+
+static void Test_InitHc(void)
+{
+	static const uint8_t order[] = {0, 8, 55, 0x80 | 41};
+
+	SdEmu_Attach(1);
+	CHECK_EQ(SD_init(), 0);
+	CHECK_EQ(SD_TYPE, V2HC);
+	CHECK_EQ(SdEmu_Errors, 0);						//CMD0/CMD8的CRC、ACMD41前的CMD55、识别阶段的时钟
+	CHECK(Logged(order, sizeof(order)));
+	CHECK(SdEmu_CmdCount[64 + 41] >= 5);			//轮询ACMD41直到退出空闲状态
+	CHECK_EQ(SdEmu_CmdCount[58], 1);
+	CHECK_EQ(SdEmu_CmdCount[16], 0);				//块寻址的卡不用设块长
+	CHECK_EQ(SdEmu_CmdCount[9], 1);
+	CHECK_EQ(SD_SpiHz, 18000000);					//卡25MHz，SPI1最高18MHz
+	CHECK_EQ(SD_GetSectorCount(), SD_EMU_SECTORS);
+}
+
+static void Test_InitSc(void)
+{
+	SdEmu_Attach(0);
+	CHECK_EQ(SD_init(), 0);
+	CHECK_EQ(SD_TYPE, V2);
+	CHECK_EQ(SdEmu_CmdCount[16], 1);
+	CHECK_EQ(SD_GetSectorCount(), SD_EMU_SECTORS);
+
+	//字节地址：模型检查地址按512对齐
+	Fill(1);
+	CHECK_EQ(SD_WriteDisk(Buf, 7, 1), 0);
+	CHECK_EQ(SD_WriteDisk(Buf + 512, 8, 3), 0);
+	CHECK_EQ(SD_ReadDisk(Back, 7, 4), 0);
+	CHECK(memcmp(Back, Buf, 4 * 512) == 0);
+	CHECK_EQ(SdEmu_Errors, 0);
+}
+
+static void Test_ReadWrite(void)
+{
+	SdEmu_Attach(1);
+	CHECK_EQ(SD_init(), 0);
+
+	//单块：CMD24/0xFE令牌，CMD17
+	Fill(2);
+	CHECK_EQ(SD_WriteDisk(Buf, 100, 1), 0);
+	CHECK(memcmp(SdEmu_Sector(100), Buf, 512) == 0);
+	CHECK_EQ(SD_ReadDisk(Back, 100, 1), 0);
+	CHECK(memcmp(Back, Buf, 512) == 0);
+	CHECK_EQ(SdEmu_CmdCount[24], 1);
+	CHECK_EQ(SdEmu_CmdCount[17], 1);
+
+	//多块：ACMD23预擦除、CMD25/0xFC令牌/0xFD停止，CMD18/CMD12
+	Fill(3);
+	CHECK_EQ(SD_WriteDisk(Buf, 200, 8), 0);
+	CHECK_EQ(SdEmu_PreErase, 8);
+	CHECK_EQ(SdEmu_CmdCount[64 + 23], 1);
+	CHECK_EQ(SdEmu_CmdCount[25], 1);
+	CHECK_EQ(SdEmu_BlocksWritten, 9);
+	CHECK(memcmp(SdEmu_Sector(207), Buf + 7 * 512, 512) == 0);
+	memset(Back, 0, sizeof(Back));
+	CHECK_EQ(SD_ReadDisk(Back, 200, 8), 0);
+	CHECK(memcmp(Back, Buf, sizeof(Buf)) == 0);
+	CHECK_EQ(SdEmu_CmdCount[18], 1);
+	CHECK_EQ(SdEmu_CmdCount[12], 1);
+
+	//两段拼成一块
+	CHECK_EQ(SD_WriteMultiStart(300, 1), 0);
+	CHECK_EQ(SD_WriteMultiBlockParts(Buf, 100, Buf + 1000), 0);
+	CHECK_EQ(SD_WriteMultiStop(), 0);
+	CHECK(memcmp(SdEmu_Sector(300), Buf, 100) == 0);
+	CHECK(memcmp(SdEmu_Sector(300) + 100, Buf + 1000, 412) == 0);
+
+	CHECK_EQ(SD_Sync(), 0);
+	CHECK_EQ(SdEmu_Errors, 0);
+#if SD_USE_DMA
+	CHECK(SdEmu_DmaBytes >= 19 * 512);				//扇区数据都走DMA
+
+	//DMA传输期间调用SD_IdleHook，回调中不能访问SPI1（模型在DMA进行中被查询收发时报错）
+	SD_IdleHook = Idle;
+	IdleCalls = 0;
+	CHECK_EQ(SD_WriteDisk(Buf, 400, 4), 0);
+	CHECK_EQ(SD_ReadDisk(Back, 400, 4), 0);
+	SD_IdleHook = NULL;
+	CHECK(memcmp(Back, Buf, 4 * 512) == 0);
+	CHECK(IdleCalls > 8 * 16);
+	CHECK_EQ(IdleOutside, 0);
+	CHECK_EQ(SdEmu_Errors, 0);
+#else
+	CHECK_EQ(SdEmu_DmaBytes, 0);
+#endif
+}
+
+static void Test_Errors(void)
+{
+	uint64_t t0;
+	uint8_t r;
+
+	SdEmu_Attach(1);
+	CHECK_EQ(SD_init(), 0);
+	Fill(4);
+	CHECK_EQ(SD_WriteDisk(Buf, 50, 2), 0);
+
+	//数据响应为CRC错误：单块返回2，多块停止并返回错误，扇区不变
+	SdEmu_WriteResp = MSD_DATA_CRC_ERROR;
+	Fill(5);
+	CHECK_EQ(SD_WriteDisk(Buf, 50, 1), 2);
+	CHECK(SD_WriteDisk(Buf, 50, 2) != 0);
+	CHECK_EQ(SdEmu_BlocksWritten, 2);
+	SdEmu_ClearFaults();
+	CHECK_EQ(SD_ReadDisk(Back, 50, 1), 0);
+	Fill(4);
+	CHECK(memcmp(Back, Buf, 512) == 0);
+
+	//写入后卡一直忙：下一条命令等SD_TIMEOUT_WRITE_MS后失败，不会卡死
+	SdEmu_StuckBusy = 1;
+	CHECK_EQ(SD_WriteDisk(Buf, 60, 1), 0);			//数据已接受，忙在下一条命令才暴露
+	t0 = Host_Cycles;
+	r = SD_ReadDisk(Back, 60, 1);
+	CHECK(r != 0);
+	CHECK(Host_Cycles - t0 >= SD_TIMEOUT_WRITE_MS * MS);
+	CHECK(Host_Cycles - t0 < 2 * SD_TIMEOUT_WRITE_MS * MS);
+	CHECK_EQ(SD_Sync(), 1);
+	SdEmu_ClearFaults();
+
+	//多块写入中途卡忙：等下一块超时，停止令牌也超时
+	CHECK_EQ(SD_WriteMultiStart(70, 3), 0);
+	CHECK_EQ(SD_WriteMultiBlock(Buf), 0);
+	SdEmu_StuckBusy = 1;
+	CHECK_EQ(SD_WriteMultiBlock(Buf + 512), 0);
+	t0 = Host_Cycles;
+	CHECK_EQ(SD_WriteMultiBlock(Buf + 1024), 1);
+	CHECK_EQ(SD_WriteMultiStop(), 1);
+	CHECK(Host_Cycles - t0 < 3 * SD_TIMEOUT_WRITE_MS * MS);
+	CHECK_EQ(SdEmu_Errors, 0);
+
+	//停止令牌没有送到，卡还在等数据令牌：重新上电初始化
+	SdEmu_Attach(1);
+	CHECK_EQ(SD_init(), 0);
+
+	//错误令牌和读超时
+	SdEmu_ReadToken = 0x08;
+	CHECK_EQ(SD_ReadDisk(Back, 50, 1), 1);
+	CHECK(SD_ReadDisk(Back, 50, 4) != 0);
+	SdEmu_ReadToken = 0xFF;
+	t0 = Host_Cycles;
+	CHECK_EQ(SD_ReadDisk(Back, 50, 1), 1);
+	CHECK(Host_Cycles - t0 >= SD_TIMEOUT_READ_MS * MS);
+	CHECK(Host_Cycles - t0 < 2 * SD_TIMEOUT_READ_MS * MS);
+	SdEmu_ClearFaults();
+
+	//地址超出范围：命令被拒绝
+	CHECK(SD_ReadDisk(Back, SD_EMU_SECTORS + 10, 1) != 0);
+	CHECK(SD_WriteDisk(Buf, SD_EMU_SECTORS + 10, 1) != 0);
+
+	//卡不应答：命令返回0xFF，初始化在SD_TIMEOUT_INIT_MS后失败
+	SdEmu_NoResponse = 1;
+	CHECK_EQ(SD_ReadDisk(Back, 50, 1), 0xFF);
+	CHECK_EQ(SD_WriteDisk(Buf, 50, 1), 0xFF);
+	t0 = Host_Cycles;
+	CHECK_EQ(SD_init(), 1);
+	CHECK(Host_Cycles - t0 >= SD_TIMEOUT_INIT_MS * MS);
+	CHECK(Host_Cycles - t0 < 2 * SD_TIMEOUT_INIT_MS * MS);
+	CHECK_EQ(SD_TYPE, 0);
+	SdEmu_ClearFaults();
+
+	//故障清除后重新初始化即可恢复
+	CHECK_EQ(SD_init(), 0);
+	CHECK_EQ(SD_ReadDisk(Back, 50, 2), 0);
+	CHECK(memcmp(Back, Buf, 1024) == 0);
+	CHECK_EQ(SdEmu_Errors, 0);
+}
+
+int main(void)
+{
+	Host_Reset();
+
+	Test_InitHc();
+	Test_InitSc();
+	Test_ReadWrite();
+	Test_Errors();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,219 @@
+//会话文件：打开、关闭、再打开（文件名递增），帧槽、帧头和索引的内容，中途放弃后重写同一帧槽，
+//写满后拒绝，连续空间不足时帧槽数减半直到放弃，掉电（不关闭）后索引和帧头仍完整，
+//边读边写（写入期间打开、读出中途帧写完）时帧头的frame_us为这一帧的两次VSYNC间隔
+#include "stm32f10x.h"
+#include "session.h"
+#include "crc32.h"
+#include "frame.h"
+#include "timer.h"
+#include "fatfs.h"
+#include "sd_emu.h"
+#include "fs_host.h"
+#include "test.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define FRAME_US		66666					//15fps
+
+/* session.c、photo.c用到的其他模块 */
+u8 SCCB_RD_Reg(u8 reg) { return reg; }
+uint32_t FIFO_LineCyclesMax;
+uint32_t TIMER_Millis(void) { return (uint32_t)(Host_Cycles / 72000); }
+
+static uint8_t Bufs[3][CAPTURE_LINE_SIZE];
+static uint32_t Sent[3], Done[3];
+static uint32_t Crcs[16];						//当前会话各帧的像素CRC
+static uint32_t FrameUs[16];					//当前会话各帧头中应有的frame_us
+
+//边读边写：StreamLine行之前帧写完（VSYNC），-1为不经过帧状态机
+static int16_t StreamLine = -1;
+static uint32_t Now = 0XFFFFFFFF - 3 * FRAME_US * 72;	//DWT_CYCCNT，会话2中回绕
+
+static void Write_Nop(void) { }
+static const Frame_ConfigTypeDef FrameCfg = {Write_Nop, Write_Nop, NULL, NULL};
+
+static void Done_Cb(const uint8_t *buf)
+{
+	uint8_t b;
+	for(b = 0; b < 3; b++)
+		if(buf == Bufs[b]) Done[b]++;
+}
+
+/* 通过Session_Sink写入一帧，第abort_at行放弃（-1为写完），返回像素CRC */
+static uint32_t Shoot(uint8_t light_mode, int16_t abort_at)
+{
+	const Capture_SinkTypeDef *s = &Session_Sink;
+	uint32_t crc = CRC32_Init();
+	uint16_t l, i;
+	uint8_t b;
+
+	memset(Sent, 0, sizeof(Sent));
+	memset(Done, 0, sizeof(Done));
+	if(StreamLine >= 0)
+	{
+		//快门后的VSYNC开始写入，之前一帧的end早于start
+		Frame_Arm(Now);
+		Now += 1000;
+		Frame_Vsync(Now);
+		CHECK(Frame_Stream());
+		CHECK_EQ(Frame_GetState(), FRAME_WRITING);
+	}
+	CHECK_EQ(s->open(light_mode), 0);
+	for(l = 0; l < CAPTURE_HEIGHT; l++)
+	{
+		if(l == StreamLine)
+		{
+			Now += FRAME_US * 72;
+			Frame_Vsync(Now);
+			CHECK_EQ(Frame_GetState(), FRAME_DRAINING);
+		}
+		b = l % 3;
+		CHECK_EQ(Done[b], Sent[b]);
+		for(i = 0; i < CAPTURE_LINE_SIZE; i++) Bufs[b][i] = (uint8_t)rand();
+		if(l == abort_at)
+		{
+			s->abort();
+			break;
+		}
+		crc = CRC32_Update(crc, Bufs[b], CAPTURE_LINE_SIZE);
+		CHECK_EQ(s->write_async(Bufs[b], CAPTURE_LINE_SIZE, Done_Cb), 0);
+		Sent[b]++;
+	}
+	crc = CRC32_Final(crc);
+	if(abort_at < 0)
+		CHECK_EQ(s->close(crc), 0);
+	if(StreamLine >= 0)
+		Frame_Release(0);
+	for(b = 0; b < 3; b++) CHECK_EQ(Done[b], Sent[b]);
+	return crc;
+}
+
+/* 按文件内容检查会话：头部、前frames个索引项和帧头，像素CRC与写入时相同 */
+static void Check(const char *name, uint32_t frames, uint32_t max_frames, uint8_t closed)
+{
+	static uint8_t pixels[CAPTURE_FRAME_SIZE];
+	static FIL f;
+	Session_HeaderTypeDef sh;
+	Session_EntryTypeDef e;
+	Photo_HeaderTypeDef ph;
+	uint32_t n;
+	UINT br;
+
+	CHECK_EQ(f_open(&f, name, FA_READ), FR_OK);
+	CHECK_EQ(f_read(&f, &sh, sizeof(sh), &br), FR_OK);
+	CHECK_EQ(sh.magic, SESSION_MAGIC);
+	CHECK_EQ(sh.max_frames, max_frames);
+	CHECK_EQ(sh.slot_size, SESSION_SLOT_SIZE);
+	CHECK_EQ(f_size(&f), sh.data_offset + max_frames * SESSION_SLOT_SIZE);
+	CHECK_EQ(sh.flags & SESSION_FLAG_CLOSED, closed);
+	CHECK_EQ(sh.frame_count, closed ? frames : 0);		//掉电时frame_count没有写入，以索引为准
+
+	for(n = 0; n <= frames && n < max_frames; n++)
+	{
+		CHECK_EQ(f_lseek(&f, sh.index_offset + n * sizeof(e)), FR_OK);
+		CHECK_EQ(f_read(&f, &e, sizeof(e), &br), FR_OK);
+		if(n == frames)
+		{
+			CHECK_EQ(e.flags, 0);						//索引在最后一帧之后结束
+			break;
+		}
+		CHECK_EQ(e.flags, SESSION_ENTRY_VALID);
+		CHECK_EQ(e.offset, sh.data_offset + n * SESSION_SLOT_SIZE);
+		CHECK_EQ(e.crc32, Crcs[n]);
+
+		CHECK_EQ(f_lseek(&f, e.offset), FR_OK);
+		CHECK_EQ(f_read(&f, &ph, sizeof(ph), &br), FR_OK);
+		CHECK_EQ(ph.magic, PHOTO_MAGIC);
+		CHECK(ph.flags & PHOTO_FLAG_COMPLETE);
+		CHECK_EQ(ph.session_id, sh.session_id);
+		CHECK_EQ(ph.session_frame, n);
+		CHECK_EQ(ph.light_mode, e.light_mode);
+		CHECK_EQ(ph.crc32, Crcs[n]);
+		CHECK_EQ(ph.frame_us, FrameUs[n]);
+
+		CHECK_EQ(f_lseek(&f, e.offset + PHOTO_HEADER_SIZE), FR_OK);
+		CHECK_EQ(f_read(&f, pixels, sizeof(pixels), &br), FR_OK);
+		CHECK_EQ(CRC32_Final(CRC32_Update(CRC32_Init(), pixels, sizeof(pixels))), Crcs[n]);
+	}
+	f_close(&f);
+}
+
+static uint32_t SessionId(const char *name)
+{
+	static FIL f;
+	Session_HeaderTypeDef sh;
+	UINT br;
+
+	memset(&sh, 0, sizeof(sh));
+	CHECK_EQ(f_open(&f, name, FA_READ), FR_OK);
+	CHECK_EQ(f_read(&f, &sh, sizeof(sh), &br), FR_OK);
+	f_close(&f);
+	return sh.session_id;
+}
+
+int main(void)
+{
+	FILINFO fno;
+	uint8_t n;
+
+	Host_Reset();
+	Frame_Init(&FrameCfg);
+	srand(1);
+	CHECK_EQ(FsHost_Format(2048), FR_OK);
+	CHECK_EQ(Session_IsOpen(), 0);
+	CHECK(Session_Sink.open(1) != 0);				//会话未打开
+
+	//第一个会话：64个帧槽，写3帧，第4帧中途放弃后重写同一帧槽
+	CHECK_EQ(Session_Open(SESSION_MAX_FRAMES), FR_OK);
+	CHECK_EQ(strcmp(Session_FileName(), "SES_001.DAT"), 0);
+	CHECK_EQ(Session_MaxFrames(), SESSION_MAX_FRAMES);
+	CHECK_EQ(Session_Open(SESSION_MAX_FRAMES), FR_OK);	//已打开时不变
+	CHECK_EQ(strcmp(Session_FileName(), "SES_001.DAT"), 0);
+	for(n = 0; n < 3; n++) Crcs[n] = Shoot(1 + n, -1);
+	Shoot(1, 100);
+	CHECK_EQ(Session_FrameCount(), 3);
+	Crcs[3] = Shoot(2, -1);
+	CHECK_EQ(Session_FrameCount(), 4);
+	CHECK_EQ(Session_Close(), FR_OK);
+	CHECK_EQ(Session_IsOpen(), 0);
+	CHECK(Session_Sink.open(1) != 0);
+	CHECK_EQ(Session_Close(), FR_OK);				//已关闭时不变
+	Check("SES_001.DAT", 4, SESSION_MAX_FRAMES, SESSION_FLAG_CLOSED);
+
+	//再打开：下一个文件名；剩余空间放不下64、32帧，减半到16帧。写满后拒绝
+	//这个会话边读边写：帧写入期间打开帧槽，读到第120行时帧写完
+	CHECK_EQ(Session_Open(SESSION_MAX_FRAMES), FR_OK);
+	CHECK_EQ(strcmp(Session_FileName(), "SES_002.DAT"), 0);
+	CHECK_EQ(Session_MaxFrames(), 16);
+	StreamLine = CAPTURE_HEIGHT / 2;
+	for(n = 0; n < 16; n++)
+	{
+		Crcs[n] = Shoot(3, -1);
+		FrameUs[n] = FRAME_US;
+	}
+	StreamLine = -1;
+	CHECK(Session_IsFull());
+	CHECK(Session_Sink.open(1) != 0);
+	CHECK_EQ(Session_Close(), FR_OK);
+	Check("SES_002.DAT", 16, 16, SESSION_FLAG_CLOSED);
+
+	//连SESSION_MIN_FRAMES帧也放不下：失败，不留下空文件
+	CHECK_EQ(Session_Open(SESSION_MAX_FRAMES), FR_DENIED);
+	CHECK_EQ(Session_IsOpen(), 0);
+	CHECK_EQ(f_stat("SES_003.DAT", &fno), FR_NO_FILE);
+
+	//删除第一个会话后空出名字和空间；写2帧后掉电，重新挂载后按索引找到这2帧
+	CHECK_EQ(f_unlink("SES_001.DAT"), FR_OK);
+	CHECK_EQ(Session_Open(16), FR_OK);
+	CHECK_EQ(strcmp(Session_FileName(), "SES_001.DAT"), 0);
+	for(n = 0; n < 2; n++) Crcs[n] = Shoot(1, -1);
+	Shoot(1, 50);									//第3帧写到一半
+	CHECK_EQ(FsHost_Remount(), FR_OK);
+	Check("SES_001.DAT", 2, 16, 0);
+
+	//两个会话的ID不同，旧帧头不会被误认为属于新会话
+	CHECK(SessionId("SES_001.DAT") != SessionId("SES_002.DAT"));
+
+	CHECK_EQ(SdEmu_Errors, 0);
+	return TEST_RESULT();
+}
@@ -0,0 +1,217 @@
+//连续文件的原始多块写入：在碎片化的FAT上f_expand预分配，像素用一条CMD25直接写入，
+//写入期间不碰FAT和目录项，耗时与碎片无关；没有足够大的连续空闲区时返回FR_DENIED，改用f_write
+#include "stm32f10x.h"
+#include "storage.h"
+#include "capture.h"
+#include "fatfs.h"
+#include "sd_emu.h"
+#include "fs_host.h"
+#include "test.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMG_SIZE		(512 + CAPTURE_FRAME_SIZE)
+#define SMALL_FILES		400							//每个3000字节，占两簇
+
+static uint8_t Ref[CAPTURE_FRAME_SIZE];
+static uint8_t Bufs[3][CAPTURE_LINE_SIZE];
+static uint32_t Sent[3], Done[3];
+
+static void Done_Cb(const uint8_t *buf)
+{
+	uint8_t b;
+	for(b = 0; b < 3; b++)
+		if(buf == Bufs[b]) Done[b]++;
+}
+
+static uint32_t Commands(void)
+{
+	uint32_t i, n = 0;
+	for(i = 0; i < sizeof(SdEmu_CmdCount) / sizeof(SdEmu_CmdCount[0]); i++) n += SdEmu_CmdCount[i];
+	return n;
+}
+
+/* 写入期间写到数据区以外（FAT、根目录）的扇区 */
+static uint32_t MetaWrites;
+
+static void Write_Hook(uint32_t sector)
+{
+	if(sector < USERFatFS.database) MetaWrites++;
+}
+
+/* 拍一张：预分配后流式写入，不能流式写入时用f_write；返回流式写入的耗时（周期），0表示用了f_write */
+static uint64_t Shoot(const char *path, uint8_t seed, FRESULT expect_prealloc)
+{
+	static FIL f;
+	uint8_t hdr[512];
+	uint64_t t0, cycles = 0;
+	uint32_t cmds;
+	uint16_t l;
+	uint8_t b, sr;
+	UINT bw;
+
+	srand(seed);
+	for(l = 0; l < CAPTURE_HEIGHT; l++)
+		for(bw = 0; bw < CAPTURE_LINE_SIZE; bw++) Ref[l * CAPTURE_LINE_SIZE + bw] = (uint8_t)rand();
+	memset(hdr, seed, sizeof(hdr));
+	memset(Sent, 0, sizeof(Sent));
+	memset(Done, 0, sizeof(Done));
+
+	CHECK_EQ(f_open(&f, path, FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+	CHECK_EQ(Storage_Prealloc(&f, IMG_SIZE), expect_prealloc);
+	CHECK_EQ(f_write(&f, hdr, sizeof(hdr), &bw), FR_OK);
+	sr = Storage_StreamBegin(&f, 512, CAPTURE_FRAME_SIZE);
+	CHECK_EQ(sr, expect_prealloc == FR_OK ? 0 : 1);
+
+	t0 = Host_Cycles;
+	cmds = Commands();
+	MetaWrites = 0;
+	SdEmu_WriteHook = Write_Hook;
+	for(l = 0; l < CAPTURE_HEIGHT; l++)
+	{
+		b = l % 3;
+		CHECK_EQ(Done[b], Sent[b]);					//缓冲区归还后才再用
+		memcpy(Bufs[b], Ref + l * CAPTURE_LINE_SIZE, CAPTURE_LINE_SIZE);
+		if(sr == 0)
+		{
+			CHECK_EQ(Storage_StreamWrite(Bufs[b], CAPTURE_LINE_SIZE, Done_Cb), 0);
+			Sent[b]++;
+		}
+		else
+		{
+			CHECK_EQ(f_write(&f, Bufs[b], CAPTURE_LINE_SIZE, &bw), FR_OK);
+		}
+	}
+	if(sr == 0)
+	{
+		CHECK_EQ(Storage_StreamEnd(), 0);
+		cycles = Host_Cycles - t0;
+		CHECK_EQ(SdEmu_PreErase, CAPTURE_FRAME_SIZE / 512);	//StreamBegin发出的一条CMD25写完全部像素，
+		CHECK_EQ(Commands(), cmds);					//之后不再有命令
+		CHECK_EQ(MetaWrites, 0);
+	}
+	SdEmu_WriteHook = 0;
+	for(b = 0; b < 3; b++) CHECK_EQ(Done[b], Sent[b]);
+
+	CHECK_EQ(f_close(&f), FR_OK);
+	return cycles;
+}
+
+static void Verify(const char *path, uint8_t seed)
+{
+	static uint8_t rb[IMG_SIZE];
+	static FIL f;
+	uint32_t i;
+	UINT br;
+
+	srand(seed);
+	for(i = 0; i < CAPTURE_FRAME_SIZE; i++) Ref[i] = (uint8_t)rand();
+	CHECK_EQ(f_open(&f, path, FA_READ), FR_OK);
+	CHECK_EQ(f_size(&f), IMG_SIZE);
+	CHECK_EQ(f_read(&f, rb, sizeof(rb), &br), FR_OK);
+	CHECK_EQ(br, IMG_SIZE);
+	f_close(&f);
+	CHECK(rb[0] == seed && rb[511] == seed);
+	CHECK(memcmp(rb + 512, Ref, CAPTURE_FRAME_SIZE) == 0);
+}
+
+static void Name(char *name, uint16_t n)
+{
+	sprintf(name, "FRAG/F%03u.BIN", n);
+}
+
+int main(void)
+{
+	static uint8_t small[3000];
+	static uint8_t fill[32768];
+	static FIL f;
+	uint64_t t_clean, t_frag;
+	uint32_t cmd25;
+	char name[20];
+	uint16_t n;
+	UINT bw;
+
+	Host_Reset();
+	CHECK_EQ(FsHost_Format(2048), FR_OK);			//4扇区一簇
+
+	//空卡上的耗时作为基准
+	t_clean = Shoot("IMG_0.DAT", 10, FR_OK);
+	CHECK(t_clean > 0);
+
+	//碎片化：一簇一簇隔开的小文件，删掉一半，留下SMALL_FILES/2个两簇的空洞
+	CHECK_EQ(f_mkdir("FRAG"), FR_OK);
+	for(n = 0; n < SMALL_FILES; n++)
+	{
+		Name(name, n);
+		memset(small, (uint8_t)n, sizeof(small));
+		CHECK_EQ(FsHost_WriteFile(name, small, sizeof(small)), FR_OK);
+	}
+	for(n = 0; n < SMALL_FILES; n += 2)
+	{
+		Name(name, n);
+		CHECK_EQ(f_unlink(name), FR_OK);
+	}
+
+	//空洞放不下，预分配在后面找到连续的一段：一段簇链，耗时与空卡相同
+	t_frag = Shoot("IMG_1.DAT", 11, FR_OK);
+	CHECK_EQ(FsHost_Fragments("IMG_1.DAT"), 1);
+	CHECK(t_frag > 0);
+	CHECK(t_frag < t_clean + t_clean / 50 && t_clean < t_frag + t_frag / 50);
+	printf("stream %lu us on empty card, %lu us on fragmented card\n",
+		(unsigned long)(t_clean / 72), (unsigned long)(t_frag / 72));
+
+	//填满剩余空间，只剩两簇的空洞：没有连续空闲区，文件不变，改用f_write，写成多段
+	CHECK_EQ(f_open(&f, "BIG.BIN", FA_CREATE_ALWAYS | FA_WRITE), FR_OK);
+	while(f_write(&f, fill, sizeof(fill), &bw) == FR_OK && bw == sizeof(fill));
+	CHECK_EQ(f_close(&f), FR_OK);
+	for(n = 1; n < SMALL_FILES; n += 4)
+	{
+		Name(name, n);
+		CHECK_EQ(f_unlink(name), FR_OK);
+	}
+	CHECK_EQ(Shoot("IMG_2.DAT", 12, FR_DENIED), 0);
+	CHECK(FsHost_Fragments("IMG_2.DAT") > 1);
+
+	//长度足够但不连续的文件：不能直接写扇区，卡上不写任何数据（Verify检查其他文件没有被覆盖）
+	CHECK_EQ(f_open(&f, "IMG_2.DAT", FA_WRITE), FR_OK);
+	MetaWrites = 0;
+	cmd25 = SdEmu_CmdCount[25];
+	SdEmu_WriteHook = Write_Hook;
+	CHECK_EQ(Storage_StreamBegin(&f, 512, CAPTURE_FRAME_SIZE), 1);
+	CHECK_EQ(Storage_WriteSector(&f, IMG_SIZE - 512, 0, 0), 1);
+	SdEmu_WriteHook = 0;
+	CHECK_EQ(SdEmu_CmdCount[25], cmd25);
+	CHECK_EQ(MetaWrites, 0);
+	CHECK_EQ(f_close(&f), FR_OK);
+
+	//不是本次预分配的连续文件：遍历簇链确认后可以直接写扇区
+	CHECK_EQ(f_open(&f, "IMG_1.DAT", FA_WRITE), FR_OK);
+	memset(fill, 11, 512);
+	CHECK_EQ(Storage_WriteSector(&f, 0, fill, 512), 0);
+	CHECK_EQ(f_close(&f), FR_OK);
+
+	//释放大文件后又有连续空间
+	CHECK_EQ(f_unlink("BIG.BIN"), FR_OK);
+	CHECK(Shoot("IMG_3.DAT", 13, FR_OK) > 0);
+	CHECK_EQ(FsHost_Fragments("IMG_3.DAT"), 1);
+
+	//重新挂载：目录项和FAT已写到卡上，其他文件没有被覆盖
+	CHECK_EQ(FsHost_Remount(), FR_OK);
+	Verify("IMG_0.DAT", 10);
+	Verify("IMG_1.DAT", 11);
+	Verify("IMG_2.DAT", 12);
+	Verify("IMG_3.DAT", 13);
+	for(n = 3; n < SMALL_FILES; n += 4)
+	{
+		Name(name, n);
+		CHECK_EQ(f_open(&f, name, FA_READ), FR_OK);
+		CHECK_EQ(f_read(&f, small, sizeof(small), &bw), FR_OK);
+		CHECK_EQ(bw, sizeof(small));
+		CHECK(small[0] == (uint8_t)n && small[sizeof(small) - 1] == (uint8_t)n);
+		f_close(&f);
+	}
+
+	CHECK_EQ(SdEmu_Errors, 0);
+	return TEST_RESULT();
+}
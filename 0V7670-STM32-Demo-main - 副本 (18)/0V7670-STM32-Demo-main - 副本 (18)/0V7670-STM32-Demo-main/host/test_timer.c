@@ -0,0 +1,159 @@
+//TIM2微秒时间：溢出中断扩展高位，关中断期间（或在更高优先级中断中）溢出未处理时由UIF补上，
+//读CNT和读SR之间溢出时重读CNT；计数器自由运行时在每个相位溢出都单调、与实际时间一致
+#include "stm32f10x.h"
+#include "timer.h"
+#include "test.h"
+
+void TIM2_IRQHandler(void);
+
+static uint8_t Script;				//1：下一次访问TIM2寄存器时溢出
+static uint8_t Running;				//1：每次访问TIM2寄存器计数器加1（1us）
+static uint64_t Time;				//自由运行时的实际时间
+static uint32_t Irqs;
+
+static void Overflow(uint16_t cnt)
+{
+	Host_TIM2.CNT = cnt;
+	Host_TIM2.SR |= TIM_SR_UIF;
+}
+
+static void Tim2_Hook(void)
+{
+	if(Script && --Script == 0)
+		Overflow(1);
+	if(Running)
+	{
+		Time++;
+		Host_TIM2.CNT = (uint16_t)Time;
+		if((uint16_t)Time == 0)
+			Host_TIM2.SR |= TIM_SR_UIF;
+	}
+}
+
+static void Irq_Hook(void)
+{
+	if((Host_TIM2.SR & TIM_SR_UIF) && (Host_TIM2.DIER & TIM_DIER_UIE))
+	{
+		Irqs++;
+		TIM2_IRQHandler();
+	}
+}
+
+static void Test_Init(void)
+{
+	TIMER_Init();
+	CHECK_EQ(Host_TIM2.PSC, 71);
+	CHECK_EQ(Host_TIM2.ARR, 0XFFFF);
+	CHECK(Host_TIM2.DIER & TIM_DIER_UIE);
+	CHECK(Host_TIM2.CR1 & TIM_CR1_CEN);
+	CHECK_EQ(Host_TIM2.SR & TIM_SR_UIF, 0);
+	CHECK_EQ(TIMER_Micros64(), 0);
+	Host_TIM2.CNT = 1234;
+	CHECK_EQ(TIMER_Micros64(), 1234);
+	CHECK_EQ(Irqs, 0);
+}
+
+static void Test_Pending(void)
+{
+	uint8_t i;
+
+	//开着中断：溢出中断加高位并清标志
+	Overflow(5);
+	Host_SetPrimask(0);
+	CHECK_EQ(Irqs, 1);
+	CHECK_EQ(Host_TIM2.SR & TIM_SR_UIF, 0);
+	CHECK_EQ(TIMER_Micros64(), 0X10000 + 5);
+
+	//关中断期间溢出：中断还没处理，读到的已经包含这次溢出
+	Host_Primask = 1;
+	Overflow(3);
+	CHECK_EQ(TIMER_Micros64(), 0X20000 + 3);
+	CHECK_EQ(TIMER_Micros64(), 0X20000 + 3);
+	CHECK(Host_TIM2.SR & TIM_SR_UIF);
+	CHECK_EQ(Host_Primask, 1);					//恢复调用前的PRIMASK
+	Host_SetPrimask(0);
+	CHECK_EQ(Irqs, 2);
+	CHECK_EQ(TIMER_Micros64(), 0X20000 + 3);
+
+	//秒计数：第16次溢出时过了1s
+	CHECK_EQ(TIM_Seconds, 0);
+	for(i = 2; i < 16; i++)
+	{
+		Overflow(0);
+		Host_SetPrimask(0);
+	}
+	CHECK_EQ(TIM_Seconds, 1);
+	CHECK_EQ(TIM_1S, 1);
+	CHECK_EQ(TIMER_Micros64(), 16 * 0X10000);
+	CHECK_EQ(TIMER_Millis(), 16 * 0X10000 / 1000);
+}
+
+static void Test_Race(void)
+{
+	uint64_t base = TIMER_Micros64() & ~0XFFFFULL;
+
+	//读CNT（0xFFFF）之后、读SR之前溢出：高位加一，CNT须重读，否则快了65535us
+	Host_Primask = 1;
+	Host_TIM2.CNT = 0XFFFF;
+	Script = 2;
+	CHECK_EQ(TIMER_Micros64(), base + 0X10000 + 1);
+	Host_SetPrimask(0);
+	CHECK_EQ(TIMER_Micros64(), base + 0X10000 + 1);
+
+	//开着中断调用时同样：TIMER_Micros64内关中断，溢出中断在返回后才执行
+	Host_TIM2.CNT = 0XFFFF;
+	Script = 2;
+	CHECK_EQ(TIMER_Micros64(), base + 0X20000 + 1);
+	CHECK_EQ(Host_TIM2.SR & TIM_SR_UIF, 0);
+	CHECK_EQ(TIMER_Micros64(), base + 0X20000 + 1);
+}
+
+static void Test_Running(void)
+{
+	uint64_t before, t, last = 0;
+	uint32_t i, irqs = Irqs;
+	uint8_t masked;
+
+	//从当前时刻自由运行：每次调用访问TIM2两三次，溢出落在调用中的每个位置；
+	//部分调用在关中断（更高优先级中断）中进行，最长约1000us，短于一个溢出周期
+	Time = TIMER_Micros64();
+	Running = 1;
+	for(i = 0; i < 1000000; i++)
+	{
+		masked = (i / 337) % 3 == 0;
+		if(masked) Host_Primask = 1;
+		before = Time;
+		t = TIMER_Micros64();
+		CHECK(t >= before && t <= Time);
+		CHECK(t > last);
+		if(t <= last || t < before || t > Time)
+			break;
+		last = t;
+		if(masked) Host_SetPrimask(0);
+	}
+	Running = 0;
+	Host_SetPrimask(0);
+	CHECK(Irqs - irqs >= 30);
+
+	//超时时刻
+	Host_TIM2.CNT = 0X100;
+	t = TIMER_Deadline(100);
+	CHECK(!TIMER_Expired(t));
+	Host_TIM2.CNT += 99;
+	CHECK(!TIMER_Expired(t));
+	Host_TIM2.CNT += 1;
+	CHECK(TIMER_Expired(t));
+}
+
+int main(void)
+{
+	Host_Reset();
+	Host_Tim2Hook = Tim2_Hook;
+	Host_IrqHook = Irq_Hook;
+
+	Test_Init();
+	Test_Pending();
+	Test_Race();
+	Test_Running();
+	return TEST_RESULT();
+}
@@ -0,0 +1,155 @@
+//串口DMA发送队列：输出顺序、缓冲池和队列满时的等待，关中断或DMA中断不能响应时不卡死
+#include "stm32f10x.h"
+#include "USART.h"
+#include "test.h"
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+void DMA1_Channel4_IRQHandler(void);
+
+#define BYTE_CYCLES		781				//921600波特，每字节10位
+
+static uint8_t Out[65536];
+static uint32_t OutLen;
+static uint8_t IsrEnabled;			//0：模拟DMA中断不能响应（优先级不够）
+static uint32_t IsrCalls;
+
+/* DMA1通道4：使能后按波特率计时，完成时把数据“发出”并置TC4 */
+static uint8_t TxActive;
+static uint64_t TxDoneAt;
+
+static void Dma_Hook(void)
+{
+	DMA_Channel_TypeDef *ch = &Host_DMA1_Channel[4];
+
+	if(!TxActive && (ch->CCR & DMA_CCR4_EN) && ch->CNDTR)
+	{
+		TxActive = 1;
+		TxDoneAt = Host_Cycles + (uint64_t)ch->CNDTR * BYTE_CYCLES;
+	}
+	if(TxActive && Host_Cycles >= TxDoneAt)
+	{
+		CHECK(OutLen + ch->CNDTR <= sizeof(Out));
+		memcpy(Out + OutLen, Host_DmaPtr(ch->CMAR), ch->CNDTR);
+		OutLen += ch->CNDTR;
+		ch->CNDTR = 0;
+		TxActive = 0;
+		Host_DMA1.ISR |= DMA1_FLAG_TC4 | DMA1_FLAG_GL4;
+	}
+}
+
+//开着中断时TC4立即进入DMA中断
+static void Irq_Hook(void)
+{
+	if(IsrEnabled && (Host_DMA1.ISR & DMA1_FLAG_TC4))
+	{
+		IsrCalls++;
+		DMA1_Channel4_IRQHandler();
+	}
+}
+
+/* 发送完成回调 */
+static const uint8_t *DoneBufs[64];
+static uint8_t DoneCount;
+
+static void Done(const uint8_t *buf)
+{
+	DoneBufs[DoneCount++] = buf;
+}
+
+static void Watchdog(int sig)
+{
+	(void)sig;
+	printf("test_usart: hung waiting for the DMA (OutLen=%lu)\n", (unsigned long)OutLen);
+	exit(1);
+}
+
+//写入大量文本，超过缓冲池和描述符队列，检查输出完整且有序
+static void Test_Text(uint8_t primask)
+{
+	static char expect[32768];
+	uint32_t n = 0;
+	uint16_t i;
+	char line[48];
+
+	OutLen = 0;
+	Host_Primask = primask;
+	for(i = 0; i < 600; i++)
+	{
+		sprintf(line, "line %u of the report\r\n", i);
+		strcpy(expect + n, line);
+		n += strlen(line);
+		if(i % 3 == 0)
+			Serial_Printf("%s", line);
+		else
+			Serial_SendString(line);
+	}
+	Serial_Flush();
+	Host_Primask = 0;
+
+	CHECK_EQ(OutLen, n);
+	CHECK(memcmp(Out, expect, n) == 0);
+}
+
+//异步发送：队列满时等待，回调按顺序执行，数据不复制
+static void Test_Async(uint8_t primask)
+{
+	static uint8_t blocks[20][100];
+	uint8_t i;
+
+	OutLen = 0;
+	DoneCount = 0;
+	Host_Primask = primask;
+	for(i = 0; i < 20; i++)
+	{
+		memset(blocks[i], 'A' + i, sizeof(blocks[i]));
+		Serial_SendArrayAsync(blocks[i], sizeof(blocks[i]), Done);
+	}
+	Serial_Flush();
+	Serial_SendArrayAsync(blocks[0], 0, Done);	//长度为0立即回调
+	Host_Primask = 0;
+
+	CHECK_EQ(OutLen, 20 * 100);
+	CHECK_EQ(DoneCount, 21);
+	CHECK(DoneBufs[20] == blocks[0]);
+	for(i = 0; i < 20; i++)
+	{
+		CHECK(DoneBufs[i] == blocks[i]);
+		CHECK(Out[i * 100] == 'A' + i && Out[i * 100 + 99] == 'A' + i);
+	}
+}
+
+int main(void)
+{
+	Host_Reset();
+	Host_DmaHook = Dma_Hook;
+	Host_IrqHook = Irq_Hook;
+	signal(SIGALRM, Watchdog);
+	alarm(20);
+
+	Serial_Init();
+	CHECK_EQ(Host_DMA1_Channel[4].CPAR, (uint32_t)&Host_USART1.DR);
+	CHECK(Host_DMA1_Channel[4].CCR & DMA_CCR4_DIR);
+	CHECK(Host_USART1.CR3 & USART_DMAReq_Tx);
+
+	//DMA中断正常响应
+	IsrEnabled = 1;
+	Test_Text(0);
+	Test_Async(0);
+	CHECK(IsrCalls > 0);
+
+	//关中断调用：只能靠发送函数查询完成标志
+	Test_Text(1);
+	Test_Async(1);
+
+	//在优先级不低于DMA1通道4的中断中调用：开着中断，但DMA中断进不去
+	IsrEnabled = 0;
+	IsrCalls = 0;
+	Test_Text(0);
+	Test_Async(0);
+	CHECK_EQ(IsrCalls, 0);
+
+	return TEST_RESULT();
+}